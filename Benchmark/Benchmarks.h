@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace Benchmark {
+
+// each returns the process exit code, args are the launch args after the benchmark name
+
+// cpu projection of the skybox to sh irradiance in every mode, then the error against the cached irradiance cubemap.
+// fails if the cubemap is missing or the error exceeds the tolerance
+int shIrradiance(const std::vector<std::string>& args);
+// open addressing vertex weld of Util::Model::TinyObj against the baseline unordered_map weld and its hash, on an obj relative to Resources.
+// fails if either index stream does not reproduce the source vertices
+int meshWeld(const std::vector<std::string>& args);
+// Util::Model::buildMeshlets on a flat grid, checks the vertex and triangle limits, index coverage, bounding spheres,
+// and isMeshletVisible against known cones and frustum planes. fails on the first violated check
+int meshlet(const std::vector<std::string>& args);
+
+}
@@ -0,0 +1,169 @@
+#include "Benchmarks.h"
+#include "Util/Meshutil.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Benchmark {
+
+namespace {
+
+// meshlet.cull.comp and the per mesh index buffer it compacts into are sized for these
+static_assert(Util::Model::MESHLET_MAX_VERTICES == 64, "meshlet vertex limit changed");
+static_assert(Util::Model::MESHLET_MAX_TRIANGLES == 124, "meshlet triangle limit changed");
+
+// a flat grid of size x size quads in the z = 0 plane, counter clockwise seen from +z, so every cone opens towards +z
+Util::Model::MeshData makeGrid(uint32_t size)
+{
+    Util::Model::MeshData meshData;
+    meshData.name = "grid";
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            Util::Model::VertexData vertex{};
+            vertex.position = glm::vec4((float)x, (float)y, 0.0f, 1.0f);
+            vertex.normal = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+            meshData.vertices.push_back(vertex);
+        }
+    }
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint32_t i = y * (size + 1) + x;
+            meshData.indices.insert(meshData.indices.end(), { i, i + 1, i + size + 2, i, i + size + 2, i + size + 1 });
+        }
+    }
+    meshData.ComputeBounds();
+    return meshData;
+}
+
+// the triangles of the first indexCount indices, each rotated to start at its smallest index so the winding is kept
+std::multiset<std::array<uint32_t, 3>> triangleSet(const std::vector<uint32_t>& indices, size_t indexCount)
+{
+    std::multiset<std::array<uint32_t, 3>> triangles;
+    for (size_t i = 0; i + 3 <= indexCount; i += 3)
+    {
+        std::array<uint32_t, 3> triangle { indices[i], indices[i + 1], indices[i + 2] };
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.insert(triangle);
+    }
+    return triangles;
+}
+
+// strictly inside the clip volume of both the gl and the vulkan depth range
+bool insideClipVolume(const glm::mat4& mvp, const glm::vec4& position)
+{
+    glm::vec4 clip = mvp * position;
+    return clip.w > 0.0f && std::abs(clip.x) < clip.w && std::abs(clip.y) < clip.w && clip.z > 0.0f && clip.z < clip.w;
+}
+
+bool check(bool condition, const std::string& what)
+{
+    if (!condition)
+    {
+        std::cout << "[Benchmark] meshlet check failed: " << what << std::endl;
+    }
+    return condition;
+}
+
+}
+
+int meshlet(const std::vector<std::string>& args)
+{
+    using namespace Util::Model;
+    const uint32_t gridSize = 64;
+    MeshData meshData = makeGrid(gridSize);
+    const auto sourceTriangles = triangleSet(meshData.indices, meshData.indices.size());
+
+    auto tStart = std::chrono::high_resolution_clock::now();
+    buildMeshlets(meshData);
+    auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+    std::cout << "[Benchmark] " << gridSize << "x" << gridSize << " grid, " << sourceTriangles.size() << " triangles in "
+              << meshData.meshlets.size() << " meshlets, built in " << tDiff << " ms" << std::endl;
+
+    // limits, contiguous coverage of lod 0 and bounding spheres
+    std::string error;
+    if (!check(!meshData.meshlets.empty(), "no meshlets built")
+        || !check(validateMeshlets(meshData, &error), error)
+        || !check(triangleSet(meshData.indices, meshData.GetLod(0).indexCount) == sourceTriangles, "the meshlets changed the triangle set"))
+    {
+        return -1;
+    }
+
+    const std::array<glm::vec4, 6> noPlanes {};
+    for (size_t i = 0; i < meshData.meshlets.size(); i++)
+    {
+        const Meshlet& meshlet = meshData.meshlets[i];
+        std::set<uint32_t> vertices(meshData.indices.begin() + meshlet.indexOffset, meshData.indices.begin() + meshlet.indexOffset + meshlet.triangleCount * 3);
+        if (!check(meshlet.triangleCount > 0 && meshlet.triangleCount <= MESHLET_MAX_TRIANGLES && vertices.size() <= MESHLET_MAX_VERTICES,
+                   "meshlet " + std::to_string(i) + " has " + std::to_string(meshlet.triangleCount) + " triangles and " + std::to_string(vertices.size()) + " vertices"))
+        {
+            return -1;
+        }
+
+        glm::vec3 center = glm::vec3(meshlet.sphere);
+        // flat and facing +z: seen from above it is front facing, from below every triangle is back facing
+        if (!check(isMeshletVisible(meshlet, noPlanes, center + glm::vec3(0.0f, 0.0f, 10.0f), false, true), "meshlet " + std::to_string(i) + " cone culled from the front")
+            || !check(!isMeshletVisible(meshlet, noPlanes, center - glm::vec3(0.0f, 0.0f, 10.0f), false, true), "meshlet " + std::to_string(i) + " cone kept from behind"))
+        {
+            return -1;
+        }
+    }
+
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+    const float half = gridSize * 0.5f;
+
+    // looking down at one corner: some meshlets are in view, and none that has a vertex in view may be culled
+    {
+        const glm::vec3 eye(half * 0.5f, half * 0.5f, 10.0f);
+        const glm::mat4 mvp = proj * glm::lookAt(eye, glm::vec3(eye.x, eye.y, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const auto planes = extractFrustumPlanes(mvp);
+        size_t visible = 0;
+        for (size_t i = 0; i < meshData.meshlets.size(); i++)
+        {
+            const Meshlet& meshlet = meshData.meshlets[i];
+            bool inView = false;
+            for (uint32_t j = 0; j < meshlet.triangleCount * 3 && !inView; j++)
+            {
+                inView = insideClipVolume(mvp, meshData.vertices[meshData.indices[meshlet.indexOffset + j]].position);
+            }
+            bool kept = isMeshletVisible(meshlet, planes, eye, true, false);
+            visible += kept ? 1 : 0;
+            if (!check(!inView || kept, "meshlet " + std::to_string(i) + " in view but frustum culled"))
+            {
+                return -1;
+            }
+        }
+        if (!check(visible > 0 && visible < meshData.meshlets.size(), "the corner view keeps " + std::to_string(visible) + " meshlets"))
+        {
+            return -1;
+        }
+    }
+
+    // looking away from the grid: it is behind the near plane, everything is culled
+    {
+        const glm::vec3 eye(half, half, 10.0f);
+        const glm::mat4 mvp = proj * glm::lookAt(eye, glm::vec3(half, half, 20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const auto planes = extractFrustumPlanes(mvp);
+        for (size_t i = 0; i < meshData.meshlets.size(); i++)
+        {
+            if (!check(!isMeshletVisible(meshData.meshlets[i], planes, eye, true, false), "meshlet " + std::to_string(i) + " kept behind the camera"))
+            {
+                return -1;
+            }
+        }
+    }
+
+    std::cout << "[Benchmark] meshlet checks passed" << std::endl;
+    return 0;
+}
+
+}
@@ -0,0 +1,71 @@
+#include "Benchmarks.h"
+#include "Runtime/Render/Prefilter/SHIrradiance.h"
+#include "Runtime/VulkanRHI/Graphic/ModelPresets.h"
+#include "Util/Textureutil.h"
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <iostream>
+
+namespace Benchmark {
+
+namespace {
+
+// nine L2 terms reproduce the cosine convolved irradiance within a few percent for typical environments,
+// the rest is left for the sampling noise of the compute generated reference. the skybox is ldr, so the irradiance stays within [0, 1]
+constexpr float MAX_RELATIVE_ERROR = 0.05f;
+constexpr float MAX_RMS_ERROR = 0.03f;
+
+// Ibl writes <skybox stem>.irradiance.<key>.ktx2 next to the skybox, see Render::Prefilter::IblCache
+boost::filesystem::path findCachedIrradiance(const boost::filesystem::path& skyboxPath)
+{
+    const std::string prefix = skyboxPath.stem().string() + ".irradiance.";
+    for (const auto& entry : boost::filesystem::directory_iterator(skyboxPath.parent_path()))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 && entry.path().extension() == ".ktx2")
+        {
+            return entry.path();
+        }
+    }
+    return {};
+}
+
+}
+
+int shIrradiance(const std::vector<std::string>& args)
+{
+    using Render::Prefilter::SHIrradiance;
+    const boost::filesystem::path skyboxPath = RHI::ModelPresets::GetSkyboxTexturePath();
+    auto envRawData = Util::Texture::RawData::Load(skyboxPath, Util::Texture::RawData::Format::eRgbAlpha, true, vk::Format::eR8G8B8A8Unorm);
+    if (!envRawData)
+    {
+        std::cout << "[Benchmark] load skybox failed: " << skyboxPath.string() << std::endl;
+        return -1;
+    }
+    SHIrradiance::Benchmark(envRawData.get());
+
+    // an explicit cubemap or the one the renderer cached
+    boost::filesystem::path irradiancePath = args.empty() ? findCachedIrradiance(skyboxPath) : boost::filesystem::path(args[0]);
+    if (irradiancePath.empty())
+    {
+        std::cout << "[Benchmark] no cached irradiance cubemap next to " << skyboxPath.string() << ", run the pbr demo once to write it" << std::endl;
+        return -1;
+    }
+    auto irradianceRawData = Util::Texture::RawData::Load(irradiancePath, Util::Texture::RawData::Format::eRgbAlpha, true, vk::Format::eR32G32B32A32Sfloat);
+    if (!irradianceRawData)
+    {
+        std::cout << "[Benchmark] load irradiance cubemap failed: " << irradiancePath.string() << std::endl;
+        return -1;
+    }
+    auto error = SHIrradiance::CompareWithCubeMap(SHIrradiance::ProjectCubeMap(envRawData.get()), irradianceRawData.get());
+    std::cout << "[Benchmark] sh irradiance vs " << irradiancePath.filename().string() << ": max abs " << error.maxAbs
+              << ", rms " << error.rms << ", relative " << error.relative << std::endl;
+    if (error.relative > MAX_RELATIVE_ERROR || error.rms > MAX_RMS_ERROR)
+    {
+        std::cout << "[Benchmark] sh irradiance exceeds the tolerance: rms " << MAX_RMS_ERROR << ", relative " << MAX_RELATIVE_ERROR << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,158 @@
+#include "Benchmarks.h"
+#include "Runtime/VulkanRHI/Graphic/Vertex.h"
+#include "Util/Fileutil.h"
+#include "Util/Objweldutil.h"
+#include <boost/filesystem/path.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include <tiny_obj_loader.h>
+
+namespace Benchmark {
+
+namespace {
+
+constexpr uint32_t ITERATIONS = 10;
+
+struct WeldResult
+{
+    std::vector<Util::Model::VertexData> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// the std::hash<RHI::Vertex> TinyObj welded with before the open addressing table, kept verbatim for the comparison
+struct BaselineVertexHash
+{
+    size_t operator()(const RHI::Vertex& vertex) const
+    {
+        return
+            std::hash<glm::vec3>()(glm::vec3(vertex.position)) ^ (std::hash<glm::vec2>()(glm::vec2(vertex.texCoord)) << 1) >> 1
+            ^ ((std::hash<glm::vec2>()(glm::vec2(vertex.texCoord)) << 1) >> 1)
+            ^ ((std::hash<glm::vec3>()(glm::vec3(vertex.normal)) << 1) >> 1)
+            ^ ((std::hash<glm::vec3>()(glm::vec3(vertex.tangent)) << 1) >> 1)
+            ^ ((std::hash<glm::vec3>()(glm::vec3(vertex.bitangent)) << 1) >> 1);
+    }
+};
+
+// the open addressing weld of Util::Model::TinyObj, on the (position, texcoord) index pair
+void weld(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, size_t indexCount, WeldResult& result)
+{
+    result.vertices.clear();
+    result.indices.clear();
+    result.indices.reserve(indexCount);
+    Util::Model::VertexWelder welder(indexCount);
+    for (const auto& shape : shapes)
+    {
+        for (const auto& index : shape.mesh.indices)
+        {
+            uint32_t vertexIdx = 0;
+            if (!welder.FindOrInsert(Util::Model::VertexWelder::PackKey(index), (uint32_t)result.vertices.size(), vertexIdx))
+            {
+                result.vertices.emplace_back(Util::Model::makeObjVertex(attrib, index));
+            }
+            result.indices.push_back(vertexIdx);
+        }
+    }
+}
+
+// the baseline weld: one vertex per index, looked up by value with the baseline hash
+void referenceWeld(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, size_t indexCount, WeldResult& result)
+{
+    result.vertices.clear();
+    result.indices.clear();
+    result.indices.reserve(indexCount);
+    std::unordered_map<RHI::Vertex, uint32_t, BaselineVertexHash> uniqueVertices;
+    for (const auto& shape : shapes)
+    {
+        for (const auto& index : shape.mesh.indices)
+        {
+            RHI::Vertex vertex = Util::Model::makeObjVertex(attrib, index);
+            auto it = uniqueVertices.find(vertex);
+            if (it == uniqueVertices.end())
+            {
+                it = uniqueVertices.emplace(vertex, (uint32_t)result.vertices.size()).first;
+                result.vertices.push_back(vertex);
+            }
+            result.indices.push_back(it->second);
+        }
+    }
+}
+
+// index pairs with equal values stay separate vertices in the open addressing weld, so the counts may differ.
+// both index streams must give back the vertex of every source index
+bool reproducesSource(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, const WeldResult& result)
+{
+    size_t i = 0;
+    for (const auto& shape : shapes)
+    {
+        for (const auto& index : shape.mesh.indices)
+        {
+            if (i >= result.indices.size() || result.indices[i] >= result.vertices.size()
+                || !(result.vertices[result.indices[i]] == Util::Model::makeObjVertex(attrib, index)))
+            {
+                return false;
+            }
+            i++;
+        }
+    }
+    return i == result.indices.size();
+}
+
+template<typename Fn>
+double bestOf(Fn&& fn)
+{
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < ITERATIONS; i++)
+    {
+        auto tStart = std::chrono::high_resolution_clock::now();
+        fn();
+        bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+    }
+    return bestMs;
+}
+
+}
+
+int meshWeld(const std::vector<std::string>& args)
+{
+    // relative paths are resolved against Resources
+    boost::filesystem::path objPath = args.empty() ? boost::filesystem::path("Model/viking_room.obj") : boost::filesystem::path(args[0]);
+    if (objPath.is_relative())
+    {
+        objPath = Util::File::getResourcePath() / objPath;
+    }
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objPath.string().c_str()))
+    {
+        std::cout << "[Benchmark] load obj failed: " << warn << err << std::endl;
+        return -1;
+    }
+    size_t indexCount = 0;
+    for (const auto& shape : shapes)
+    {
+        indexCount += shape.mesh.indices.size();
+    }
+
+    WeldResult welded, reference;
+    double ms = bestOf([&]() { weld(attrib, shapes, indexCount, welded); });
+    double referenceMs = bestOf([&]() { referenceWeld(attrib, shapes, indexCount, reference); });
+    std::cout << "[Benchmark] " << objPath.filename().string() << " weld of " << indexCount << " indices, best of " << ITERATIONS << std::endl;
+    std::cout << "[Benchmark]   open addressing: " << welded.vertices.size() << " vertices in " << ms << " ms" << std::endl;
+    std::cout << "[Benchmark]   baseline unordered_map: " << reference.vertices.size() << " vertices in " << referenceMs
+              << " ms, speed-up " << (ms > 0.0 ? referenceMs / ms : 0.0) << "x" << std::endl;
+    if (!reproducesSource(attrib, shapes, welded) || !reproducesSource(attrib, shapes, reference))
+    {
+        std::cout << "[Benchmark] a welded index stream does not reproduce the source vertices" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,31 @@
+#include "Benchmarks.h"
+#include "Util/Fileutil.h"
+#include <boost/filesystem/path.hpp>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    const std::map<std::string, std::function<int(const std::vector<std::string>&)>> benchmarks
+    {
+        {"sh", Benchmark::shIrradiance},
+        {"weld", Benchmark::meshWeld},
+        {"meshlet", Benchmark::meshlet},
+    };
+
+    if (argc < 3 || benchmarks.find(argv[2]) == benchmarks.end())
+    {
+        std::cout << "usage: VulkanRHIBenchmark <path of Resources> <benchmark> [args]" << std::endl;
+        std::cout << "  sh       sh irradiance projection modes, error against the cached irradiance cubemap" << std::endl;
+        std::cout << "  weld     tinyobj vertex weld against the baseline unordered_map weld, [obj] defaults to Model/viking_room.obj" << std::endl;
+        std::cout << "  meshlet  meshlet build of a 64x64 grid, checks limits, coverage, bounds, cones and frustum culling" << std::endl;
+        return -1;
+    }
+
+    Util::File::setExePath(argv[0]);
+    Util::File::setResourcePath(argv[1]);
+    return benchmarks.at(argv[2])(std::vector<std::string>(argv + 3, argv + argc));
+}
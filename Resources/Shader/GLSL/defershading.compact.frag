@@ -0,0 +1,116 @@
+#version 450
+
+layout (set = 1, binding = 2) uniform sampler2D samplerNormal;
+layout (set = 1, binding = 3) uniform sampler2D samplerAlbedo;
+layout (set = 1, binding = 4) uniform sampler2D samplerDepth;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+layout(binding = 3) uniform CustomLargeLightUBO
+{
+	vec4 header;
+	mat4 viewProjMatrix[100];
+	vec4 position_near[100];
+	vec4 color_far[100];
+	vec4 direction[100];
+} lightUbo;
+
+
+
+layout(push_constant) uniform PushConsts {
+	layout (offset = 0) int showDebugTarget;
+	layout (offset = 4) float renderScale;
+	layout (offset = 16) mat4 invViewProj;
+} consts;
+
+vec3 octDecode(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv, float depth)
+{
+	vec4 world = consts.invViewProj * vec4(uv * 2.0 - 1.0, depth, 1.0);
+	return world.xyz / world.w;
+}
+
+void main()
+{
+	// Get G-Buffer values
+	// gbuffer is only filled in its top left renderScale part, inUV stays the screen position
+	vec2 gbufferUV = inUV * consts.renderScale;
+	float depth = texture(samplerDepth, gbufferUV).r;
+	vec3 fragPos = reconstructPosition(inUV, depth);
+	vec3 normal = octDecode(texture(samplerNormal, gbufferUV).rg);
+	vec4 albedo = texture(samplerAlbedo, gbufferUV);
+
+	// Debug display
+	if (consts.showDebugTarget > 0) {
+		switch (consts.showDebugTarget) {
+			case 1:
+				outFragcolor.rgb = fragPos;
+				break;
+			case 2:
+				outFragcolor.rgb = normal;
+				break;
+			case 3:
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4:
+				outFragcolor.rgb = albedo.aaa;
+				break;
+			case 5:
+				outFragcolor.rgb = vec3(depth);
+				break;
+		}
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	// Render-target composition
+
+	float lightCount = lightUbo.header.x;
+	#define ambient 0.1
+
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * ambient;
+
+	for(int i = 0; i < lightCount; ++i)
+	{
+		// Vector to light
+		vec3 L = lightUbo.position_near[i].xyz - fragPos;
+		// Distance from light to fragment position
+		float dist = length(L) / 3.0;
+
+		// Viewer to fragment
+		vec3 V = lightUbo.viewProjMatrix[i][3].xyz - fragPos;
+		V = normalize(V);
+
+		// Light to fragment
+		L = normalize(L);
+
+		// Attenuation
+		float atten = lightUbo.color_far[i].w / (pow(dist, 2.0) + 1.0);
+
+		// Diffuse part
+		vec3 N = normal;
+		float NdotL = max(0.0, dot(N, L));
+		vec3 diff = lightUbo.color_far[i].rgb * albedo.rgb * NdotL * atten;
+
+		// Specular part
+		// Specular map values are stored in alpha of albedo mrt
+		vec3 R = reflect(-L, N);
+		float NdotR = max(0.0, dot(R, V));
+		vec3 spec = lightUbo.color_far[i].rgb * albedo.a * pow(NdotR, 16.0) * atten;
+
+		fragcolor += diff + spec;
+	}
+
+    outFragcolor = vec4(fragcolor, 1.0);
+}
@@ -21,15 +21,18 @@ layout(binding = 3) uniform CustomLargeLightUBO
 
 layout(push_constant) uniform PushConsts {
 	layout (offset = 0) int showDebugTarget;
+	layout (offset = 4) float renderScale;
 } consts;
 
 void main()
 {
 	// Get G-Buffer values
-	vec4 fragPos4 = texture(samplerposition, inUV).rgba;
+	// gbuffer is only filled in its top left renderScale part
+	vec2 gbufferUV = inUV * consts.renderScale;
+	vec4 fragPos4 = texture(samplerposition, gbufferUV).rgba;
 	vec3 fragPos = fragPos4.xyz / fragPos4.w;
-	vec3 normal = texture(samplerNormal, inUV).rgb;
-	vec4 albedo = texture(samplerAlbedo, inUV);
+	vec3 normal = texture(samplerNormal, gbufferUV).rgb;
+	vec4 albedo = texture(samplerAlbedo, gbufferUV);
 
 	// Debug display
 	if (consts.showDebugTarget > 0) {
@@ -0,0 +1,34 @@
+#version 450
+
+// SET1 CUSTOM5SAMPLER
+layout(set = 1, binding = 1) uniform sampler2D albedoTex;
+layout(set = 1, binding = 4) uniform sampler2D normalTex;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inColor;
+layout (location = 3) in vec4 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+
+// position is rebuilt from depth in the lighting pass
+layout (location = 0) out vec2 outNormal;
+layout (location = 1) out vec4 outAlbedo;
+
+vec2 octWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octEncode(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy;
+}
+
+void main()
+{
+	outNormal = octEncode(normalize(inNormal));
+	// rgb: albedo, a: specular intensity
+	outAlbedo = texture(albedoTex, inUV);
+}
@@ -0,0 +1,55 @@
+#version 450
+// mrt.vert for the packed and quantized vertex formats, see RHI::VertexLayout
+
+layout(binding = 0) uniform CameraUniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    mat4 model;
+    vec4 camPos;
+} camUbo;
+
+layout(binding = 2) uniform ModelUniformBufferObject
+{
+    mat4 model;
+    vec4 color;
+} modelUbo;
+
+layout(location = 0) in vec3 inPosition;    // float3, or unorm16 within the mesh aabb
+layout(location = 1) in vec2 inTexCoord;    // half2
+layout(location = 2) in vec2 inNormal;      // octahedral snorm16
+layout(location = 3) in vec4 inTangent;     // octahedral snorm8 xy, bitangent sign z
+// per mesh, advanced per instance
+layout(location = 5) in vec4 inPositionOffset;
+layout(location = 6) in vec4 inPositionScale;
+
+
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 2) out vec3 outColor;
+layout (location = 3) out vec4 outWorldPos;
+layout (location = 4) out vec3 outTangent;
+
+// same as octDecode in Meshutil.cpp
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 position = inPositionOffset.xyz + inPositionScale.xyz * inPosition;
+    outWorldPos = modelUbo.model * vec4(position, 1.0);
+    gl_Position = camUbo.proj * camUbo.view * outWorldPos;
+	outUV = inTexCoord;
+
+
+    mat3 mNormal = transpose(inverse(mat3(modelUbo.model)));
+	outNormal = mNormal * octDecode(inNormal);
+	outTangent = mNormal * octDecode(inTangent.xy);
+	outColor = modelUbo.color.rgb;
+}
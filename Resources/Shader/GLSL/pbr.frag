@@ -1,5 +1,10 @@
 #version 450
 
+// SET0 BINDING3 CUSTOM UBO
+layout(set = 0, binding = 3) uniform SHIrradianceUniformBufferObject {
+    vec4 coefficients[9];
+} shIrradiance;
+
 // SET1 CUSTOM5SAMPLER
 layout(set = 1, binding = 1) uniform sampler2D albedoTex;
 layout(set = 1, binding = 2) uniform sampler2D metallicTex;
@@ -28,7 +33,7 @@ layout (location = 0) out vec4 outColor;
 
 
 layout(push_constant) uniform PushConsts {
-	layout (offset = 0) float useIbl;
+	layout (offset = 0) float useIbl; // 0: off, 1: irradiance cubemap, 2: sh irradiance
 } consts;
 /*
 
@@ -115,7 +120,10 @@ vec3 fresnelSchlickR(float cosTheta, vec3 F0, float roughness)
 
 vec3 getNormalFromMap()
 {
-    vec3 tangentNormal = texture(normalTex, fragTexCoord).xyz * 2.0 - 1.0;
+    // normal maps only keep xy, z is rebuilt from the unit length
+    vec3 tangentNormal;
+    tangentNormal.xy = texture(normalTex, fragTexCoord).xy * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(1.0 - dot(tangentNormal.xy, tangentNormal.xy), 0.0));
     vec3 WorldPos = fragPosition.xyz / fragPosition.w;
     vec3 Q1  = dFdx(WorldPos);
     vec3 Q2  = dFdy(WorldPos);
@@ -130,6 +138,21 @@ vec3 getNormalFromMap()
     return normalize(TBN * tangentNormal);
 }
 
+// L2 spherical harmonics, cosine convolution already folded into the coefficients
+vec3 shIrradianceColor(vec3 n)
+{
+    vec3 color = shIrradiance.coefficients[0].rgb * 0.282095
+               + shIrradiance.coefficients[1].rgb * (0.488603 * n.y)
+               + shIrradiance.coefficients[2].rgb * (0.488603 * n.z)
+               + shIrradiance.coefficients[3].rgb * (0.488603 * n.x)
+               + shIrradiance.coefficients[4].rgb * (1.092548 * n.x * n.y)
+               + shIrradiance.coefficients[5].rgb * (1.092548 * n.y * n.z)
+               + shIrradiance.coefficients[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+               + shIrradiance.coefficients[7].rgb * (1.092548 * n.x * n.z)
+               + shIrradiance.coefficients[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(color, vec3(0.0));
+}
+
 vec3 prefilteredReflection(vec3 R, float roughness)
 {
 	const float MAX_REFLECTION_LOD = 4.0; // todo: param/const
@@ -220,9 +243,9 @@ void main() {
 
     vec3 ambient = vec3(0.03) * albedo * ao;
 
-    if (consts.useIbl == 1.0)
+    if (consts.useIbl > 0.5)
     {
-        vec3 iblIrradianceColor = texture(irradianceTex, samplerDir).rgb;
+        vec3 iblIrradianceColor = consts.useIbl > 1.5 ? shIrradianceColor(samplerDir) : texture(irradianceTex, samplerDir).rgb;
         vec3 iblPrefilterEnvColor = prefilteredReflection(R, roughness).rgb;
         vec2 brdf = texture(brdfLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
 
@@ -13,11 +13,8 @@ layout(binding = 2) uniform ModelUniformBufferObject
     vec4 color;
 } modelUbo;
 
+// position stream, see Mesh::BindPositions
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inNormal;
-layout(location = 3) in vec3 inTangent;
-layout(location = 4) in vec3 inBittangent;
 
 
 void main() {
@@ -0,0 +1,27 @@
+#version 450
+
+layout (set = 1, binding = 1) uniform sampler2D samplerColor;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+layout(push_constant) uniform PushConsts {
+	layout (offset = 4) float renderScale;
+} consts;
+
+// bilinear upscale of the top left renderScale part of the lit target
+// a better filter (catmull-rom, edge aware) only has to replace sampleColor
+vec4 sampleColor(vec2 uv)
+{
+	return texture(samplerColor, uv);
+}
+
+void main()
+{
+	// keep the footprint half a texel inside the rendered rect, otherwise the edge picks up stale pixels
+	vec2 texelSize = 1.0 / vec2(textureSize(samplerColor, 0));
+	vec2 maxUV = vec2(consts.renderScale) - 0.5 * texelSize;
+	vec2 uv = min(inUV * consts.renderScale, maxUV);
+	outFragcolor = vec4(sampleColor(uv).rgb, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout (set = 1, binding = 1) uniform sampler2D opaqueTex;
+layout (set = 1, binding = 2) uniform sampler2D accumTex;
+layout (set = 1, binding = 3) uniform sampler2D revealageTex;
+
+layout(location = 0) in vec2 inTexCoord;
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    vec4 color = texture(opaqueTex, inTexCoord);
+
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(revealageTex, coord, 0).r;
+    if (revealage >= 0.9999)
+    {
+        // no transparent fragment
+        outFragColor = color;
+        return;
+    }
+
+    vec4 accum = texelFetch(accumTex, coord, 0);
+    // half float overflow
+    if (isinf(max(max(abs(accum.r), abs(accum.g)), abs(accum.b))))
+    {
+        accum.rgb = vec3(accum.a);
+    }
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+
+    outFragColor = vec4(mix(average, color.rgb, revealage), color.a);
+}
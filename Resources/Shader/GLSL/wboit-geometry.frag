@@ -0,0 +1,25 @@
+#version 450
+
+layout (early_fragment_tests) in;
+
+layout(set = 1, binding = 1) uniform sampler2D diffuse;
+
+layout(location = 0) in vec4 inModelColor;
+layout(location = 1) in vec2 inTexCoord;
+
+layout (location = 0) out vec4 outAccum;
+layout (location = 1) out float outRevealage;
+
+void main()
+{
+    vec4 color = vec4(texture(diffuse, inTexCoord).rgb, 1) * inModelColor;
+
+    // depth weight, McGuire & Bavoil 2013 eq. 10 on the [0,1] window depth
+    float a = min(1.0, color.a * 10.0) + 0.01;
+    float b = 1.0 - gl_FragCoord.z * 0.9;
+    float weight = clamp(a * a * a * 1e8 * b * b * b, 1e-2, 3e3);
+
+    outAccum = vec4(color.rgb * color.a, color.a) * weight;
+    // blended as dst * (1 - src)
+    outRevealage = color.a;
+}
@@ -14,6 +14,7 @@ layout(binding = 2) uniform ModelUniformBufferObject
     vec4 color;
 } modelUbo;
 
+// position stream, see Mesh::BindPositions
 layout(location = 0) in vec3 inPosition;
 
 void main()
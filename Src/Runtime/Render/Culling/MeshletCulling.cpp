@@ -0,0 +1,196 @@
+#include "MeshletCulling.h"
+#include "Runtime/VulkanRHI/VulkanShaderSet.h"
+#include "Util/Fileutil.h"
+#include "Util/Meshutil.h"
+#include <algorithm>
+#include <iostream>
+#include <tracy/Tracy.hpp>
+
+namespace Render {
+
+namespace {
+
+constexpr uint32_t BINDING_COUNT = 4; // meshlets, source indices, culled indices, draw command
+
+}
+
+MeshletCulling::MeshletCulling(RHI::VulkanDevice* device)
+    : m_pDevice(device)
+{
+    prepareLayout();
+    preparePipeline();
+}
+
+MeshletCulling::~MeshletCulling()
+{
+    m_entries.clear();
+    m_pDescPool.reset();
+    m_pPipeline.reset();
+}
+
+void MeshletCulling::AddModel(RHI::Model* model)
+{
+    ZoneScopedN("MeshletCulling::AddModel");
+    uint32_t meshletCount = 0;
+    size_t culledMeshes = 0;
+    for (auto& mesh : model->GetMeshes())
+    {
+        if (!mesh->InitCulledDraw())
+        {
+            continue;
+        }
+        m_entries.push_back({model, mesh.get(), nullptr});
+        meshletCount += (uint32_t)mesh->GetMeshData().meshlets.size();
+        culledMeshes++;
+    }
+    // sets of earlier models are reallocated too, a model is only added while setting up
+    prepareDescriptorSets();
+    std::cout << "[MeshletCulling] " << culledMeshes << "/" << model->GetMeshes().size() << " meshes, " << meshletCount << " meshlets" << std::endl;
+}
+
+void MeshletCulling::Cull(vk::CommandBuffer cmd, Util::Math::VPMatrix& view)
+{
+    ZoneScopedN("MeshletCulling::Cull");
+    if (m_entries.empty())
+    {
+        return;
+    }
+
+    // the previous frame may still read the draw commands and culled indices
+    auto toTransfer = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead)
+            .setDstAccessMask(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite);
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+        vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlagBits(0), {toTransfer}, {}, {}
+    );
+
+    const vk::DrawIndexedIndirectCommand reset{0, 1, 0, 0, 0};
+    for (auto& entry : m_entries)
+    {
+        cmd.updateBuffer(*entry.mesh->GetCulledDrawBuffer()->GetPVkBuf(), 0, sizeof(reset), &reset);
+    }
+
+    auto toCompute = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(0), {toCompute}, {}, {});
+
+    const glm::mat4 viewProj = view.GetProjMatrix() * view.GetViewMatrix();
+    const glm::vec4 eye = glm::inverse(view.GetViewMatrix())[3];
+    m_pPipeline->Bind(cmd);
+    for (auto& entry : m_entries)
+    {
+        // test in object space, so the meshlet bounds need no transform
+        const glm::mat4& modelMatrix = entry.model->GetTransformation().GetMatrix();
+        auto planes = Util::Model::extractFrustumPlanes(viewProj * modelMatrix);
+
+        PushConstant consts;
+        std::copy(planes.begin(), planes.end(), consts.planes);
+        consts.eye = glm::inverse(modelMatrix) * eye;
+        consts.meshletCount = (uint32_t)entry.mesh->GetMeshData().meshlets.size();
+        consts.flags = m_cullFlags;
+        consts.index16 = entry.mesh->GetIndexType() == vk::IndexType::eUint16 ? 1 : 0;
+        m_pPipelineLayout->PushConstantT<PushConstant>(cmd, 0, consts, vk::ShaderStageFlagBits::eCompute);
+        m_pPipeline->BindDescriptorSets(cmd, {entry.descriptorSet->GetVkDescriptorSet(0)});
+        m_pPipeline->Dispatch(cmd, (consts.meshletCount + GROUP_SIZE - 1) / GROUP_SIZE);
+    }
+
+    auto toDraw = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead);
+    cmd.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+        vk::DependencyFlagBits(0), {toDraw}, {}, {}
+    );
+}
+
+void MeshletCulling::prepareLayout()
+{
+    m_pDescriptorSetLayout = std::make_shared<RHI::VulkanDescriptorSetLayout>(m_pDevice);
+    for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+    {
+        m_pDescriptorSetLayout->AddBinding(
+            binding,
+            vk::DescriptorSetLayoutBinding()
+                .setBinding(binding)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+        );
+    }
+    m_pDescriptorSetLayout->Finish();
+
+    std::map<int, vk::PushConstantRange> Constant
+    {
+        {
+            0, //offset
+            vk::PushConstantRange
+            {
+                vk::ShaderStageFlagBits::eCompute,
+                0,
+                sizeof(PushConstant)
+            }
+        }
+    };
+    m_pPipelineLayout.reset(new RHI::VulkanPipelineLayout(m_pDevice, {m_pDescriptorSetLayout}, Constant));
+}
+
+void MeshletCulling::preparePipeline()
+{
+    std::shared_ptr<RHI::VulkanShaderSet> shader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
+    shader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/meshlet.cull.comp.spv", vk::ShaderStageFlagBits::eCompute);
+    m_pPipeline.reset(new RHI::VulkanComputePipeline(m_pDevice, shader, m_pPipelineLayout));
+}
+
+void MeshletCulling::prepareDescriptorSets()
+{
+    for (auto& entry : m_entries)
+    {
+        entry.descriptorSet.reset();
+    }
+    m_pDescPool.reset();
+    if (m_entries.empty())
+    {
+        return;
+    }
+
+    uint32_t setCount = (uint32_t)m_entries.size();
+    std::vector<vk::DescriptorPoolSize> sizes
+    {
+        vk::DescriptorPoolSize {vk::DescriptorType::eStorageBuffer, setCount * BINDING_COUNT},
+    };
+    m_pDescPool.reset(new RHI::VulkanDescriptorPool(m_pDevice, sizes, setCount));
+
+    for (auto& entry : m_entries)
+    {
+        RHI::VulkanBuffer* buffers[BINDING_COUNT] =
+        {
+            entry.mesh->GetMeshletBuffer(),
+            entry.mesh->GetIndexBuffer(),
+            entry.mesh->GetCulledIndexBuffer(),
+            entry.mesh->GetCulledDrawBuffer(),
+        };
+        std::vector<vk::DescriptorBufferInfo> bufferInfos(BINDING_COUNT);
+        std::vector<vk::WriteDescriptorSet> writeDescs(BINDING_COUNT);
+        for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+        {
+            bufferInfos[binding]
+                .setBuffer(*buffers[binding]->GetPVkBuf())
+                .setOffset(0)
+                .setRange(VK_WHOLE_SIZE);
+            writeDescs[binding]
+                .setDstBinding(binding)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setBufferInfo(bufferInfos[binding]);
+        }
+        entry.descriptorSet = m_pDescPool->AllocCustomToUpdatedDescriptorSet(m_pDescriptorSetLayout.get());
+        entry.descriptorSet->UpdateDescriptorSets(writeDescs);
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Runtime/VulkanRHI/Graphic/Mesh.h"
+#include "Runtime/VulkanRHI/Graphic/Model.h"
+#include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
+#include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
+#include "Runtime/VulkanRHI/VulkanComputePipeline.h"
+#include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
+#include "Runtime/VulkanRHI/VulkanDescriptorSets.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Util/Mathutil.h"
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace Render {
+
+// Culls the lod 0 meshlets of the added models against the camera frustum, and optionally their backface cones, in a compute pass.
+// The survivors are compacted into a per mesh index buffer and drawn with one indirect call, see RHI::Mesh::DrawCulled.
+// Record Cull outside of a render pass and before the passes that draw the models.
+class MeshletCulling
+{
+public:
+    enum CullFlagBits : uint32_t
+    {
+        kFrustum = 1 << 0,
+        // only for models whose pipelines cull back faces, with eNone the culled meshlets would have shown their back faces
+        kCone = 1 << 1,
+    };
+public:
+    explicit MeshletCulling(RHI::VulkanDevice* device);
+    ~MeshletCulling();
+
+    // meshes without meshlets keep drawing the whole lod 0
+    void AddModel(RHI::Model* model);
+    void Cull(vk::CommandBuffer cmd, Util::Math::VPMatrix& view);
+    inline void SetCullFlags(uint32_t flags) { m_cullFlags = flags; }
+
+private:
+    void prepareLayout();
+    void preparePipeline();
+    void prepareDescriptorSets();
+
+private:
+    struct PushConstant
+    {
+        glm::vec4 planes[6];
+        glm::vec4 eye;
+        uint32_t meshletCount = 0;
+        uint32_t flags = 0;
+        uint32_t index16 = 0; // source indices are packed two per word
+    };
+    static constexpr uint32_t GROUP_SIZE = 64;
+
+    struct Entry
+    {
+        RHI::Model* model;
+        RHI::Mesh* mesh;
+        std::shared_ptr<RHI::VulkanDescriptorSets> descriptorSet;
+    };
+
+private:
+    RHI::VulkanDevice* m_pDevice;
+    // the g-buffer and shadow pipelines rasterize both faces
+    uint32_t m_cullFlags = kFrustum;
+
+    std::vector<Entry> m_entries;
+    std::shared_ptr<RHI::VulkanDescriptorSetLayout> m_pDescriptorSetLayout;
+    std::shared_ptr<RHI::VulkanPipelineLayout> m_pPipelineLayout;
+    std::unique_ptr<RHI::VulkanComputePipeline> m_pPipeline;
+    std::unique_ptr<RHI::VulkanDescriptorPool> m_pDescPool;
+};
+
+}
@@ -3,12 +3,16 @@
 #include "Runtime/VulkanRHI/Graphic/Model.h"
 #include "Runtime/VulkanRHI/Graphic/ModelPresets.h"
 #include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanColorBlendState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanMultisampleState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanVertextInputState.h"
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
 #include "Runtime/VulkanRHI/VulkanRenderPipeline.h"
 #include "Runtime/VulkanRHI/VulkanShaderSet.h"
 #include "Util/Fileutil.h"
 #include "vulkan/vulkan_enums.hpp"
+#include <iostream>
 #include <memory>
 #include <stdint.h>
 #include <tracy/Tracy.hpp>
@@ -31,6 +35,15 @@ DeferredRenderer::~DeferredRenderer()
 
 void DeferredRenderer::prepare()
 {
+    // the subpass path renders the gbuffer at present resolution, it cannot be scaled
+    m_subpassDeferred = m_subpassDeferred && !m_pPhysicalDevice->IsUsingMSAA() && !m_dynamicResolution;
+    std::cout << "[DeferredRenderer] " << (m_subpassDeferred ? "single render pass (subpass)" : "geometry prepass") << " path"
+                << (m_dynamicResolution ? ", dynamic resolution" : "") << std::endl;
+    if (m_dynamicResolution)
+    {
+        m_pDynamicResolution.reset(new DynamicResolution());
+        m_pTimestampQuery.reset(new RHI::VulkanTimestampQuery(m_pDevice.get(), 2 * MAX_FRAMES_IN_FLIGHT));
+    }
 
     prepareLayout();
     preparePresentFramebufferAttachments();
@@ -49,8 +62,14 @@ void DeferredRenderer::prepare()
     prepareInputCallback();
 
 
-    prepareGeometryPrePass();
-
+    if (m_subpassDeferred)
+    {
+        prepareSubpassInputDescriptorSet();
+    }
+    else
+    {
+        prepareGeometryPrePass();
+    }
 }
 
 void DeferredRenderer::render()
@@ -65,6 +84,10 @@ void DeferredRenderer::render()
     {
         throw std::runtime_error("wait for inflight fence failed");
     }
+    if (m_pDynamicResolution)
+    {
+        updateRenderScale();
+    }
     uint32_t m_imageIdx = 0;
     // acquire image
     vk::Result acquireImageResult;
@@ -99,6 +122,12 @@ void DeferredRenderer::render()
     m_pPlaneModel->UpdateModelUniformBuffer();
     m_pCamera->UpdateUniformBuffer();
     m_pLight->UpdateLightUBO();
+    m_pushConstant.invViewProj = glm::inverse(m_pCamera->GetProjMatrix() * m_pCamera->GetViewMatrix());
+    m_pSceneModel->SelectLod(m_pCamera->GetVPMatrix(), (float)m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent.height);
+    if (m_pTextureStreamer)
+    {
+        m_pTextureStreamer->Update();
+    }
 
 
     // reset fence after acquiring the image
@@ -115,43 +144,85 @@ void DeferredRenderer::render()
         TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "deferred");
 
         {
-            // geometry pass
-            ZoneScopedN("DeferredRenderer::render::geometry pass");
-            m_pGeometryPass->Render(m_vkCmds[m_frameIdxInFlight], {m_pSceneModel.get()});
+            // meshlet culling, outside of any render pass
+            ZoneScopedN("DeferredRenderer::render::meshlet culling");
+            TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "meshlet culling");
+            m_pMeshletCulling->Cull(m_vkCmds[m_frameIdxInFlight], m_pCamera->GetVPMatrix());
         }
 
+        if (m_subpassDeferred)
         {
-            // lighting pass
-            m_pPipelineLayout->PushConstantT(m_vkCmds[m_frameIdxInFlight], 0, m_pushConstant, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
-
-
-            std::vector<vk::ClearValue> clears(2);
-            clears[0] = vk::ClearValue{vk::ClearColorValue{std::array<float,4>{0.0f,0.0f,0.0f,1.0f}}};
-            clears[1] = vk::ClearValue {vk::ClearDepthStencilValue{1.0f, 0}};
-            if (m_pPhysicalDevice->IsUsingMSAA())
+            recordSubpassDeferred(m_vkCmds[m_frameIdxInFlight], m_imageIdx);
+        }
+        else
+        {
+            uint32_t queryIdx = 2 * m_frameIdxInFlight;
+            if (m_pTimestampQuery)
             {
-                clears.push_back(clears[0]);
+                m_pTimestampQuery->Reset(m_vkCmds[m_frameIdxInFlight], queryIdx, 2);
+                m_pTimestampQuery->Write(m_vkCmds[m_frameIdxInFlight], queryIdx, vk::PipelineStageFlagBits::eTopOfPipe);
             }
 
-            std::vector<vk::DescriptorSet> tobinding(2);
-            tobinding[1] = m_pGeometryPass->GetDescriptorSets()->GetVkDescriptorSet(0);
+            {
+                // geometry pass
+                ZoneScopedN("DeferredRenderer::render::geometry pass");
+                TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "geometry pass");
+                m_pGeometryPass->Render(m_vkCmds[m_frameIdxInFlight], {m_pSceneModel.get()});
+            }
 
-            m_pRenderPass->Begin(m_vkCmds[m_frameIdxInFlight], clears, vk::Rect2D{vk::Offset2D{0,0}, m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent}, m_pDevice->GetVulkanPresentFramebuffer(m_imageIdx)->GetVkFramebuffer());
+            m_pPipelineLayout->PushConstantT(m_vkCmds[m_frameIdxInFlight], 0, m_pushConstant, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+            auto& extent = m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent;
             {
+                // lighting pass, internal resolution
                 ZoneScopedN("DeferredRenderer::render::lighting pass");
-                auto& extent = m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent;
-                vk::Rect2D rect{{0,0},extent};
-                m_vkCmds[m_frameIdxInFlight].setViewport(0,vk::Viewport{0,0,(float)extent.width, (float)extent.height,0,1});
-                m_vkCmds[m_frameIdxInFlight].setScissor(0,rect);
+                vk::Extent2D renderExtent = m_pDynamicResolution ? m_pDynamicResolution->Scale(extent) : extent;
+                vk::Rect2D rect{{0,0},renderExtent};
+                std::vector<vk::ClearValue> clears {
+                    vk::ClearValue{vk::ClearColorValue{std::array<float,4>{0.0f,0.0f,0.0f,1.0f}}}
+                };
+
+                std::vector<vk::DescriptorSet> tobinding(2);
+                tobinding[1] = m_pGeometryPass->GetDescriptorSets()->GetVkDescriptorSet(0);
+
+                m_lightingTarget.renderPass->Begin(m_vkCmds[m_frameIdxInFlight], clears, rect, m_lightingTarget.framebuffer->GetVkFramebuffer());
+                {
+                    m_vkCmds[m_frameIdxInFlight].setViewport(0,vk::Viewport{0,0,(float)renderExtent.width, (float)renderExtent.height,0,1});
+                    m_vkCmds[m_frameIdxInFlight].setScissor(0,rect);
+                    m_lightingTarget.renderPass->BindGraphicPipeline(m_vkCmds[m_frameIdxInFlight], "shading");
+                    m_pPlaneModel->DrawWithNoMaterial(m_vkCmds[m_frameIdxInFlight], m_pPipelineLayout.get(), tobinding);
+                }
+                m_lightingTarget.renderPass->End(m_vkCmds[m_frameIdxInFlight]);
+            }
 
-                // m_pRenderPass->BindGraphicPipeline(m_vkCmds[m_frameIdxInFlight], "skybox");
-                // m_pSkyboxModel->Draw(m_vkCmds[m_frameIdxInFlight], m_pPipelineLayout.get(), tobinding);
+            {
+                // upscale pass, present resolution
+                std::vector<vk::ClearValue> clears(2);
+                clears[0] = vk::ClearValue{vk::ClearColorValue{std::array<float,4>{0.0f,0.0f,0.0f,1.0f}}};
+                clears[1] = vk::ClearValue {vk::ClearDepthStencilValue{1.0f, 0}};
+                if (m_pPhysicalDevice->IsUsingMSAA())
+                {
+                    clears.push_back(clears[0]);
+                }
 
-                m_pRenderPass->BindGraphicPipeline(m_vkCmds[m_frameIdxInFlight], "shading");
-                // m_vkCmds[m_frameIdxInFlight].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pPipelineLayout->GetVkPieplineLayout(), 0, tobinding, {});
-                m_pPlaneModel->DrawWithNoMaterial(m_vkCmds[m_frameIdxInFlight], m_pPipelineLayout.get(), tobinding);
+                std::vector<vk::DescriptorSet> tobinding(2);
+                tobinding[1] = m_lightingTarget.descriptorSet->GetVkDescriptorSet(0);
+
+                vk::Rect2D rect{{0,0},extent};
+                m_pRenderPass->Begin(m_vkCmds[m_frameIdxInFlight], clears, rect, m_pDevice->GetVulkanPresentFramebuffer(m_imageIdx)->GetVkFramebuffer());
+                {
+                    ZoneScopedN("DeferredRenderer::render::upscale pass");
+                    m_vkCmds[m_frameIdxInFlight].setViewport(0,vk::Viewport{0,0,(float)extent.width, (float)extent.height,0,1});
+                    m_vkCmds[m_frameIdxInFlight].setScissor(0,rect);
+                    m_pRenderPass->BindGraphicPipeline(m_vkCmds[m_frameIdxInFlight], "upscale");
+                    m_pPlaneModel->DrawWithNoMaterial(m_vkCmds[m_frameIdxInFlight], m_pPipelineLayout.get(), tobinding);
+                }
+                m_pRenderPass->End(m_vkCmds[m_frameIdxInFlight]);
+            }
+
+            if (m_pTimestampQuery)
+            {
+                m_pTimestampQuery->Write(m_vkCmds[m_frameIdxInFlight], queryIdx + 1, vk::PipelineStageFlagBits::eBottomOfPipe);
             }
-            m_pRenderPass->End(m_vkCmds[m_frameIdxInFlight]);
         }
     }
     m_vkCmds[m_frameIdxInFlight].end();
@@ -191,6 +262,73 @@ void DeferredRenderer::render()
     }
 }
 
+void DeferredRenderer::onSwapchainRecreated()
+{
+    // the present framebuffers were re-created with the old depth and gbuffer, rebuild both at the new extent
+    preparePresentFramebufferAttachments();
+    preparePresentFramebuffer();
+    if (m_subpassDeferred)
+    {
+        prepareSubpassInputDescriptorSet();
+        return;
+    }
+    // the render passes and pipelines do not depend on the extent and are kept
+    prepareLightingTarget();
+    prepareGeometryPrePass();
+}
+
+void DeferredRenderer::updateRenderScale()
+{
+    // the fence of this frame slot is signaled, so its timestamps are available
+    double gpuMs = 0.0;
+    uint32_t queryIdx = 2 * m_frameIdxInFlight;
+    if (m_pTimestampQuery->GetElapsedMs(queryIdx, queryIdx + 1, gpuMs))
+    {
+        m_pDynamicResolution->Update(gpuMs);
+    }
+    m_pushConstant.renderScale = m_pDynamicResolution->GetScale();
+    m_pGeometryPass->SetRenderScale(m_pushConstant.renderScale);
+}
+
+void DeferredRenderer::recordSubpassDeferred(vk::CommandBuffer& cmd, uint32_t imageIdx)
+{
+    ZoneScopedN("DeferredRenderer::recordSubpassDeferred");
+    // attachment order: present, depth, normal, albedo
+    std::vector<vk::ClearValue> clears {
+        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 1.0f } } },
+        vk::ClearValue { vk::ClearDepthStencilValue { 1.0f, 0 } },
+        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 0.0f } } },
+        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 1.0f, 1.0f, 1.0f, 1.0f } } }
+    };
+    auto& extent = m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent;
+    vk::Rect2D rect{{0,0},extent};
+
+    m_pRenderPass->Begin(cmd, clears, rect, m_pDevice->GetVulkanPresentFramebuffer(imageIdx)->GetVkFramebuffer());
+    {
+        cmd.setViewport(0,vk::Viewport{0,0,(float)extent.width, (float)extent.height,0,1});
+        cmd.setScissor(0,rect);
+        {
+            // subpass 0: geometry
+            ZoneScopedN("DeferredRenderer::render::geometry subpass");
+            TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], cmd, "geometry subpass");
+            m_pRenderPass->BindGraphicPipeline(cmd, "mrt");
+            std::vector<vk::DescriptorSet> tobinding;
+            m_pSceneModel->Draw(cmd, m_pGeometryPipelineLayout.get(), tobinding);
+        }
+        m_pRenderPass->NextSubpass(cmd);
+        {
+            // subpass 1: lighting, gbuffer read as input attachments
+            ZoneScopedN("DeferredRenderer::render::lighting subpass");
+            m_pRenderPass->BindGraphicPipeline(cmd, "shading");
+            m_pPipelineLayout->PushConstantT(cmd, 0, m_pushConstant, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+            std::vector<vk::DescriptorSet> tobinding(2);
+            tobinding[1] = m_pInputAttachmentDescriptorSet->GetVkDescriptorSet(0);
+            m_pPlaneModel->DrawWithNoMaterial(cmd, m_pPipelineLayout.get(), tobinding);
+        }
+    }
+    m_pRenderPass->End(cmd);
+}
+
 void DeferredRenderer::prepareLayout()
 {
     std::map<int, vk::PushConstantRange> pushconstants
@@ -207,6 +345,26 @@ void DeferredRenderer::prepareLayout()
     };
 
     m_pCustomDescriptorSetLayout = m_pDevice->GetDescLayoutPresets().CreateCustomUBO(m_pDevice.get(), vk::ShaderStageFlagBits::eFragment);
+    if (m_subpassDeferred)
+    {
+        // normal, albedo, depth
+        m_pInputAttachmentSetLayout = m_pDevice->GetDescLayoutPresets().CreateInputAttachments(m_pDevice.get(), 3);
+        m_pPipelineLayout.reset(
+            new RHI::VulkanPipelineLayout(
+                m_pDevice.get(),
+                {m_pCustomDescriptorSetLayout, m_pInputAttachmentSetLayout}
+                ,pushconstants
+                )
+            );
+        m_pGeometryPipelineLayout.reset(
+            new RHI::VulkanPipelineLayout(
+                m_pDevice.get(),
+                {m_pSet0UniformSetLayout.lock(), m_pSet1SamplerSetLayout.lock()}
+                )
+            );
+        return;
+    }
+
     m_pPipelineLayout.reset(
         new RHI::VulkanPipelineLayout(
             m_pDevice.get(),
@@ -216,30 +374,213 @@ void DeferredRenderer::prepareLayout()
         );
 }
 
+void DeferredRenderer::preparePresentFramebufferAttachments()
+{
+    RendererBase::preparePresentFramebufferAttachments();
+    if (!m_subpassDeferred)
+    {
+        return;
+    }
+    assert(m_VulkanPresentFramebufferAttachments.size() == SubpassGBuffer::kNormalAttachmentId);
+
+    // gbuffer never leaves the render pass: transient usage, lazily allocated when the device has it, not stored
+    RHI::VulkanImageResource::Config imageConfig;
+    imageConfig.extent = vk::Extent3D{ m_pDevice->GetSwapchainExtent(), 1};
+    vk::MemoryPropertyFlags memProps = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated;
+
+    // depth is re-created so the lighting subpass can read it, depth aspect only for the input attachment view
+    auto& depth = m_VulkanPresentFramebufferAttachments[SubpassGBuffer::kDepthAttachmentId];
+    imageConfig.format = depth.resourceFormat;
+    imageConfig.imageUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+    imageConfig.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eDepth);
+    m_presentFramebufferAttachResource.depthVulkanImageResource.reset(new RHI::VulkanImageResource(m_pDevice.get(), memProps, imageConfig));
+    depth.resource = m_presentFramebufferAttachResource.depthVulkanImageResource->GetNative();
+    depth.storeOp = vk::AttachmentStoreOp::eDontCare;
+
+    imageConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+    imageConfig.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+    auto addGBufferAttachment = [&](std::unique_ptr<RHI::VulkanImageResource>& target, vk::Format format)
+    {
+        imageConfig.format = format;
+        target.reset(new RHI::VulkanImageResource(m_pDevice.get(), memProps, imageConfig));
+        RHI::VulkanFramebuffer::Attachment attachment;
+        attachment.type = RHI::VulkanFramebuffer::kColor;
+        attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        attachment.resourceFormat = format;
+        attachment.resource = target->GetNative();
+        m_VulkanPresentFramebufferAttachments.push_back(attachment);
+    };
+    // same packing as the compact geometry prepass
+    addGBufferAttachment(m_subpassGBuffer.normal, vk::Format::eR16G16Sfloat);
+    addGBufferAttachment(m_subpassGBuffer.albedo, vk::Format::eR8G8B8A8Unorm);
+}
+
 
 void DeferredRenderer::prepareRenderpass()
 {
+    if (m_subpassDeferred)
+    {
+        m_pRenderPass = RHI::VulkanRenderPassBuilder(m_pDevice.get())
+                                .SetAttachments(m_VulkanPresentFramebufferAttachments)
+                                // 0: geometry
+                                .AddSubpass({SubpassGBuffer::kNormalAttachmentId, SubpassGBuffer::kAlbedoAttachmentId}, {}, SubpassGBuffer::kDepthAttachmentId)
+                                // 1: lighting
+                                .AddSubpass({SubpassGBuffer::kPresentAttachmentId}, {SubpassGBuffer::kNormalAttachmentId, SubpassGBuffer::kAlbedoAttachmentId, SubpassGBuffer::kDepthAttachmentId})
+                                .SetDefaultSubpassDependencies()
+                                .AddSubpassDependency(vk::SubpassDependency()
+                                    .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+                                    .setDstSubpass(1)
+                                    .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                                    .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                                    .setSrcAccessMask(vk::AccessFlagBits(0))
+                                    .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite))
+                                .AddSubpassInputDependency(0, 1)
+                                .buildUnique();
+        return;
+    }
     m_pRenderPass = RHI::VulkanRenderPassBuilder(m_pDevice.get())
                             .SetAttachments(m_VulkanPresentFramebufferAttachments)
                             .buildUnique();
+    prepareLightingTarget();
+}
+
+void DeferredRenderer::prepareLightingTarget()
+{
+    // sized to the swapchain, only the top left renderScale part is rendered
+    vk::Format format = vk::Format::eR16G16B16A16Sfloat;
+    RHI::VulkanImageResource::Config imageConfig;
+    imageConfig.extent = vk::Extent3D{ m_pDevice->GetSwapchainExtent(), 1};
+    imageConfig.format = format;
+    imageConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+    imageConfig.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+    RHI::VulkanImageSampler::Config samplerConfig;
+    samplerConfig.uAddressMode = vk::SamplerAddressMode::eClampToEdge;
+    samplerConfig.vAddressMode = vk::SamplerAddressMode::eClampToEdge;
+    samplerConfig.anisotropyEnable = VK_FALSE;
+    m_lightingTarget.color.reset(new RHI::VulkanImageSampler(m_pDevice.get(), nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig, imageConfig));
+
+    std::vector<RHI::VulkanFramebuffer::Attachment> attachments(1);
+    attachments[0].type = RHI::VulkanFramebuffer::kColor;
+    attachments[0].resourceFinalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    attachments[0].resource = m_lightingTarget.color->GetPImageResource()->GetNative();
+    attachments[0].resourceFormat = format;
+
+    if (!m_lightingTarget.renderPass)
+    {
+        m_lightingTarget.renderPass = RHI::VulkanRenderPassBuilder(m_pDevice.get())
+                                        .SetAttachments(attachments)
+                                        .SetDefaultSubpass()
+                                        .AddSubpassDependency(vk::SubpassDependency()
+                                            .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+                                            .setDstSubpass(0)
+                                            .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader)
+                                            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                                            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
+                                            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite))
+                                        .AddSubpassDependency(vk::SubpassDependency()
+                                            .setSrcSubpass(0)
+                                            .setDstSubpass(VK_SUBPASS_EXTERNAL)
+                                            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                                            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
+                                            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+                                            .setDstAccessMask(vk::AccessFlagBits::eShaderRead))
+                                        .buildUnique();
+    }
+    m_lightingTarget.framebuffer.reset(new RHI::VulkanFramebuffer(m_pDevice.get(), m_lightingTarget.renderPass.get(), imageConfig.extent.width, imageConfig.extent.height, 1, attachments));
+
+    m_lightingTarget.descriptorPool.reset(new RHI::VulkanDescriptorPool(m_pDevice.get(),
+        {vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 1}}, 1));
+    m_lightingTarget.descriptorSet = m_lightingTarget.descriptorPool->AllocSamplerDescriptorSet(
+        m_pDevice->GetDescLayoutPresets().CUSTOM5SAMPLER.get(),
+        {m_lightingTarget.color.get()}, std::vector<uint32_t> {1});
 }
 
 void DeferredRenderer::preparePipeline()
 {
+    if (m_subpassDeferred)
+    {
+        auto geometryShader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice.get());
+        bool packed = m_vertexFormat != Util::Model::VertexFormat::kFull;
+        geometryShader->AddShader(Util::File::getResourcePath()/(packed ? "Shader/GLSL/SPIR-V/mrt.packed.vert.spv" : "Shader/GLSL/SPIR-V/mrt.vert.spv"), vk::ShaderStageFlagBits::eVertex);
+        geometryShader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/mrt.compact.frag.spv", vk::ShaderStageFlagBits::eFragment);
+        auto blendStateAttachment = vk::PipelineColorBlendAttachmentState()
+                                        .setColorWriteMask(vk::ColorComponentFlags(0xf))
+                                        .setBlendEnable(VK_FALSE);
+        auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>(2, blendStateAttachment));
+        m_pRenderPass->AddGraphicRenderPipeline("mrt",
+            RHI::VulkanRenderPipelineBuilder(m_pDevice.get(), m_pRenderPass.get())
+                .SetVulkanPipelineLayout(m_pGeometryPipelineLayout)
+                .SetVulkanColorBlendState(blendState)
+                .SetVulkanVertexInputState(std::make_shared<RHI::VulkanVertextInputState>(m_vertexFormat))
+                .SetshaderSet(geometryShader)
+                .SetSubpass(0)
+                .buildUnique());
+
+        auto lightingShader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice.get());
+        lightingShader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/defershading.vert.spv", vk::ShaderStageFlagBits::eVertex);
+        lightingShader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/defershading.subpass.frag.spv", vk::ShaderStageFlagBits::eFragment);
+        m_pRenderPass->AddGraphicRenderPipeline("shading",
+            RHI::VulkanRenderPipelineBuilder(m_pDevice.get(), m_pRenderPass.get())
+                .SetVulkanPipelineLayout(m_pPipelineLayout)
+                .SetshaderSet(lightingShader)
+                .SetSubpass(1)
+                .buildUnique());
+        return;
+    }
+
     std::shared_ptr<RHI::VulkanShaderSet> shader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice.get());
     shader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/defershading.vert.spv", vk::ShaderStageFlagBits::eVertex);
-    shader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/defershading.frag.spv", vk::ShaderStageFlagBits::eFragment);
-    m_pRenderPass->AddGraphicRenderPipeline("shading",
-        RHI::VulkanRenderPipelineBuilder(m_pDevice.get(), m_pRenderPass.get())
+    shader->AddShader(Util::File::getResourcePath()/(m_compactGBuffer ? "Shader/GLSL/SPIR-V/defershading.compact.frag.spv" : "Shader/GLSL/SPIR-V/defershading.frag.spv"), vk::ShaderStageFlagBits::eFragment);
+    m_lightingTarget.renderPass->AddGraphicRenderPipeline("shading",
+        RHI::VulkanRenderPipelineBuilder(m_pDevice.get(), m_lightingTarget.renderPass.get())
             .SetVulkanPipelineLayout(m_pPipelineLayout)
+            .SetVulkanMultisampleState(std::make_shared<RHI::VulkanMultisampleState>(vk::SampleCountFlagBits::e1))
             .SetshaderSet(shader)
             .buildUnique());
+
+    std::shared_ptr<RHI::VulkanShaderSet> upscaleShader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice.get());
+    upscaleShader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/defershading.vert.spv", vk::ShaderStageFlagBits::eVertex);
+    upscaleShader->AddShader(Util::File::getResourcePath()/"Shader/GLSL/SPIR-V/upscale.frag.spv", vk::ShaderStageFlagBits::eFragment);
+    m_pRenderPass->AddGraphicRenderPipeline("upscale",
+        RHI::VulkanRenderPipelineBuilder(m_pDevice.get(), m_pRenderPass.get())
+            .SetVulkanPipelineLayout(m_pPipelineLayout)
+            .SetshaderSet(upscaleShader)
+            .buildUnique());
 }
 
 void DeferredRenderer::prepareGeometryPrePass()
 {
-    constexpr const uint32_t geoPassFbDim = 2048;
-    m_pGeometryPass = PrePass::CreateGeometryPrePass(m_pDevice.get(), m_pCamera.get(), geoPassFbDim, geoPassFbDim);
+    // sized to the swapchain, the dynamic resolution scale only shrinks the rendered rect
+    auto extent = m_pDevice->GetSwapchainExtent();
+    m_pGeometryPass = PrePass::CreateGeometryPrePass(m_pDevice.get(), m_pCamera.get(), extent.width, extent.height, m_compactGBuffer, m_vertexFormat);
+}
+
+void DeferredRenderer::prepareSubpassInputDescriptorSet()
+{
+    m_pInputAttachmentDescriptorPool.reset(new RHI::VulkanDescriptorPool(
+        m_pDevice.get(),
+        std::vector<vk::DescriptorPoolSize>{
+            { vk::DescriptorType::eInputAttachment, 3 }
+        }, 1));
+    m_pInputAttachmentDescriptorSet = m_pInputAttachmentDescriptorPool->AllocCustomToUpdatedDescriptorSet(m_pInputAttachmentSetLayout.get());
+
+    // layouts match the lighting subpass input attachment references
+    std::array<vk::DescriptorImageInfo, 3> imageInfos {
+        vk::DescriptorImageInfo{ nullptr, m_subpassGBuffer.normal->GetVkImageView(), vk::ImageLayout::eShaderReadOnlyOptimal },
+        vk::DescriptorImageInfo{ nullptr, m_subpassGBuffer.albedo->GetVkImageView(), vk::ImageLayout::eShaderReadOnlyOptimal },
+        vk::DescriptorImageInfo{ nullptr, m_presentFramebufferAttachResource.depthVulkanImageResource->GetVkImageView(), vk::ImageLayout::eDepthStencilReadOnlyOptimal },
+    };
+    std::vector<vk::WriteDescriptorSet> writes(imageInfos.size());
+    for (int i = 0; i < imageInfos.size(); i++)
+    {
+        writes[i]
+            .setDstBinding(i)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eInputAttachment)
+            .setDescriptorCount(1)
+            .setImageInfo(imageInfos[i]);
+    }
+    m_pInputAttachmentDescriptorSet->UpdateDescriptorSets(writes);
 }
 
 void DeferredRenderer::prepareCamera()
@@ -255,12 +596,21 @@ void DeferredRenderer::prepareCamera()
 void DeferredRenderer::prepareModel()
 {
     m_pPlaneModel = RHI::ModelPresets::CreatePlaneModel(m_pDevice.get(), m_pSet1SamplerSetLayout.lock().get());
-    m_pSceneModel.reset(new RHI::Model(m_pDevice.get(), Util::File::getResourcePath() / "Model/Sponza-master/sponza.obj",  m_pSet1SamplerSetLayout.lock().get()));
+    m_pSceneModel.reset(new RHI::Model(m_pDevice.get(), Util::File::getResourcePath() / "Model/Sponza-master/sponza.obj",  m_pSet1SamplerSetLayout.lock().get(), glm::vec4(1.0f), m_vertexFormat, m_textureMips, m_textureStreaming));
     auto camUboInfo = m_pCamera->GetUboInfo();
     auto lightUboInfo = m_pLight->GetUboInfo();
     auto lightLargeUboInfo = m_pLight->GetLargeUboInfo();
     m_pSceneModel->InitUniformDescriptorSets({camUboInfo, lightUboInfo});
     m_pPlaneModel->InitUniformDescriptorSets({camUboInfo, lightLargeUboInfo}, m_pCustomDescriptorSetLayout.get());
+
+    m_pMeshletCulling.reset(new MeshletCulling(m_pDevice.get()));
+    m_pMeshletCulling->AddModel(m_pSceneModel.get());
+
+    if (m_textureStreaming)
+    {
+        m_pTextureStreamer.reset(new TextureStreamer(m_pDevice.get()));
+        m_pTextureStreamer->AddModel(m_pSceneModel.get());
+    }
 }
 void DeferredRenderer::prepareLight()
 {
@@ -1,9 +1,14 @@
 #pragma once
+#include "Runtime/Render/Culling/MeshletCulling.h"
+#include "Runtime/Render/DynamicResolution.h"
 #include "Runtime/Render/PrePass/PrePass.h"
+#include "Runtime/Render/TextureStreamer.h"
 #include "Runtime/VulkanRHI/Layout/UniformBufferObject.h"
 #include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorSets.h"
+#include "Runtime/VulkanRHI/VulkanTimestampQuery.h"
+#include <glm/glm.hpp>
 #include <memory>
 #include <vulkan/vulkan.hpp>
 #include <Runtime/Render/RendererBase.h>
@@ -23,12 +28,15 @@ protected:
 
     // 1. layout
     void prepareLayout() override;
-    // 2. attachments = default
+    // 2. attachments
+    void preparePresentFramebufferAttachments() override;
     // 3. renderpass
     void prepareRenderpass() override;
     // 4. framebuffer = default
     // 5. pipeline
     void preparePipeline() override;
+    // depth, gbuffer, lighting and upscale targets follow the new extent
+    void onSwapchainRecreated() override;
 
 
     std::vector<RHI::Model*> GetModels() override { return {m_pSceneModel.get()}; }
@@ -36,6 +44,10 @@ protected:
     Lights* GetLights() override { return m_pLight.get(); }
 private:
     void prepareGeometryPrePass();
+    void prepareLightingTarget();
+    void updateRenderScale();
+    void prepareSubpassInputDescriptorSet();
+    void recordSubpassDeferred(vk::CommandBuffer& cmd, uint32_t imageIdx);
     void prepareCamera();
     void prepareModel();
     void prepareLight();
@@ -44,13 +56,61 @@ private:
     struct PushConstant
     {
         int showDebugTarget = 0;
+        // part of the internal targets that is rendered this frame
+        float renderScale = 1.0f;
+        // compact gbuffer only: rebuild world position from depth
+        alignas(16) glm::mat4 invViewProj = glm::mat4(1.0f);
+    };
+    // single render pass path: geometry & lighting are subpasses, gbuffer is read as input attachments
+    struct SubpassGBuffer
+    {
+        static constexpr uint32_t kPresentAttachmentId = 0;
+        static constexpr uint32_t kDepthAttachmentId = 1;
+        static constexpr uint32_t kNormalAttachmentId = 2;
+        static constexpr uint32_t kAlbedoAttachmentId = 3;
+        std::unique_ptr<RHI::VulkanImageResource> normal;
+        std::unique_ptr<RHI::VulkanImageResource> albedo;
+    };
+    // prepass path: lighting is rendered at the internal resolution, then upscaled into the present target
+    struct LightingTarget
+    {
+        std::unique_ptr<RHI::VulkanImageSampler> color;
+        std::unique_ptr<RHI::VulkanRenderPass> renderPass;
+        std::unique_ptr<RHI::VulkanFramebuffer> framebuffer;
+        std::unique_ptr<RHI::VulkanDescriptorPool> descriptorPool;
+        std::shared_ptr<RHI::VulkanDescriptorSets> descriptorSet;
     };
 private:
+    bool m_compactGBuffer = true;
+    // falls back to the geometry prepass path when msaa or dynamic resolution is on
+    bool m_subpassDeferred = true;
+    // off by default: the subpass path keeps the gbuffer in tile memory, which the prepass path needs to scale its targets.
+    // on to trade that for a render scale that holds the frame time target
+    bool m_dynamicResolution = false;
+    // of the scene model, the geometry pipelines are built for it
+    Util::Model::VertexFormat m_vertexFormat = Util::Model::VertexFormat::kQuantized;
+    // off to compare the gpu time of the geometry pass without texture mips
+    bool m_textureMips = true;
+    // sponza starts with the mip tails of its textures, the rest streams in as the camera needs it
+    bool m_textureStreaming = true;
     PushConstant m_pushConstant;
     std::unique_ptr<PrePass> m_pGeometryPass;
+    LightingTarget m_lightingTarget;
+    std::unique_ptr<DynamicResolution> m_pDynamicResolution;
+    // begin/end of frame, two queries per frame in flight
+    std::unique_ptr<RHI::VulkanTimestampQuery> m_pTimestampQuery;
+
+    SubpassGBuffer m_subpassGBuffer;
+    std::shared_ptr<RHI::VulkanPipelineLayout> m_pGeometryPipelineLayout;
+    std::shared_ptr<RHI::VulkanDescriptorSetLayout> m_pInputAttachmentSetLayout;
+    std::unique_ptr<RHI::VulkanDescriptorPool> m_pInputAttachmentDescriptorPool;
+    std::shared_ptr<RHI::VulkanDescriptorSets> m_pInputAttachmentDescriptorSet;
 
     std::unique_ptr<RHI::Model> m_pSceneModel;
     std::unique_ptr<RHI::Model> m_pPlaneModel;
+    std::unique_ptr<MeshletCulling> m_pMeshletCulling;
+    // after the scene model, it is destroyed first
+    std::unique_ptr<TextureStreamer> m_pTextureStreamer;
     std::unique_ptr<Camera> m_pCamera;
     std::unique_ptr<Lights> m_pLight;
 
@@ -0,0 +1,45 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace Render;
+
+DynamicResolution::DynamicResolution(const Config& config)
+    : m_config(config)
+    , m_scale(config.maxScale)
+{
+    assert(m_config.minScale > 0.0f && m_config.minScale <= m_config.maxScale);
+}
+
+void DynamicResolution::Update(double gpuFrameMs)
+{
+    if (gpuFrameMs <= 0.0)
+    {
+        return;
+    }
+    m_smoothedMs = m_smoothedMs == 0.0
+                    ? gpuFrameMs
+                    : m_smoothedMs + (gpuFrameMs - m_smoothedMs) * m_config.smoothing;
+
+    double ratio = m_config.targetFrameMs / m_smoothedMs;
+    if (std::abs(ratio - 1.0) <= m_config.deadband)
+    {
+        return;
+    }
+
+    // gpu cost is roughly proportional to pixel count, i.e. scale^2
+    float step = m_scale * (float)std::sqrt(ratio) - m_scale;
+    step = std::clamp(step, -m_config.maxStep, m_config.maxStep);
+    float scale = std::clamp(m_scale + step, m_config.minScale, m_config.maxScale);
+    // quantize so small jitter does not move the viewport every frame
+    m_scale = std::round(scale * 100.0f) / 100.0f;
+}
+
+vk::Extent2D DynamicResolution::Scale(const vk::Extent2D& extent) const
+{
+    return vk::Extent2D {
+        std::max(1u, (uint32_t)(extent.width * m_scale)),
+        std::max(1u, (uint32_t)(extent.height * m_scale))
+    };
+}
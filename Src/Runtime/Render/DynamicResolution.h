@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+namespace Render {
+
+// picks a render scale for internal targets from measured gpu frame time
+class DynamicResolution
+{
+public:
+    struct Config
+    {
+        float targetFrameMs = 16.6f;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        // smoothing of the measured frame time, 1 = no smoothing
+        float smoothing = 0.1f;
+        // no change while the smoothed time is within target * (1 +- deadband)
+        float deadband = 0.05f;
+        // largest scale change per update
+        float maxStep = 0.05f;
+    };
+public:
+    explicit DynamicResolution(const Config& config = Config());
+
+    void Update(double gpuFrameMs);
+    inline float GetScale() const { return m_scale; }
+    inline double GetSmoothedFrameMs() const { return m_smoothedMs; }
+    vk::Extent2D Scale(const vk::Extent2D& extent) const;
+private:
+    Config m_config;
+    float m_scale;
+    double m_smoothedMs = 0.0;
+};
+
+}
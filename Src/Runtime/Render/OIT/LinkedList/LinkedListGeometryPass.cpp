@@ -12,6 +12,8 @@
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <iostream>
 #include <memory>
 
 using namespace Render;
@@ -32,10 +34,14 @@ LinkedListGeometryPass::LinkedListGeometryPass(RHI::VulkanDevice* device, Camera
     prepareSBO();
     preparePipeline();
     prepareOutputDescriptorSets();
+
+    std::cout << "[LinkedListGeometryPass] " << m_fbWidth << "x" << m_fbHeight
+                << " oit memory: " << GetGPUMemorySize() / (1024.0 * 1024.0) << " MB" << std::endl;
 }
 
 LinkedListGeometryPass::~LinkedListGeometryPass()
 {
+    m_linkedlistSBOGPUData.readbackBuffer.reset();
     m_linkedlistSBOGPUData.linkedListBuffer.reset();
     m_linkedlistSBOGPUData.headIndexImageResource.reset();
     m_linkedlistSBOGPUData.metaBuffer.reset();
@@ -54,7 +60,9 @@ void LinkedListGeometryPass::Render(vk::CommandBuffer &cmdBuffer, const std::vec
                     .setAspectMask(vk::ImageAspectFlagBits::eColor)
                     .setLevelCount(1)
                     .setLayerCount(1));
-    cmdBuffer.fillBuffer(*m_linkedlistSBOGPUData.metaBuffer->GetPVkBuf(), 0, sizeof(uint32_t), 0);
+    // reset the counter, the capacity follows the current node pool
+    MetaSBOData metaSBOData { 0, m_maxNodeCount };
+    cmdBuffer.updateBuffer(*m_linkedlistSBOGPUData.metaBuffer->GetPVkBuf(), 0, sizeof(MetaSBOData), &metaSBOData);
 
     vk::MemoryBarrier enterBarrier;
     enterBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
@@ -84,6 +92,104 @@ void LinkedListGeometryPass::Render(vk::CommandBuffer &cmdBuffer, const std::vec
     cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), exitBarrier, nullptr, nullptr);
 }
 
+size_t LinkedListGeometryPass::GetGPUMemorySize() const
+{
+    // node pool + head index image + meta, the pool follows the observed depth complexity
+    return sizeof(LinkedListNode) * (size_t)m_maxNodeCount
+            + (size_t)m_fbWidth * m_fbHeight * sizeof(uint32_t)
+            + sizeof(MetaSBOData);
+}
+
+void LinkedListGeometryPass::RecordNodeUsageReadback(vk::CommandBuffer& cmdBuffer, uint32_t frameIdx)
+{
+    assert(frameIdx < MAX_FRAMES_IN_FLIGHT);
+    vk::MemoryBarrier toTransfer;
+    toTransfer.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(), toTransfer, nullptr, nullptr);
+
+    vk::BufferCopy region { 0, sizeof(MetaSBOData) * frameIdx, sizeof(MetaSBOData) };
+    cmdBuffer.copyBuffer(*m_linkedlistSBOGPUData.metaBuffer->GetPVkBuf(), *m_linkedlistSBOGPUData.readbackBuffer->GetPVkBuf(), region);
+
+    vk::MemoryBarrier toHost;
+    toHost.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags(), toHost, nullptr, nullptr);
+    m_readbackPending[frameIdx] = true;
+}
+
+void LinkedListGeometryPass::UpdateNodePool(uint32_t frameIdx)
+{
+    ZoneScopedN("LinkedListGeometryPass::UpdateNodePool");
+    assert(frameIdx < MAX_FRAMES_IN_FLIGHT);
+    if (!m_readbackPending[frameIdx])
+    {
+        return;
+    }
+    m_readbackPending[frameIdx] = false;
+
+    const MetaSBOData& data = m_pReadbackData[frameIdx];
+    uint32_t usage = data.count;
+    m_nodePoolStats.lastUsage = usage;
+    if (usage > data.maxNodeCount)
+    {
+        m_nodePoolStats.overflowFragments += usage - data.maxNodeCount;
+        m_nodePoolStats.overflowFrames++;
+    }
+    // the readback may predate a resize, only compare against the pool it was written with
+    if (data.maxNodeCount != m_maxNodeCount)
+    {
+        return;
+    }
+
+    m_windowPeakUsage = std::max(m_windowPeakUsage, usage);
+    m_windowFrames++;
+
+    uint64_t pixels = (uint64_t)m_fbWidth * m_fbHeight;
+    auto poolSize = [&](uint64_t nodes)
+    {
+        nodes = (uint64_t)(nodes * NodePoolPolicy::HEADROOM);
+        nodes = (nodes + NodePoolPolicy::GRANULARITY - 1) / NodePoolPolicy::GRANULARITY * NodePoolPolicy::GRANULARITY;
+        nodes = std::clamp(nodes, pixels * NodePoolPolicy::MIN_NODES_PER_PIXEL, pixels * MetaSBOData::MAX_NODE_COUNT);
+        return (uint32_t)nodes;
+    };
+
+    uint32_t newMaxNodeCount = m_maxNodeCount;
+    if (usage > m_maxNodeCount)
+    {
+        // fragments were dropped, grow right away
+        newMaxNodeCount = poolSize(usage);
+    }
+    else if (m_windowFrames >= NodePoolPolicy::SHRINK_WINDOW)
+    {
+        if (m_windowPeakUsage < m_maxNodeCount * NodePoolPolicy::SHRINK_THRESHOLD)
+        {
+            newMaxNodeCount = poolSize(m_windowPeakUsage);
+        }
+        m_windowPeakUsage = 0;
+        m_windowFrames = 0;
+    }
+
+    if (newMaxNodeCount == m_maxNodeCount)
+    {
+        return;
+    }
+
+    std::cout << "[LinkedListGeometryPass] node pool " << m_maxNodeCount << " -> " << newMaxNodeCount << " nodes"
+                << " (usage " << usage << ", " << sizeof(LinkedListNode) * (size_t)newMaxNodeCount / (1024.0 * 1024.0) << " MB)" << std::endl;
+
+    // the pool is bound by the frames in flight, resizes are rare thanks to the hysteresis
+    m_pDevice->GetVkDevice().waitIdle();
+    prepareLinkedListBuffer(newMaxNodeCount);
+    updateLinkedListDescriptor();
+    m_readbackPending.fill(false);
+    m_windowPeakUsage = 0;
+    m_windowFrames = 0;
+    m_nodePoolStats.resizeCount++;
+}
+
 void LinkedListGeometryPass::prepareLayout()
 {
     m_pLinkedListDescriptorSetLayout = std::make_shared<RHI::VulkanDescriptorSetLayout>(m_pDevice);
@@ -213,13 +319,13 @@ void LinkedListGeometryPass::prepareSBO()
 {
     MetaSBOData metaSBOData;
     metaSBOData.count = 0;
-    metaSBOData.maxNodeCount = MetaSBOData::MAX_NODE_COUNT * m_fbWidth * m_fbHeight;
+    metaSBOData.maxNodeCount = NodePoolPolicy::INITIAL_NODES_PER_PIXEL * m_fbWidth * m_fbHeight;
 
     {   // prepare metaBuffer
         m_linkedlistSBOGPUData.metaBuffer.reset(new RHI::VulkanGPUBuffer(
             m_pDevice,
             sizeof(MetaSBOData),
-            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
             vk::MemoryPropertyFlagBits::eDeviceLocal,
             vk::SharingMode::eExclusive));
         m_linkedlistSBOGPUData.metaBuffer->FillingBufferOneTime(&metaSBOData, sizeof(metaSBOData));
@@ -254,17 +360,33 @@ void LinkedListGeometryPass::prepareSBO()
         );
     }
 
-    { // prepare linkedListBuffer
-        m_linkedlistSBOGPUData.linkedListBuffer.reset(new RHI::VulkanBuffer(
+    prepareLinkedListBuffer(metaSBOData.maxNodeCount);
+
+    { // prepare readbackBuffer
+        m_linkedlistSBOGPUData.readbackBuffer.reset(new RHI::VulkanBuffer(
             m_pDevice,
-            sizeof(LinkedListNode) * metaSBOData.maxNodeCount,
-            vk::BufferUsageFlagBits::eStorageBuffer,
-            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            sizeof(MetaSBOData) * MAX_FRAMES_IN_FLIGHT,
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
             vk::SharingMode::eExclusive
         ));
+        m_pReadbackData = (MetaSBOData*)m_linkedlistSBOGPUData.readbackBuffer->MappingBuffer(0, sizeof(MetaSBOData) * MAX_FRAMES_IN_FLIGHT);
     }
 }
 
+void LinkedListGeometryPass::prepareLinkedListBuffer(uint32_t maxNodeCount)
+{
+    m_maxNodeCount = maxNodeCount;
+    m_nodePoolStats.capacity = maxNodeCount;
+    m_linkedlistSBOGPUData.linkedListBuffer.reset(new RHI::VulkanBuffer(
+        m_pDevice,
+        sizeof(LinkedListNode) * (size_t)maxNodeCount,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        vk::SharingMode::eExclusive
+    ));
+}
+
 void LinkedListGeometryPass::preparePipeline()
 {
     auto sampleCount = vk::SampleCountFlagBits::e1;
@@ -314,7 +436,7 @@ void LinkedListGeometryPass::prepareOutputDescriptorSets()
     bufferInfo[1]
         .setBuffer(*m_linkedlistSBOGPUData.linkedListBuffer->GetPVkBuf())
         .setOffset(0)
-        .setRange(sizeof(LinkedListNode) * MetaSBOData::MAX_NODE_COUNT * m_fbWidth * m_fbHeight);
+        .setRange(sizeof(LinkedListNode) * (size_t)m_maxNodeCount);
     vk::DescriptorImageInfo imgInfo;
     imgInfo.setImageLayout(vk::ImageLayout::eGeneral)
             .setImageView(m_linkedlistSBOGPUData.headIndexImageResource->GetVkImageView());
@@ -346,4 +468,23 @@ void LinkedListGeometryPass::prepareOutputDescriptorSets()
         .setImageInfo(imgInfo)
         ;
     m_pDescriptors->UpdateDescriptorSets(writeDescs);
-}
\ No newline at end of file
+}
+
+void LinkedListGeometryPass::updateLinkedListDescriptor()
+{
+    vk::DescriptorBufferInfo bufferInfo;
+    bufferInfo
+        .setBuffer(*m_linkedlistSBOGPUData.linkedListBuffer->GetPVkBuf())
+        .setOffset(0)
+        .setRange(sizeof(LinkedListNode) * (size_t)m_maxNodeCount);
+
+    std::vector<vk::WriteDescriptorSet> writeDescs(1);
+    writeDescs[0]
+        .setDstBinding(1)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setDescriptorCount(1)
+        .setBufferInfo(bufferInfo)
+        ;
+    m_pDescriptors->UpdateDescriptorSets(writeDescs);
+}
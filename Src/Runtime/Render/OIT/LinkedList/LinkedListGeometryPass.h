@@ -3,6 +3,7 @@
 #include "Runtime/Render/PrePass/PrePass.h"
 #include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include <array>
 #include <memory>
 namespace Render {
 
@@ -16,6 +17,21 @@ public:
     RHI::VulkanDescriptorSets* GetDescriptorSets() const override { return m_pDescriptors.get(); }
 
     std::shared_ptr<RHI::VulkanDescriptorSetLayout> GetLinkedListDescriptorSetLayout() const { return m_pLinkedListDescriptorSetLayout; }
+    size_t GetGPUMemorySize() const;
+
+    struct NodePoolStats
+    {
+        uint32_t capacity = 0;
+        uint32_t lastUsage = 0;
+        uint64_t overflowFragments = 0;
+        uint32_t overflowFrames = 0;
+        uint32_t resizeCount = 0;
+    };
+    // copy the node counter of this frame into its readback slot, after Render
+    void RecordNodeUsageReadback(vk::CommandBuffer& cmdBuffer, uint32_t frameIdx);
+    // once the fence of frameIdx is signaled: consume its readback, grow or shrink the node pool
+    void UpdateNodePool(uint32_t frameIdx);
+    inline const NodePoolStats& GetNodePoolStats() const { return m_nodePoolStats; }
 private:
     void prepareLayout() override;
     void prepareAttachments(std::vector<RHI::VulkanFramebuffer::Attachment>& attachments) override;
@@ -25,14 +41,29 @@ private:
     void prepareOutputDescriptorSets() override;
 
     void prepareSBO();
+    void prepareLinkedListBuffer(uint32_t maxNodeCount);
+    void updateLinkedListDescriptor();
 private:
     struct MetaSBOData
     {
         static constexpr uint32_t MAX_NODE_COUNT = 20;
+        // every fragment increments count, so count - maxNodeCount is the overflow
         uint32_t count;
         uint32_t maxNodeCount;
     };
-    struct LinkedListNode
+    // pool capacity in nodes per pixel, capped by MetaSBOData::MAX_NODE_COUNT
+    struct NodePoolPolicy
+    {
+        static constexpr uint32_t INITIAL_NODES_PER_PIXEL = 4;
+        static constexpr uint32_t MIN_NODES_PER_PIXEL = 1;
+        static constexpr float HEADROOM = 1.5f;
+        // shrink only when the peak stays below this part of the capacity for SHRINK_WINDOW readbacks
+        static constexpr float SHRINK_THRESHOLD = 0.25f;
+        static constexpr uint32_t SHRINK_WINDOW = 240;
+        static constexpr uint32_t GRANULARITY = 1 << 16;
+    };
+    // std430 layout of Node: vec4 alignment rounds the stride up to 32 bytes
+    struct alignas(16) LinkedListNode
     {
         glm::vec4 color;
         float depth;
@@ -44,6 +75,8 @@ private:
         std::unique_ptr<RHI::VulkanGPUBuffer> metaBuffer;
         std::unique_ptr<RHI::VulkanImageResource> headIndexImageResource;
         std::unique_ptr<RHI::VulkanBuffer> linkedListBuffer;
+        // host visible, one MetaSBOData per frame in flight
+        std::unique_ptr<RHI::VulkanBuffer> readbackBuffer;
     };
 private:
     std::shared_ptr<RHI::VulkanDescriptorSetLayout> m_pLinkedListDescriptorSetLayout;
@@ -51,6 +84,12 @@ private:
     uint32_t m_fbHeight;
     RHI::VulkanImageResource* m_pDepthAttachmentResource;
     LinkedListSBOGPUData m_linkedlistSBOGPUData;
+    uint32_t m_maxNodeCount = 0;
+    MetaSBOData* m_pReadbackData = nullptr;
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> m_readbackPending {};
+    uint32_t m_windowPeakUsage = 0;
+    uint32_t m_windowFrames = 0;
+    NodePoolStats m_nodePoolStats;
 };
 
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "OITRenderer.h"
 #include "Runtime/Render/OIT/LinkedList/LinkedListColorPass.h"
 #include "Runtime/Render/OIT/LinkedList/LinkedListGeometryPass.h"
+#include "Runtime/Render/OIT/WeightedBlended/WeightedBlendedColorPass.h"
+#include "Runtime/Render/OIT/WeightedBlended/WeightedBlendedGeometryPass.h"
 #include "Runtime/Render/PostPass/PresentPostPass.h"
 #include "Runtime/VulkanRHI/Graphic/ModelPresets.h"
 #include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
@@ -14,6 +16,7 @@
 #include "Util/Fileutil.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <iostream>
 #include <memory>
 
 using namespace Render;
@@ -56,7 +59,10 @@ void OITRenderer::prepare()
     prepareInputCallback();
 
     prepareLinkedListPass();
+    prepareWeightedBlendedPass();
     preparePresentFramebuffer();
+
+    m_pTimestampQuery.reset(new RHI::VulkanTimestampQuery(m_pDevice.get(), 2 * MAX_FRAMES_IN_FLIGHT));
 }
 
 void OITRenderer::render()
@@ -71,6 +77,8 @@ void OITRenderer::render()
     {
         throw std::runtime_error("wait for inflight fence failed");
     }
+    collectOITTiming();
+    m_linkedlistPass.geometryPass->UpdateNodePool(m_frameIdxInFlight);
     uint32_t m_imageIdx = 0;
     // acquire image
     vk::Result acquireImageResult;
@@ -120,6 +128,10 @@ void OITRenderer::render()
         TracyVkCollect(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight]);
         TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "deferred");
 
+        uint32_t queryIdx = 2 * m_frameIdxInFlight;
+        m_pTimestampQuery->Reset(m_vkCmds[m_frameIdxInFlight], queryIdx, 2);
+        m_timedModes[m_frameIdxInFlight] = m_oitMode;
+
         {
             // opaque pass
             std::vector<vk::ClearValue> clearValues
@@ -150,29 +162,42 @@ void OITRenderer::render()
             m_vkCmds[m_frameIdxInFlight].pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barrier);
         }
 
+        // bottom of pipe: start once the opaque pass is done
+        m_pTimestampQuery->Write(m_vkCmds[m_frameIdxInFlight], queryIdx, vk::PipelineStageFlagBits::eBottomOfPipe);
+        if (m_oitMode == OITMode::kLinkedList)
         {
-            // geometry pass
-            ZoneScopedN("DeferredRenderer::render::geometry pass");
-            m_linkedlistPass.geometryPass->Render(m_vkCmds[m_frameIdxInFlight], { m_pModel.get() });
-        }
-
-        // m_opaquePass.colorAttachmentSampler->GetPImageResource()->TransitionImageLayout(m_vkCmds[m_frameIdxInFlight], vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+            {
+                // geometry pass
+                ZoneScopedN("DeferredRenderer::render::geometry pass");
+                m_linkedlistPass.geometryPass->Render(m_vkCmds[m_frameIdxInFlight], { m_pModel.get() });
+                m_linkedlistPass.geometryPass->RecordNodeUsageReadback(m_vkCmds[m_frameIdxInFlight], m_frameIdxInFlight);
+            }
 
+            {
+                // color pass
+                std::vector<vk::DescriptorSet> tobinding(3);
+                tobinding[1] = m_opaquePass.descriptorSet->GetVkDescriptorSet(0);
+                auto desc = m_linkedlistPass.geometryPass->GetDescriptorSets();
+                tobinding[2] = desc->GetVkDescriptorSet(0);
+                m_linkedlistPass.colorPass->Render(m_vkCmds[m_frameIdxInFlight], tobinding, m_pDevice->GetVulkanPresentFramebuffer(m_imageIdx)->GetVkFramebuffer());
+            }
+        }
+        else
         {
-            // color pass
-            std::vector<vk::DescriptorSet> tobinding(3);
-            tobinding[1] = m_opaquePass.descriptorSet->GetVkDescriptorSet(0);
-            auto desc = m_linkedlistPass.geometryPass->GetDescriptorSets();
-            tobinding[2] = desc->GetVkDescriptorSet(0);
-            m_linkedlistPass.colorPass->Render(m_vkCmds[m_frameIdxInFlight], tobinding, m_pDevice->GetVulkanPresentFramebuffer(m_imageIdx)->GetVkFramebuffer());
-
-            // vk::MemoryBarrier enterBarrier;
-            // enterBarrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
-            //     .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead);
-            // m_vkCmds[m_frameIdxInFlight].pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-            // vk::DependencyFlags(), enterBarrier, nullptr, nullptr);
+            {
+                // accum & revealage pass
+                ZoneScopedN("OITRenderer::render::weighted blended geometry pass");
+                m_weightedBlendedPass.geometryPass->Render(m_vkCmds[m_frameIdxInFlight], { m_pModel.get() });
+            }
 
+            {
+                // composite pass, opaque color + accum + revealage in one set
+                std::vector<vk::DescriptorSet> tobinding(2);
+                tobinding[1] = m_weightedBlendedPass.geometryPass->GetDescriptorSets()->GetVkDescriptorSet(0);
+                m_weightedBlendedPass.colorPass->Render(m_vkCmds[m_frameIdxInFlight], tobinding, m_pDevice->GetVulkanPresentFramebuffer(m_imageIdx)->GetVkFramebuffer());
+            }
         }
+        m_pTimestampQuery->Write(m_vkCmds[m_frameIdxInFlight], queryIdx + 1, vk::PipelineStageFlagBits::eBottomOfPipe);
     }
     m_vkCmds[m_frameIdxInFlight].end();
 
@@ -211,6 +236,42 @@ void OITRenderer::render()
     }
 }
 
+void OITRenderer::collectOITTiming()
+{
+    double gpuMs = 0.0;
+    uint32_t queryIdx = 2 * m_frameIdxInFlight;
+    if (!m_pTimestampQuery->GetElapsedMs(queryIdx, queryIdx + 1, gpuMs))
+    {
+        return;
+    }
+
+    OITMode mode = m_timedModes[m_frameIdxInFlight];
+    auto& stats = m_modeStats[(size_t)mode];
+    stats.gpuMsSum += gpuMs;
+    stats.frames++;
+    if (stats.frames < ModeStats::REPORT_FRAME_COUNT)
+    {
+        return;
+    }
+
+    bool linkedList = mode == OITMode::kLinkedList;
+    size_t memory = linkedList
+                    ? m_linkedlistPass.geometryPass->GetGPUMemorySize()
+                    : m_weightedBlendedPass.geometryPass->GetGPUMemorySize();
+    std::cout << "[OITRenderer] " << (linkedList ? "linked list" : "weighted blended")
+                << ": " << stats.gpuMsSum / stats.frames << " ms gpu (avg of " << stats.frames << " frames), "
+                << memory / (1024.0 * 1024.0) << " MB";
+    if (linkedList)
+    {
+        auto& poolStats = m_linkedlistPass.geometryPass->GetNodePoolStats();
+        std::cout << ", nodes " << poolStats.lastUsage << "/" << poolStats.capacity
+                    << ", overflow " << poolStats.overflowFragments << " fragments in " << poolStats.overflowFrames << " frames"
+                    << ", " << poolStats.resizeCount << " resizes";
+    }
+    std::cout << std::endl;
+    stats = ModeStats();
+}
+
 void OITRenderer::prepareLayout()
 {
     m_pPipelineLayout.reset(new RHI::VulkanPipelineLayout(
@@ -413,6 +474,11 @@ void OITRenderer::prepareInputCallback()
         m_pCamera->GetVPMatrix().Translate(move);
     });
 
+    inputMonitor->AddKeyboardPressedCallback(platform::Keyboard::Key::TAB, [&](){
+        m_oitMode = m_oitMode == OITMode::kLinkedList ? OITMode::kWeightedBlended : OITMode::kLinkedList;
+        std::cout << "[OITRenderer] mode: " << (m_oitMode == OITMode::kLinkedList ? "linked list" : "weighted blended") << std::endl;
+    });
+
     inputMonitor->AddKeyboardPressedCallback(platform::Keyboard::Key::SPACE, [&](){
         m_pCamera->GetVPMatrix().SetPosition(glm::vec3(0,0,2));
         m_pCamera->GetVPMatrix().SetRotation(glm::vec3(0,0,0));
@@ -469,4 +535,30 @@ void OITRenderer::prepareLinkedListPass()
             m_VulkanPresentFramebufferAttachments,
             m_linkedlistPass.geometryPass->GetLinkedListDescriptorSetLayout());
     m_linkedlistPass.colorPass->Prepare();
-}
\ No newline at end of file
+}
+
+void OITRenderer::prepareWeightedBlendedPass()
+{
+    auto extent = m_pDevice->GetSwapchainExtent();
+    m_weightedBlendedPass.geometryPass =
+        std::make_unique<WeightedBlendedGeometryPass>(
+            m_pDevice.get(),
+            m_pCamera.get(),
+            extent.width, extent.height,
+            m_opaquePass.depthAttachmentSampler->GetPImageResource(),
+            m_opaquePass.colorAttachmentSampler.get()
+        );
+
+    auto colorShader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice.get());
+    colorShader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/linkedlist-color.vert.spv", vk::ShaderStageFlagBits::eVertex);
+    colorShader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/wboit-color.frag.spv", vk::ShaderStageFlagBits::eFragment);
+
+    // same attachments as the linked list color pass, so the present framebuffers are shared
+    m_weightedBlendedPass.colorPass =
+        std::make_unique<WeightedBlendedColorPass>(
+            m_pDevice.get(), m_pCamera.get(), m_pLight.get(),
+            extent.width, extent.height,
+            colorShader,
+            m_VulkanPresentFramebufferAttachments);
+    m_weightedBlendedPass.colorPass->Prepare();
+}
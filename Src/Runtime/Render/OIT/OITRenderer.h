@@ -1,6 +1,8 @@
 #pragma once
 #include "Runtime/Render/OIT/LinkedList/LinkedListColorPass.h"
 #include "Runtime/Render/OIT/LinkedList/LinkedListGeometryPass.h"
+#include "Runtime/Render/OIT/WeightedBlended/WeightedBlendedColorPass.h"
+#include "Runtime/Render/OIT/WeightedBlended/WeightedBlendedGeometryPass.h"
 #include "Runtime/Render/PostPass/PostPass.h"
 #include "Runtime/Render/PrePass/GeometryPrePass.h"
 #include "Runtime/Render/PrePass/PrePass.h"
@@ -9,6 +11,8 @@
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorSets.h"
+#include "Runtime/VulkanRHI/VulkanTimestampQuery.h"
+#include <array>
 #include <vulkan/vulkan.hpp>
 #include <Runtime/Render/RendererBase.h>
 
@@ -51,13 +55,36 @@ private:
     void prepareInputCallback();
 
     void prepareLinkedListPass();
+    void prepareWeightedBlendedPass();
+    // gpu time of the transparent passes, averaged per mode
+    void collectOITTiming();
 private:
+    enum class OITMode
+    {
+        kLinkedList = 0,
+        kWeightedBlended,
+        kCount
+    };
+
     struct LinkedListPass
     {
         std::unique_ptr<LinkedListGeometryPass> geometryPass;
         std::unique_ptr<LinkedListColorPass> colorPass;
     };
 
+    struct WeightedBlendedPass
+    {
+        std::unique_ptr<WeightedBlendedGeometryPass> geometryPass;
+        std::unique_ptr<WeightedBlendedColorPass> colorPass;
+    };
+
+    struct ModeStats
+    {
+        static constexpr uint32_t REPORT_FRAME_COUNT = 256;
+        double gpuMsSum = 0.0;
+        uint32_t frames = 0;
+    };
+
     struct OpaquePass
     {
         std::vector<RHI::VulkanFramebuffer::Attachment> attachments;
@@ -75,8 +102,16 @@ private:
     std::unique_ptr<Camera> m_pCamera;
     std::unique_ptr<Lights> m_pLight;
 
+    // TAB switches the mode at runtime, both passes stay allocated
+    OITMode m_oitMode = OITMode::kLinkedList;
     LinkedListPass m_linkedlistPass;
+    WeightedBlendedPass m_weightedBlendedPass;
     OpaquePass m_opaquePass;
+
+    // two queries per frame in flight around the transparent passes
+    std::unique_ptr<RHI::VulkanTimestampQuery> m_pTimestampQuery;
+    std::array<OITMode, MAX_FRAMES_IN_FLIGHT> m_timedModes;
+    std::array<ModeStats, (size_t)OITMode::kCount> m_modeStats;
 };
 
 }
\ No newline at end of file
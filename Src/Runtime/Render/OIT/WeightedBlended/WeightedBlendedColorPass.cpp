@@ -0,0 +1,14 @@
+#include "WeightedBlendedColorPass.h"
+
+using namespace Render;
+
+void WeightedBlendedColorPass::prepareLayout()
+{
+    m_pPipelineLayout.reset(
+    new RHI::VulkanPipelineLayout(
+        m_pDevice,
+        {m_pDevice->GetDescLayoutPresets().UBO, m_pDevice->GetDescLayoutPresets().CUSTOM5SAMPLER}
+        , {}
+        )
+    );
+}
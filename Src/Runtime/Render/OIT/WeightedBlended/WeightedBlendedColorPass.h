@@ -0,0 +1,17 @@
+#pragma once
+#include "Runtime/Render/PostPass/PresentPostPass.h"
+
+namespace Render {
+
+// composites the weighted blended accum/revealage targets over the opaque color
+class WeightedBlendedColorPass : public PresetPostPass
+{
+public:
+    using PresetPostPass::PresetPostPass;
+    ~WeightedBlendedColorPass() override = default;
+
+protected:
+    void prepareLayout() override;
+};
+
+}
@@ -0,0 +1,201 @@
+#include "WeightedBlendedGeometryPass.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanColorBlendState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanDepthStencilState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanMultisampleState.h"
+#include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
+#include "Runtime/VulkanRHI/VulkanRenderPass.h"
+#include "Runtime/VulkanRHI/VulkanRenderPipeline.h"
+#include "Util/Fileutil.h"
+#include "vulkan/vulkan_enums.hpp"
+#include "vulkan/vulkan_structs.hpp"
+#include <iostream>
+#include <memory>
+
+using namespace Render;
+
+WeightedBlendedGeometryPass::WeightedBlendedGeometryPass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight,
+    RHI::VulkanImageResource* depthAttachmentResource, RHI::VulkanImageSampler* opaqueColorSampler)
+    : PrePass(device, camera)
+    , m_fbWidth(fbWidth)
+    , m_fbHeight(fbHeight)
+    , m_pDepthAttachmentResource(depthAttachmentResource)
+    , m_pOpaqueColorSampler(opaqueColorSampler)
+{
+    assert(m_pDepthAttachmentResource && m_pOpaqueColorSampler);
+    prepareLayout();
+    {
+        std::vector<RHI::VulkanFramebuffer::Attachment> attachments;
+        prepareAttachments(attachments);
+        prepareRenderPass(attachments);
+        prepareFramebuffer(std::move(attachments));
+    }
+    preparePipeline();
+    prepareOutputDescriptorSets();
+
+    std::cout << "[WeightedBlendedGeometryPass] " << m_fbWidth << "x" << m_fbHeight
+                << " oit memory: " << GetGPUMemorySize() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+WeightedBlendedGeometryPass::~WeightedBlendedGeometryPass()
+{
+    m_attachmentResources.accum.reset();
+    m_attachmentResources.revealage.reset();
+}
+
+void WeightedBlendedGeometryPass::Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models)
+{
+    ZoneScopedN("WeightedBlendedGeometryPass::Render");
+    std::vector<vk::ClearValue> clears {
+        // accum
+        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 0.0f } } },
+        // revealage, product of (1 - alpha) starts at 1
+        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 1.0f, 0.0f, 0.0f, 0.0f } } },
+        // depth, loaded from the opaque pass
+        vk::ClearValue { vk::ClearDepthStencilValue { 1.0f, 0 } }
+    };
+
+    vk::Rect2D rect{{0,0},vk::Extent2D{m_fbWidth, m_fbHeight}};
+    m_pRenderPass->Begin(cmdBuffer, clears, rect, m_pFramebuffer->GetVkFramebuffer());
+    {
+        cmdBuffer.setViewport(0,vk::Viewport{0,0,(float)m_fbWidth, (float)m_fbHeight,0,1});
+        cmdBuffer.setScissor(0,rect);
+        m_pRenderPass->BindGraphicPipeline(cmdBuffer, "geometry");
+        std::vector<vk::DescriptorSet> tobinding;
+        for (auto model : models)
+        {
+            model->Draw(cmdBuffer, m_pPipelineLayout.get(), tobinding);
+        }
+    }
+    m_pRenderPass->End(cmdBuffer);
+}
+
+size_t WeightedBlendedGeometryPass::GetGPUMemorySize() const
+{
+    // accum rgba16f + revealage r16f, independent of depth complexity
+    return (size_t)m_fbWidth * m_fbHeight * (8 + 2);
+}
+
+void WeightedBlendedGeometryPass::prepareAttachments(std::vector<RHI::VulkanFramebuffer::Attachment>& attachments)
+{
+    RHI::VulkanImageResource::Config imageConfig;
+    imageConfig.extent = vk::Extent3D{ m_fbWidth, m_fbHeight, 1 };
+    imageConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+    imageConfig.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+    RHI::VulkanImageSampler::Config samplerConfig;
+    samplerConfig.magFilter = vk::Filter::eNearest;
+    samplerConfig.minFilter = vk::Filter::eNearest;
+    samplerConfig.anisotropyEnable = VK_FALSE;
+
+    auto addColorAttachment = [&](std::unique_ptr<RHI::VulkanImageSampler>& target, vk::Format format)
+    {
+        imageConfig.format = format;
+        target.reset(new RHI::VulkanImageSampler(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig, imageConfig));
+        RHI::VulkanFramebuffer::Attachment attachment;
+        attachment.type = RHI::VulkanFramebuffer::kColor;
+        attachment.resourceFormat = format;
+        attachment.resourceFinalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        attachment.resource = target->GetPImageResource()->GetNative();
+        attachments.push_back(attachment);
+    };
+    addColorAttachment(m_attachmentResources.accum, ACCUM_FORMAT);
+    addColorAttachment(m_attachmentResources.revealage, REVEALAGE_FORMAT);
+
+    // depth test against the opaque pass, no depth write
+    RHI::VulkanFramebuffer::Attachment depth;
+    depth.type = RHI::VulkanFramebuffer::kDepthStencil;
+    depth.loadOp = vk::AttachmentLoadOp::eLoad;
+    depth.storeOp = vk::AttachmentStoreOp::eDontCare;
+    depth.resourceInitialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depth.resourceFinalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depth.attachmentReferenceLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depth.resource = m_pDepthAttachmentResource->GetNative();
+    depth.resourceFormat = m_pDepthAttachmentResource->GetConfig().format;
+    attachments.push_back(depth);
+}
+
+void WeightedBlendedGeometryPass::prepareRenderPass(const std::vector<RHI::VulkanFramebuffer::Attachment>& attachments)
+{
+    m_pRenderPass = RHI::VulkanRenderPassBuilder(m_pDevice)
+                        .SetAttachments(attachments)
+                        .SetDefaultSubpass()
+                        .AddSubpassDependency(vk::SubpassDependency()
+                            .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+                            .setDstSubpass(0)
+                            .setSrcStageMask(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eLateFragmentTests)
+                            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests)
+                            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead))
+                        .AddSubpassDependency(vk::SubpassDependency()
+                            .setSrcSubpass(0)
+                            .setDstSubpass(VK_SUBPASS_EXTERNAL)
+                            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+                            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
+                            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eShaderRead))
+                        .buildUnique();
+}
+
+void WeightedBlendedGeometryPass::prepareFramebuffer(std::vector<RHI::VulkanFramebuffer::Attachment>&& attachments)
+{
+    m_pFramebuffer = std::make_unique<RHI::VulkanFramebuffer>(m_pDevice, m_pRenderPass.get(), m_fbWidth, m_fbHeight, 1, std::move(attachments));
+}
+
+void WeightedBlendedGeometryPass::preparePipeline()
+{
+    auto sampleCount = vk::SampleCountFlagBits::e1;
+
+    auto shaderSet = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
+    shaderSet->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/linkedlist-geometry.vert.spv", vk::ShaderStageFlagBits::eVertex);
+    shaderSet->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/wboit-geometry.frag.spv", vk::ShaderStageFlagBits::eFragment);
+    auto multiSampleState = std::make_shared<RHI::VulkanMultisampleState>(sampleCount);
+
+    RHI::VulkanDepthStencilState::Config depthTestConfig;
+    depthTestConfig.DepthWriteEnable = VK_FALSE;
+    auto depthTestState = std::make_shared<RHI::VulkanDepthStencilState>(depthTestConfig);
+
+    // accum += (rgb * a, a) * w
+    auto accumBlend = vk::PipelineColorBlendAttachmentState()
+                        .setColorWriteMask(vk::ColorComponentFlags(0xf))
+                        .setBlendEnable(VK_TRUE)
+                        .setSrcColorBlendFactor(vk::BlendFactor::eOne)
+                        .setDstColorBlendFactor(vk::BlendFactor::eOne)
+                        .setColorBlendOp(vk::BlendOp::eAdd)
+                        .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+                        .setDstAlphaBlendFactor(vk::BlendFactor::eOne)
+                        .setAlphaBlendOp(vk::BlendOp::eAdd);
+    // revealage *= (1 - a)
+    auto revealageBlend = vk::PipelineColorBlendAttachmentState()
+                        .setColorWriteMask(vk::ColorComponentFlagBits::eR)
+                        .setBlendEnable(VK_TRUE)
+                        .setSrcColorBlendFactor(vk::BlendFactor::eZero)
+                        .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcColor)
+                        .setColorBlendOp(vk::BlendOp::eAdd)
+                        .setSrcAlphaBlendFactor(vk::BlendFactor::eZero)
+                        .setDstAlphaBlendFactor(vk::BlendFactor::eOne)
+                        .setAlphaBlendOp(vk::BlendOp::eAdd);
+    auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>{accumBlend, revealageBlend});
+
+    m_pRenderPass->AddGraphicRenderPipeline(
+                    "geometry",
+                        RHI::VulkanRenderPipelineBuilder(m_pDevice, m_pRenderPass.get())
+                            .SetVulkanPipelineLayout(m_pPipelineLayout)
+                            .SetVulkanMultisampleState(multiSampleState)
+                            .SetVulkanColorBlendState(blendState)
+                            .SetshaderSet(shaderSet)
+                            .SetVulkanDepthStencilState(depthTestState)
+                            .buildUnique()
+                    );
+}
+
+void WeightedBlendedGeometryPass::prepareOutputDescriptorSets()
+{
+    // the opaque color rides along so the composite pass binds a single set
+    m_pDescriptorPool.reset(new RHI::VulkanDescriptorPool(m_pDevice,
+        {vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, 3}}, 1));
+    m_pDescriptors = m_pDescriptorPool->AllocSamplerDescriptorSet(
+        m_pDevice->GetDescLayoutPresets().CUSTOM5SAMPLER.get(),
+        {m_pOpaqueColorSampler, m_attachmentResources.accum.get(), m_attachmentResources.revealage.get()},
+        std::vector<uint32_t> {1, 2, 3});
+}
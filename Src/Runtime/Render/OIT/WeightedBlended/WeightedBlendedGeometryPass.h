@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Runtime/Render/PrePass/PrePass.h"
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include <memory>
+namespace Render {
+
+// weighted blended oit: two fixed size targets accumulated with fixed function blending,
+// no atomics, no per pixel lists, no sorting
+class WeightedBlendedGeometryPass : public PrePass
+{
+public:
+    // output descriptor set (CUSTOM5SAMPLER): binding 1 opaque color, 2 accum, 3 revealage
+    explicit WeightedBlendedGeometryPass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight,
+        RHI::VulkanImageResource* depthAttachmentResource, RHI::VulkanImageSampler* opaqueColorSampler);
+    ~WeightedBlendedGeometryPass() override;
+
+    void Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models) override;
+    RHI::VulkanDescriptorSets* GetDescriptorSets() const override { return m_pDescriptors.get(); }
+    size_t GetGPUMemorySize() const;
+private:
+    void prepareAttachments(std::vector<RHI::VulkanFramebuffer::Attachment>& attachments) override;
+    void prepareRenderPass(const std::vector<RHI::VulkanFramebuffer::Attachment>& attachments) override;
+    void prepareFramebuffer(std::vector<RHI::VulkanFramebuffer::Attachment>&& attachments) override;
+    void preparePipeline() override;
+    void prepareOutputDescriptorSets() override;
+private:
+    static constexpr vk::Format ACCUM_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+    static constexpr vk::Format REVEALAGE_FORMAT = vk::Format::eR16Sfloat;
+    struct AttachmentResources
+    {
+        std::unique_ptr<RHI::VulkanImageSampler> accum;
+        std::unique_ptr<RHI::VulkanImageSampler> revealage;
+    };
+private:
+    uint32_t m_fbWidth;
+    uint32_t m_fbHeight;
+    RHI::VulkanImageResource* m_pDepthAttachmentResource;
+    RHI::VulkanImageSampler* m_pOpaqueColorSampler;
+    AttachmentResources m_attachmentResources;
+};
+
+}
@@ -2,6 +2,7 @@
 #include "Runtime/Platform/PlatformInputMonitor.h"
 #include "Runtime/Render/Camera.h"
 #include "Runtime/Render/Prefilter/Ibl.h"
+#include "Runtime/Render/Prefilter/SHIrradiance.h"
 #include "Runtime/VulkanRHI/Graphic/Model.h"
 #include "Runtime/VulkanRHI/Graphic/ModelPresets.h"
 #include "Runtime/VulkanRHI/Graphic/Vertex.h"
@@ -24,6 +25,7 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/quaternion_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include <cmath>
 #include <iostream>
 #include <stdint.h>
 using namespace Render;
@@ -44,6 +46,7 @@ PBRRenderer::~PBRRenderer()
 
 void PBRRenderer::prepare()
 {
+    m_prepareTimePoint = std::chrono::high_resolution_clock::now();
     prepareLayout();
     preparePresentFramebufferAttachments();
     prepareRenderpass();
@@ -54,6 +57,8 @@ void PBRRenderer::prepare()
     prepareCamera();
     // prepare Light
     prepareLight();
+    // prepare sh irradiance, bound with the model ubos
+    prepareSHIrradiance();
     // prepare descriptor layout
     prepareModel();
     // prepare callback
@@ -78,6 +83,9 @@ void PBRRenderer::render()
         throw std::runtime_error("wait for inflight fence failed");
     }
 
+    // descriptor and coefficient updates land between the fence wait and the recording of this frame
+    updateIbl();
+
     // acquire image
     vk::Result acquireImageResult;
     try
@@ -124,7 +132,13 @@ void PBRRenderer::render()
         ZoneScoped;
         TracyVkCollect(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight]);
         TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "pbr");
-        m_pPipelineLayout->PushConstantT(m_vkCmds[m_frameIdxInFlight], 0, m_pushConstant, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+        PushConstant pushConstant = m_pushConstant;
+        if (!m_pIbl->IsReady() && pushConstant.vec4.x == 1.0f)
+        {
+            // the placeholder set has no irradiance cubemap, fall back to sh
+            pushConstant.vec4.x = 2.0f;
+        }
+        m_pPipelineLayout->PushConstantT(m_vkCmds[m_frameIdxInFlight], 0, pushConstant, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
 
         std::vector<vk::DescriptorSet> tobinding;
         m_pIbl->FillToBindingDescriptorSets(tobinding);
@@ -189,6 +203,8 @@ void PBRRenderer::render()
     {
         throw std::runtime_error("present image failed");
     }
+
+    reportStartupTime();
 }
 
 void PBRRenderer::prepareModel()
@@ -202,11 +218,14 @@ void PBRRenderer::prepareModel()
     auto camUbo = m_pCamera->GetUboInfo();
     auto lightUbo = m_pLight->GetUboInfo();
 
+    auto shUbo = m_pSHIrradiance->GetUboInfo();
+
     uboInfos.push_back(camUbo);
     uboInfos.push_back(lightUbo);
+    uboInfos.push_back(shUbo);
 
-    m_pModel->InitUniformDescriptorSets(uboInfos);
-    m_pSkyboxModel->InitUniformDescriptorSets(uboInfos);
+    m_pModel->InitUniformDescriptorSets(uboInfos, m_pCustomDescriptorSetLayout.get());
+    m_pSkyboxModel->InitUniformDescriptorSets(uboInfos, m_pCustomDescriptorSetLayout.get());
 }
 
 void PBRRenderer::prepareCamera()
@@ -312,8 +331,9 @@ void PBRRenderer::prepareInputCallback()
     });
 
 
+    // off -> irradiance cubemap -> sh irradiance
     inputMonitor->AddKeyboardPressedCallback(platform::Keyboard::Key::TAB, [&](){
-        m_pushConstant.vec4.x = 1 - m_pushConstant.vec4.x;
+        m_pushConstant.vec4.x = std::fmod(m_pushConstant.vec4.x + 1.0f, 3.0f);
     });
 
 
@@ -392,7 +412,54 @@ void PBRRenderer::prepareInputCallback()
 void PBRRenderer::prepareIbl()
 {
     m_pIbl.reset(new Prefilter::Ibl(m_pDevice.get()));
-    m_pIbl->Prepare();
+    m_pIbl->PrepareAsync();
+}
+
+void PBRRenderer::prepareSHIrradiance()
+{
+    constexpr int placeholderSize = 32;
+    m_pSHIrradiance.reset(new Prefilter::SHIrradiance(m_pDevice.get()));
+    auto envRawData = RHI::ModelPresets::GetSkyboxMaterialData().textureDatas[0].rawData;
+
+    uint32_t level = 0;
+    while ((int)level + 1 < envRawData->GetMipLevels() && (envRawData->GetWidth() >> level) > placeholderSize)
+    {
+        level++;
+    }
+    m_pSHIrradiance->Project(envRawData.get(), level);
+
+    // the skybox and the ibl upload the same raw data and free its payload meanwhile, the job holds it until it is done
+    m_shIrradianceJob = std::async(std::launch::async, [envRawData, payload = envRawData->AcquireData()](){
+        return Prefilter::SHIrradiance::ProjectCubeMap(envRawData.get(), 0);
+    });
+}
+
+void PBRRenderer::updateIbl()
+{
+    ZoneScoped;
+    m_pIbl->Update();
+    if (m_shIrradianceJob.valid() && m_shIrradianceJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        m_pSHIrradiance->SetCoefficients(m_shIrradianceJob.get());
+    }
+}
+
+void PBRRenderer::reportStartupTime()
+{
+    if (!m_firstFrameReported)
+    {
+        m_firstFrameReported = true;
+        auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_prepareTimePoint).count();
+        std::cout << "[PBRRenderer] time to first frame " << tDiff << " ms" << (m_pIbl->IsReady() ? "" : " (ibl placeholder)") << std::endl;
+    }
+
+    if (m_fullQualityReported || !m_pIbl->IsReady() || m_shIrradianceJob.valid())
+    {
+        return;
+    }
+    m_fullQualityReported = true;
+    auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_prepareTimePoint).count();
+    std::cout << "[PBRRenderer] time to full quality " << tDiff << " ms" << std::endl;
 }
 
 
@@ -412,10 +479,11 @@ void PBRRenderer::prepareLayout()
     };
 
 
+    m_pCustomDescriptorSetLayout = m_pDevice->GetDescLayoutPresets().CreateCustomUBO(m_pDevice.get(), vk::ShaderStageFlagBits::eFragment);
     m_pPipelineLayout.reset(
         new RHI::VulkanPipelineLayout(
             m_pDevice.get(),
-            {m_pSet0UniformSetLayout.lock(), m_pSet1SamplerSetLayout.lock(), m_pSet2ShadowmapSamplerLayout.lock()}
+            {m_pCustomDescriptorSetLayout, m_pSet1SamplerSetLayout.lock(), m_pSet2ShadowmapSamplerLayout.lock()}
             ,pushconstants
             )
         );
@@ -1,8 +1,11 @@
 #pragma once
 #include "Runtime/Render/Light.h"
 #include "Runtime/Render/Prefilter/Ibl.h"
+#include "Runtime/Render/Prefilter/SHIrradiance.h"
 #include "Runtime/VulkanRHI/Graphic/Model.h"
 #include "vulkan/vulkan_structs.hpp"
+#include <chrono>
+#include <future>
 #include <vulkan/vulkan.hpp>
 #include <Runtime/Render/RendererBase.h>
 
@@ -17,6 +20,11 @@ protected:
     std::unique_ptr<Camera> m_pCamera;
     std::unique_ptr<Lights> m_pLight;
     std::unique_ptr<Prefilter::Ibl> m_pIbl;
+    std::unique_ptr<Prefilter::SHIrradiance> m_pSHIrradiance;
+    // full resolution projection, the placeholder comes from a small mip
+    std::future<Prefilter::SHIrradiance::Coefficients> m_shIrradianceJob;
+    // set0 with the sh irradiance ubo at the custom binding
+    std::shared_ptr<RHI::VulkanDescriptorSetLayout> m_pCustomDescriptorSetLayout;
     uint32_t m_imageIdx = 0;
 
 public:
@@ -40,6 +48,9 @@ protected:
     void prepareLight();
     void prepareInputCallback();
     void prepareIbl();
+    void prepareSHIrradiance();
+    void updateIbl();
+    void reportStartupTime();
     void updateLightUniformBuf();
 private:
     struct PushConstant
@@ -47,6 +58,10 @@ private:
         glm::vec4 vec4 = glm::vec4(1.0);
     };
     PushConstant m_pushConstant;
+
+    std::chrono::high_resolution_clock::time_point m_prepareTimePoint;
+    bool m_firstFrameReported = false;
+    bool m_fullQualityReported = false;
 };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "GeometryPrePass.h"
 #include "Runtime/Render/PrePass/PrePass.h"
 #include "Runtime/VulkanRHI/PipelineStates/VulkanColorBlendState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanVertextInputState.h"
 #include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
@@ -10,15 +11,19 @@
 #include "vulkan/vulkan_core.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <iostream>
 #include <memory>
 
 using namespace Render;
 
 
-GeometryPrePass::GeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight)
+GeometryPrePass::GeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight, bool compact, Util::Model::VertexFormat vertexFormat)
     : PrePass(device, camera)
     , m_fbWidth(fbWidth)
     , m_fbHeight(fbHeight)
+    , m_compact(compact)
+    , m_vertexFormat(vertexFormat)
 {
     prepareLayout();
     {
@@ -40,8 +45,6 @@ GeometryPrePass::~GeometryPrePass()
 void GeometryPrePass::Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models)
 {
     std::vector<vk::ClearValue> clearValues {
-        // position
-        vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 1.0f } } },
         // normal
         vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 0.0f } } },
         // albedo
@@ -49,12 +52,18 @@ void GeometryPrePass::Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI
         // depth
         vk::ClearValue { vk::ClearDepthStencilValue { 1.0f, 0 } }
     };
-    m_pRenderPass->Begin(cmdBuffer, clearValues, vk::Rect2D { vk::Offset2D {0,0}, vk::Extent2D{ m_fbWidth, m_fbHeight } }, m_pFramebuffer->GetVkFramebuffer());
+    if (!m_compact)
+    {
+        // position
+        clearValues.insert(clearValues.begin(), vk::ClearValue { vk::ClearColorValue { std::array<float, 4> { 0.0f, 0.0f, 0.0f, 1.0f } } });
+    }
+    vk::Extent2D renderExtent { std::max(1u, (uint32_t)(m_fbWidth * m_renderScale)), std::max(1u, (uint32_t)(m_fbHeight * m_renderScale)) };
+    m_pRenderPass->Begin(cmdBuffer, clearValues, vk::Rect2D { vk::Offset2D {0,0}, renderExtent }, m_pFramebuffer->GetVkFramebuffer());
     {
         m_pRenderPass->BindGraphicPipeline(cmdBuffer, "mrt");
-        vk::Viewport viewport {0,0,(float)m_fbWidth, (float)m_fbHeight, 0.0f, 1.0f};
+        vk::Viewport viewport {0,0,(float)renderExtent.width, (float)renderExtent.height, 0.0f, 1.0f};
         cmdBuffer.setViewport(0,1,&viewport);
-        cmdBuffer.setScissor(0, vk::Rect2D{vk::Offset2D{0,0}, vk::Extent2D{m_fbWidth, m_fbHeight}});
+        cmdBuffer.setScissor(0, vk::Rect2D{vk::Offset2D{0,0}, renderExtent});
         std::vector<vk::DescriptorSet> tobinding;
         for (auto model : models)
         {
@@ -68,8 +77,6 @@ void GeometryPrePass::Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI
 
 void GeometryPrePass::prepareAttachments(std::vector<RHI::VulkanFramebuffer::Attachment>& attachments)
 {
-    attachments.resize(4);
-
     auto sampleCount = vk::SampleCountFlagBits::e1;
 
     RHI::VulkanImageSampler::Config samplerConfig;
@@ -86,47 +93,57 @@ void GeometryPrePass::prepareAttachments(std::vector<RHI::VulkanFramebuffer::Att
     attachRTConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
     attachRTConfig.sampleCount = sampleCount;
 
-    // 0: position attachment samplable
-    attachRTConfig.format = vk::Format::eR16G16B16A16Sfloat;
-    m_attachmentResources.position = std::make_unique<RHI::VulkanImageSampler>(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig,  attachRTConfig);
-    attachments[0].resource = m_attachmentResources.position->GetPImageResource()->GetNative();
-    attachments[0].resourceFormat = attachRTConfig.format;
-    attachments[0].samples = sampleCount;
-    attachments[0].attachmentReferenceLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachments[0].type = RHI::VulkanFramebuffer::kColor;
-
-    // 1: normal attachment samplable
-    RHI::VulkanFramebuffer::Attachment normal;
-    attachRTConfig.format = vk::Format::eR16G16B16A16Sfloat;
-    m_attachmentResources.normal = std::make_unique<RHI::VulkanImageSampler>(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig,  attachRTConfig);
-    attachments[1].resource = m_attachmentResources.normal->GetPImageResource()->GetNative();
-    attachments[1].resourceFormat = attachRTConfig.format;
-    attachments[1].samples = sampleCount;
-    attachments[1].attachmentReferenceLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachments[1].type = RHI::VulkanFramebuffer::kColor;
-
-
-    // 2: albedo attachment samplable
-    attachRTConfig.format = vk::Format::eR8G8B8A8Unorm;
-    m_attachmentResources.albedo = std::make_unique<RHI::VulkanImageSampler>(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig,  attachRTConfig);
-    attachments[2].resource = m_attachmentResources.albedo->GetPImageResource()->GetNative();
-    attachments[2].resourceFormat = attachRTConfig.format;
-    attachments[2].samples = sampleCount;
-    attachments[2].attachmentReferenceLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachments[2].type = RHI::VulkanFramebuffer::kColor;
-
-
-    // 3: depth attachment
+    auto addColorAttachment = [&](std::unique_ptr<RHI::VulkanImageSampler>& target, vk::Format format)
+    {
+        attachRTConfig.format = format;
+        target = std::make_unique<RHI::VulkanImageSampler>(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig,  attachRTConfig);
+        RHI::VulkanFramebuffer::Attachment attachment;
+        attachment.resource = target->GetPImageResource()->GetNative();
+        attachment.resourceFormat = format;
+        attachment.samples = sampleCount;
+        attachment.attachmentReferenceLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        attachment.type = RHI::VulkanFramebuffer::kColor;
+        attachments.push_back(attachment);
+    };
+
+    uint32_t bytesPerPixel = 0;
+    if (m_compact)
+    {
+        // 0: octahedral encoded normal
+        addColorAttachment(m_attachmentResources.normal, vk::Format::eR16G16Sfloat);
+        // 1: albedo.rgb + specular intensity in alpha
+        addColorAttachment(m_attachmentResources.albedo, vk::Format::eR8G8B8A8Unorm);
+        bytesPerPixel += 4 + 4;
+    }
+    else
+    {
+        // 0: position attachment samplable
+        addColorAttachment(m_attachmentResources.position, vk::Format::eR16G16B16A16Sfloat);
+        // 1: normal attachment samplable
+        addColorAttachment(m_attachmentResources.normal, vk::Format::eR16G16B16A16Sfloat);
+        // 2: albedo attachment samplable
+        addColorAttachment(m_attachmentResources.albedo, vk::Format::eR8G8B8A8Unorm);
+        bytesPerPixel += 8 + 8 + 4;
+    }
+
+    // last: depth attachment, sampled by the lighting pass to rebuild position in compact mode
     attachRTConfig.format = m_pDevice->GetVulkanPhysicalDevice()->QuerySupportedDepthFormat();
     attachRTConfig.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eDepth);
     attachRTConfig.imageUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
     m_attachmentResources.depth = std::make_unique<RHI::VulkanImageSampler>(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig,  attachRTConfig);
-    attachments[3].resource = m_attachmentResources.depth->GetPImageResource()->GetNative();
-    attachments[3].resourceFormat = attachRTConfig.format;
-    attachments[3].samples = sampleCount;
-    attachments[3].resourceFinalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
-    attachments[3].attachmentReferenceLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
-    attachments[3].type = RHI::VulkanFramebuffer::kDepthStencil;
+    RHI::VulkanFramebuffer::Attachment depth;
+    depth.resource = m_attachmentResources.depth->GetPImageResource()->GetNative();
+    depth.resourceFormat = attachRTConfig.format;
+    depth.samples = sampleCount;
+    depth.resourceFinalLayout = m_compact ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depth.attachmentReferenceLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    depth.type = RHI::VulkanFramebuffer::kDepthStencil;
+    attachments.push_back(depth);
+    bytesPerPixel += attachRTConfig.format == vk::Format::eD32SfloatS8Uint ? 8 : 4;
+
+    std::cout << "[GeometryPrePass] " << (m_compact ? "compact" : "default") << " gbuffer: "
+              << bytesPerPixel << " bytes/pixel, "
+              << (uint64_t)bytesPerPixel * m_fbWidth * m_fbHeight / (1024 * 1024) << " MB" << std::endl;
 }
 
 void GeometryPrePass::prepareRenderPass(const std::vector<RHI::VulkanFramebuffer::Attachment>& attachments)
@@ -145,10 +162,10 @@ void GeometryPrePass::prepareRenderPass(const std::vector<RHI::VulkanFramebuffer
                         .AddSubpassDependency(vk::SubpassDependency()
                             .setSrcSubpass(0)
                             .setDstSubpass(VK_SUBPASS_EXTERNAL)
-                            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-                            .setDstStageMask(vk::PipelineStageFlagBits::eBottomOfPipe)
-                            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite)
-                            .setDstAccessMask(vk::AccessFlagBits::eMemoryRead)
+                            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+                            .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eBottomOfPipe)
+                            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eMemoryRead)
                             .setDependencyFlags(vk::DependencyFlagBits::eByRegion))
                         .buildUnique();
 }
@@ -164,20 +181,22 @@ void GeometryPrePass::preparePipeline()
 
     {
         auto shaderSet = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
-        shaderSet->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/mrt.vert.spv", vk::ShaderStageFlagBits::eVertex);
-        shaderSet->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/mrt.frag.spv", vk::ShaderStageFlagBits::eFragment);
+        bool packed = m_vertexFormat != Util::Model::VertexFormat::kFull;
+        shaderSet->AddShader(Util::File::getResourcePath() / (packed ? "Shader/GLSL/SPIR-V/mrt.packed.vert.spv" : "Shader/GLSL/SPIR-V/mrt.vert.spv"), vk::ShaderStageFlagBits::eVertex);
+        shaderSet->AddShader(Util::File::getResourcePath() / (m_compact ? "Shader/GLSL/SPIR-V/mrt.compact.frag.spv" : "Shader/GLSL/SPIR-V/mrt.frag.spv"), vk::ShaderStageFlagBits::eFragment);
         auto multiSampleState = std::make_shared<RHI::VulkanMultisampleState>(sampleCount);
 
         auto blendStateAttachment = vk::PipelineColorBlendAttachmentState()
                                         .setColorWriteMask(vk::ColorComponentFlags(0xf))
                                         .setBlendEnable(VK_FALSE);
-        auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>(3, blendStateAttachment));
+        auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>(m_compact ? 2 : 3, blendStateAttachment));
         m_pRenderPass->AddGraphicRenderPipeline(
                         "mrt",
                             RHI::VulkanRenderPipelineBuilder(m_pDevice, m_pRenderPass.get())
                                 .SetVulkanPipelineLayout(m_pPipelineLayout)
                                 .SetVulkanMultisampleState(multiSampleState)
                                 .SetVulkanColorBlendState(blendState)
+                                .SetVulkanVertexInputState(std::make_shared<RHI::VulkanVertextInputState>(m_vertexFormat))
                                 .SetshaderSet(shaderSet)
                                 .buildUnique()
                         );
@@ -191,12 +210,20 @@ void GeometryPrePass::prepareOutputDescriptorSets()
         std::vector<vk::DescriptorPoolSize>{
             { vk::DescriptorType::eCombinedImageSampler, 4 }
         },1));
-    m_pDescriptors = m_pDescriptorPool->AllocSamplerDescriptorSet(
-        m_pDevice->GetDescLayoutPresets().CUSTOM5SAMPLER.get(),
-        {
-            m_attachmentResources.position.get(),
+    // binding 1: position, 2: normal, 3: albedo, 4: depth
+    std::vector<RHI::VulkanImageSampler*> samplers;
+    std::vector<uint32_t> bindings;
+    if (!m_compact)
+    {
+        samplers.push_back(m_attachmentResources.position.get());
+        bindings.push_back(1);
+    }
+    samplers.insert(samplers.end(), {
             m_attachmentResources.normal.get(),
             m_attachmentResources.albedo.get(),
             m_attachmentResources.depth.get()
-        }, {1,2,3,4});
+        });
+    bindings.insert(bindings.end(), {2,3,4});
+    m_pDescriptors = m_pDescriptorPool->AllocSamplerDescriptorSet(
+        m_pDevice->GetDescLayoutPresets().CUSTOM5SAMPLER.get(), samplers, bindings);
 }
\ No newline at end of file
@@ -1,17 +1,21 @@
 #pragma once
 #include "PrePass.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Util/Modelutil.h"
 
 namespace Render {
 
 class GeometryPrePass : public PrePass
 {
 public:
-    explicit GeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight);
+    // compact: no position target (rebuilt from depth), octahedral normal in RG16, albedo.a = specular
+    // vertexFormat: of the models rendered
+    explicit GeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight, bool compact = false, Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull);
     ~GeometryPrePass() override;
 
     void Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models) override;
     RHI::VulkanDescriptorSets* GetDescriptorSets() const override { return m_pDescriptors.get(); }
+    inline bool IsCompact() const { return m_compact; }
 private:
     // void prepareLayout() = default;
     void prepareAttachments(std::vector<RHI::VulkanFramebuffer::Attachment>& attachments) override;
@@ -30,6 +34,8 @@ private:
     AttachmentResources m_attachmentResources;
     uint32_t m_fbWidth;
     uint32_t m_fbHeight;
+    bool m_compact;
+    Util::Model::VertexFormat m_vertexFormat;
 };
 
 }
\ No newline at end of file
@@ -5,9 +5,9 @@
 using namespace Render;
 
 
-std::unique_ptr<PrePass> PrePass::CreateGeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight)
+std::unique_ptr<PrePass> PrePass::CreateGeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight, bool compact, Util::Model::VertexFormat vertexFormat)
 {
-    return std::make_unique<GeometryPrePass>(device, camera, fbWidth, fbHeight);
+    return std::make_unique<GeometryPrePass>(device, camera, fbWidth, fbHeight, compact, vertexFormat);
 }
 
 std::unique_ptr<PrePass> PrePass::CreateZPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight)
@@ -6,6 +6,7 @@
 #include "Runtime/VulkanRHI/VulkanDescriptorSets.h"
 #include "Runtime/VulkanRHI/VulkanDevice.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Util/Modelutil.h"
 #include <stdint.h>
 #include <vulkan/vulkan.hpp>
 #include <Runtime/Render/RendererBase.h>
@@ -16,7 +17,7 @@ class PrePass
 {
 public:
     // presets
-    static std::unique_ptr<PrePass> CreateGeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight);
+    static std::unique_ptr<PrePass> CreateGeometryPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight, bool compact = false, Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull);
     static std::unique_ptr<PrePass> CreateZPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight);
 
 
@@ -26,6 +27,9 @@ public:
     virtual ~PrePass() = default;
     virtual void Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models) = 0;
     virtual RHI::VulkanDescriptorSets* GetDescriptorSets() const = 0;
+    // render into the top left scale * fbSize of the targets, the targets are not resized
+    virtual void SetRenderScale(float scale) { m_renderScale = scale; }
+    inline float GetRenderScale() const { return m_renderScale; }
 protected:
     // 1. layout
     virtual void prepareLayout();
@@ -42,6 +46,7 @@ protected:
 protected:
     RHI::VulkanDevice* m_pDevice;
     Camera* m_pCamera;
+    float m_renderScale = 1.0f;
     std::shared_ptr<RHI::VulkanPipelineLayout> m_pPipelineLayout;
     std::unique_ptr<RHI::VulkanRenderPass> m_pRenderPass;
     std::unique_ptr<RHI::VulkanFramebuffer> m_pFramebuffer;
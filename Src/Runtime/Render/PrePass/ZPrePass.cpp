@@ -1,8 +1,10 @@
 #include "ZPrePass.h"
 #include "Runtime/VulkanRHI/PipelineStates/VulkanColorBlendState.h"
 #include "Runtime/VulkanRHI/PipelineStates/VulkanMultisampleState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanVertextInputState.h"
 #include "Runtime/VulkanRHI/VulkanRenderPipeline.h"
 #include "Util/Fileutil.h"
+#include <algorithm>
 
 using namespace Render;
 
@@ -27,6 +29,27 @@ ZPrePass::~ZPrePass()
     m_pDepthImageSampler.reset();
 }
 
+void ZPrePass::Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models)
+{
+    std::vector<vk::ClearValue> clearValues {
+        vk::ClearValue { vk::ClearDepthStencilValue { 1.0f, 0 } }
+    };
+    vk::Extent2D renderExtent { std::max(1u, (uint32_t)(m_fbWidth * m_renderScale)), std::max(1u, (uint32_t)(m_fbHeight * m_renderScale)) };
+    m_pRenderPass->Begin(cmdBuffer, clearValues, vk::Rect2D { vk::Offset2D {0,0}, renderExtent }, m_pFramebuffer->GetVkFramebuffer());
+    {
+        m_pRenderPass->BindGraphicPipeline(cmdBuffer, "mrt");
+        vk::Viewport viewport {0,0,(float)renderExtent.width, (float)renderExtent.height, 0.0f, 1.0f};
+        cmdBuffer.setViewport(0,1,&viewport);
+        cmdBuffer.setScissor(0, vk::Rect2D{vk::Offset2D{0,0}, renderExtent});
+        std::vector<vk::DescriptorSet> tobinding;
+        for (auto model : models)
+        {
+            model->DrawDepthOnly(cmdBuffer, m_pPipelineLayout.get(), tobinding);
+        }
+    }
+    m_pRenderPass->End(cmdBuffer);
+}
+
 void ZPrePass::prepareLayout()
 {
     m_pPipelineLayout.reset(
@@ -110,16 +133,15 @@ void ZPrePass::preparePipeline()
         // shaderSet->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/mrt.frag.spv", vk::ShaderStageFlagBits::eFragment);
         auto multiSampleState = std::make_shared<RHI::VulkanMultisampleState>(sampleCount);
 
-        auto blendStateAttachment = vk::PipelineColorBlendAttachmentState()
-                                        .setColorWriteMask(vk::ColorComponentFlags(0xf))
-                                        .setBlendEnable(VK_FALSE);
-        auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>(1, blendStateAttachment));
+        // depth only, no color attachment to blend
+        auto blendState = std::make_shared<RHI::VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>{});
         m_pRenderPass->AddGraphicRenderPipeline(
                         "mrt",
                             RHI::VulkanRenderPipelineBuilder(m_pDevice, m_pRenderPass.get())
                                 .SetVulkanPipelineLayout(m_pPipelineLayout)
                                 .SetVulkanMultisampleState(multiSampleState)
                                 .SetVulkanColorBlendState(blendState)
+                                .SetVulkanVertexInputState(RHI::VulkanVertextInputState::CreatePositionOnly())
                                 .SetshaderSet(shaderSet)
                                 .buildUnique()
                         );
@@ -11,7 +11,7 @@ public:
     explicit ZPrePass(RHI::VulkanDevice* device, Camera* camera, uint32_t fbWidth, uint32_t fbHeight);
     ~ZPrePass() override;
 
-    void Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models) override { assert(false); }
+    void Render(vk::CommandBuffer& cmdBuffer, const std::vector<RHI::Model*>& models) override;
     RHI::VulkanDescriptorSets* GetDescriptorSets() const override { return m_pDescriptors.get(); }
 private:
     void prepareLayout() override;
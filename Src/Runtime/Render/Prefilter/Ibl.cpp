@@ -6,10 +6,12 @@
 #include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
 #include "Runtime/VulkanRHI/VulkanCommandPool.h"
+#include "Runtime/VulkanRHI/VulkanComputePipeline.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
 #include "Runtime/VulkanRHI/VulkanRenderPass.h"
 #include "Runtime/VulkanRHI/VulkanRenderPipeline.h"
 #include "Runtime/VulkanRHI/VulkanShaderSet.h"
+#include "Runtime/VulkanRHI/VulkanTimestampQuery.h"
 #include "Util/Fileutil.h"
 #include "Util/Modelutil.h"
 #include "Util/Textureutil.h"
@@ -17,10 +19,17 @@
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
 #include <assimp/material.h>
+#include <boost/filesystem/path.hpp>
+#include <chrono>
 #include <cmath>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <stdexcept>
 #include <stdint.h>
 #include <utility>
 #include <vector>
@@ -29,21 +38,134 @@
 
 namespace Render { namespace Prefilter {
 
+namespace {
+
+constexpr vk::Format IRRADIANCE_FORMAT = vk::Format::eR32G32B32A32Sfloat;
+constexpr int32_t IRRADIANCE_DIM = 64;
+constexpr float IRRADIANCE_DELTA_PHI = (2.0f * 3.14159265358979323846f) / 180.0f;
+constexpr float IRRADIANCE_DELTA_THETA = (0.5f * 3.14159265358979323846f) / 64.0f;
+// cosine weighted importance sampling, the raster path takes (2PI / deltaPhi) * (0.5PI / deltaTheta) = 11520 samples
+constexpr uint32_t IRRADIANCE_COMPUTE_SAMPLES = 256;
+
+constexpr vk::Format PREFILTER_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+constexpr int32_t PREFILTER_DIM = 512;
+constexpr uint32_t PREFILTER_SAMPLES = 32;
+
+uint32_t mipCount(int32_t dim)
+{
+    return floor(log2(dim)) + 1;
+}
+
+// the compared path writes the same cubemap as the path in use, which starts once it finished
+void barrierAfterComparedPath(vk::CommandBuffer cmd)
+{
+    auto barrier = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eMemoryWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlagBits(0), {barrier}, {}, {});
+}
+
+}
+
+Ibl::~Ibl()
+{
+    // the workers write into members and read the readback buffers
+    if (m_cacheJob.valid())
+    {
+        m_cacheJob.wait();
+    }
+    for (auto& write : m_cacheWrites)
+    {
+        write.job.wait();
+    }
+    if (m_pGeneration)
+    {
+        (void)m_pDevice->GetVkDevice().waitForFences(m_generationFence, true, std::numeric_limits<uint64_t>::max());
+        for (auto& view : m_pGeneration->views)
+        {
+            m_pDevice->GetVkDevice().destroyImageView(view);
+        }
+    }
+    if (m_generationFence)
+    {
+        m_pDevice->GetVkDevice().destroyFence(m_generationFence);
+    }
+}
+
 void Ibl::Prepare()
+{
+    ZoneScoped;
+    PrepareAsync();
+    m_cacheJob.wait();
+    while (!Update())
+    {
+        // block on the submitted generation instead of polling its fence, the next Update finishes it
+        if (m_pGeneration)
+        {
+            (void)m_pDevice->GetVkDevice().waitForFences(m_generationFence, true, std::numeric_limits<uint64_t>::max());
+        }
+    }
+}
+
+void Ibl::PrepareAsync()
 {
     ZoneScoped;
     prepareLayout();
     prepareCamera();
-    prepareSamplerCubeModel();
     prepareCmd();
-    generateIrradianceCubeMap();
-    generatePrefilterEnvCubeMap();
+    prepareEnvCubeMap();
     generateBrdfLUT();
+    generatePlaceholderDescriptorSet();
 
-
-    generateOutputDiscriptorSet();
+    m_cacheJob = std::async(std::launch::async, [this](){ loadCache(); });
 }
 
+bool Ibl::Update()
+{
+    ZoneScoped;
+    m_cacheWrites.erase(std::remove_if(m_cacheWrites.begin(), m_cacheWrites.end(), [](CacheWrite& write)
+    {
+        return write.job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), m_cacheWrites.end());
+    if (m_step == Step::kReady)
+    {
+        return true;
+    }
+    if (m_cacheJob.valid())
+    {
+        if (m_cacheJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return false;
+        }
+        // rethrows what the worker threw
+        m_cacheJob.get();
+    }
+
+    // one step per call, a cache miss waits for its generation over as many frames as the gpu takes
+    switch (m_step)
+    {
+    case Step::kIrradiance:
+        if (updateIrradianceCubeMap())
+        {
+            m_step = Step::kPrefilter;
+        }
+        break;
+    case Step::kPrefilter:
+        if (updatePrefilterEnvCubeMap())
+        {
+            m_step = Step::kDescriptor;
+        }
+        break;
+    case Step::kDescriptor:
+        // a fresh set, never recorded before, so in-flight frames keep the placeholder without a wait
+        generateOutputDiscriptorSet();
+        m_step = Step::kReady;
+        break;
+    case Step::kReady:
+        break;
+    }
+    return m_step == Step::kReady;
+}
 
 void Ibl::FillToBindingDescriptorSets(std::vector<vk::DescriptorSet>& tobinding)
 {
@@ -52,7 +174,7 @@ void Ibl::FillToBindingDescriptorSets(std::vector<vk::DescriptorSet>& tobinding)
     {
         tobinding.resize(3);
     }
-    tobinding[2] = m_pDescriptor->GetVkDescriptorSet(0);
+    tobinding[2] = IsReady() ? m_pDescriptor->GetVkDescriptorSet(0) : m_pPlaceholderDescriptor->GetVkDescriptorSet(0);
 }
 
 
@@ -87,9 +209,14 @@ void Ibl::prepareCamera()
     m_pCamera->InitUniformBuffer(m_pDevice);
 }
 
+// only the raster path draws the cube, created on first use
 void Ibl::prepareSamplerCubeModel()
 {
     ZoneScoped;
+    if (m_pSamplerCubeModel)
+    {
+        return;
+    }
     m_pLight.reset(new Lights(m_pDevice, 1));
     m_pSamplerCubeModel = RHI::ModelPresets::CreateSkyboxModel(m_pDevice, m_pPipelineLayout->GetPVulkanDescriptorSet(1));
 
@@ -105,28 +232,201 @@ void Ibl::prepareSamplerCubeModel()
 void Ibl::prepareCmd()
 {
     m_pCmdPool.reset(new RHI::VulkanCommandPool(m_pDevice, m_pDevice->GetQueueFamilyIndices().graphic.value()));
+    m_pTimestampQuery.reset(new RHI::VulkanTimestampQuery(m_pDevice, 4));
+    m_generationCmd = m_pCmdPool->CreateReUsableCmd();
+    m_generationFence = m_pDevice->GetVkDevice().createFence(vk::FenceCreateInfo());
+}
+
+// runs on the worker thread: hashing and disk reads only, no vulkan calls
+void Ibl::loadCache()
+{
+    ZoneScoped;
+    auto tStart = std::chrono::high_resolution_clock::now();
+
+    m_pCache.reset(new IblCache(RHI::ModelPresets::GetSkyboxTexturePath()));
+    m_irradianceCacheParams = irradianceCacheParams();
+    m_prefilterCacheParams = prefilterCacheParams();
+    m_pCachedIrradiance = m_pCache->Load(m_irradianceCacheParams);
+    m_pCachedPrefilterEnv = m_pCache->Load(m_prefilterCacheParams);
+
+    auto tEnd = std::chrono::high_resolution_clock::now();
+    auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+    std::cout << "[Ibl] reading cache on worker took " << tDiff << " ms" << std::endl;
+}
+
+IblCache::Params Ibl::irradianceCacheParams() const
+{
+    const uint32_t numMips = mipCount(IRRADIANCE_DIM);
+    return m_useCompute
+        ? IblCache::Params{"irradiance", IRRADIANCE_FORMAT, (uint32_t)IRRADIANCE_DIM, numMips, 0.0f, 0.0f, (float)IRRADIANCE_COMPUTE_SAMPLES, {shaderPath("ibl.irradiance.comp.spv")}}
+        : IblCache::Params{"irradiance", IRRADIANCE_FORMAT, (uint32_t)IRRADIANCE_DIM, numMips, IRRADIANCE_DELTA_PHI, IRRADIANCE_DELTA_THETA, 0.0f, {shaderPath("ibl.filtercube.vert.spv"), shaderPath("ibl.irradiance.frag.spv")}};
+}
+
+IblCache::Params Ibl::prefilterCacheParams() const
+{
+    const uint32_t numMips = mipCount(PREFILTER_DIM);
+    return m_useCompute
+        ? IblCache::Params{"prefilter", PREFILTER_FORMAT, (uint32_t)PREFILTER_DIM, numMips, 0.0f, 0.0f, (float)PREFILTER_SAMPLES, {shaderPath("ibl.prefilterEnvMap.comp.spv")}}
+        : IblCache::Params{"prefilter", PREFILTER_FORMAT, (uint32_t)PREFILTER_DIM, numMips, 0.0f, 0.0f, (float)PREFILTER_SAMPLES, {shaderPath("ibl.filtercube.vert.spv"), shaderPath("ibl.prefilterEnvMap.frag.spv")}};
 }
 
-void Ibl::generateIrradianceCubeMap()
+bool Ibl::loadCubeMapFromCache(
+    std::shared_ptr<Util::Texture::RawData>& rawData,
+    const IblCache::Params& params,
+    std::unique_ptr<RHI::VulkanImageSampler>& sampler,
+    const RHI::VulkanImageSampler::Config& samplerConfig,
+    const RHI::VulkanImageResource::Config& resourceConfig
+)
 {
     ZoneScoped;
+    if (!rawData)
+    {
+        return false;
+    }
     auto tStart = std::chrono::high_resolution_clock::now();
 
-    const vk::Format format = vk::Format::eR32G32B32A32Sfloat;
-    const int32_t dim = 64;
-    const uint32_t numMips = floor(log2(dim)) + 1;
-    float deltaPhi = (2.0f * 3.14159265358979323846f) / 180.0f;
-    float deltaTheta = (0.5f * 3.14159265358979323846f) / 64.0f;
+    sampler.reset(new RHI::VulkanImageSampler(m_pDevice, rawData, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig, resourceConfig));
+    rawData.reset();
+
+    auto tEnd = std::chrono::high_resolution_clock::now();
+    auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+    std::cout << "Uploading " << params.name << " cubemap from cache took " << tDiff << " ms" << std::endl;
+    return true;
+}
+
+bool Ibl::updateIrradianceCubeMap()
+{
+    ZoneScoped;
+    if (m_pGeneration)
+    {
+        return finishGeneration();
+    }
+
+    const vk::Format format = IRRADIANCE_FORMAT;
+    const int32_t dim = IRRADIANCE_DIM;
+    const uint32_t numMips = mipCount(dim);
+    const float deltaPhi = IRRADIANCE_DELTA_PHI;
+    const float deltaTheta = IRRADIANCE_DELTA_THETA;
+    const uint32_t computeNumSamples = IRRADIANCE_COMPUTE_SAMPLES;
 
     RHI::VulkanImageResource::Config cubemapResourceConfig = RHI::VulkanImageResource::Config::CubeMap(dim, dim, numMips);
     RHI::VulkanImageSampler::Config cubemapSamplerConfig = RHI::VulkanImageSampler::Config::CubeMap(numMips);
     cubemapResourceConfig.format = format;
+    // transferSrc for reading the result back into the disk cache, storage for the compute path
+    cubemapResourceConfig.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage;
+
+    const IblCache::Params& cacheParams = m_irradianceCacheParams;
+    if (loadCubeMapFromCache(m_pCachedIrradiance, cacheParams, m_pIrradianceCubeMapSampler, cubemapSamplerConfig, cubemapResourceConfig))
+    {
+        return true;
+    }
 
     if (!m_pIrradianceCubeMapSampler)
     {
         m_pIrradianceCubeMapSampler.reset(new RHI::VulkanImageSampler(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, cubemapSamplerConfig, cubemapResourceConfig));
     }
 
+    RHI::VulkanImageResource* cubemap = m_pIrradianceCubeMapSampler->GetPImageResource();
+    vk::CommandBuffer cmd = beginGeneration("irradiance", numMips);
+    if (m_comparePaths && m_useCompute)
+    {
+        // the other path first, the cubemap is fully rewritten below
+        renderIrradianceCubeMap(cmd, COMPARE_QUERY, format, dim, numMips, deltaPhi, deltaTheta);
+    }
+    else if (m_comparePaths)
+    {
+        computeCubeMap(cmd, COMPARE_QUERY, m_pIrradianceComputePipeline, "ibl.irradiance.comp.spv", cubemap, dim, numMips, computeNumSamples, false);
+    }
+    if (m_comparePaths)
+    {
+        barrierAfterComparedPath(cmd);
+    }
+    if (m_useCompute)
+    {
+        computeCubeMap(cmd, PATH_QUERY, m_pIrradianceComputePipeline, "ibl.irradiance.comp.spv", cubemap, dim, numMips, computeNumSamples, false);
+    }
+    else
+    {
+        renderIrradianceCubeMap(cmd, PATH_QUERY, format, dim, numMips, deltaPhi, deltaTheta);
+    }
+    submitGeneration(cubemap, cacheParams);
+    return false;
+}
+
+vk::CommandBuffer Ibl::beginGeneration(const char* name, uint32_t numMips)
+{
+    ZoneScoped;
+    m_pGeneration.reset(new Generation());
+    m_pGeneration->name = name;
+    m_pGeneration->numMips = numMips;
+    m_pGeneration->compared = m_comparePaths;
+    m_pGeneration->start = std::chrono::high_resolution_clock::now();
+
+    m_generationCmd.reset();
+    m_generationCmd.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    return m_generationCmd;
+}
+
+void Ibl::submitGeneration(RHI::VulkanImageResource* cubemap, const IblCache::Params& params)
+{
+    ZoneScoped;
+    m_pGeneration->readback = m_pCache->RecordReadback(m_pDevice, m_generationCmd, cubemap, params);
+    m_pGeneration->params = params;
+    m_generationCmd.end();
+
+    // the frames in flight never sample the cubemap before the descriptor step, nothing waits for the queue
+    m_pDevice->GetVkDevice().resetFences(m_generationFence);
+    m_pDevice->GetVkGraphicQueue().submit(vk::SubmitInfo().setCommandBuffers(m_generationCmd), m_generationFence);
+}
+
+bool Ibl::finishGeneration()
+{
+    ZoneScoped;
+    if (m_pDevice->GetVkDevice().getFenceStatus(m_generationFence) != vk::Result::eSuccess)
+    {
+        return false;
+    }
+
+    Generation& generation = *m_pGeneration;
+    double gpuMs = 0.0;
+    if (generation.compared && m_pTimestampQuery->GetElapsedMs(COMPARE_QUERY, COMPARE_QUERY + 1, gpuMs))
+    {
+        std::cout << "[Ibl] " << generation.name << " " << (m_useCompute ? "raster" : "compute") << " path gpu " << gpuMs << " ms" << std::endl;
+    }
+    if (m_pTimestampQuery->GetElapsedMs(PATH_QUERY, PATH_QUERY + 1, gpuMs))
+    {
+        std::cout << "[Ibl] " << generation.name << " " << (m_useCompute ? "compute" : "raster") << " path gpu " << gpuMs << " ms" << std::endl;
+    }
+    auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - generation.start).count();
+    std::cout << "[Ibl] generating " << generation.name << " cubemap with " << generation.numMips << " mip levels took " << tDiff << " ms" << std::endl;
+
+    generation.descPools.clear();
+    for (auto& view : generation.views)
+    {
+        m_pDevice->GetVkDevice().destroyImageView(view);
+    }
+    if (generation.readback)
+    {
+        // the ktx2 encoding and the disk write stay off the render thread
+        CacheWrite write;
+        const unsigned char* mapped = static_cast<const unsigned char*>(generation.readback->MappingBuffer(0, generation.readback->GetSize()));
+        const IblCache* cache = m_pCache.get();
+        IblCache::Params params = generation.params;
+        write.job = std::async(std::launch::async, [cache, mapped, params]() { return cache->Write(mapped, params); });
+        write.readback = std::move(generation.readback);
+        m_cacheWrites.emplace_back(std::move(write));
+    }
+    m_pGeneration.reset();
+    return true;
+}
+
+void Ibl::renderIrradianceCubeMap(vk::CommandBuffer cmd, uint32_t query, vk::Format format, int32_t dim, uint32_t numMips, float deltaPhi, float deltaTheta)
+{
+    ZoneScoped;
+    prepareSamplerCubeModel();
+    const boost::filesystem::path vertShader = shaderPath("ibl.filtercube.vert.spv");
+    const boost::filesystem::path fragShader = shaderPath("ibl.irradiance.frag.spv");
+
     // irrandiance sampler render pass
     if (!m_pIrradianceRenderPass)
     {
@@ -173,7 +473,7 @@ void Ibl::generateIrradianceCubeMap()
         RHI::VulkanImageSampler::Config samplerConfig;
         RHI::VulkanImageResource::Config imageResourceConfig;
 
-        imageResourceConfig.extent = vk::Extent3D{ dim, dim, 1 };
+        imageResourceConfig.extent = vk::Extent3D{ (uint32_t)dim, (uint32_t)dim, 1 };
         imageResourceConfig.miplevel = 1;
         imageResourceConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
         imageResourceConfig.format = format;
@@ -190,15 +490,15 @@ void Ibl::generateIrradianceCubeMap()
         m_pIrradianceFramebuffer->native = m_pDevice->GetVkDevice().createFramebuffer(fbCreateInfo);
 
         // transfer imageresource layout
-        m_pIrradianceFramebuffer->attachment->TransitionImageLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
+        m_pIrradianceFramebuffer->attachment->TransitionImageLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
     }
 
     // pipeline
     if (!m_pIrradianceRenderPass->GetGraphicRenderPipeline("irrandiance"))
     {
         std::shared_ptr<RHI::VulkanShaderSet> shader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
-        shader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/ibl.filtercube.vert.spv", vk::ShaderStageFlagBits::eVertex);
-        shader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/ibl.irradiance.frag.spv", vk::ShaderStageFlagBits::eFragment);
+        shader->AddShader(vertShader, vk::ShaderStageFlagBits::eVertex);
+        shader->AddShader(fragShader, vk::ShaderStageFlagBits::eFragment);
         auto pipeline = RHI::VulkanRenderPipelineBuilder(m_pDevice, m_pIrradianceRenderPass.get())
                     .SetshaderSet(shader)
                     .SetVulkanPipelineLayout(m_pPipelineLayout)
@@ -209,9 +509,10 @@ void Ibl::generateIrradianceCubeMap()
 
     // render
     {
-        vk::CommandBuffer cmd = m_pCmdPool->BeginSingleTimeCommand();
+        m_pTimestampQuery->Reset(cmd, query, 2);
+        m_pTimestampQuery->Write(cmd, query, vk::PipelineStageFlagBits::eTopOfPipe);
         vk::ClearValue clear { vk::ClearColorValue{std::array<float, 4>{{0.0f, 0.0f, 0.2f, 0.0f}}} };
-        vk::Rect2D renderArea {0, vk::Extent2D{dim, dim}};
+        vk::Rect2D renderArea {0, vk::Extent2D{(uint32_t)dim, (uint32_t)dim}};
 
         // cannot use uniformbuffer, because it will be covered
         // std::array<glm::vec3, 6> rotations
@@ -239,8 +540,8 @@ void Ibl::generateIrradianceCubeMap()
 			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
 		};
 
-        vk::Viewport viewport {0,0,dim,dim,0,1};
-        vk::Rect2D scissor {{0,0}, vk::Extent2D{dim, dim}};
+        vk::Viewport viewport {0,0,(float)dim,(float)dim,0,1};
+        vk::Rect2D scissor {{0,0}, vk::Extent2D{(uint32_t)dim, (uint32_t)dim}};
         cmd.setViewport(0,1,&viewport);
         cmd.setScissor(0,scissor);
 
@@ -303,35 +604,74 @@ void Ibl::generateIrradianceCubeMap()
         // change sampler layout to shaderReadOnly
         m_pIrradianceCubeMapSampler->GetPImageResource()->TransitionImageLayout(cmd, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
 
-        m_pCmdPool->EndSingleTimeCommand(cmd, m_pDevice->GetVkGraphicQueue());
+        m_pTimestampQuery->Write(cmd, query + 1);
     }
-
-
-    auto tEnd = std::chrono::high_resolution_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-    std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
 }
 
 
-void Ibl::generatePrefilterEnvCubeMap()
+bool Ibl::updatePrefilterEnvCubeMap()
 {
     ZoneScoped;
-    auto tStart = std::chrono::high_resolution_clock::now();
+    if (m_pGeneration)
+    {
+        return finishGeneration();
+    }
 
-    const vk::Format format = vk::Format::eR16G16B16A16Sfloat;
-    const int32_t dim = 512;
-    const uint32_t numMips = floor(log2(dim)) + 1;
+    const vk::Format format = PREFILTER_FORMAT;
+    const int32_t dim = PREFILTER_DIM;
+    const uint32_t numMips = mipCount(dim);
+    const uint32_t numSamples = PREFILTER_SAMPLES;
 
     RHI::VulkanImageResource::Config prefilterCubemapResourceConfig = RHI::VulkanImageResource::Config::CubeMap(dim, dim, numMips);
     RHI::VulkanImageSampler::Config prefilterCubemapSamplerConfig = RHI::VulkanImageSampler::Config::CubeMap(numMips);
     prefilterCubemapResourceConfig.format = format;
+    prefilterCubemapResourceConfig.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage;
+
+    const IblCache::Params& cacheParams = m_prefilterCacheParams;
+    if (loadCubeMapFromCache(m_pCachedPrefilterEnv, cacheParams, m_pPrefilterEnvCubeMapSampler, prefilterCubemapSamplerConfig, prefilterCubemapResourceConfig))
+    {
+        return true;
+    }
 
     if (!m_pPrefilterEnvCubeMapSampler)
     {
         m_pPrefilterEnvCubeMapSampler.reset(new RHI::VulkanImageSampler(m_pDevice, nullptr, vk::MemoryPropertyFlagBits::eDeviceLocal, prefilterCubemapSamplerConfig, prefilterCubemapResourceConfig));
     }
 
-    // irrandiance sampler render pass
+    RHI::VulkanImageResource* cubemap = m_pPrefilterEnvCubeMapSampler->GetPImageResource();
+    vk::CommandBuffer cmd = beginGeneration("prefilter environment", numMips);
+    if (m_comparePaths && m_useCompute)
+    {
+        renderPrefilterEnvCubeMap(cmd, COMPARE_QUERY, format, dim, numMips, numSamples);
+    }
+    else if (m_comparePaths)
+    {
+        computeCubeMap(cmd, COMPARE_QUERY, m_pPrefilterComputePipeline, "ibl.prefilterEnvMap.comp.spv", cubemap, dim, numMips, numSamples, true);
+    }
+    if (m_comparePaths)
+    {
+        barrierAfterComparedPath(cmd);
+    }
+    if (m_useCompute)
+    {
+        computeCubeMap(cmd, PATH_QUERY, m_pPrefilterComputePipeline, "ibl.prefilterEnvMap.comp.spv", cubemap, dim, numMips, numSamples, true);
+    }
+    else
+    {
+        renderPrefilterEnvCubeMap(cmd, PATH_QUERY, format, dim, numMips, numSamples);
+    }
+    submitGeneration(cubemap, cacheParams);
+    return false;
+}
+
+void Ibl::renderPrefilterEnvCubeMap(vk::CommandBuffer cmd, uint32_t query, vk::Format format, int32_t dim, uint32_t numMips, uint32_t numSamples)
+{
+    ZoneScoped;
+    prepareSamplerCubeModel();
+    const boost::filesystem::path vertShader = shaderPath("ibl.filtercube.vert.spv");
+    const boost::filesystem::path fragShader = shaderPath("ibl.prefilterEnvMap.frag.spv");
+
+    // prefilter environment render pass
     if (!m_pPrefilterEnvRenderPass)
     {
         vk::AttachmentDescription attDesc;
@@ -377,7 +717,7 @@ void Ibl::generatePrefilterEnvCubeMap()
         RHI::VulkanImageSampler::Config samplerConfig;
         RHI::VulkanImageResource::Config imageResourceConfig;
 
-        imageResourceConfig.extent = vk::Extent3D{ dim, dim, 1 };
+        imageResourceConfig.extent = vk::Extent3D{ (uint32_t)dim, (uint32_t)dim, 1 };
         imageResourceConfig.miplevel = 1;
         imageResourceConfig.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
         imageResourceConfig.format = format;
@@ -394,15 +734,15 @@ void Ibl::generatePrefilterEnvCubeMap()
         m_pPrefilterEnvFramebuffer->native = m_pDevice->GetVkDevice().createFramebuffer(fbCreateInfo);
 
         // transfer imageresource layout
-        m_pPrefilterEnvFramebuffer->attachment->TransitionImageLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
+        m_pPrefilterEnvFramebuffer->attachment->TransitionImageLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
     }
 
     // pipeline
     if (!m_pPrefilterEnvRenderPass->GetGraphicRenderPipeline("prefilterEnvironment"))
     {
         std::shared_ptr<RHI::VulkanShaderSet> shader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
-        shader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/ibl.filtercube.vert.spv", vk::ShaderStageFlagBits::eVertex);
-        shader->AddShader(Util::File::getResourcePath() / "Shader/GLSL/SPIR-V/ibl.prefilterEnvMap.frag.spv", vk::ShaderStageFlagBits::eFragment);
+        shader->AddShader(vertShader, vk::ShaderStageFlagBits::eVertex);
+        shader->AddShader(fragShader, vk::ShaderStageFlagBits::eFragment);
         auto pipeline = RHI::VulkanRenderPipelineBuilder(m_pDevice, m_pPrefilterEnvRenderPass.get())
                     .SetshaderSet(shader)
                     .SetVulkanPipelineLayout(m_pPipelineLayout)
@@ -413,9 +753,10 @@ void Ibl::generatePrefilterEnvCubeMap()
 
     // render
     {
-        vk::CommandBuffer cmd = m_pCmdPool->BeginSingleTimeCommand();
+        m_pTimestampQuery->Reset(cmd, query, 2);
+        m_pTimestampQuery->Write(cmd, query, vk::PipelineStageFlagBits::eTopOfPipe);
         vk::ClearValue clear { vk::ClearColorValue{std::array<float, 4>{{0.0f, 0.0f, 0.2f, 0.0f}}} };
-        vk::Rect2D renderArea {0, vk::Extent2D{dim, dim}};
+        vk::Rect2D renderArea {0, vk::Extent2D{(uint32_t)dim, (uint32_t)dim}};
 
         // cannot use uniformbuffer, because it will be covered
         // std::array<glm::vec3, 6> rotations
@@ -443,8 +784,8 @@ void Ibl::generatePrefilterEnvCubeMap()
 			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
 		};
 
-        vk::Viewport viewport {0,0,dim,dim,0,1};
-        vk::Rect2D scissor {{0,0}, vk::Extent2D{dim, dim}};
+        vk::Viewport viewport {0,0,(float)dim,(float)dim,0,1};
+        vk::Rect2D scissor {{0,0}, vk::Extent2D{(uint32_t)dim, (uint32_t)dim}};
         cmd.setViewport(0,1,&viewport);
         cmd.setScissor(0,scissor);
 
@@ -455,7 +796,7 @@ void Ibl::generatePrefilterEnvCubeMap()
 
 
         PushConstant consts;
-        consts.numSamples = 32.0f;
+        consts.numSamples = (float)numSamples;
         // render 6 faces for cubemap
         for (uint32_t m = 0; m < numMips; m++)
         {
@@ -509,15 +850,170 @@ void Ibl::generatePrefilterEnvCubeMap()
         // change sampler layout to shaderReadOnly
         m_pPrefilterEnvCubeMapSampler->GetPImageResource()->TransitionImageLayout(cmd, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
 
-        m_pCmdPool->EndSingleTimeCommand(cmd, m_pDevice->GetVkGraphicQueue());
+        m_pTimestampQuery->Write(cmd, query + 1);
     }
+}
 
+void Ibl::prepareCompute()
+{
+    ZoneScoped;
+    if (m_pComputePipelineLayout)
+    {
+        return;
+    }
 
-    auto tEnd = std::chrono::high_resolution_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-    std::cout << "Generating prefilter environment cubemap with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+    m_pComputeDescriptorSetLayout = std::make_shared<RHI::VulkanDescriptorSetLayout>(m_pDevice);
+    m_pComputeDescriptorSetLayout->AddBinding(
+        0,
+        vk::DescriptorSetLayoutBinding()
+            .setBinding(0)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+    );
+    m_pComputeDescriptorSetLayout->AddBinding(
+        1,
+        vk::DescriptorSetLayoutBinding()
+            .setBinding(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+    );
+    m_pComputeDescriptorSetLayout->Finish();
+
+    std::map<int, vk::PushConstantRange> Constant
+    {
+        {
+            0, //offset
+            vk::PushConstantRange
+            {
+                vk::ShaderStageFlagBits::eCompute,
+                0,
+                sizeof(ComputePushConstant)
+            }
+        }
+    };
+    m_pComputePipelineLayout.reset(new RHI::VulkanPipelineLayout(m_pDevice, {m_pComputeDescriptorSetLayout}, Constant));
 }
 
+void Ibl::computeCubeMap(
+    vk::CommandBuffer cmd,
+    uint32_t query,
+    std::unique_ptr<RHI::VulkanComputePipeline>& pipeline,
+    const char* shaderName,
+    RHI::VulkanImageResource* cubemap,
+    int32_t dim,
+    uint32_t numMips,
+    uint32_t numSamples,
+    bool roughnessPerMip
+)
+{
+    ZoneScoped;
+    prepareCompute();
+
+    if (!pipeline)
+    {
+        std::shared_ptr<RHI::VulkanShaderSet> shader = std::make_shared<RHI::VulkanShaderSet>(m_pDevice);
+        shader->AddShader(shaderPath(shaderName), vk::ShaderStageFlagBits::eCompute);
+        pipeline.reset(new RHI::VulkanComputePipeline(m_pDevice, shader, m_pComputePipelineLayout));
+    }
+
+    // one storage view (2d array over the 6 faces) and one descriptor set per mip, kept by the generation until its fence signalled
+    std::vector<vk::ImageView> mipViews(numMips);
+    std::vector<std::shared_ptr<RHI::VulkanDescriptorSets>> mipSets(numMips);
+    std::vector<vk::DescriptorPoolSize> sizes
+    {
+        vk::DescriptorPoolSize {vk::DescriptorType::eCombinedImageSampler, numMips},
+        vk::DescriptorPoolSize {vk::DescriptorType::eStorageImage, numMips},
+    };
+    m_pGeneration->descPools.emplace_back(new RHI::VulkanDescriptorPool(m_pDevice, sizes, numMips));
+    RHI::VulkanDescriptorPool& descPool = *m_pGeneration->descPools.back();
+    for (uint32_t m = 0; m < numMips; m++)
+    {
+        auto viewInfo = vk::ImageViewCreateInfo()
+                .setImage(cubemap->GetVkImage())
+                .setViewType(vk::ImageViewType::e2DArray)
+                .setFormat(cubemap->GetConfig().format)
+                .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, m, 1, 0, 6});
+        mipViews[m] = m_pDevice->GetVkDevice().createImageView(viewInfo);
+
+        vk::DescriptorImageInfo srcInfo;
+        srcInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                .setImageView(*m_pEnvCubeMapSampler->GetPVkImageView())
+                .setSampler(*m_pEnvCubeMapSampler->GetPVkSampler());
+        vk::DescriptorImageInfo dstInfo;
+        dstInfo.setImageLayout(vk::ImageLayout::eGeneral)
+                .setImageView(mipViews[m]);
+
+        std::vector<vk::WriteDescriptorSet> writeDescs(2);
+        writeDescs[0]
+            .setDstBinding(0)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(1)
+            .setImageInfo(srcInfo);
+        writeDescs[1]
+            .setDstBinding(1)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setDescriptorCount(1)
+            .setImageInfo(dstInfo);
+        mipSets[m] = descPool.AllocCustomToUpdatedDescriptorSet(m_pComputeDescriptorSetLayout.get());
+        mipSets[m]->UpdateDescriptorSets(writeDescs);
+    }
+
+    vk::ImageSubresourceRange fullRange {vk::ImageAspectFlagBits::eColor, 0, numMips, 0, 6};
+    {
+        m_pTimestampQuery->Reset(cmd, query, 2);
+        m_pTimestampQuery->Write(cmd, query, vk::PipelineStageFlagBits::eTopOfPipe);
+
+        auto toGeneral = vk::ImageMemoryBarrier()
+                .setImage(cubemap->GetVkImage())
+                .setOldLayout(vk::ImageLayout::eUndefined)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setSrcAccessMask(vk::AccessFlags(0))
+                .setDstAccessMask(vk::AccessFlagBits::eShaderWrite)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange(fullRange);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits(0), {}, {}, {toGeneral});
+
+        pipeline->Bind(cmd);
+        ComputePushConstant consts;
+        consts.numSamples = numSamples;
+        // every mip writes its own subresource, so the dispatches need no barrier in between
+        for (uint32_t m = 0; m < numMips; m++)
+        {
+            consts.mipSize = std::max((uint32_t)dim >> m, 1u);
+            consts.roughness = roughnessPerMip ? (float)m / (float)(numMips - 1) : 0.0f;
+            m_pComputePipelineLayout->PushConstantT<ComputePushConstant>(cmd, 0, consts, vk::ShaderStageFlagBits::eCompute);
+            pipeline->BindDescriptorSets(cmd, {mipSets[m]->GetVkDescriptorSet(0)});
+            uint32_t groups = (consts.mipSize + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE;
+            pipeline->Dispatch(cmd, groups, groups, 6);
+        }
+
+        auto toShaderRead = vk::ImageMemoryBarrier()
+                .setImage(cubemap->GetVkImage())
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange(fullRange);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits(0), {}, {}, {toShaderRead});
+
+        m_pTimestampQuery->Write(cmd, query + 1);
+    }
+    m_pGeneration->views.insert(m_pGeneration->views.end(), mipViews.begin(), mipViews.end());
+}
+
+boost::filesystem::path Ibl::shaderPath(const char* name)
+{
+    return Util::File::getResourcePath() / "Shader/GLSL/SPIR-V" / name;
+}
+
+// the lut is a shipped png, it is already loaded from disk and needs no cache entry
 void Ibl::generateBrdfLUT()
 {
     auto rawdata = Util::Texture::RawData::Load(Util::File::getResourcePath() / "Texture/ibl_brdf_lut.png", Util::Texture::RawData::Format::eRgbAlpha);
@@ -528,15 +1024,48 @@ void Ibl::generateBrdfLUT()
     m_pBrdfLUTSampler.reset(new RHI::VulkanImageSampler(m_pDevice, rawdata, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig, imageConfig));
 }
 
-void Ibl::generateOutputDiscriptorSet()
+// source environment map with its full mip chain: input of the compute path and the placeholder reflection
+void Ibl::prepareEnvCubeMap()
+{
+    ZoneScoped;
+    auto rawData = RHI::ModelPresets::GetSkyboxMaterialData().textureDatas[0].rawData;
+    if (!rawData)
+    {
+        throw std::runtime_error("load ibl source environment map failed");
+    }
+    RHI::VulkanImageSampler::Config samplerConfig = RHI::VulkanImageSampler::Config::CubeMap(rawData->GetMipLevels());
+    RHI::VulkanImageResource::Config resourceConfig = RHI::VulkanImageResource::Config::CubeMap(rawData->GetWidth(), rawData->GetHeight(), rawData->GetMipLevels());
+    resourceConfig.format = rawData->GetVkFormat();
+    m_pEnvCubeMapSampler.reset(new RHI::VulkanImageSampler(m_pDevice, rawData, vk::MemoryPropertyFlagBits::eDeviceLocal, samplerConfig, resourceConfig));
+}
+
+// bound until the real maps are ready: the unfiltered environment for both cubemaps, its mips stand in for the prefiltered lods
+void Ibl::generatePlaceholderDescriptorSet()
 {
     ZoneScoped;
+    // placeholder and final set
     std::vector<vk::DescriptorPoolSize> sizes
     {
-        vk::DescriptorPoolSize {vk::DescriptorType::eCombinedImageSampler, 3}
+        vk::DescriptorPoolSize {vk::DescriptorType::eCombinedImageSampler, 6}
     };
-    m_pDescPool.reset(new RHI::VulkanDescriptorPool(m_pDevice, sizes, 3));
+    m_pDescPool.reset(new RHI::VulkanDescriptorPool(m_pDevice, sizes, 2));
 
+    m_pPlaceholderDescriptor = m_pDescPool->AllocSamplerDescriptorSet(
+        m_pPipelineLayout->GetPVulkanDescriptorSet(1),
+        {
+            m_pEnvCubeMapSampler.get(),
+            m_pEnvCubeMapSampler.get(),
+            m_pBrdfLUTSampler.get()
+            },
+            {
+                1,2,3
+            }
+    );
+}
+
+void Ibl::generateOutputDiscriptorSet()
+{
+    ZoneScoped;
     m_pDescriptor = m_pDescPool->AllocSamplerDescriptorSet(
         m_pPipelineLayout->GetPVulkanDescriptorSet(1),
         {
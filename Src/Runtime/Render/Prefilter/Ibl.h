@@ -1,15 +1,22 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include "Runtime/Render/Camera.h"
+#include "Runtime/Render/Prefilter/IblCache.h"
 #include "Runtime/Render/Light.h"
 #include "Runtime/VulkanRHI/Graphic/Model.h"
 #include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
 #include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
 #include "Runtime/VulkanRHI/VulkanCommandPool.h"
+#include "Runtime/VulkanRHI/VulkanComputePipeline.h"
 #include "Runtime/VulkanRHI/VulkanDescriptorPool.h"
 #include "Runtime/VulkanRHI/VulkanDevice.h"
 #include "Runtime/VulkanRHI/VulkanRenderPass.h"
+#include "Runtime/VulkanRHI/VulkanTimestampQuery.h"
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <future>
 #include "vulkan/vulkan_handles.hpp"
 
 namespace Render { namespace Prefilter {
@@ -25,7 +32,19 @@ public:
     };
 public:
     explicit Ibl(RHI::VulkanDevice* device) : m_pDevice(device) { }
+    ~Ibl();
+    // blocks until the maps are ready
     void Prepare();
+    // binds a placeholder right away, the disk cache is read on a worker thread
+    void PrepareAsync();
+    // call once per frame after the wait for the frame's fence, before recording. true once the real maps are bound.
+    // a cache miss generates the map on the gpu behind a fence polled here, the readback is written to the cache on a worker thread
+    bool Update();
+    inline bool IsReady() const { return m_step == Step::kReady; }
+    // compute path writes all faces of a mip per dispatch, raster path renders face by face
+    inline void SetUseCompute(bool useCompute) { m_useCompute = useCompute; }
+    // opt-in, for comparing the paths: a cache miss also runs the path not in use first and prints the gpu time of both
+    inline void SetComparePaths(bool comparePaths) { m_comparePaths = comparePaths; }
     void FillToBindingDescriptorSets(std::vector<vk::DescriptorSet>& tobinding);
 
 private:
@@ -33,13 +52,48 @@ private:
     void prepareCamera();
     void prepareSamplerCubeModel();
     void prepareCmd();
-
-    void generateIrradianceCubeMap();
-    void generatePrefilterEnvCubeMap();
+    void prepareEnvCubeMap();
+    void loadCache();
+    IblCache::Params irradianceCacheParams() const;
+    IblCache::Params prefilterCacheParams() const;
+
+    void prepareCompute();
+
+    // true once the map is uploaded from the cache or generated, a generation spans the frames until its fence signalled
+    bool updateIrradianceCubeMap();
+    bool updatePrefilterEnvCubeMap();
+    vk::CommandBuffer beginGeneration(const char* name, uint32_t numMips);
+    void submitGeneration(RHI::VulkanImageResource* cubemap, const IblCache::Params& params);
+    // false while the fence is unsignalled, then reports the gpu time and hands the readback to a cache write
+    bool finishGeneration();
+    // record into cmd, the gpu time lands in the timestamps query and query + 1
+    void renderIrradianceCubeMap(vk::CommandBuffer cmd, uint32_t query, vk::Format format, int32_t dim, uint32_t numMips, float deltaPhi, float deltaTheta);
+    void renderPrefilterEnvCubeMap(vk::CommandBuffer cmd, uint32_t query, vk::Format format, int32_t dim, uint32_t numMips, uint32_t numSamples);
+    void computeCubeMap(
+        vk::CommandBuffer cmd,
+        uint32_t query,
+        std::unique_ptr<RHI::VulkanComputePipeline>& pipeline,
+        const char* shaderName,
+        RHI::VulkanImageResource* cubemap,
+        int32_t dim,
+        uint32_t numMips,
+        uint32_t numSamples,
+        bool roughnessPerMip
+    );
     void generateBrdfLUT();
 
+    void generatePlaceholderDescriptorSet();
     void generateOutputDiscriptorSet();
 
+    bool loadCubeMapFromCache(
+        std::shared_ptr<Util::Texture::RawData>& rawData,
+        const IblCache::Params& params,
+        std::unique_ptr<RHI::VulkanImageSampler>& sampler,
+        const RHI::VulkanImageSampler::Config& samplerConfig,
+        const RHI::VulkanImageResource::Config& resourceConfig
+    );
+    static boost::filesystem::path shaderPath(const char* name);
+
 private:
     struct PushConstant
     {
@@ -50,6 +104,44 @@ private:
         float numSamples = 32.0f;
     };
 
+    struct ComputePushConstant
+    {
+        uint32_t mipSize = 0;
+        uint32_t numSamples = 32;
+        float roughness = 0.0f;
+    };
+    static constexpr uint32_t COMPUTE_GROUP_SIZE = 8;
+    // timestamps of the path in use, the compared path writes the next two
+    static constexpr uint32_t PATH_QUERY = 0;
+    static constexpr uint32_t COMPARE_QUERY = 2;
+
+    // a cubemap generation submitted with m_generationFence
+    struct Generation
+    {
+        const char* name = nullptr;
+        uint32_t numMips = 0;
+        bool compared = false;
+        std::chrono::high_resolution_clock::time_point start;
+        // compute path views and sets, the gpu uses them until the fence signalled
+        std::vector<std::unique_ptr<RHI::VulkanDescriptorPool>> descPools;
+        std::vector<vk::ImageView> views;
+        std::unique_ptr<RHI::VulkanBuffer> readback;
+        IblCache::Params params;
+    };
+    struct CacheWrite
+    {
+        std::unique_ptr<RHI::VulkanBuffer> readback;
+        std::future<bool> job;
+    };
+
+    enum class Step
+    {
+        kIrradiance,
+        kPrefilter,
+        kDescriptor,
+        kReady
+    };
+
 private:
     RHI::VulkanDevice* m_pDevice;
 
@@ -59,6 +151,29 @@ private:
     std::unique_ptr<Lights> m_pLight;
     std::unique_ptr<RHI::Model> m_pSamplerCubeModel;
     std::unique_ptr<RHI::VulkanCommandPool> m_pCmdPool;
+    std::unique_ptr<IblCache> m_pCache;
+    IblCache::Params m_irradianceCacheParams;
+    IblCache::Params m_prefilterCacheParams;
+    // written by the worker, read after m_cacheJob completes
+    std::future<void> m_cacheJob;
+    std::shared_ptr<Util::Texture::RawData> m_pCachedIrradiance;
+    std::shared_ptr<Util::Texture::RawData> m_pCachedPrefilterEnv;
+    Step m_step = Step::kIrradiance;
+    std::unique_ptr<RHI::VulkanTimestampQuery> m_pTimestampQuery;
+    vk::CommandBuffer m_generationCmd;
+    vk::Fence m_generationFence;
+    std::unique_ptr<Generation> m_pGeneration;
+    // read the mapped readback on workers, the buffers are kept until they are done
+    std::vector<CacheWrite> m_cacheWrites;
+    bool m_useCompute = true;
+    bool m_comparePaths = false;
+
+    // source environment, compute input and placeholder
+    std::unique_ptr<RHI::VulkanImageSampler> m_pEnvCubeMapSampler;
+    std::shared_ptr<RHI::VulkanDescriptorSetLayout> m_pComputeDescriptorSetLayout;
+    std::shared_ptr<RHI::VulkanPipelineLayout> m_pComputePipelineLayout;
+    std::unique_ptr<RHI::VulkanComputePipeline> m_pIrradianceComputePipeline;
+    std::unique_ptr<RHI::VulkanComputePipeline> m_pPrefilterComputePipeline;
 
     // irradiance
     std::unique_ptr<RHI::VulkanImageSampler> m_pIrradianceCubeMapSampler;
@@ -77,6 +192,7 @@ private:
 
     std::unique_ptr<RHI::VulkanDescriptorPool> m_pDescPool;
     std::shared_ptr<RHI::VulkanDescriptorSets> m_pDescriptor;
+    std::shared_ptr<RHI::VulkanDescriptorSets> m_pPlaceholderDescriptor;
 };
 
 }}
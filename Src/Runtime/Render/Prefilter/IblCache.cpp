@@ -0,0 +1,254 @@
+#include "IblCache.h"
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Util/Fileutil.h"
+#include "Util/Textureutil.h"
+#include "vulkan/vulkan_enums.hpp"
+#include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <ktx.h>
+#include <memory>
+#include <sstream>
+#include <stdint.h>
+#include <vector>
+#include <tracy/Tracy.hpp>
+
+namespace Render { namespace Prefilter {
+
+namespace {
+
+template<typename T>
+uint64_t hashValue(const T& value, uint64_t hash)
+{
+    return Util::File::hashBytes(&value, sizeof(T), hash);
+}
+
+uint32_t texelSize(vk::Format format)
+{
+    switch (format)
+    {
+    case vk::Format::eR32G32B32A32Sfloat:
+        return 16;
+    case vk::Format::eR16G16B16A16Sfloat:
+        return 8;
+    case vk::Format::eR8G8B8A8Unorm:
+        return 4;
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+}
+
+IblCache::IblCache(const boost::filesystem::path& sourcePath)
+    : m_sourcePath(sourcePath)
+{
+    ZoneScopedN("IblCache::IblCache");
+    uint64_t hash = Util::File::HASH_SEED;
+    if (!Util::File::hashFile(m_sourcePath, hash))
+    {
+        std::cout << "[IblCache] source not readable, cache disabled: " << m_sourcePath.string() << std::endl;
+        return;
+    }
+    m_sourceHash = hash;
+}
+
+uint64_t IblCache::computeKey(const Params& params) const
+{
+    uint64_t key = hashValue(CACHE_VERSION, m_sourceHash);
+    key = Util::File::hashBytes(params.name.data(), params.name.size(), key);
+    key = hashValue(params.format, key);
+    key = hashValue(params.dim, key);
+    key = hashValue(params.numMips, key);
+    key = hashValue(params.deltaPhi, key);
+    key = hashValue(params.deltaTheta, key);
+    key = hashValue(params.numSamples, key);
+    for (const auto& shader : params.shaders)
+    {
+        // a missing shader leaves the key as it is, the generation fails loudly on its own
+        Util::File::hashFile(shader, key);
+    }
+    return key;
+}
+
+boost::filesystem::path IblCache::GetCachePath(const Params& params) const
+{
+    std::stringstream name;
+    name << m_sourcePath.stem().string() << "." << params.name << "."
+         << std::hex << std::setw(16) << std::setfill('0') << computeKey(params) << ".ktx2";
+    return m_sourcePath.parent_path() / name.str();
+}
+
+std::shared_ptr<Util::Texture::RawData> IblCache::Load(const Params& params) const
+{
+    ZoneScopedN("IblCache::Load");
+    if (!IsValid())
+    {
+        return nullptr;
+    }
+
+    boost::filesystem::path path = GetCachePath(params);
+    if (!Util::File::fileExist(path))
+    {
+        return nullptr;
+    }
+
+    auto rawData = Util::Texture::RawData::Load(path, Util::Texture::RawData::Format::eRgbAlpha, true, params.format);
+    if (!rawData
+        || rawData->GetWidth() != (int)params.dim
+        || rawData->GetHeight() != (int)params.dim
+        || rawData->GetMipLevels() != (int)params.numMips)
+    {
+        std::cout << "[IblCache] ignore invalid cache file: " << path.string() << std::endl;
+        return nullptr;
+    }
+    return rawData;
+}
+
+size_t IblCache::readbackLayout(const Params& params, std::vector<vk::BufferImageCopy>& regions, std::vector<size_t>& offsets)
+{
+    const uint32_t faceCount = 6;
+    const uint32_t bytesPerTexel = texelSize(params.format);
+    size_t totalSize = 0;
+    for (uint32_t level = 0; level < params.numMips; level++)
+    {
+        uint32_t levelDim = std::max(params.dim >> level, 1u);
+        for (uint32_t face = 0; face < faceCount; face++)
+        {
+            auto region = vk::BufferImageCopy()
+                    .setBufferOffset(totalSize)
+                    .setBufferRowLength(0)
+                    .setBufferImageHeight(0)
+                    .setImageSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level, face, 1})
+                    .setImageOffset(vk::Offset3D{0, 0, 0})
+                    .setImageExtent(vk::Extent3D{levelDim, levelDim, 1});
+            regions.emplace_back(region);
+            offsets.push_back(totalSize);
+            totalSize += (size_t)levelDim * levelDim * bytesPerTexel;
+        }
+    }
+    return totalSize;
+}
+
+std::unique_ptr<RHI::VulkanBuffer> IblCache::RecordReadback(RHI::VulkanDevice* device, vk::CommandBuffer cmd, RHI::VulkanImageResource* cubemap, const Params& params) const
+{
+    ZoneScopedN("IblCache::RecordReadback");
+    if (!IsValid())
+    {
+        return nullptr;
+    }
+
+    std::vector<vk::BufferImageCopy> regions;
+    std::vector<size_t> offsets;
+    size_t totalSize = readbackLayout(params, regions, offsets);
+    std::unique_ptr<RHI::VulkanBuffer> readback(new RHI::VulkanBuffer(
+        device, totalSize,
+        vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        vk::SharingMode::eExclusive
+    ));
+
+    cubemap->TransitionImageLayout(cmd, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal);
+    cmd.copyImageToBuffer(cubemap->GetVkImage(), vk::ImageLayout::eTransferSrcOptimal, *readback->GetPVkBuf(), regions);
+    // the worker maps the buffer once the fence signalled
+    auto toHost = vk::BufferMemoryBarrier()
+            .setBuffer(*readback->GetPVkBuf())
+            .setSize(VK_WHOLE_SIZE)
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlagBits(0), {}, {toHost}, {});
+    cubemap->TransitionImageLayout(cmd, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+    return readback;
+}
+
+bool IblCache::Write(const unsigned char* readback, const Params& params) const
+{
+    ZoneScopedN("IblCache::Write");
+    if (!IsValid())
+    {
+        return false;
+    }
+
+    const uint32_t faceCount = 6;
+    std::vector<vk::BufferImageCopy> regions;
+    std::vector<size_t> offsets;
+    size_t totalSize = readbackLayout(params, regions, offsets);
+
+    ktxTextureCreateInfo createInfo{};
+    createInfo.vkFormat = (ktx_uint32_t)params.format;
+    createInfo.baseWidth = params.dim;
+    createInfo.baseHeight = params.dim;
+    createInfo.baseDepth = 1;
+    createInfo.numDimensions = 2;
+    createInfo.numLevels = params.numMips;
+    createInfo.numLayers = 1;
+    createInfo.numFaces = faceCount;
+    createInfo.isArray = KTX_FALSE;
+    createInfo.generateMipmaps = KTX_FALSE;
+
+    ktxTexture2* texture = nullptr;
+    if (ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+    {
+        std::cout << "[IblCache] create ktx texture failed: " << params.name << std::endl;
+        return false;
+    }
+
+    size_t regionIdx = 0;
+    for (uint32_t level = 0; level < params.numMips; level++)
+    {
+        ktx_size_t imageSize = ktxTexture_GetImageSize(ktxTexture(texture), level);
+        for (uint32_t face = 0; face < faceCount; face++, regionIdx++)
+        {
+            ktxTexture_SetImageFromMemory(ktxTexture(texture), level, 0, face, readback + offsets[regionIdx], imageSize);
+        }
+    }
+
+    // write to a temporary file first, so an interrupted run never leaves a truncated cache behind
+    boost::filesystem::path path = GetCachePath(params);
+    boost::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    KTX_error_code ret = ktxTexture_WriteToNamedFile(ktxTexture(texture), tmpPath.string().c_str());
+    ktxTexture_Destroy(ktxTexture(texture));
+
+    boost::system::error_code err;
+    if (ret == KTX_SUCCESS)
+    {
+        boost::filesystem::rename(tmpPath, path, err);
+    }
+    if (ret != KTX_SUCCESS || err)
+    {
+        boost::filesystem::remove(tmpPath, err);
+        std::cout << "[IblCache] write cache failed: " << path.string() << std::endl;
+        return false;
+    }
+
+    removeStaleFiles(params, path);
+    std::cout << "[IblCache] saved " << path.filename().string() << " (" << totalSize / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+void IblCache::removeStaleFiles(const Params& params, const boost::filesystem::path& keep) const
+{
+    ZoneScopedN("IblCache::removeStaleFiles");
+    const std::string prefix = m_sourcePath.stem().string() + "." + params.name + ".";
+    boost::system::error_code err;
+    for (boost::filesystem::directory_iterator it(m_sourcePath.parent_path(), err), end; !err && it != end; it.increment(err))
+    {
+        const boost::filesystem::path& path = it->path();
+        std::string filename = path.filename().string();
+        if (path != keep && filename.rfind(prefix, 0) == 0 && path.extension() == ".ktx2")
+        {
+            boost::system::error_code removeErr;
+            boost::filesystem::remove(path, removeErr);
+        }
+    }
+}
+
+}}
@@ -0,0 +1,56 @@
+#pragma once
+#include <boost/filesystem/path.hpp>
+#include <vulkan/vulkan.hpp>
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Util/Textureutil.h"
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Render { namespace Prefilter {
+
+// Stores generated ibl cubemaps as ktx2 files next to the source environment map.
+// File name: <source stem>.<name>.<key>.ktx2, where key hashes the source texture bytes,
+// the generation parameters and the shaders used to generate the map.
+class IblCache
+{
+public:
+    struct Params
+    {
+        std::string name;
+        vk::Format format;
+        uint32_t dim;
+        uint32_t numMips;
+        float deltaPhi = 0.0f;
+        float deltaTheta = 0.0f;
+        float numSamples = 0.0f;
+        std::vector<boost::filesystem::path> shaders;
+    };
+public:
+    explicit IblCache(const boost::filesystem::path& sourcePath);
+
+    boost::filesystem::path GetCachePath(const Params& params) const;
+    std::shared_ptr<Util::Texture::RawData> Load(const Params& params) const;
+    // records the copy of cubemap into a host visible buffer, nullptr if the cache is disabled. Write stores it once cmd completed
+    std::unique_ptr<RHI::VulkanBuffer> RecordReadback(RHI::VulkanDevice* device, vk::CommandBuffer cmd, RHI::VulkanImageResource* cubemap, const Params& params) const;
+    // encodes the mapped readback as ktx2 and writes it to disk. no vulkan calls, it runs on a worker thread
+    bool Write(const unsigned char* readback, const Params& params) const;
+    inline bool IsValid() const { return m_sourceHash != 0; }
+
+private:
+    uint64_t computeKey(const Params& params) const;
+    // tightly packed, level-major then face, matches the ktx2 image order. returns the total size
+    static size_t readbackLayout(const Params& params, std::vector<vk::BufferImageCopy>& regions, std::vector<size_t>& offsets);
+    void removeStaleFiles(const Params& params, const boost::filesystem::path& keep) const;
+
+private:
+    static constexpr uint32_t CACHE_VERSION = 1;
+
+    boost::filesystem::path m_sourcePath;
+    uint64_t m_sourceHash = 0;
+};
+
+}}
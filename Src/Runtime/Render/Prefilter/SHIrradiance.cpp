@@ -0,0 +1,484 @@
+#include "SHIrradiance.h"
+#include "Runtime/VulkanRHI/Layout/UniformBufferObject.h"
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Util/Parallelutil.h"
+#include "Util/Textureutil.h"
+#include "vulkan/vulkan_enums.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+#include <tracy/Tracy.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SH_SIMD_SSE 1
+#include <immintrin.h>
+#endif
+
+namespace Render { namespace Prefilter {
+
+namespace {
+
+constexpr uint32_t FACE_COUNT = 6;
+// 9 coefficients * rgb, then the solid angle sum
+using Accumulator = std::array<double, SHIrradiance::COEFFICIENT_COUNT * 3 + 1>;
+constexpr uint32_t WEIGHT_SUM_IDX = SHIrradiance::COEFFICIENT_COUNT * 3;
+
+constexpr float SH_Y00 = 0.282095f;
+constexpr float SH_Y1 = 0.488603f;
+constexpr float SH_Y2 = 1.092548f;
+constexpr float SH_Y20 = 0.315392f;
+constexpr float SH_Y22 = 0.546274f;
+
+// direction = normal + uAxis * u + vAxis * v, same face orientation as the ibl compute shaders
+struct FaceAxes
+{
+    glm::vec3 normal;
+    glm::vec3 uAxis;
+    glm::vec3 vAxis;
+};
+const FaceAxes FACES[FACE_COUNT] =
+{
+    { glm::vec3( 1, 0, 0), glm::vec3( 0, 0,-1), glm::vec3(0,-1, 0) },
+    { glm::vec3(-1, 0, 0), glm::vec3( 0, 0, 1), glm::vec3(0,-1, 0) },
+    { glm::vec3( 0, 1, 0), glm::vec3( 1, 0, 0), glm::vec3(0, 0, 1) },
+    { glm::vec3( 0,-1, 0), glm::vec3( 1, 0, 0), glm::vec3(0, 0,-1) },
+    { glm::vec3( 0, 0, 1), glm::vec3( 1, 0, 0), glm::vec3(0,-1, 0) },
+    { glm::vec3( 0, 0,-1), glm::vec3(-1, 0, 0), glm::vec3(0,-1, 0) },
+};
+
+struct RowInput
+{
+    const float* u;
+    const float* r;
+    const float* g;
+    const float* b;
+    glm::vec3 base;     // normal + vAxis * v
+    glm::vec3 uAxis;
+    float texelArea;
+};
+
+struct ScalarLane
+{
+    using V = float;
+    static constexpr uint32_t WIDTH = 1;
+    static inline V load(const float* p) { return *p; }
+    static inline V set(float v) { return v; }
+    static inline V add(V a, V b) { return a + b; }
+    static inline V sub(V a, V b) { return a - b; }
+    static inline V mul(V a, V b) { return a * b; }
+    static inline V invSqrt(V a) { return 1.0f / std::sqrt(a); }
+    static inline float sum(V a) { return a; }
+};
+
+#ifdef SH_SIMD_SSE
+struct SseLane
+{
+    using V = __m128;
+    static constexpr uint32_t WIDTH = 4;
+    static inline V load(const float* p) { return _mm_loadu_ps(p); }
+    static inline V set(float v) { return _mm_set1_ps(v); }
+    static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    // full precision, rsqrt_ps is too coarse for the accuracy check against the cubemap
+    static inline V invSqrt(V a) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a)); }
+    static inline float sum(V a)
+    {
+        alignas(16) float lanes[WIDTH];
+        _mm_store_ps(lanes, a);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+#endif
+
+#ifdef __AVX__
+struct AvxLane
+{
+    using V = __m256;
+    static constexpr uint32_t WIDTH = 8;
+    static inline V load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline V set(float v) { return _mm256_set1_ps(v); }
+    static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static inline V invSqrt(V a) { return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(a)); }
+    static inline float sum(V a)
+    {
+        return SseLane::sum(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+    }
+};
+using SimdLane = AvxLane;
+#elif defined(SH_SIMD_SSE)
+using SimdLane = SseLane;
+#else
+using SimdLane = ScalarLane;
+#endif
+
+// accumulates texels [begin, end) of a row in steps of Lane::WIDTH, returns the first texel not processed
+template<typename Lane>
+uint32_t accumulateRow(const RowInput& row, uint32_t begin, uint32_t end, Accumulator& out)
+{
+    using V = typename Lane::V;
+    constexpr uint32_t N = SHIrradiance::COEFFICIENT_COUNT;
+
+    V acc[N * 3];
+    for (auto& a : acc)
+    {
+        a = Lane::set(0.0f);
+    }
+    V accWeight = Lane::set(0.0f);
+
+    const V ax = Lane::set(row.uAxis.x), ay = Lane::set(row.uAxis.y), az = Lane::set(row.uAxis.z);
+    const V bx = Lane::set(row.base.x), by = Lane::set(row.base.y), bz = Lane::set(row.base.z);
+    const V area = Lane::set(row.texelArea);
+    const V one = Lane::set(1.0f), three = Lane::set(3.0f);
+    const V y00 = Lane::set(SH_Y00), y1 = Lane::set(SH_Y1), y2 = Lane::set(SH_Y2), y20 = Lane::set(SH_Y20), y22 = Lane::set(SH_Y22);
+
+    uint32_t x = begin;
+    for (; x + Lane::WIDTH <= end; x += Lane::WIDTH)
+    {
+        V u = Lane::load(row.u + x);
+        V dx = Lane::add(Lane::mul(ax, u), bx);
+        V dy = Lane::add(Lane::mul(ay, u), by);
+        V dz = Lane::add(Lane::mul(az, u), bz);
+        V invLen = Lane::invSqrt(Lane::add(Lane::add(Lane::mul(dx, dx), Lane::mul(dy, dy)), Lane::mul(dz, dz)));
+        // texel solid angle: area / |d|^3
+        V weight = Lane::mul(area, Lane::mul(invLen, Lane::mul(invLen, invLen)));
+        dx = Lane::mul(dx, invLen);
+        dy = Lane::mul(dy, invLen);
+        dz = Lane::mul(dz, invLen);
+
+        const V basis[N] =
+        {
+            y00,
+            Lane::mul(y1, dy),
+            Lane::mul(y1, dz),
+            Lane::mul(y1, dx),
+            Lane::mul(y2, Lane::mul(dx, dy)),
+            Lane::mul(y2, Lane::mul(dy, dz)),
+            Lane::mul(y20, Lane::sub(Lane::mul(three, Lane::mul(dz, dz)), one)),
+            Lane::mul(y2, Lane::mul(dx, dz)),
+            Lane::mul(y22, Lane::sub(Lane::mul(dx, dx), Lane::mul(dy, dy))),
+        };
+
+        V wr = Lane::mul(weight, Lane::load(row.r + x));
+        V wg = Lane::mul(weight, Lane::load(row.g + x));
+        V wb = Lane::mul(weight, Lane::load(row.b + x));
+        for (uint32_t i = 0; i < N; i++)
+        {
+            acc[i * 3 + 0] = Lane::add(acc[i * 3 + 0], Lane::mul(basis[i], wr));
+            acc[i * 3 + 1] = Lane::add(acc[i * 3 + 1], Lane::mul(basis[i], wg));
+            acc[i * 3 + 2] = Lane::add(acc[i * 3 + 2], Lane::mul(basis[i], wb));
+        }
+        accWeight = Lane::add(accWeight, weight);
+    }
+
+    for (uint32_t i = 0; i < N * 3; i++)
+    {
+        out[i] += Lane::sum(acc[i]);
+    }
+    out[WEIGHT_SUM_IDX] += Lane::sum(accWeight);
+    return x;
+}
+
+uint32_t texelSize(vk::Format format)
+{
+    switch (format)
+    {
+    case vk::Format::eR32G32B32A32Sfloat:
+        return 16;
+    case vk::Format::eR16G16B16A16Sfloat:
+        return 8;
+    case vk::Format::eR8G8B8A8Unorm:
+        return 4;
+    default:
+        throw std::runtime_error("sh irradiance: unsupported cubemap format " + vk::to_string(format));
+    }
+}
+
+// rgba texels to planar rgb floats
+void decodeRow(const unsigned char* src, vk::Format format, uint32_t count, float* r, float* g, float* b)
+{
+    switch (format)
+    {
+    case vk::Format::eR32G32B32A32Sfloat:
+    {
+        const float* texels = reinterpret_cast<const float*>(src);
+        for (uint32_t x = 0; x < count; x++)
+        {
+            r[x] = texels[x * 4 + 0];
+            g[x] = texels[x * 4 + 1];
+            b[x] = texels[x * 4 + 2];
+        }
+        break;
+    }
+    case vk::Format::eR16G16B16A16Sfloat:
+    {
+        const uint16_t* texels = reinterpret_cast<const uint16_t*>(src);
+        for (uint32_t x = 0; x < count; x++)
+        {
+            r[x] = glm::unpackHalf1x16(texels[x * 4 + 0]);
+            g[x] = glm::unpackHalf1x16(texels[x * 4 + 1]);
+            b[x] = glm::unpackHalf1x16(texels[x * 4 + 2]);
+        }
+        break;
+    }
+    case vk::Format::eR8G8B8A8Unorm:
+    {
+        const float scale = 1.0f / 255.0f;
+        for (uint32_t x = 0; x < count; x++)
+        {
+            r[x] = src[x * 4 + 0] * scale;
+            g[x] = src[x * 4 + 1] * scale;
+            b[x] = src[x * 4 + 2] * scale;
+        }
+        break;
+    }
+    default:
+        assert(false);
+    }
+}
+
+// texel center in [-1, 1]
+std::vector<float> texelCenters(uint32_t size)
+{
+    std::vector<float> centers(size);
+    for (uint32_t x = 0; x < size; x++)
+    {
+        centers[x] = (2.0f * (x + 0.5f)) / size - 1.0f;
+    }
+    return centers;
+}
+
+}
+
+SHIrradiance::SHIrradiance(RHI::VulkanDevice* device)
+    : m_pDevice(device)
+{
+    m_pUniformBuffer.reset(
+        new RHI::VulkanBuffer(
+            device, sizeof(RHI::SHIrradianceUniformBufferObject),
+            vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            vk::SharingMode::eExclusive
+        )
+    );
+    upload();
+}
+
+SHIrradiance::~SHIrradiance()
+{
+    m_pUniformBuffer.reset();
+}
+
+void SHIrradiance::Project(Util::Texture::RawData* envCubeMap, uint32_t level)
+{
+    ZoneScoped;
+    auto tStart = std::chrono::high_resolution_clock::now();
+
+    m_coefficients = ProjectCubeMap(envCubeMap, level, ProjectMode::kParallelSimd);
+    upload();
+
+    auto tEnd = std::chrono::high_resolution_clock::now();
+    auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+    std::cout << "[SHIrradiance] projecting " << envCubeMap->GetWidth() << "x" << envCubeMap->GetHeight() << " cubemap took " << tDiff << " ms" << std::endl;
+}
+
+void SHIrradiance::SetCoefficients(const Coefficients& coefficients)
+{
+    m_coefficients = coefficients;
+    upload();
+}
+
+void SHIrradiance::upload()
+{
+    RHI::SHIrradianceUniformBufferObject ubo;
+    for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+    {
+        ubo.coefficients[i] = glm::vec4(m_coefficients[i], 0.0f);
+    }
+    m_pUniformBuffer->FillingMappingBuffer(&ubo, 0, sizeof(ubo));
+}
+
+SHIrradiance::Coefficients SHIrradiance::ProjectCubeMap(Util::Texture::RawData* envCubeMap, uint32_t level, ProjectMode mode)
+{
+    ZoneScoped;
+    assert(envCubeMap && envCubeMap->IsCubeMap());
+    assert((int)level < envCubeMap->GetMipLevels());
+
+    const uint32_t size = std::max((uint32_t)envCubeMap->GetWidth() >> level, 1u);
+    const vk::Format format = envCubeMap->GetVkFormat();
+    const uint32_t bytesPerTexel = texelSize(format);
+    const std::vector<float> centers = texelCenters(size);
+    const float texelArea = (2.0f / size) * (2.0f / size);
+
+    size_t faceOffsets[FACE_COUNT];
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        faceOffsets[face] = envCubeMap->GetLevelOffset(level, face);
+    }
+    Util::Texture::RawData::Payload payload = envCubeMap->AcquireData();
+    if (!payload)
+    {
+        throw std::runtime_error("sh irradiance: read environment cubemap failed");
+    }
+    const unsigned char* data = payload.Get();
+
+    auto projectRows = [&](size_t begin, size_t end, Accumulator& acc)
+    {
+        std::vector<float> r(size), g(size), b(size);
+        for (size_t rowIdx = begin; rowIdx < end; rowIdx++)
+        {
+            uint32_t face = (uint32_t)(rowIdx / size);
+            uint32_t y = (uint32_t)(rowIdx % size);
+            decodeRow(data + faceOffsets[face] + (size_t)y * size * bytesPerTexel, format, size, r.data(), g.data(), b.data());
+
+            RowInput row{
+                centers.data(), r.data(), g.data(), b.data(),
+                FACES[face].normal + FACES[face].vAxis * centers[y],
+                FACES[face].uAxis,
+                texelArea
+            };
+            uint32_t done = mode == ProjectMode::kScalar ? 0 : accumulateRow<SimdLane>(row, 0, size, acc);
+            accumulateRow<ScalarLane>(row, done, size, acc);
+        }
+    };
+
+    const size_t rowCount = (size_t)FACE_COUNT * size;
+    std::vector<Accumulator> accumulators;
+    if (mode == ProjectMode::kParallelSimd)
+    {
+        accumulators.resize(Util::Parallel::workerCount(), Accumulator{});
+        Util::Parallel::parallelFor(rowCount, [&](size_t begin, size_t end, uint32_t worker){
+            projectRows(begin, end, accumulators[worker]);
+        });
+    }
+    else
+    {
+        accumulators.resize(1, Accumulator{});
+        projectRows(0, rowCount, accumulators[0]);
+    }
+
+    Accumulator total{};
+    for (const auto& acc : accumulators)
+    {
+        for (size_t i = 0; i < total.size(); i++)
+        {
+            total[i] += acc[i];
+        }
+    }
+
+    // the texel solid angles only sum to 4pi in the limit, renormalize to remove the discretization bias
+    const double normalize = 4.0 * 3.14159265358979323846 / total[WEIGHT_SUM_IDX];
+    // cosine lobe convolution A_l = pi, 2pi/3, pi/4, divided by pi to match the irradiance cubemap
+    const double bandScale[COEFFICIENT_COUNT] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+
+    Coefficients coefficients;
+    for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+    {
+        double scale = normalize * bandScale[i];
+        coefficients[i] = glm::vec3(total[i * 3 + 0] * scale, total[i * 3 + 1] * scale, total[i * 3 + 2] * scale);
+    }
+    return coefficients;
+}
+
+glm::vec3 SHIrradiance::Evaluate(const Coefficients& c, const glm::vec3& n)
+{
+    return c[0] * SH_Y00
+         + c[1] * (SH_Y1 * n.y)
+         + c[2] * (SH_Y1 * n.z)
+         + c[3] * (SH_Y1 * n.x)
+         + c[4] * (SH_Y2 * n.x * n.y)
+         + c[5] * (SH_Y2 * n.y * n.z)
+         + c[6] * (SH_Y20 * (3.0f * n.z * n.z - 1.0f))
+         + c[7] * (SH_Y2 * n.x * n.z)
+         + c[8] * (SH_Y22 * (n.x * n.x - n.y * n.y));
+}
+
+SHIrradiance::ErrorStats SHIrradiance::CompareWithCubeMap(const Coefficients& coefficients, Util::Texture::RawData* irradianceCubeMap, uint32_t level)
+{
+    ZoneScoped;
+    assert(irradianceCubeMap && irradianceCubeMap->IsCubeMap());
+
+    const uint32_t size = std::max((uint32_t)irradianceCubeMap->GetWidth() >> level, 1u);
+    const vk::Format format = irradianceCubeMap->GetVkFormat();
+    const uint32_t bytesPerTexel = texelSize(format);
+    const std::vector<float> centers = texelCenters(size);
+    std::vector<float> r(size), g(size), b(size);
+
+    Util::Texture::RawData::Payload payload = irradianceCubeMap->AcquireData();
+    if (!payload)
+    {
+        throw std::runtime_error("sh irradiance: read irradiance cubemap failed");
+    }
+
+    ErrorStats stats;
+    double sumSquared = 0.0;
+    double sumReference = 0.0;
+    for (uint32_t face = 0; face < FACE_COUNT; face++)
+    {
+        const unsigned char* faceData = payload.Get() + irradianceCubeMap->GetLevelOffset(level, face);
+        for (uint32_t y = 0; y < size; y++)
+        {
+            decodeRow(faceData + (size_t)y * size * bytesPerTexel, format, size, r.data(), g.data(), b.data());
+            for (uint32_t x = 0; x < size; x++)
+            {
+                glm::vec3 dir = glm::normalize(FACES[face].normal + FACES[face].uAxis * centers[x] + FACES[face].vAxis * centers[y]);
+                glm::vec3 reference(r[x], g[x], b[x]);
+                glm::vec3 diff = glm::abs(Evaluate(coefficients, dir) - reference);
+                stats.maxAbs = std::max(stats.maxAbs, std::max(diff.x, std::max(diff.y, diff.z)));
+                sumSquared += glm::dot(diff, diff) / 3.0;
+                sumReference += (reference.x + reference.y + reference.z) / 3.0;
+            }
+        }
+    }
+
+    const double texelCount = (double)FACE_COUNT * size * size;
+    stats.rms = (float)std::sqrt(sumSquared / texelCount);
+    stats.relative = sumReference > 0.0 ? (float)(stats.rms / (sumReference / texelCount)) : 0.0f;
+    return stats;
+}
+
+void SHIrradiance::Benchmark(Util::Texture::RawData* envCubeMap, uint32_t level, uint32_t iterations)
+{
+    ZoneScoped;
+    const ProjectMode modes[] = { ProjectMode::kScalar, ProjectMode::kSimd, ProjectMode::kParallelSimd };
+    const char* names[] = { "scalar", "simd", "parallel simd" };
+    constexpr size_t modeCount = sizeof(modes) / sizeof(modes[0]);
+
+    std::cout << "[SHIrradiance] benchmark " << envCubeMap->GetWidth() << "x" << envCubeMap->GetHeight() << "x6 " << vk::to_string(envCubeMap->GetVkFormat())
+              << ", simd width " << SimdLane::WIDTH << ", " << Util::Parallel::workerCount() << " workers, best of " << iterations << std::endl;
+
+    Coefficients results[modeCount];
+    double bestMs[modeCount];
+    for (size_t m = 0; m < modeCount; m++)
+    {
+        bestMs[m] = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+        {
+            auto tStart = std::chrono::high_resolution_clock::now();
+            results[m] = ProjectCubeMap(envCubeMap, level, modes[m]);
+            auto tEnd = std::chrono::high_resolution_clock::now();
+            bestMs[m] = std::min(bestMs[m], std::chrono::duration<double, std::milli>(tEnd - tStart).count());
+        }
+
+        float maxDiff = 0.0f;
+        for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+        {
+            glm::vec3 diff = glm::abs(results[m][i] - results[0][i]);
+            maxDiff = std::max(maxDiff, std::max(diff.x, std::max(diff.y, diff.z)));
+        }
+        std::cout << "[SHIrradiance]   " << names[m] << ": " << bestMs[m] << " ms, x" << bestMs[0] / bestMs[m]
+                  << " vs scalar, max coefficient diff " << maxDiff << std::endl;
+    }
+}
+
+}}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Runtime/VulkanRHI/Graphic/Model.h"
+#include "Runtime/VulkanRHI/Layout/UniformBufferObject.h"
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Util/Textureutil.h"
+#include <array>
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
+
+namespace Render { namespace Prefilter {
+
+// Diffuse irradiance as 9 rgb L2 spherical harmonics coefficients, projected from the environment cubemap on the cpu.
+// The cosine lobe convolution is folded in, so evaluating the basis gives the same value as the irradiance cubemap.
+class SHIrradiance
+{
+public:
+    static constexpr uint32_t COEFFICIENT_COUNT = 9;
+    using Coefficients = std::array<glm::vec3, COEFFICIENT_COUNT>;
+
+    enum class ProjectMode
+    {
+        kScalar,
+        kSimd,          // widest available of avx / sse
+        kParallelSimd   // simd, rows split across worker threads
+    };
+
+    struct ErrorStats
+    {
+        float maxAbs = 0.0f;
+        float rms = 0.0f;
+        float relative = 0.0f; // rms / mean reference luminance
+    };
+public:
+    explicit SHIrradiance(RHI::VulkanDevice* device);
+    ~SHIrradiance();
+
+    // project and upload to the uniform buffer
+    void Project(Util::Texture::RawData* envCubeMap, uint32_t level = 0);
+    // upload coefficients projected elsewhere, e.g. on a worker thread
+    void SetCoefficients(const Coefficients& coefficients);
+    inline const Coefficients& GetCoefficients() const { return m_coefficients; }
+    inline RHI::Model::UBOLayoutInfo GetUboInfo() const
+    {
+        return { m_pUniformBuffer.get(), RHI::VulkanDescriptorSetLayout::DESCRIPTOR_CUSTOMUBO_BINDING_ID, sizeof(RHI::SHIrradianceUniformBufferObject) };
+    }
+
+    static Coefficients ProjectCubeMap(Util::Texture::RawData* envCubeMap, uint32_t level = 0, ProjectMode mode = ProjectMode::kParallelSimd);
+    static glm::vec3 Evaluate(const Coefficients& coefficients, const glm::vec3& normal);
+    // compare against every texel of a prefiltered irradiance cubemap
+    static ErrorStats CompareWithCubeMap(const Coefficients& coefficients, Util::Texture::RawData* irradianceCubeMap, uint32_t level = 0);
+    // prints the best time of each project mode
+    static void Benchmark(Util::Texture::RawData* envCubeMap, uint32_t level = 0, uint32_t iterations = 10);
+
+private:
+    void upload();
+
+private:
+    RHI::VulkanDevice* m_pDevice;
+    Coefficients m_coefficients{};
+    std::unique_ptr<RHI::VulkanBuffer> m_pUniformBuffer;
+};
+
+}}
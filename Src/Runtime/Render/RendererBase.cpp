@@ -311,6 +311,7 @@ void RendererBase::recreateSwapchain()
     }
 
     m_pDevice->ReCreateSwapchain(m_pRenderPass.get(), windowSetting.width, windowSetting.height, 1, m_VulkanPresentFramebufferAttachments, getPresentImageAttachmentId());
+    onSwapchainRecreated();
 }
 
 void RendererBase::prepareDescriptorLayout()
@@ -117,6 +117,9 @@ protected:
     void endCommand(vk::CommandBuffer& cmd);
 
     void recreateSwapchain();
+    // after the swapchain and the present framebuffers were re-created on resize, the device is idle.
+    // renderers with more targets sized to the swapchain rebuild them here
+    virtual void onSwapchainRecreated() {}
     void prepareDescriptorLayout();
 private:
 
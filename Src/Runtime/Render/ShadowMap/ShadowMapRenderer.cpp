@@ -116,6 +116,11 @@ void ShadowMapRenderer::render()
     {
         m_pCamera->UpdateUniformBuffer();
     }
+    {
+        float viewportHeight = (float)m_pDevice->GetPVulkanSwapchain()->GetSwapchainInfo().imageExtent.height;
+        auto& view = m_renderFromLight ? m_pLights->GetLightTransformation(0) : m_pCamera->GetVPMatrix();
+        m_pModel->SelectLod(view, viewportHeight);
+    }
 
     // reset fence after acquiring the image
     m_pDevice->GetVkDevice().resetFences(m_vkFences[m_frameIdxInFlight]);
@@ -130,6 +135,7 @@ void ShadowMapRenderer::render()
         TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "shadowmap render");
         // shadow map pass
         {
+            TracyVkZone(m_tracyVkCtx[m_frameIdxInFlight], m_vkCmds[m_frameIdxInFlight], "shadow pass");
             updateShadowMapMVPUniformBuf();
             m_pShadwomapPass->Render(m_vkCmds[m_frameIdxInFlight], {m_pModel.get(), m_pCubeModel.get()});
         }
@@ -241,6 +247,7 @@ void ShadowMapRenderer::prepareModel()
     transformation.SetPosition(glm::vec3(0.0f, 0.f, 0.f));
     transformation.SetRotation(glm::vec3(0,0,0));
     m_pModel->InitUniformDescriptorSets(uboInfos);
+    m_pModel->SetShadowLodBias(1);
     m_pShadwomapPass->InitModelShadowDescriptor(m_pModel.get());
 
 
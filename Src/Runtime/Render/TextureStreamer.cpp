@@ -0,0 +1,327 @@
+#include "TextureStreamer.h"
+#include "Util/Textureutil.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <tracy/Tracy.hpp>
+
+namespace Render {
+
+TextureStreamer::TextureStreamer(RHI::VulkanDevice* device, const Config& config)
+    : m_pDevice(device)
+    , m_config(config)
+    , m_budget(config.budget)
+{
+    assert(m_config.maxPendingLoads > 0 && m_config.maxChangesPerUpdate > 0);
+    vk::DeviceSize heapBudget = 0;
+    vk::DeviceSize heapUsage = 0;
+    bool memoryBudget = m_pDevice->QueryDeviceLocalBudget(heapBudget, heapUsage);
+    std::cout << "[TextureStreamer] budget " << (m_config.budget >> 20) << " MB"
+              << (memoryBudget ? ", capped by VK_EXT_memory_budget" : "") << std::endl;
+    m_batchCmd = m_pDevice->GetPVulkanCmdPool()->CreateReUsableCmd();
+    m_batchFence = m_pDevice->GetVkDevice().createFence(vk::FenceCreateInfo());
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    if (m_batchSubmitted)
+    {
+        (void)m_pDevice->GetVkDevice().waitForFences(m_batchFence, true, std::numeric_limits<uint64_t>::max());
+    }
+    for (size_t textureIdx : m_batchTextures)
+    {
+        m_textures[textureIdx].imageSampler->CancelResidentMip();
+    }
+    for (size_t textureIdx : m_copiedTextures)
+    {
+        m_textures[textureIdx].imageSampler->CancelResidentMip();
+    }
+    m_pDevice->GetVkDevice().destroyFence(m_batchFence);
+    m_pDevice->GetPVulkanCmdPool()->FreeReUsableCmd(m_batchCmd);
+    m_retiredImages.clear();
+    for (auto& texture : m_textures)
+    {
+        if (texture.load.valid())
+        {
+            texture.load.get();
+            texture.imageSampler->GetRawData()->FreeData();
+        }
+    }
+    m_textures.clear();
+}
+
+void TextureStreamer::AddModel(RHI::Model* model)
+{
+    m_models.push_back(model);
+    std::vector<RHI::VulkanImageSampler*> imageSamplers;
+    model->CollectStreamedTextures(imageSamplers);
+    for (auto* imageSampler : imageSamplers)
+    {
+        auto it = m_textureIndices.find(imageSampler);
+        if (it != m_textureIndices.end())
+        {
+            m_textures[it->second].models.push_back(model);
+            continue;
+        }
+        Texture texture;
+        texture.imageSampler = imageSampler;
+        texture.models.push_back(model);
+        texture.tailMip = imageSampler->GetResidentMip();
+        texture.requiredMip = texture.tailMip;
+        m_textureIndices[imageSampler] = m_textures.size();
+        m_textures.emplace_back(std::move(texture));
+    }
+}
+
+void TextureStreamer::Update()
+{
+    ZoneScopedN("TextureStreamer::Update");
+    m_frame++;
+    std::unordered_map<RHI::VulkanImageSampler*, uint32_t> requiredMips;
+    for (auto* model : m_models)
+    {
+        model->CollectTextureRequests(requiredMips);
+    }
+
+    // images the frames in flight no longer sample
+    m_retiredImages.erase(std::remove_if(m_retiredImages.begin(), m_retiredImages.end(), [this](const RetiredImage& retired)
+    {
+        return retired.frame + MAX_FRAMES_IN_FLIGHT <= m_frame;
+    }), m_retiredImages.end());
+    if (m_batchSubmitted && m_pDevice->GetVkDevice().getFenceStatus(m_batchFence) == vk::Result::eSuccess)
+    {
+        m_batchSubmitted = false;
+        m_copiedTextures.insert(m_copiedTextures.end(), m_batchTextures.begin(), m_batchTextures.end());
+        m_batchTextures.clear();
+    }
+    switchCopied();
+
+    // textures out of view only need their tail, they keep what they have until the budget runs out
+    m_residentBytes = 0;
+    for (auto& texture : m_textures)
+    {
+        auto it = requiredMips.find(texture.imageSampler);
+        if (it != requiredMips.end())
+        {
+            texture.requiredMip = std::min(it->second, texture.tailMip);
+            texture.lastUsedFrame = m_frame;
+        }
+        else
+        {
+            texture.requiredMip = texture.tailMip;
+        }
+        m_residentBytes += texture.imageSampler->HasPendingResidentMip() ? texture.imageSampler->GetPendingMemorySize() : texture.imageSampler->GetPImageResource()->GetMemorySize();
+    }
+    updateBudget();
+
+    // one batch is in flight at a time, until it is copied finished loads wait in their futures
+    uint32_t changes = m_batchSubmitted ? m_config.maxChangesPerUpdate : 0;
+    if (m_residentBytes > m_budget)
+    {
+        evict(m_residentBytes - m_budget, nullptr, changes);
+    }
+
+    // finished loads go in as far as the budget allows, a payload that is not used is freed again
+    uint32_t pendingLoads = 0;
+    for (auto& texture : m_textures)
+    {
+        if (!texture.load.valid())
+        {
+            continue;
+        }
+        if (changes >= m_config.maxChangesPerUpdate || texture.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            pendingLoads++;
+            continue;
+        }
+
+        Util::Texture::RawData::Payload payload = texture.load.get();
+        bool loaded = (bool)payload;
+        uint32_t residentMip = texture.imageSampler->GetResidentMip();
+        uint32_t targetMip = texture.requiredMip;
+        for (; loaded && targetMip < residentMip; targetMip++)
+        {
+            vk::DeviceSize bytes = m_residentBytes + estimateBytes(texture, targetMip) - estimateBytes(texture, residentMip);
+            if (bytes <= m_budget || evict(bytes - m_budget, &texture, changes))
+            {
+                break;
+            }
+        }
+        if (loaded && targetMip < residentMip && changes < m_config.maxChangesPerUpdate)
+        {
+            setResidentMip(texture, targetMip);
+            changes++;
+        }
+        else
+        {
+            texture.imageSampler->GetRawData()->FreeData();
+        }
+    }
+
+    // the textures missing the most levels are read first, those that would not fit even after evicting are not read at all
+    std::vector<Texture*> wanted;
+    for (auto& texture : m_textures)
+    {
+        if (!texture.load.valid() && !texture.imageSampler->HasPendingResidentMip() && texture.requiredMip < texture.imageSampler->GetResidentMip())
+        {
+            wanted.push_back(&texture);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end(), [](const Texture* l, const Texture* r)
+    {
+        return l->imageSampler->GetResidentMip() - l->requiredMip > r->imageSampler->GetResidentMip() - r->requiredMip;
+    });
+    for (auto* texture : wanted)
+    {
+        if (pendingLoads >= m_config.maxPendingLoads)
+        {
+            break;
+        }
+        uint32_t residentMip = texture->imageSampler->GetResidentMip();
+        vk::DeviceSize bytes = m_residentBytes + estimateBytes(*texture, residentMip - 1) - estimateBytes(*texture, residentMip);
+        if (bytes > m_budget + evictableBytes(texture))
+        {
+            continue;
+        }
+        std::shared_ptr<Util::Texture::RawData> rawData = texture->imageSampler->GetRawData();
+        texture->load = std::async(std::launch::async, [rawData]() { return rawData->AcquireData(); });
+        pendingLoads++;
+    }
+
+    submitBatch();
+}
+
+void TextureStreamer::updateBudget()
+{
+    m_budget = m_config.budget;
+    vk::DeviceSize heapBudget = 0;
+    vk::DeviceSize heapUsage = 0;
+    if (m_pDevice->QueryDeviceLocalBudget(heapBudget, heapUsage))
+    {
+        // the rest of the process and other processes are not ours to evict
+        vk::DeviceSize others = heapUsage > m_residentBytes ? heapUsage - m_residentBytes : 0;
+        vk::DeviceSize limit = (vk::DeviceSize)((double)heapBudget * m_config.heapBudgetShare);
+        m_budget = std::min(m_budget, limit > others ? limit - others : 0);
+    }
+}
+
+vk::DeviceSize TextureStreamer::estimateBytes(Texture& texture, uint32_t residentMip)
+{
+    std::shared_ptr<Util::Texture::RawData> rawData = texture.imageSampler->GetRawData();
+    vk::DeviceSize bytes = 0;
+    for (uint32_t level = residentMip; level < texture.imageSampler->GetMipLevels(); level++)
+    {
+        bytes += (vk::DeviceSize)rawData->GetLevelSize(level);
+    }
+    return bytes;
+}
+
+vk::DeviceSize TextureStreamer::evictableBytes(Texture* keep)
+{
+    vk::DeviceSize bytes = 0;
+    for (auto& texture : m_textures)
+    {
+        uint32_t residentMip = texture.imageSampler->GetResidentMip();
+        if (&texture != keep && !texture.load.valid() && !texture.imageSampler->HasPendingResidentMip() && residentMip < texture.requiredMip)
+        {
+            bytes += estimateBytes(texture, residentMip) - estimateBytes(texture, texture.requiredMip);
+        }
+    }
+    return bytes;
+}
+
+bool TextureStreamer::evict(vk::DeviceSize bytes, Texture* keep, uint32_t& changes)
+{
+    ZoneScopedN("TextureStreamer::evict");
+    // textures still loading keep their levels, their payload is about to need them
+    std::vector<Texture*> candidates;
+    for (auto& texture : m_textures)
+    {
+        if (&texture != keep && !texture.load.valid() && !texture.imageSampler->HasPendingResidentMip() && texture.imageSampler->GetResidentMip() < texture.requiredMip)
+        {
+            candidates.push_back(&texture);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Texture* l, const Texture* r) { return l->lastUsedFrame < r->lastUsedFrame; });
+
+    vk::DeviceSize freed = 0;
+    for (auto* texture : candidates)
+    {
+        if (freed >= bytes || changes >= m_config.maxChangesPerUpdate)
+        {
+            break;
+        }
+        vk::DeviceSize residentBytes = m_residentBytes;
+        setResidentMip(*texture, texture->requiredMip);
+        changes++;
+        freed += residentBytes > m_residentBytes ? residentBytes - m_residentBytes : 0;
+    }
+    return freed >= bytes;
+}
+
+void TextureStreamer::setResidentMip(Texture& texture, uint32_t residentMip)
+{
+    ZoneScopedN("TextureStreamer::setResidentMip");
+    assert(!m_batchSubmitted);
+    if (m_batchTextures.empty())
+    {
+        m_batchCmd.reset();
+        m_batchCmd.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    }
+    vk::DeviceSize before = texture.imageSampler->GetPImageResource()->GetMemorySize();
+    texture.imageSampler->RecordResidentMip(m_batchCmd, residentMip);
+    m_batchTextures.push_back((size_t)(&texture - m_textures.data()));
+    m_residentBytes = m_residentBytes - before + texture.imageSampler->GetPendingMemorySize();
+}
+
+void TextureStreamer::submitBatch()
+{
+    if (m_batchSubmitted || m_batchTextures.empty())
+    {
+        return;
+    }
+    ZoneScopedN("TextureStreamer::submitBatch");
+    m_batchCmd.end();
+    m_pDevice->GetVkDevice().resetFences(m_batchFence);
+    m_pDevice->GetVkGraphicQueue().submit(vk::SubmitInfo().setCommandBuffers(m_batchCmd), m_batchFence);
+    m_batchSubmitted = true;
+}
+
+void TextureStreamer::switchCopied()
+{
+    ZoneScopedN("TextureStreamer::switchCopied");
+    // a model switches its descriptor sets to the copy the frames in flight do not use, which it last left MAX_FRAMES_IN_FLIGHT updates ago.
+    // every model drawing a texture switches with it, none may keep the old image past its retirement
+    auto canSwitch = [this](RHI::Model* model)
+    {
+        auto it = m_descriptorFrames.find(model);
+        return it == m_descriptorFrames.end() || it->second + MAX_FRAMES_IN_FLIGHT <= m_frame;
+    };
+    std::unordered_map<RHI::Model*, std::vector<RHI::VulkanImageSampler*>> switched;
+    std::vector<size_t> waiting;
+    for (size_t textureIdx : m_copiedTextures)
+    {
+        Texture& texture = m_textures[textureIdx];
+        if (!std::all_of(texture.models.begin(), texture.models.end(), canSwitch))
+        {
+            waiting.push_back(textureIdx);
+            continue;
+        }
+        m_retiredImages.push_back({texture.imageSampler->ApplyResidentMip(), m_frame});
+        for (auto* model : texture.models)
+        {
+            switched[model].push_back(texture.imageSampler);
+        }
+    }
+    m_copiedTextures.swap(waiting);
+    for (auto& model : switched)
+    {
+        model.first->UpdateTextureDescriptors(model.second);
+        m_descriptorFrames[model.first] = m_frame;
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "Runtime/VulkanRHI/Graphic/Model.h"
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include <future>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace Render {
+
+// Keeps the mip levels the view needs of the streamed textures of the added models resident, within a vram budget.
+// Streamed textures start with their mip tail, see RHI::Model. Finer levels are read on worker threads, copied to the gpu in batches
+// that run beside the frames and switched in by a later Update, when the budget runs out the textures the view needed least recently
+// give their levels back first.
+class TextureStreamer
+{
+public:
+    struct Config
+    {
+        // vram the streamed textures may hold
+        vk::DeviceSize budget = 256ull << 20;
+        // share of the device local budget reported by VK_EXT_memory_budget the process may fill, the texture budget shrinks to stay below it
+        float heapBudgetShare = 0.9f;
+        // texture payloads read at once
+        uint32_t maxPendingLoads = 4;
+        // residency changes recorded into one batch, a batch is submitted to the graphics queue with a fence and polled by Update
+        uint32_t maxChangesPerUpdate = 4;
+    };
+public:
+    explicit TextureStreamer(RHI::VulkanDevice* device, const Config& config = Config());
+    ~TextureStreamer();
+
+    void AddModel(RHI::Model* model);
+    // once per frame, after Model::SelectLod of the added models and the wait for the frame's fence, before the frame is recorded.
+    // images and descriptor sets a switch leaves behind are reused or destroyed once MAX_FRAMES_IN_FLIGHT later updates passed
+    void Update();
+    inline vk::DeviceSize GetResidentBytes() const { return m_residentBytes; }
+    inline vk::DeviceSize GetBudget() const { return m_budget; }
+
+private:
+    struct Texture
+    {
+        RHI::VulkanImageSampler* imageSampler = nullptr;
+        // whose descriptor sets reference it
+        std::vector<RHI::Model*> models;
+        uint32_t tailMip = 0;
+        uint32_t requiredMip = 0;
+        uint64_t lastUsedFrame = 0;
+        // reads the raw payload and holds it until Update copies it to the gpu
+        std::future<Util::Texture::RawData::Payload> load;
+    };
+    // an image a switch replaced, the frames in flight at that update may still sample it
+    struct RetiredImage
+    {
+        std::shared_ptr<RHI::VulkanImageResource> image;
+        uint64_t frame;
+    };
+
+    void updateBudget();
+    vk::DeviceSize estimateBytes(Texture& texture, uint32_t residentMip);
+    // what the textures holding more levels than they need could give back
+    vk::DeviceSize evictableBytes(Texture* keep);
+    // drops those levels, least recently used first, until bytes are freed. false if they could not be
+    bool evict(vk::DeviceSize bytes, Texture* keep, uint32_t& changes);
+    // records the change into the open batch
+    void setResidentMip(Texture& texture, uint32_t residentMip);
+    // switches in the copied textures whose models may switch their descriptor sets this frame
+    void switchCopied();
+    void submitBatch();
+
+private:
+    RHI::VulkanDevice* m_pDevice;
+    Config m_config;
+    std::vector<RHI::Model*> m_models;
+    std::vector<Texture> m_textures;
+    std::unordered_map<RHI::VulkanImageSampler*, size_t> m_textureIndices;
+    uint64_t m_frame = 0;
+    vk::DeviceSize m_budget;
+    // textures with a change in flight count with their new image
+    vk::DeviceSize m_residentBytes = 0;
+
+    vk::CommandBuffer m_batchCmd;
+    vk::Fence m_batchFence;
+    bool m_batchSubmitted = false;
+    // indices of the textures recorded into m_batchCmd
+    std::vector<size_t> m_batchTextures;
+    // copied and waiting for the descriptor sets of their models
+    std::vector<size_t> m_copiedTextures;
+    // update that last switched the descriptor sets of a model
+    std::unordered_map<RHI::Model*, uint64_t> m_descriptorFrames;
+    std::vector<RetiredImage> m_retiredImages;
+};
+
+}
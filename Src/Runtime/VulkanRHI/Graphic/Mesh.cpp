@@ -5,32 +5,124 @@
 #include <stdint.h>
 RHI_NAMESPACE_USING
 
-Mesh::Mesh(VulkanDevice* device, Util::Model::MeshData&& meshData)
+Mesh::Mesh(VulkanDevice* device, Util::Model::MeshData&& meshData, Util::Model::VertexFormat vertexFormat)
     : m_pVulkanDevice(device)
     , m_meshData(std::move(meshData))
+    , m_vertexFormat(vertexFormat)
 {
     auto cmd = m_pVulkanDevice->GetPVulkanCmdPool()->CreateReUsableCmd();
     {
-        m_pVulkanVertexBuffer = VulkanVertexBuffer::Create(m_pVulkanDevice, m_meshData.vertices, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
-        m_pVulkanVertexBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), m_meshData.vertices.size() * sizeof(m_meshData.vertices[0]));
+        if (m_vertexFormat == Util::Model::VertexFormat::kFull)
+        {
+            m_pVulkanVertexBuffer = VulkanVertexBuffer::Create(m_pVulkanDevice, m_meshData.vertices, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        }
+        else
+        {
+            m_pVulkanVertexBuffer = tVulkanGPUBuffer<uint8_t>::Create(m_pVulkanDevice, Util::Model::encodeVertices(m_meshData, m_vertexFormat), vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+            std::vector<Util::Model::VertexDequantization> dequantization{ Util::Model::getVertexDequantization(m_meshData, m_vertexFormat) };
+            m_pDequantizationBuffer = tVulkanGPUBuffer<Util::Model::VertexDequantization>::Create(m_pVulkanDevice, dequantization, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            m_pDequantizationBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), sizeof(dequantization[0]));
+            cmd.reset();
+        }
+        m_pVulkanVertexBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), GetVertexBufferSize());
+        cmd.reset();
+
+        std::vector<glm::vec3> positions(m_meshData.vertices.size());
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            positions[i] = glm::vec3(m_meshData.vertices[i].position);
+        }
+        m_pPositionBuffer = tVulkanGPUBuffer<glm::vec3>::Create(m_pVulkanDevice, positions, vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        m_pPositionBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), positions.size() * sizeof(positions[0]));
         cmd.reset();
 
-        m_pVulkanVertexIndexBuffer = RHI::VulkanVertexIndexBuffer::Create(m_pVulkanDevice, m_meshData.indices, vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
-        m_pVulkanVertexIndexBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), m_meshData.indices.size() * sizeof(m_meshData.indices[0]));
+        // storage for the meshlet culling pass, which reads lod 0 from it
+        vk::BufferUsageFlags indexUsage = vk::BufferUsageFlagBits::eIndexBuffer;
+        if (!m_meshData.meshlets.empty())
+        {
+            indexUsage |= vk::BufferUsageFlagBits::eStorageBuffer;
+        }
+        if (m_meshData.FitsIndex16())
+        {
+            std::vector<uint16_t> indices = Util::Model::narrowIndices(m_meshData.indices);
+            // even count, the culling pass reads the indices as 32 bit words
+            if (indices.size() % 2)
+            {
+                indices.push_back(0);
+            }
+            m_indexType = vk::IndexType::eUint16;
+            m_pVulkanVertexIndexBuffer = tVulkanGPUBuffer<uint16_t>::Create(m_pVulkanDevice, indices, indexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            m_pVulkanVertexIndexBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), indices.size() * sizeof(indices[0]));
+        }
+        else
+        {
+            m_pVulkanVertexIndexBuffer = RHI::VulkanVertexIndexBuffer::Create(m_pVulkanDevice, m_meshData.indices, indexUsage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            m_pVulkanVertexIndexBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), m_meshData.indices.size() * sizeof(m_meshData.indices[0]));
+        }
+        cmd.reset();
+    }
+    m_pVulkanDevice->GetPVulkanCmdPool()->FreeReUsableCmd(cmd);
+}
+
+bool Mesh::InitCulledDraw()
+{
+    if (m_meshData.meshlets.empty())
+    {
+        return false;
+    }
+    if (HasCulledDraw())
+    {
+        return true;
+    }
+
+    auto cmd = m_pVulkanDevice->GetPVulkanCmdPool()->CreateReUsableCmd();
+    {
+        m_pMeshletBuffer = tVulkanGPUBuffer<Util::Model::Meshlet>::Create(m_pVulkanDevice, m_meshData.meshlets, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        m_pMeshletBuffer->CopyDataToGPU(cmd, m_pVulkanDevice->GetVkGraphicQueue(), m_meshData.meshlets.size() * sizeof(m_meshData.meshlets[0]));
         cmd.reset();
     }
     m_pVulkanDevice->GetPVulkanCmdPool()->FreeReUsableCmd(cmd);
+
+    m_pCulledIndexBuffer.reset(new VulkanBuffer(
+        m_pVulkanDevice, m_meshData.GetLod(0).indexCount * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, vk::SharingMode::eExclusive
+    ));
+    m_pCulledDrawBuffer.reset(new VulkanBuffer(
+        m_pVulkanDevice, sizeof(vk::DrawIndexedIndirectCommand),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, vk::SharingMode::eExclusive
+    ));
+    return true;
+}
+
+void Mesh::DrawCulled(vk::CommandBuffer& cmd)
+{
+    cmd.bindIndexBuffer(*m_pCulledIndexBuffer->GetPVkBuf(), 0, vk::IndexType::eUint32);
+    cmd.drawIndexedIndirect(*m_pCulledDrawBuffer->GetPVkBuf(), 0, 1, sizeof(vk::DrawIndexedIndirectCommand));
 }
 
 void Mesh::Bind(vk::CommandBuffer& cmd)
 {
     cmd.bindVertexBuffers(0, *m_pVulkanVertexBuffer->GetPVkBuf(), {0});
-    cmd.bindIndexBuffer(*m_pVulkanVertexIndexBuffer->GetPVkBuf(), 0, vk::IndexType::eUint32);
+    if (m_pDequantizationBuffer)
+    {
+        cmd.bindVertexBuffers(VertexLayout::DEQUANTIZATION_BINDING, *m_pDequantizationBuffer->GetPVkBuf(), {0});
+    }
+    cmd.bindIndexBuffer(*m_pVulkanVertexIndexBuffer->GetPVkBuf(), 0, m_indexType);
+}
+
+void Mesh::BindPositions(vk::CommandBuffer& cmd)
+{
+    cmd.bindVertexBuffers(0, *m_pPositionBuffer->GetPVkBuf(), {0});
+    cmd.bindIndexBuffer(*m_pVulkanVertexIndexBuffer->GetPVkBuf(), 0, m_indexType);
 }
 
-void Mesh::DrawIndexed(vk::CommandBuffer &cmd)
+void Mesh::DrawIndexed(vk::CommandBuffer &cmd, uint32_t lod)
 {
-    cmd.drawIndexed(m_meshData.indices.size(), 1, 0,0,0);
+    Util::Model::MeshLod range = m_meshData.GetLod(lod);
+    cmd.drawIndexed(range.indexCount, 1, range.indexOffset, 0, 0);
 }
 
 
@@ -63,7 +155,8 @@ void MeshView::Bind(vk::CommandBuffer& cmd)
     cmd.bindIndexBuffer(*m_pVulkanVertexIndexBuffer->GetPVkBuf(), 0, vk::IndexType::eUint32);
 }
 
-void MeshView::DrawIndexed(vk::CommandBuffer& cmd)
+void MeshView::DrawIndexed(vk::CommandBuffer& cmd, uint32_t lod)
 {
-    cmd.drawIndexed(m_mesh->m_meshData.indices.size(), 1, 0,0,0);
+    Util::Model::MeshLod range = m_mesh->m_meshData.GetLod(lod);
+    cmd.drawIndexed(range.indexCount, 1, range.indexOffset, 0, 0);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "Runtime/VulkanRHI/Graphic/Vertex.h"
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Util/Meshutil.h"
 #include "Util/Modelutil.h"
 #include <boost/filesystem/path.hpp>
 #include <vulkan/vulkan.hpp>
@@ -15,14 +16,44 @@ class Mesh final
 private:
     VulkanDevice* m_pVulkanDevice;
     Util::Model::MeshData m_meshData;
+    Util::Model::VertexFormat m_vertexFormat;
 
-    std::unique_ptr<VulkanVertexBuffer> m_pVulkanVertexBuffer;
-    std::unique_ptr<VulkanVertexIndexBuffer> m_pVulkanVertexIndexBuffer;
+    // encoded in m_vertexFormat
+    std::unique_ptr<VulkanGPUBuffer> m_pVulkanVertexBuffer;
+    // uint16_t when every index fits, see MeshData::FitsIndex16
+    std::unique_ptr<VulkanGPUBuffer> m_pVulkanVertexIndexBuffer;
+    vk::IndexType m_indexType = vk::IndexType::eUint32;
+    // one VertexDequantization, bound per instance for the packed formats
+    std::unique_ptr<tVulkanGPUBuffer<Util::Model::VertexDequantization>> m_pDequantizationBuffer;
+    // float3 positions only, read by the depth only passes
+    std::unique_ptr<tVulkanGPUBuffer<glm::vec3>> m_pPositionBuffer;
+
+    // meshlet culling: input meshlets, compacted lod 0 indices and the indirect draw the culling pass writes
+    std::unique_ptr<tVulkanGPUBuffer<Util::Model::Meshlet>> m_pMeshletBuffer;
+    std::unique_ptr<VulkanBuffer> m_pCulledIndexBuffer;
+    std::unique_ptr<VulkanBuffer> m_pCulledDrawBuffer;
 public:
-    explicit Mesh(VulkanDevice* device, Util::Model::MeshData&& meshData);
+    explicit Mesh(VulkanDevice* device, Util::Model::MeshData&& meshData, Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull);
 
     void Bind(vk::CommandBuffer& cmd);
-    void DrawIndexed(vk::CommandBuffer& cmd);
+    // the position stream and the index buffer, for pipelines with VulkanVertextInputState::CreatePositionOnly
+    void BindPositions(vk::CommandBuffer& cmd);
+    // lod is clamped to the coarsest one the mesh has
+    void DrawIndexed(vk::CommandBuffer& cmd, uint32_t lod = 0);
+    inline const Util::Model::MeshData& GetMeshData() const { return m_meshData; }
+    inline Util::Model::VertexFormat GetVertexFormat() const { return m_vertexFormat; }
+    inline vk::IndexType GetIndexType() const { return m_indexType; }
+    inline vk::DeviceSize GetVertexBufferSize() const { return m_meshData.vertices.size() * Util::Model::getVertexStride(m_vertexFormat); }
+
+    // creates the meshlet culling buffers, false if the mesh has no meshlets
+    bool InitCulledDraw();
+    inline bool HasCulledDraw() const { return m_pCulledDrawBuffer != nullptr; }
+    // draws what the last culling pass kept of lod 0, binds its own index buffer
+    void DrawCulled(vk::CommandBuffer& cmd);
+    inline VulkanBuffer* GetMeshletBuffer() { return m_pMeshletBuffer.get(); }
+    inline VulkanBuffer* GetIndexBuffer() { return m_pVulkanVertexIndexBuffer.get(); }
+    inline VulkanBuffer* GetCulledIndexBuffer() { return m_pCulledIndexBuffer.get(); }
+    inline VulkanBuffer* GetCulledDrawBuffer() { return m_pCulledDrawBuffer.get(); }
 private:
 
 };
@@ -40,7 +71,7 @@ public:
     ~MeshView();
 
     void Bind(vk::CommandBuffer& cmd);
-    void DrawIndexed(vk::CommandBuffer& cmd);
+    void DrawIndexed(vk::CommandBuffer& cmd, uint32_t lod = 0);
 };
 
 RHI_NAMESPACE_END
\ No newline at end of file
@@ -9,30 +9,52 @@
 #include "Runtime/VulkanRHI/Graphic/Material.h"
 #include "Runtime/VulkanRHI/Graphic/Mesh.h"
 #include "Util/Fileutil.h"
+#include "Util/Meshutil.h"
 #include "Util/Modelutil.h"
 #include "Util/Textureutil.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <array>
 #include <assimp/material.h>
+#include <cmath>
 #include <glm/ext/matrix_transform.hpp>
+#include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
 #include <unordered_map>
 RHI_NAMESPACE_USING
 
+namespace {
 
-Model::Model(VulkanDevice* device, Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout* layout, const glm::vec4& color)
+// a file used with two semantics is two images, e.g. srgb as diffuse and linear as a mask
+std::string samplerKey(const Util::Model::TextureData& texData)
+{
+    return texData.name + "|" + Util::Texture::toString(Util::Texture::getSemantic(texData.type));
+}
+
+}
+
+
+Model::Model(VulkanDevice* device, Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout* layout, const glm::vec4& color, Util::Model::VertexFormat vertexFormat, bool textureMips, bool textureStreaming)
     : m_pVulkanDevice(device)
     , m_color(color)
+    , m_vertexFormat(vertexFormat)
+    , m_textureMips(textureMips)
+    , m_textureStreaming(textureStreaming)
 {
     init(std::move(modelData), layout);
 }
 
-Model::Model(VulkanDevice* device, const boost::filesystem::path& modelPath, VulkanDescriptorSetLayout* layout, const glm::vec4& color)
+Model::Model(VulkanDevice* device, const boost::filesystem::path& modelPath, VulkanDescriptorSetLayout* layout, const glm::vec4& color, Util::Model::VertexFormat vertexFormat, bool textureMips, bool textureStreaming)
     : m_pVulkanDevice(device)
     , m_color(color)
+    , m_vertexFormat(vertexFormat)
+    , m_textureMips(textureMips)
+    , m_textureStreaming(textureStreaming)
 {
     init(Util::Model::AssimpObj(modelPath).MoveModelData(), layout);
 }
@@ -122,10 +144,10 @@ void Model::DrawShadowPass(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelin
         cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout->GetVkPieplineLayout(), 0, CAMUBO_Descriptors, {});
     }
 
-    for (auto& mesh : m_meshes)
+    for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
     {
-        mesh->Bind(cmd);
-        mesh->DrawIndexed(cmd);
+        m_meshes[meshIdx]->BindPositions(cmd);
+        m_meshes[meshIdx]->DrawIndexed(cmd, getMeshLod(meshIdx) + m_shadowLodBias);
     }
 }
 
@@ -140,19 +162,36 @@ void Model::DrawWithNoMaterial(vk::CommandBuffer& cmd, VulkanPipelineLayout* pip
         cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout->GetVkPieplineLayout(), 0, tobinding, {});
     }
 
-    for (auto& mesh : m_meshes)
+    for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
+    {
+        m_meshes[meshIdx]->Bind(cmd);
+        m_meshes[meshIdx]->DrawIndexed(cmd, getMeshLod(meshIdx));
+    }
+}
+
+void Model::DrawDepthOnly(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, std::vector<vk::DescriptorSet>& tobinding)
+{
+    ZoneScopedN("Model::DrawDepthOnly");
+    // bind model ubo
+    {
+        UpdateModelUniformBuffer();
+        m_uniformSet->FillToBindedDescriptorSetsVector(tobinding, pipelineLayout);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout->GetVkPieplineLayout(), 0, tobinding, {});
+    }
+
+    for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
     {
-        mesh->Bind(cmd);
-        mesh->DrawIndexed(cmd);
+        m_meshes[meshIdx]->BindPositions(cmd);
+        m_meshes[meshIdx]->DrawIndexed(cmd, getMeshLod(meshIdx));
     }
 }
 
 void Model::DrawMesh(vk::CommandBuffer& cmd)
 {
-    for (auto& mesh : m_meshes)
+    for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
     {
-        mesh->Bind(cmd);
-        mesh->DrawIndexed(cmd);
+        m_meshes[meshIdx]->Bind(cmd);
+        m_meshes[meshIdx]->DrawIndexed(cmd, getMeshLod(meshIdx));
     }
 }
 
@@ -173,7 +212,130 @@ void Model::Draw(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, s
         {
             m_materials[matIdx]->bind(cmd, pipelineLayout, tobinding);
         }
-        m_meshes[meshIdx]->DrawIndexed(cmd);
+        // the culled draw only exists for lod 0
+        uint32_t lod = getMeshLod(meshIdx);
+        if (lod == 0 && m_meshes[meshIdx]->HasCulledDraw())
+        {
+            m_meshes[meshIdx]->DrawCulled(cmd);
+        }
+        else
+        {
+            m_meshes[meshIdx]->DrawIndexed(cmd, lod);
+        }
+    }
+}
+
+void Model::SelectLod(Util::Math::VPMatrix& view, float viewportHeight, float maxPixelError)
+{
+    ZoneScopedN("Model::SelectLod");
+    const glm::mat4& proj = view.GetProjMatrix();
+    // proj[1][1] is cot(fov / 2) for a perspective and 2 / height for an orthographic projection, only the perspective one divides by depth
+    const bool perspective = proj[2][3] != 0.0f;
+    const float pixelsPerUnit = std::abs(proj[1][1]) * 0.5f * viewportHeight;
+    const glm::mat4& modelMatrix = m_transformation.GetMatrix();
+    const glm::vec3 scale = glm::abs(m_transformation.GetScale());
+    const float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+    const glm::vec3 eye = view.GetPosition();
+    // object space, the texture requests leave out meshes the view cannot see
+    std::array<glm::vec4, 6> planes;
+    if (m_textureStreaming)
+    {
+        planes = Util::Model::extractFrustumPlanes(proj * view.GetViewMatrix() * modelMatrix);
+    }
+
+    m_meshLods.resize(m_meshes.size());
+    m_meshUvPixels.assign(m_meshes.size(), 0.0f);
+    for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
+    {
+        const Util::Model::MeshData& meshData = m_meshes[meshIdx]->GetMeshData();
+        uint32_t lod = 0;
+        // nearest point of the bounding sphere, from inside it lod 0 is kept
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(0.5f * (meshData.boundsMin + meshData.boundsMax), 1.0f));
+        float radius = 0.5f * glm::length(meshData.boundsMax - meshData.boundsMin) * maxScale;
+        float distance = perspective ? glm::length(center - eye) - radius : 1.0f;
+        if (distance > 0.0f)
+        {
+            for (uint32_t candidate = 1; candidate < meshData.GetLodCount(); candidate++)
+            {
+                float pixelError = meshData.GetLod(candidate).error * maxScale / distance * pixelsPerUnit;
+                if (pixelError > maxPixelError)
+                {
+                    break;
+                }
+                lod = candidate;
+            }
+        }
+        m_meshLods[meshIdx] = lod;
+
+        if (m_textureStreaming && meshIdx < m_meshUvScales.size())
+        {
+            glm::vec3 objectCenter = 0.5f * (meshData.boundsMin + meshData.boundsMax);
+            float objectRadius = 0.5f * glm::length(meshData.boundsMax - meshData.boundsMin);
+            bool visible = std::all_of(planes.begin(), planes.end(),
+                [&](const glm::vec4& plane) { return glm::dot(glm::vec3(plane), objectCenter) + plane.w >= -objectRadius; });
+            if (visible)
+            {
+                m_meshUvPixels[meshIdx] = distance > 0.0f ? m_meshUvScales[meshIdx] * maxScale / distance * pixelsPerUnit : std::numeric_limits<float>::infinity();
+            }
+        }
+    }
+}
+
+void Model::CollectTextureRequests(std::unordered_map<VulkanImageSampler*, uint32_t>& requiredMips) const
+{
+    ZoneScopedN("Model::CollectTextureRequests");
+    for (size_t meshIdx = 0; meshIdx < m_meshUvPixels.size(); meshIdx++)
+    {
+        float uvPixels = m_meshUvPixels[meshIdx];
+        size_t matIdx = meshIdx < m_materialIndexs.size() ? m_materialIndexs[meshIdx] : m_materialData.size();
+        if (uvPixels <= 0.0f || matIdx >= m_materialData.size())
+        {
+            continue;
+        }
+        for (auto& texData : m_materialData[matIdx].textureDatas)
+        {
+            auto it = m_vulkanImageSamplers.find(samplerKey(texData));
+            if (it == m_vulkanImageSamplers.end() || !it->second->IsStreamed())
+            {
+                continue;
+            }
+            // the level whose texels per uv unit still cover the pixels per uv unit
+            VulkanImageSampler* imageSampler = it->second.get();
+            float texels = (float)std::max(texData.rawData->GetWidth(), texData.rawData->GetHeight());
+            uint32_t mip = 0;
+            if (std::isfinite(uvPixels) && texels > uvPixels)
+            {
+                mip = std::min((uint32_t)std::floor(std::log2(texels / uvPixels)), imageSampler->GetMipLevels() - 1);
+            }
+            auto inserted = requiredMips.emplace(imageSampler, mip);
+            if (!inserted.second)
+            {
+                inserted.first->second = std::min(inserted.first->second, mip);
+            }
+        }
+    }
+}
+
+void Model::CollectStreamedTextures(std::vector<VulkanImageSampler*>& textures) const
+{
+    for (auto& imageSampler : m_vulkanImageSamplers)
+    {
+        if (imageSampler.second->IsStreamed())
+        {
+            textures.emplace_back(imageSampler.second.get());
+        }
+    }
+}
+
+void Model::UpdateTextureDescriptors(const std::vector<VulkanImageSampler*>& imageSamplers)
+{
+    ZoneScopedN("Model::UpdateTextureDescriptors");
+    for (auto& descriptorSets : m_descriptorsets)
+    {
+        if (descriptorSets.second)
+        {
+            descriptorSets.second->UpdateImageSamplers(imageSamplers);
+        }
     }
 }
 
@@ -187,9 +349,40 @@ void Model::init(Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout*
     initModelUniformBuffers();
     m_materialData = modelData.materialDatas;
 }
+void Model::initTextureConfig(Util::Texture::RawData* rawData, VulkanImageSampler::Config& samplerConfig, VulkanImageResource::Config& resourceConfig) const
+{
+    uint32_t width = (uint32_t)rawData->GetWidth();
+    uint32_t height = (uint32_t)rawData->GetHeight();
+    if (rawData->IsCubeMap())
+    {
+        samplerConfig = VulkanImageSampler::Config::CubeMap(rawData->GetMipLevels());
+        resourceConfig = VulkanImageResource::Config::CubeMap(width, height, rawData->GetMipLevels());
+        resourceConfig.format = rawData->GetVkFormat();
+        return;
+    }
+
+    // block compressed levels cannot be blitted, those only have the levels they were cooked with
+    uint32_t mipLevels = 1;
+    if (m_textureMips)
+    {
+        mipLevels = rawData->IsCompressed() ? (uint32_t)rawData->GetMipLevels() : Util::Texture::getMipLevelCount(width, height);
+    }
+    resourceConfig.extent = vk::Extent3D{width, height, 1};
+    resourceConfig.format = rawData->GetVkFormat();
+    resourceConfig.components = rawData->GetComponents();
+    resourceConfig.miplevel = mipLevels;
+    resourceConfig.subresourceRange.setLevelCount(mipLevels);
+    samplerConfig.maxLod = (float)mipLevels;
+}
+
 void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialDatas, VulkanDescriptorSetLayout* layout)
 {
     ZoneScopedN("Model::initMatrials");
+    size_t textureCount = 0;
+    size_t textureBytes = 0;
+    size_t rgba8Bytes = 0;
+    size_t streamedCount = 0;
+    size_t streamedBytes = 0;
     // create image sampler
     for (auto& matData : materialDatas)
     {
@@ -199,31 +392,49 @@ void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialD
         }
         for (auto& texData : matData.textureDatas)
         {
-            if (m_vulkanImageSamplers.find(texData.name) == m_vulkanImageSamplers.end())
+            if (m_vulkanImageSamplers.find(samplerKey(texData)) == m_vulkanImageSamplers.end())
             {
                 VulkanImageSampler::Config imageSamplerConfig;
                 VulkanImageResource::Config imageResourceConfig;
                 if (texData.rawData)
                 {
-                    imageResourceConfig.extent = vk::Extent3D{(uint32_t)texData.rawData->GetWidth(), (uint32_t)texData.rawData->GetHeight(), 1};
-                    if (texData.rawData->IsCubeMap())
-                    {
-                        imageSamplerConfig = VulkanImageSampler::Config::CubeMap(texData.rawData->GetMipLevels());
-                        imageResourceConfig = VulkanImageResource::Config::CubeMap(texData.rawData->GetWidth(), texData.rawData->GetHeight(), texData.rawData->GetMipLevels());
-                    }
-                    imageResourceConfig.format = texData.rawData->GetVkFormat();
-                    m_vulkanImageSamplers[texData.name] = std::make_shared<VulkanImageSampler>(
+                    initTextureConfig(texData.rawData.get(), imageSamplerConfig, imageResourceConfig);
+                    uint32_t residentMip = m_textureStreaming ? Util::Texture::getMipTailLevel(imageResourceConfig.extent.width, imageResourceConfig.extent.height, TEXTURE_TAIL_SIZE) : 0;
+                    auto imageSampler = std::make_shared<VulkanImageSampler>(
                         m_pVulkanDevice,
                         texData.rawData,
                         vk::MemoryPropertyFlagBits::eDeviceLocal,
                         imageSamplerConfig,
-                        imageResourceConfig
+                        imageResourceConfig,
+                        residentMip
                     );
+                    m_vulkanImageSamplers[samplerKey(texData)] = imageSampler;
+                    if (imageSampler->IsStreamed())
+                    {
+                        streamedCount++;
+                        streamedBytes += (size_t)imageSampler->GetPImageResource()->GetMemorySize();
+                    }
+                    // the uploaded levels against the same levels in rgba8
+                    textureCount++;
+                    textureBytes += (size_t)texData.rawData->GetDataSize();
+                    for (int level = 0; level < texData.rawData->GetMipLevels(); level++)
+                    {
+                        rgba8Bytes += (size_t)std::max(texData.rawData->GetWidth() >> level, 1) * std::max(texData.rawData->GetHeight() >> level, 1) * 4
+                                    * (texData.rawData->IsCubeMap() ? 6 : 1);
+                    }
                 }
             }
         }
         m_descriptorsets[matData.name] = nullptr;
     }
+    if (textureCount > 0)
+    {
+        std::cout << "[Model] " << textureCount << " textures, " << textureBytes / 1024 << " KB uploaded, " << rgba8Bytes / 1024 << " KB as rgba8" << std::endl;
+    }
+    if (streamedCount > 0)
+    {
+        std::cout << "[Model] " << streamedCount << " textures streamed, " << streamedBytes / 1024 << " KB of mip tails resident" << std::endl;
+    }
 
     // create descriptorsets pool
     uint32_t maxDescriptorNums = 0;
@@ -233,6 +444,9 @@ void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialD
     {
         maxDescriptorNums += m_vulkanImageSamplers.size() / i;
     }
+    // streamed textures switch their material sets to a spare copy, the frames in flight keep the current one
+    int materialSetCount = m_textureStreaming ? 2 : 1;
+    maxDescriptorNums *= (uint32_t)materialSetCount;
 
 
     if (maxDescriptorNums > 0)
@@ -260,7 +474,7 @@ void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialD
         {
             for (auto& texData : matData.textureDatas)
             {
-                samplers.emplace_back(m_vulkanImageSamplers[texData.name].get());
+                samplers.emplace_back(m_vulkanImageSamplers[samplerKey(texData)].get());
             }
 
             std::vector<uint32_t> binding;
@@ -268,7 +482,7 @@ void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialD
             {
                 binding.emplace_back(i);
             }
-            std::shared_ptr<VulkanDescriptorSets> descs = m_vulkanDescriptorPool->AllocSamplerDescriptorSet(layout, samplers, binding);
+            std::shared_ptr<VulkanDescriptorSets> descs = m_vulkanDescriptorPool->AllocSamplerDescriptorSet(layout, samplers, binding, vk::ImageLayout::eShaderReadOnlyOptimal, materialSetCount);
             m_descriptorsets[matData.name] = descs;
         }
         else
@@ -298,11 +512,24 @@ void Model::initMatrials(const std::vector<Util::Model::MaterialData>& materialD
 void Model::initMeshes(std::vector<Util::Model::MeshData>& meshData)
 {
     ZoneScopedN("Model::initMeshes");
+    vk::DeviceSize vertexBytes = 0;
+    size_t vertexCount = 0;
     for (int i = 0; i < meshData.size(); i++)
     {
-        std::shared_ptr<Mesh> mesh(new Mesh(m_pVulkanDevice, std::move(meshData[i])));
+        std::shared_ptr<Mesh> mesh(new Mesh(m_pVulkanDevice, std::move(meshData[i]), m_vertexFormat));
+        vertexBytes += mesh->GetVertexBufferSize();
+        vertexCount += mesh->GetMeshData().vertices.size();
+        if (m_textureStreaming)
+        {
+            m_meshUvScales.emplace_back(Util::Model::computeUvScale(mesh->GetMeshData()));
+        }
         m_meshes.emplace_back(mesh);
     }
+    if (m_vertexFormat != Util::Model::VertexFormat::kFull)
+    {
+        std::cout << "[Model] " << vertexCount << " vertices, " << Util::Model::getVertexStride(m_vertexFormat) << " bytes each, "
+                  << vertexBytes / 1024 << " KB, " << vertexCount * sizeof(Vertex) / 1024 << " KB unpacked" << std::endl;
+    }
 }
 
 void Model::initModelUniformBuffers()
@@ -356,14 +583,14 @@ ModelView::ModelView(Model* model, VulkanDevice* device, VulkanDescriptorSetLayo
         }
         for (auto& texData : matData.textureDatas)
         {
-            if (m_vulkanImageSamplers.find(texData.name) == m_vulkanImageSamplers.end())
+            if (m_vulkanImageSamplers.find(samplerKey(texData)) == m_vulkanImageSamplers.end())
             {
                 VulkanImageSampler::Config imageSamplerConfig;
                 VulkanImageResource::Config imageResourceConfig;
                 if (texData.rawData)
                 {
-                    imageResourceConfig.extent = vk::Extent3D{(uint32_t)texData.rawData->GetWidth(), (uint32_t)texData.rawData->GetHeight(), 1};
-                    m_vulkanImageSamplers[texData.name] = std::make_shared<VulkanImageSampler>(
+                    m_model->initTextureConfig(texData.rawData.get(), imageSamplerConfig, imageResourceConfig);
+                    m_vulkanImageSamplers[samplerKey(texData)] = std::make_shared<VulkanImageSampler>(
                         m_pVulkanDevice,
                         texData.rawData,
                         vk::MemoryPropertyFlagBits::eDeviceLocal,
@@ -411,7 +638,7 @@ ModelView::ModelView(Model* model, VulkanDevice* device, VulkanDescriptorSetLayo
         {
             for (auto& texData : matData.textureDatas)
             {
-                samplers.emplace_back(m_vulkanImageSamplers[texData.name].get());
+                samplers.emplace_back(m_vulkanImageSamplers[samplerKey(texData)].get());
             }
 
             std::vector<uint32_t> binding;
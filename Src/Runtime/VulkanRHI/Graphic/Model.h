@@ -37,6 +37,7 @@ private:
     std::vector<size_t> m_materialIndexs;
     std::vector<Util::Model::MaterialData> m_materialData;
 
+    // keyed by texture name and semantic, the same file as color and as data is decoded to two formats
     std::unordered_map<std::string, std::shared_ptr<VulkanImageSampler>> m_vulkanImageSamplers;
     std::unordered_map<std::string, std::shared_ptr<VulkanDescriptorSets>> m_descriptorsets;
     std::unique_ptr<VulkanDescriptorPool> m_vulkanDescriptorPool;
@@ -47,9 +48,27 @@ private:
     std::vector<std::shared_ptr<RHI::VulkanDescriptorSets>> m_shadowPassUniformSets;
     Util::Math::SRTMatrix m_transformation;
     glm::vec4 m_color;
+    Util::Model::VertexFormat m_vertexFormat;
+    bool m_textureMips;
+    bool m_textureStreaming;
+    // per mesh, see Util::Model::computeUvScale
+    std::vector<float> m_meshUvScales;
+    // per mesh, from the last SelectLod
+    std::vector<uint32_t> m_meshLods;
+    // screen pixels one uv unit spans at the nearest point of the mesh, 0 outside the view
+    std::vector<float> m_meshUvPixels;
+    uint32_t m_shadowLodBias = 0;
 public:
-    explicit Model(VulkanDevice* device, Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout* layout, const glm::vec4& color = glm::vec4(1.0f));
-    explicit Model(VulkanDevice* device, const boost::filesystem::path& modelPath, VulkanDescriptorSetLayout* layout, const glm::vec4& color = glm::vec4(1.0f));
+    // projected lod error allowed before a finer lod is drawn
+    static constexpr float LOD_PIXEL_ERROR = 1.0f;
+    // streamed textures start with the levels whose sides are at most this
+    static constexpr uint32_t TEXTURE_TAIL_SIZE = 64;
+
+    // the pipelines drawing the model need a vertex input state of the same vertexFormat.
+    // textureMips gives every 2d texture a full mip chain, off they are sampled from level 0 only.
+    // textureStreaming uploads only the mip tail of cooked textures, the finer levels are left to a Render::TextureStreamer
+    explicit Model(VulkanDevice* device, Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout* layout, const glm::vec4& color = glm::vec4(1.0f), Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull, bool textureMips = true, bool textureStreaming = false);
+    explicit Model(VulkanDevice* device, const boost::filesystem::path& modelPath, VulkanDescriptorSetLayout* layout, const glm::vec4& color = glm::vec4(1.0f), Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull, bool textureMips = true, bool textureStreaming = false);
     ~Model();
 
     void SetColor(const glm::vec4& color) { m_color = color; }
@@ -57,18 +76,38 @@ public:
     void InitUniformDescriptorSets(const std::vector<UBOLayoutInfo>& uboInfo, RHI::VulkanDescriptorSetLayout* uboLayout = nullptr);
     void DrawShadowPass(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, int lightId);
     void DrawWithNoMaterial(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, std::vector<vk::DescriptorSet>& tobinding);
+    // position stream only, see VulkanVertextInputState::CreatePositionOnly
+    void DrawDepthOnly(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, std::vector<vk::DescriptorSet>& tobinding);
     void DrawMesh(vk::CommandBuffer& cmd);
     void Draw(vk::CommandBuffer& cmd, VulkanPipelineLayout* pipelineLayout, std::vector<vk::DescriptorSet>& tobinding);
 
+    // picks the coarsest lod of each mesh whose error projects below maxPixelError from view, kept for the following draws.
+    // until it is called every mesh draws lod 0
+    void SelectLod(Util::Math::VPMatrix& view, float viewportHeight, float maxPixelError = LOD_PIXEL_ERROR);
+    // shadow passes draw this many lods coarser than the selected one
+    inline void SetShadowLodBias(uint32_t bias) { m_shadowLodBias = bias; }
+
+    // the finest level each streamed texture needs for the view of the last SelectLod, merged into requiredMips by minimum.
+    // textures only drawn outside the view are left out
+    void CollectTextureRequests(std::unordered_map<VulkanImageSampler*, uint32_t>& requiredMips) const;
+    void CollectStreamedTextures(std::vector<VulkanImageSampler*>& textures) const;
+    // after imageSamplers changed their residency, the material sets drawing them switch to their spare copy.
+    // not again before the frames in flight since the last call completed, they may still use that copy
+    void UpdateTextureDescriptors(const std::vector<VulkanImageSampler*>& imageSamplers);
+
     void UpdateModelUniformBuffer();
     inline VulkanBuffer* GetUniformBuffer() const { return m_uniformBuffer.get(); }
     inline UBOLayoutInfo GetUboInfo() { return { m_uniformBuffer.get(), RHI::VulkanDescriptorSetLayout::DESCRIPTOR_MODELUBO_BINDING_ID, sizeof(ModelUniformBufferObject)}; }
     inline Util::Math::SRTMatrix& GetTransformation() { return m_transformation; }
+    inline const std::vector<std::shared_ptr<Mesh>>& GetMeshes() const { return m_meshes; }
+    inline Util::Model::VertexFormat GetVertexFormat() const { return m_vertexFormat; }
 private:
     void init(Util::Model::ModelData&& modelData, VulkanDescriptorSetLayout* layout);
     void initMatrials(const std::vector<Util::Model::MaterialData>& materialData, VulkanDescriptorSetLayout* layout);
     void initMeshes(std::vector<Util::Model::MeshData>& meshData);
     void initModelUniformBuffers();
+    void initTextureConfig(Util::Texture::RawData* rawData, VulkanImageSampler::Config& samplerConfig, VulkanImageResource::Config& resourceConfig) const;
+    inline uint32_t getMeshLod(size_t meshIdx) const { return meshIdx < m_meshLods.size() ? m_meshLods[meshIdx] : 0; }
 
 };
 
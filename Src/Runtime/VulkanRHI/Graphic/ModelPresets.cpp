@@ -2,6 +2,7 @@
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "Util/Fileutil.h"
 #include "Util/Modelutil.h"
+#include "Util/Texturecacheutil.h"
 #include "Util/Textureutil.h"
 #include "vulkan/vulkan_enums.hpp"
 #include <assimp/material.h>
@@ -111,6 +112,11 @@ Util::Model::MeshData GenerateSphereMeshData(unsigned int X_SEGMENTS = 64, unsig
 
 Util::Model::MeshData ModelPresets::GetCubeMeshData() { return cubeMeshData; }
 
+boost::filesystem::path ModelPresets::GetSkyboxTexturePath()
+{
+    return Util::File::getResourcePath() / "Texture/cubemap_yokohama_rgba.ktx";
+}
+
 Util::Model::MaterialData ModelPresets::GetSkyboxMaterialData()
 {
     static Util::Model::MaterialData skyMat
@@ -122,7 +128,7 @@ Util::Model::MaterialData ModelPresets::GetSkyboxMaterialData()
             {
                 "cube", aiTextureType_DIFFUSE, aiTextureMapMode_Clamp, aiTextureMapMode_Clamp,
                 Util::Texture::RawData::Load(
-                    Util::File::getResourcePath() / "Texture/cubemap_yokohama_rgba.ktx",
+                    GetSkyboxTexturePath(),
                     Util::Texture::RawData::Format::eRgbAlpha, true,
                     vk::Format::eR8G8B8A8Unorm
                     // vk::Format::eR16G16B16A16Sfloat // hdr
@@ -324,10 +330,10 @@ std::unique_ptr<Model> ModelPresets::CreateCerberusPBRModel(VulkanDevice* device
     auto assimpModel = Util::Model::AssimpObj(modelPath);
     Util::Model::ModelData&& modelData = assimpModel.MoveModelData();
 
-    auto metallic = Util::Texture::RawData::Load(texturePath / "Cerberus_M.tga", Util::Texture::RawData::Format::eRgbAlpha);
-    auto roughness = Util::Texture::RawData::Load(texturePath / "Cerberus_R.tga", Util::Texture::RawData::Format::eRgbAlpha);
-    auto normal = Util::Texture::RawData::Load(texturePath / "Cerberus_N.tga", Util::Texture::RawData::Format::eRgbAlpha);
-    auto ao = Util::Texture::RawData::Load(texturePath / "Raw/Cerberus_AO.tga", Util::Texture::RawData::Format::eRgbAlpha);
+    auto metallic = Util::Texture::loadCooked(texturePath / "Cerberus_M.tga", Util::Texture::Semantic::kData);
+    auto roughness = Util::Texture::loadCooked(texturePath / "Cerberus_R.tga", Util::Texture::Semantic::kData);
+    auto normal = Util::Texture::loadCooked(texturePath / "Cerberus_N.tga", Util::Texture::Semantic::kNormal);
+    auto ao = Util::Texture::loadCooked(texturePath / "Raw/Cerberus_AO.tga", Util::Texture::Semantic::kData);
 
     std::vector<Util::Model::TextureData>& texDatas = modelData.materialDatas[0].textureDatas;
     // Binding1: Albedo
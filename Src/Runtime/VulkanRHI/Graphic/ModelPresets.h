@@ -14,6 +14,7 @@ namespace ModelPresets
 
     Util::Model::MeshData GetCubeMeshData();
     Util::Model::MaterialData GetSkyboxMaterialData();
+    boost::filesystem::path GetSkyboxTexturePath();
 
     std::unique_ptr<Model> CreatePlaneModel(VulkanDevice* device, VulkanDescriptorSetLayout* layout);
     std::unique_ptr<Model> CreateCubeModel(VulkanDevice* device, VulkanDescriptorSetLayout* layout);
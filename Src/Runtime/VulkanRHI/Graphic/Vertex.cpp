@@ -2,6 +2,8 @@
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "vulkan/vulkan_structs.hpp"
 #include <array>
+#include <cstddef>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 RHI_NAMESPACE_USING
@@ -49,4 +51,120 @@ const std::array<vk::VertexInputAttributeDescription,5>& Vertex::GetAttributeDes
                     .setOffset(offsetof(Vertex, bitangent));
 
     return attributeDescs;
-}
\ No newline at end of file
+}
+
+namespace {
+
+template<typename T>
+std::vector<vk::VertexInputAttributeDescription> packedAttributeDescriptions(vk::Format positionFormat)
+{
+    std::vector<vk::VertexInputAttributeDescription> attributeDescs(6);
+    attributeDescs[0]
+                    .setBinding(0)
+                    .setLocation(0)
+                    .setFormat(positionFormat)
+                    .setOffset(offsetof(T, position));
+
+    attributeDescs[1]
+                    .setBinding(0)
+                    .setLocation(1)
+                    .setFormat(vk::Format::eR16G16Sfloat)
+                    .setOffset(offsetof(T, texCoord));
+
+    attributeDescs[2]
+                    .setBinding(0)
+                    .setLocation(2)
+                    .setFormat(vk::Format::eR16G16Snorm)
+                    .setOffset(offsetof(T, normal));
+
+    attributeDescs[3]
+                    .setBinding(0)
+                    .setLocation(3)
+                    .setFormat(vk::Format::eR8G8B8A8Snorm)
+                    .setOffset(offsetof(T, tangent));
+
+    attributeDescs[4]
+                    .setBinding(VertexLayout::DEQUANTIZATION_BINDING)
+                    .setLocation(5)
+                    .setFormat(vk::Format::eR32G32B32A32Sfloat)
+                    .setOffset(offsetof(Util::Model::VertexDequantization, offset));
+
+    attributeDescs[5]
+                    .setBinding(VertexLayout::DEQUANTIZATION_BINDING)
+                    .setLocation(6)
+                    .setFormat(vk::Format::eR32G32B32A32Sfloat)
+                    .setOffset(offsetof(Util::Model::VertexDequantization, scale));
+
+    return attributeDescs;
+}
+
+std::vector<vk::VertexInputBindingDescription> packedBindingDescriptions(uint32_t stride)
+{
+    return {
+        vk::VertexInputBindingDescription()
+                    .setBinding(0)
+                    .setStride(stride)
+                    .setInputRate(vk::VertexInputRate::eVertex),
+        vk::VertexInputBindingDescription()
+                    .setBinding(VertexLayout::DEQUANTIZATION_BINDING)
+                    .setStride(sizeof(Util::Model::VertexDequantization))
+                    .setInputRate(vk::VertexInputRate::eInstance)
+    };
+}
+
+}
+
+const std::vector<vk::VertexInputBindingDescription>& VertexLayout::GetBindingDescriptions(Util::Model::VertexFormat format)
+{
+    static const std::vector<vk::VertexInputBindingDescription> fullDescs{ Vertex::GetBindingDescription() };
+    static const std::vector<vk::VertexInputBindingDescription> packedDescs = packedBindingDescriptions(sizeof(Util::Model::PackedVertexData));
+    static const std::vector<vk::VertexInputBindingDescription> quantizedDescs = packedBindingDescriptions(sizeof(Util::Model::QuantizedVertexData));
+    switch (format)
+    {
+    case Util::Model::VertexFormat::kPacked:
+        return packedDescs;
+    case Util::Model::VertexFormat::kQuantized:
+        return quantizedDescs;
+    default:
+        return fullDescs;
+    }
+}
+
+const std::vector<vk::VertexInputAttributeDescription>& VertexLayout::GetAttributeDescriptions(Util::Model::VertexFormat format)
+{
+    static const std::vector<vk::VertexInputAttributeDescription> fullDescs(Vertex::GetAttributeDescriptions().begin(), Vertex::GetAttributeDescriptions().end());
+    static const std::vector<vk::VertexInputAttributeDescription> packedDescs = packedAttributeDescriptions<Util::Model::PackedVertexData>(vk::Format::eR32G32B32Sfloat);
+    static const std::vector<vk::VertexInputAttributeDescription> quantizedDescs = packedAttributeDescriptions<Util::Model::QuantizedVertexData>(vk::Format::eR16G16B16A16Unorm);
+    switch (format)
+    {
+    case Util::Model::VertexFormat::kPacked:
+        return packedDescs;
+    case Util::Model::VertexFormat::kQuantized:
+        return quantizedDescs;
+    default:
+        return fullDescs;
+    }
+}
+
+const std::vector<vk::VertexInputBindingDescription>& VertexLayout::GetPositionBindingDescriptions()
+{
+    static const std::vector<vk::VertexInputBindingDescription> bindingDescs{
+        vk::VertexInputBindingDescription()
+                    .setBinding(0)
+                    .setStride(sizeof(glm::vec3))
+                    .setInputRate(vk::VertexInputRate::eVertex)
+    };
+    return bindingDescs;
+}
+
+const std::vector<vk::VertexInputAttributeDescription>& VertexLayout::GetPositionAttributeDescriptions()
+{
+    static const std::vector<vk::VertexInputAttributeDescription> attributeDescs{
+        vk::VertexInputAttributeDescription()
+                    .setBinding(0)
+                    .setLocation(0)
+                    .setFormat(vk::Format::eR32G32B32Sfloat)
+                    .setOffset(0)
+    };
+    return attributeDescs;
+}
@@ -3,6 +3,8 @@
 #include "Util/Modelutil.h"
 #include <array>
 #include <functional>
+#include <stdint.h>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -11,6 +13,19 @@ RHI_NAMESPACE_BEGIN
 
 using Vertex = Util::Model::VertexData;
 
+// vertex input of each Util::Model::VertexFormat. the packed formats also read the VertexDequantization
+// of the mesh from binding 1 at locations 5 and 6, advanced per instance
+struct VertexLayout
+{
+    static constexpr uint32_t DEQUANTIZATION_BINDING = 1;
+
+    static const std::vector<vk::VertexInputBindingDescription>& GetBindingDescriptions(Util::Model::VertexFormat format);
+    static const std::vector<vk::VertexInputAttributeDescription>& GetAttributeDescriptions(Util::Model::VertexFormat format);
+    // float3 positions at location 0, the stream every mesh keeps for depth only passes whatever its vertex format
+    static const std::vector<vk::VertexInputBindingDescription>& GetPositionBindingDescriptions();
+    static const std::vector<vk::VertexInputAttributeDescription>& GetPositionAttributeDescriptions();
+};
+
 
 RHI_NAMESPACE_END
 
@@ -18,14 +33,17 @@ namespace std {
 
 template<> struct hash<RHI::Vertex>
 {
+    // all components of every attribute, combined so that equal hashes of different fields do not cancel out
     size_t operator()(RHI::Vertex const& vertex) const
     {
-        return
-            hash<glm::vec3>()(vertex.position) ^ (hash<glm::vec2>()(vertex.texCoord) << 1) >> 1
-            ^ ((hash<glm::vec2>()(vertex.texCoord) << 1) >> 1)
-            ^ ((hash<glm::vec3>()(vertex.normal) << 1) >> 1)
-            ^ ((hash<glm::vec3>()(vertex.tangent) << 1) >> 1)
-            ^ ((hash<glm::vec3>()(vertex.bitangent) << 1) >> 1);
+        size_t seed = 0;
+        auto combine = [&seed](size_t h) { seed ^= h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2); };
+        combine(hash<glm::vec4>()(vertex.position));
+        combine(hash<glm::vec4>()(vertex.texCoord));
+        combine(hash<glm::vec4>()(vertex.normal));
+        combine(hash<glm::vec4>()(vertex.tangent));
+        combine(hash<glm::vec4>()(vertex.bitangent));
+        return seed;
     }
 };
 
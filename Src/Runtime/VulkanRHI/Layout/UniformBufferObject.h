@@ -32,4 +32,11 @@ struct ModelUniformBufferObject
 };
 
 // SET0 BINDING3 CUSTOM UBO
+// L2 spherical harmonics irradiance, rgb in xyz
+struct SHIrradianceUniformBufferObject
+{
+    alignas(16) glm::vec4 coefficients[9];
+};
+static_assert(sizeof(SHIrradianceUniformBufferObject) == 144, "sh irradiance ubo must match the std140 layout");
+
 RHI_NAMESPACE_END
\ No newline at end of file
@@ -96,6 +96,23 @@ std::shared_ptr<VulkanDescriptorSetLayout> VulkanDescriptorSetLayoutPresets::Cre
     return std::make_shared<VulkanDescriptorSetLayout>(device, vkDescriptorSetLayout);
 }
 
+std::shared_ptr<VulkanDescriptorSetLayout> VulkanDescriptorSetLayoutPresets::CreateInputAttachments(VulkanDevice* device, uint32_t num)
+{
+    std::vector<vk::DescriptorSetLayoutBinding> binding(num);
+    for (int i = 0; i < num; i++)
+    {
+        binding[i]
+            .setDescriptorType(vk::DescriptorType::eInputAttachment)
+            .setStageFlags(vk::ShaderStageFlagBits::eFragment)
+            .setDescriptorCount(1)
+            .setBinding(i);
+    }
+    auto layoutInfo = vk::DescriptorSetLayoutCreateInfo()
+                .setBindings(binding);
+    auto vkDescriptorSetLayout = device->GetVkDevice().createDescriptorSetLayout(layoutInfo);
+    return std::make_shared<VulkanDescriptorSetLayout>(device, vkDescriptorSetLayout);
+}
+
 void VulkanDescriptorSetLayoutPresets::Init(VulkanDevice* device)
 {
     UBO = std::make_shared<VulkanUBODescriptorSetLayout>(device);
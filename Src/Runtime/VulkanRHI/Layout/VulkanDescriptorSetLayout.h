@@ -53,6 +53,7 @@ struct VulkanDescriptorSetLayoutPresets
 
     std::shared_ptr<VulkanDescriptorSetLayout> CreateCustomUBO(VulkanDevice* device, vk::ShaderStageFlags stage);
     std::shared_ptr<VulkanDescriptorSetLayout> CreateSBO(VulkanDevice* device, vk::ShaderStageFlags stage, uint32_t num);
+    std::shared_ptr<VulkanDescriptorSetLayout> CreateInputAttachments(VulkanDevice* device, uint32_t num);
     void Init(VulkanDevice* device);
     void UnInit();
 };
@@ -5,7 +5,8 @@
 
 RHI_NAMESPACE_USING
 
-VulkanVertextInputState::VulkanVertextInputState()
+VulkanVertextInputState::VulkanVertextInputState(Util::Model::VertexFormat vertexFormat)
+    : m_vertexFormat(vertexFormat)
 {
 
 }
@@ -16,12 +17,25 @@ VulkanVertextInputState::~VulkanVertextInputState()
 
 }
 
+std::shared_ptr<VulkanVertextInputState> VulkanVertextInputState::CreatePositionOnly()
+{
+    auto state = std::make_shared<VulkanVertextInputState>();
+    state->m_positionOnly = true;
+    return state;
+}
+
 vk::PipelineVertexInputStateCreateInfo VulkanVertextInputState::GetVertexInputStateCreateInfo()
 {
-    auto& attributeDescs = Vertex::GetAttributeDescriptions();
-    auto& bindingDesc = Vertex::GetBindingDescription();
+    if (m_positionOnly)
+    {
+        return vk::PipelineVertexInputStateCreateInfo()
+                    .setVertexAttributeDescriptions(VertexLayout::GetPositionAttributeDescriptions())
+                    .setVertexBindingDescriptions(VertexLayout::GetPositionBindingDescriptions());
+    }
+    auto& attributeDescs = VertexLayout::GetAttributeDescriptions(m_vertexFormat);
+    auto& bindingDescs = VertexLayout::GetBindingDescriptions(m_vertexFormat);
     auto inputInfo = vk::PipelineVertexInputStateCreateInfo()
                     .setVertexAttributeDescriptions(attributeDescs)
-                    .setVertexBindingDescriptions(bindingDesc); 
+                    .setVertexBindingDescriptions(bindingDescs);
     return inputInfo;
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Util/Modelutil.h"
+#include <memory>
 #include <vulkan/vulkan.hpp>
 
 RHI_NAMESPACE_BEGIN
@@ -8,9 +10,14 @@ class VulkanVertextInputState
 {
 public:
 private:
+    Util::Model::VertexFormat m_vertexFormat;
+    bool m_positionOnly = false;
 public:
-    VulkanVertextInputState();
+    // must match the vertex format of the meshes drawn with the pipeline
+    explicit VulkanVertextInputState(Util::Model::VertexFormat vertexFormat = Util::Model::VertexFormat::kFull);
     ~VulkanVertextInputState();
+    // for pipelines drawn through Mesh::BindPositions, independent of the vertex format
+    static std::shared_ptr<VulkanVertextInputState> CreatePositionOnly();
 
     vk::PipelineVertexInputStateCreateInfo GetVertexInputStateCreateInfo();
 };
@@ -11,6 +11,7 @@
 #include "Runtime/VulkanRHI/PipelineStates/VulkanDynamicState.h"
 #include "Runtime/VulkanRHI/PipelineStates/VulkanMultisampleState.h"
 #include "Runtime/VulkanRHI/PipelineStates/VulkanRasterizationState.h"
+#include "Runtime/VulkanRHI/PipelineStates/VulkanVertextInputState.h"
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
 #include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
 #include "Runtime/VulkanRHI/Resources/VulkanImage.h"
@@ -276,6 +277,8 @@ void ShadowMapRenderPass::initPipelines()
     // switch off color blend state
     std::shared_ptr<VulkanColorBlendState> colorBlend = std::make_shared<VulkanColorBlendState>(std::vector<vk::PipelineColorBlendAttachmentState>{});
     auto multisampleState = std::make_shared<VulkanMultisampleState>(vk::SampleCountFlagBits::e1);
+    // Model::DrawShadowPass binds the position stream only
+    auto vertexInputState = VulkanVertextInputState::CreatePositionOnly();
     for (int i = 0; i < m_num; i++)
     {
         std::unique_ptr<VulkanRenderPipeline> pipeline =
@@ -285,6 +288,7 @@ void ShadowMapRenderPass::initPipelines()
                 .SetVulkanRasterizationState(rasterization)
                 .SetVulkanDynamicState(dynamic_state)
                 .SetVulkanMultisampleState(multisampleState)
+                .SetVulkanVertexInputState(vertexInputState)
                 .buildUnique();
         m_pRenderPasses[i]->AddGraphicRenderPipeline("shadowmap", std::move(pipeline));
     }
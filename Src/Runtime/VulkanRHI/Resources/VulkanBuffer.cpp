@@ -75,6 +75,13 @@ uint32_t VulkanDeviceMemory::findMemoryType()
         }
     }
 
+    // lazily allocated memory only exists on tile based gpus, fall back to plain device local memory
+    if (m_vkMemProps & vk::MemoryPropertyFlagBits::eLazilyAllocated)
+    {
+        m_vkMemProps &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eLazilyAllocated);
+        return findMemoryType();
+    }
+
     throw std::runtime_error("faild to find suitable memory type");
     return 0;
 }
@@ -25,6 +25,7 @@ public:
     void UnMapMemory();
     void Bind(VulkanBuffer* buf);
     void Bind(VulkanImageResource* img);
+    inline vk::DeviceSize GetSize() const { return m_vkMemRequirements.size; }
 private:
     uint32_t findMemoryType();
 };
@@ -1,11 +1,15 @@
 #include "VulkanImage.h"
 #include "Runtime/VulkanRHI/VulkanDevice.h"
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanStagingRing.h"
+#include "Runtime/VulkanRHI/Resources/VulkanTextureRegistry.h"
 #include "Runtime/VulkanRHI/VulkanCommandPool.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "vulkan/vulkan_core.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <stdint.h>
@@ -241,6 +245,7 @@ void VulkanImageResource::createImageView()
                 .setImage(m_native.vkImage.value())
                 .setViewType(m_native.config.value().imageViewType)
                 .setFormat(m_native.config.value().format)
+                .setComponents(m_native.config.value().components)
                 .setSubresourceRange(m_native.config.value().subresourceRange)
                 ;
     m_native.vkImageView = m_vulkanDevice->GetVkDevice().createImageView(viewInfo);
@@ -251,125 +256,351 @@ VulkanImageSampler::VulkanImageSampler(
         std::shared_ptr<Util::Texture::RawData> rawData,
         vk::MemoryPropertyFlags memProps,
         Config config,
-        VulkanImageResource::Config resourceConfig
+        VulkanImageResource::Config resourceConfig,
+        uint32_t residentMip/* = 0 */
 )
     : m_vulkanDevice(device)
     , m_pRawData(rawData)
     , m_config(config)
+    , m_resourceConfig(resourceConfig)
     , m_memProps(memProps)
 {
     ZoneScopedN("VulkanImageSampler::VulkanImageSampler");
-    m_pVulkanImageResource.reset(new VulkanImageResource(device, memProps, resourceConfig));
+    if (m_pRawData && m_resourceConfig.miplevel > (uint32_t)m_pRawData->GetMipLevels())
+    {
+        // the missing levels are blitted from the last uploaded one
+        assert(!m_pRawData->IsCompressed());
+        m_resourceConfig.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+    m_streamed = residentMip > 0 && m_pRawData && !m_pRawData->IsCubeMap() && m_resourceConfig.arrayLayer == 1
+                && m_resourceConfig.miplevel > 1 && (uint32_t)m_pRawData->GetMipLevels() >= m_resourceConfig.miplevel;
+    if (m_streamed)
+    {
+        // the levels both images hold are copied out of the old one whenever the residency changes
+        m_residentMip = std::min(residentMip, m_resourceConfig.miplevel - 1);
+        m_resourceConfig.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
 
-    createSampler();
+    // textures are shared with every sampler of the device made from the same content and config,
+    // render targets never are and neither are streamed textures, their image is replaced under them
+    VulkanTextureRegistry* registry = m_vulkanDevice->GetPVulkanTextureRegistry();
+    m_vkSampler = registry->GetSampler(m_config);
+    VulkanTextureRegistry::ImageKey imageKey;
+    bool shared = m_pRawData && !m_streamed && VulkanTextureRegistry::GetImageKey(*m_pRawData, memProps, m_resourceConfig, m_config.imageLayout, imageKey);
+    if (shared)
+    {
+        m_pVulkanImageResource = registry->FindImage(imageKey);
+    }
+    if (m_pVulkanImageResource)
+    {
+        m_pRawData->FreeData();
+        return;
+    }
 
+    m_pVulkanImageResource.reset(new VulkanImageResource(device, memProps, getResidentConfig(m_resourceConfig, m_residentMip)));
     if (m_pRawData)
     {
-        createStagingBuffer();
         UploadImageToGPU();
     }
+    if (shared)
+    {
+        m_pVulkanImageResource = registry->AddImage(imageKey, m_pVulkanImageResource);
+    }
 }
 
 VulkanImageSampler::~VulkanImageSampler()
 {
     ZoneScopedN("VulkanImageSampler::~VulkanImageSampler");
-    m_pVulkanStagingBuffer.reset();
+    CancelResidentMip();
     m_pRawData = nullptr;
-
-    m_vulkanDevice->GetVkDevice().destroySampler(m_vkSampler);
+    // the sampler belongs to the texture registry
+    m_vkSampler = nullptr;
     m_pVulkanImageResource.reset();
 }
 
 void VulkanImageSampler::UploadImageToGPU()
 {
     ZoneScopedN("VulkanImageSampler::UploadImageToGPU");
+    // the levels past the ones in the raw data are generated afterwards
+    uint32_t endLevel = std::min(m_resourceConfig.miplevel, (uint32_t)m_pRawData->GetMipLevels());
+    VulkanStagingRing::Allocation allocation;
+    std::vector<vk::BufferImageCopy> regions;
+    std::unique_ptr<VulkanBuffer> stagingBuffer = stageLevels(m_residentMip, endLevel, m_residentMip, allocation, regions);
+
     m_pVulkanImageResource->TransitionImageLayout(vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-    copyBufferToImage();
-    m_pVulkanImageResource->TransitionImageLayout(vk::ImageLayout::eTransferDstOptimal, m_config.imageLayout);
+    copyBufferToImage(allocation.buffer, regions);
+    if (m_resourceConfig.miplevel > (uint32_t)m_pRawData->GetMipLevels())
+    {
+        generateMipmaps();
+    }
+    else
+    {
+        m_pVulkanImageResource->TransitionImageLayout(vk::ImageLayout::eTransferDstOptimal, m_config.imageLayout);
+    }
+
+    // every submit above waited for the queue, so neither the staging range nor the cpu copy is read anymore.
+    // the raw data keeps its description, GetData reads the file again if it is needed later
+    if (!stagingBuffer)
+    {
+        m_vulkanDevice->GetPVulkanStagingRing()->Free(allocation);
+    }
+    m_pRawData->FreeData();
 }
 
-void VulkanImageSampler::copyBufferToImage()
+void VulkanImageSampler::RecordResidentMip(vk::CommandBuffer cmd, uint32_t residentMip)
 {
-    ZoneScopedN("VulkanImageSampler::copyBufferToImage");
-    VulkanCommandPool* cmdPool = m_vulkanDevice->GetPVulkanCmdPool();
-    vk::CommandBuffer cmd =
-    cmdPool->BeginSingleTimeCommand();
+    ZoneScopedN("VulkanImageSampler::RecordResidentMip");
+    assert(m_streamed && !m_pPendingResidency);
+    residentMip = std::min(residentMip, m_resourceConfig.miplevel - 1);
+    if (residentMip == m_residentMip)
     {
-        ZoneScopedN("VulkanImageSampler::copyBufferToImage:: cmd recording");
-        std::vector<vk::BufferImageCopy> regions;
-        for (uint32_t face = 0; face < m_pVulkanImageResource->GetConfig().arrayLayer; face++)
+        return;
+    }
+
+    std::unique_ptr<PendingResidency> pending(new PendingResidency());
+    pending->residentMip = residentMip;
+    pending->image.reset(new VulkanImageResource(m_vulkanDevice, m_memProps, getResidentConfig(m_resourceConfig, residentMip)));
+
+    std::vector<vk::BufferImageCopy> regions;
+    if (residentMip < m_residentMip)
+    {
+        pending->stagingBuffer = stageLevels(residentMip, m_residentMip, residentMip, pending->allocation, regions);
+        // staged, the payload goes once its last reader is done with it
+        m_pRawData->FreeData();
+    }
+
+    std::vector<vk::ImageCopy> copies;
+    for (uint32_t level = std::max(residentMip, m_residentMip); level < m_resourceConfig.miplevel; level++)
+    {
+        uint32_t width = std::max(m_resourceConfig.extent.width >> level, 1u);
+        uint32_t height = std::max(m_resourceConfig.extent.height >> level, 1u);
+        copies.emplace_back(vk::ImageCopy()
+                .setSrcSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level - m_residentMip, 0, m_resourceConfig.arrayLayer})
+                .setDstSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level - residentMip, 0, m_resourceConfig.arrayLayer})
+                .setExtent(vk::Extent3D{width, height, 1}));
+    }
+
+    // frames submitted before and after cmd sample the old image, it goes back to its layout after the copy.
+    // the barriers wait for the earlier work of the queue on the gpu
+    pending->image->TransitionImageLayout(cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+    m_pVulkanImageResource->TransitionImageLayout(cmd, m_config.imageLayout, vk::ImageLayout::eTransferSrcOptimal);
+    cmd.copyImage(m_pVulkanImageResource->GetVkImage(), vk::ImageLayout::eTransferSrcOptimal, pending->image->GetVkImage(), vk::ImageLayout::eTransferDstOptimal, copies);
+    m_pVulkanImageResource->TransitionImageLayout(cmd, vk::ImageLayout::eTransferSrcOptimal, m_config.imageLayout);
+    if (!regions.empty())
+    {
+        cmd.copyBufferToImage(pending->allocation.buffer, pending->image->GetVkImage(), vk::ImageLayout::eTransferDstOptimal, regions);
+    }
+    pending->image->TransitionImageLayout(cmd, vk::ImageLayout::eTransferDstOptimal, m_config.imageLayout);
+    m_pPendingResidency = std::move(pending);
+}
+
+std::shared_ptr<VulkanImageResource> VulkanImageSampler::ApplyResidentMip()
+{
+    ZoneScopedN("VulkanImageSampler::ApplyResidentMip");
+    assert(m_pPendingResidency);
+    std::shared_ptr<VulkanImageResource> oldImage = m_pVulkanImageResource;
+    m_pVulkanImageResource = m_pPendingResidency->image;
+    m_residentMip = m_pPendingResidency->residentMip;
+    CancelResidentMip();
+    return oldImage;
+}
+
+void VulkanImageSampler::CancelResidentMip()
+{
+    if (!m_pPendingResidency)
+    {
+        return;
+    }
+    if (m_pPendingResidency->allocation.IsValid() && !m_pPendingResidency->stagingBuffer)
+    {
+        m_vulkanDevice->GetPVulkanStagingRing()->Free(m_pPendingResidency->allocation);
+    }
+    m_pPendingResidency.reset();
+}
+
+VulkanImageResource::Config VulkanImageSampler::getResidentConfig(const VulkanImageResource::Config& config, uint32_t residentMip)
+{
+    VulkanImageResource::Config resident = config;
+    resident.extent.width = std::max(config.extent.width >> residentMip, 1u);
+    resident.extent.height = std::max(config.extent.height >> residentMip, 1u);
+    resident.miplevel = config.miplevel - residentMip;
+    resident.subresourceRange.setLevelCount(resident.miplevel);
+    return resident;
+}
+
+std::unique_ptr<VulkanBuffer> VulkanImageSampler::stageLevels(uint32_t firstLevel, uint32_t endLevel, uint32_t residentMip, VulkanStagingRing::Allocation& allocation, std::vector<vk::BufferImageCopy>& regions)
+{
+    ZoneScopedN("VulkanImageSampler::stageLevels");
+    // the whole payload is read in one go, straight from the file when it is not loaded yet.
+    // part of the chain is packed level by level out of the loaded payload instead
+    const uint32_t faceCount = m_resourceConfig.arrayLayer;
+    const bool wholePayload = firstLevel == 0 && endLevel == (uint32_t)m_pRawData->GetMipLevels();
+    auto alignOffset = [](vk::DeviceSize offset) { return (offset + 15) / 16 * 16; };
+    vk::DeviceSize size = 0;
+    if (wholePayload)
+    {
+        size = (vk::DeviceSize)m_pRawData->GetDataSize();
+    }
+    else
+    {
+        for (uint32_t level = firstLevel; level < endLevel; level++)
         {
-            for (uint32_t level = 0; level < m_pVulkanImageResource->GetConfig().miplevel; level++)
+            size = alignOffset(size) + (vk::DeviceSize)m_pRawData->GetLevelSize(level) * faceCount;
+        }
+    }
+
+    // the payload is read or copied straight into the shared staging ring, a dedicated buffer is only made for what does not fit
+    VulkanStagingRing* stagingRing = m_vulkanDevice->GetPVulkanStagingRing();
+    allocation = stagingRing->Allocate(size);
+    std::unique_ptr<VulkanBuffer> stagingBuffer;
+    if (!allocation.IsValid())
+    {
+        stagingBuffer.reset(
+            new VulkanBuffer
+            (
+                m_vulkanDevice, size,
+                vk::BufferUsageFlagBits::eTransferSrc,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                vk::SharingMode::eExclusive
+            )
+        );
+        allocation.buffer = *stagingBuffer->GetPVkBuf();
+        allocation.size = size;
+        allocation.pointer = static_cast<unsigned char*>(stagingBuffer->MappingBuffer(0, size));
+    }
+
+    bool read = false;
+    if (wholePayload)
+    {
+        read = m_pRawData->ReadData(allocation.pointer, size);
+    }
+    else if (Util::Texture::RawData::Payload payload = m_pRawData->AcquireData())
+    {
+        const unsigned char* data = payload.Get();
+        vk::DeviceSize packedOffset = 0;
+        for (uint32_t level = firstLevel; level < endLevel; level++)
+        {
+            packedOffset = alignOffset(packedOffset);
+            size_t faceSize = m_pRawData->GetLevelSize(level);
+            for (uint32_t face = 0; face < faceCount; face++)
             {
-                size_t offset = m_pRawData->GetLevelOffset(level, face);
-                uint32_t width = (uint32_t)m_pRawData->GetWidth() >> level;
-                uint32_t height = (uint32_t)m_pRawData->GetHeight() >> level;
-                auto region = vk::BufferImageCopy()
-                        .setBufferOffset(offset)
-                        .setImageExtent(vk::Extent3D{width, height, 1})
-                        .setImageSubresource(vk::ImageSubresourceLayers{
-                            vk::ImageAspectFlagBits::eColor,
-                            level,face,1
-                            })
-                        .setBufferImageHeight(0)
-                        .setBufferRowLength(0)
-                        .setImageOffset(vk::Offset3D{0,0,0})
-                        ;
-                regions.emplace_back(region);
+                std::memcpy(allocation.pointer + packedOffset + face * faceSize, data + m_pRawData->GetLevelOffset(level, face), faceSize);
             }
+            packedOffset += faceSize * faceCount;
         }
-        cmd.copyBufferToImage(*m_pVulkanStagingBuffer->GetPVkBuf(), m_pVulkanImageResource->GetVkImage(), vk::ImageLayout::eTransferDstOptimal, regions);
+        read = true;
     }
-    cmdPool->EndSingleTimeCommand(cmd, m_vulkanDevice->GetVkGraphicQueue());
+    if (!read)
+    {
+        if (!stagingBuffer)
+        {
+            stagingRing->Free(allocation);
+        }
+        throw std::runtime_error("read texture data for upload failed");
+    }
+
+    vk::DeviceSize packedOffset = 0;
+    regions.clear();
+    for (uint32_t level = firstLevel; level < endLevel; level++)
+    {
+        packedOffset = alignOffset(packedOffset);
+        size_t faceSize = wholePayload ? 0 : m_pRawData->GetLevelSize(level);
+        uint32_t width = std::max((uint32_t)m_pRawData->GetWidth() >> level, 1u);
+        uint32_t height = std::max((uint32_t)m_pRawData->GetHeight() >> level, 1u);
+        for (uint32_t face = 0; face < faceCount; face++)
+        {
+            vk::DeviceSize offset = allocation.offset + (wholePayload ? m_pRawData->GetLevelOffset(level, face) : packedOffset + face * faceSize);
+            auto region = vk::BufferImageCopy()
+                    .setBufferOffset(offset)
+                    .setImageExtent(vk::Extent3D{width, height, 1})
+                    .setImageSubresource(vk::ImageSubresourceLayers{
+                        vk::ImageAspectFlagBits::eColor,
+                        level - residentMip,face,1
+                        })
+                    .setBufferImageHeight(0)
+                    .setBufferRowLength(0)
+                    .setImageOffset(vk::Offset3D{0,0,0})
+                    ;
+            regions.emplace_back(region);
+        }
+        packedOffset += faceSize * faceCount;
+    }
+    return stagingBuffer;
 }
 
-void VulkanImageSampler::createStagingBuffer()
+void VulkanImageSampler::generateMipmaps()
 {
-    ZoneScopedN("VulkanImageSampler::createStagingBuffer");
-    m_pVulkanStagingBuffer.reset(
-        new VulkanBuffer
-        (
-            m_vulkanDevice, m_pRawData->GetDataSize(),
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            vk::SharingMode::eExclusive
-        )
-    );
-    m_pVulkanStagingBuffer->FillingBufferOneTime(m_pRawData->GetData(), 0, m_pRawData->GetDataSize());
-    // m_pRawData->FreeData();
+    ZoneScopedN("VulkanImageSampler::generateMipmaps");
+    VulkanImageResource::Config config = m_pVulkanImageResource->GetConfig();
+    uint32_t firstLevel = (uint32_t)m_pRawData->GetMipLevels();
+    vk::Image image = m_pVulkanImageResource->GetVkImage();
+
+    auto levelBarrier = [&](uint32_t level, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess)
+    {
+        return vk::ImageMemoryBarrier()
+                .setImage(image)
+                .setOldLayout(oldLayout)
+                .setNewLayout(newLayout)
+                .setSrcAccessMask(srcAccess)
+                .setDstAccessMask(dstAccess)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange(vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, level, 1, 0, config.arrayLayer});
+    };
+
+    VulkanCommandPool* cmdPool = m_vulkanDevice->GetPVulkanCmdPool();
+    vk::CommandBuffer cmd =
+    cmdPool->BeginSingleTimeCommand();
+    {
+        // every level is blitted from the one above it, which becomes a transfer source once it is written
+        std::vector<vk::ImageMemoryBarrier> toShaderRead;
+        for (uint32_t level = firstLevel; level < config.miplevel; level++)
+        {
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                levelBarrier(level - 1, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead));
+
+            int32_t srcWidth = (int32_t)std::max(config.extent.width >> (level - 1), 1u);
+            int32_t srcHeight = (int32_t)std::max(config.extent.height >> (level - 1), 1u);
+            int32_t dstWidth = (int32_t)std::max(config.extent.width >> level, 1u);
+            int32_t dstHeight = (int32_t)std::max(config.extent.height >> level, 1u);
+            auto blit = vk::ImageBlit()
+                    .setSrcSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level - 1, 0, config.arrayLayer})
+                    .setSrcOffsets({vk::Offset3D{0, 0, 0}, vk::Offset3D{srcWidth, srcHeight, 1}})
+                    .setDstSubresource(vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level, 0, config.arrayLayer})
+                    .setDstOffsets({vk::Offset3D{0, 0, 0}, vk::Offset3D{dstWidth, dstHeight, 1}});
+            cmd.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+            toShaderRead.emplace_back(levelBarrier(level - 1, vk::ImageLayout::eTransferSrcOptimal, m_config.imageLayout, vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead));
+        }
+        // the uploaded levels above the source of the first blit were never made a transfer source
+        for (uint32_t level = 0; level + 1 < firstLevel; level++)
+        {
+            toShaderRead.emplace_back(levelBarrier(level, vk::ImageLayout::eTransferDstOptimal, m_config.imageLayout, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
+        }
+        toShaderRead.emplace_back(levelBarrier(config.miplevel - 1, vk::ImageLayout::eTransferDstOptimal, m_config.imageLayout, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {}, toShaderRead);
+    }
+    cmdPool->EndSingleTimeCommand(cmd, m_vulkanDevice->GetVkGraphicQueue());
 }
 
-void VulkanImageSampler::createSampler()
+void VulkanImageSampler::copyBufferToImage(vk::Buffer buffer, const std::vector<vk::BufferImageCopy>& regions)
 {
-    ZoneScopedN("VulkanImageSampler::createSampler");
-    auto deviceProps = m_vulkanDevice->GetVulkanPhysicalDevice()->GetPhysicalDeviceInfo().deviceProps;
-
-    auto samplerInfo = vk::SamplerCreateInfo()
-                .setMagFilter(m_config.magFilter)
-                .setMinFilter(m_config.minFilter)
-                .setAddressModeU(m_config.uAddressMode)
-                .setAddressModeV(m_config.vAddressMode)
-                .setAddressModeW(m_config.wAddressMode)
-                .setAnisotropyEnable(m_config.anisotropyEnable)
-                .setMaxAnisotropy(deviceProps.limits.maxSamplerAnisotropy)
-                .setBorderColor(m_config.borderColor)
-                .setUnnormalizedCoordinates(m_config.unnormalizedCoordinates)
-                .setCompareEnable(m_config.compareEnable)
-                .setCompareOp(m_config.compareOp)
-                .setMipmapMode(m_config.mipmapMode)
-                .setMipLodBias(m_config.mipLodBias)
-                .setMinLod(m_config.minLod)
-                .setMaxLod(m_config.maxLod)
-                ;
-    m_vkSampler = m_vulkanDevice->GetVkDevice().createSampler(samplerInfo);
+    ZoneScopedN("VulkanImageSampler::copyBufferToImage");
+    VulkanCommandPool* cmdPool = m_vulkanDevice->GetPVulkanCmdPool();
+    vk::CommandBuffer cmd =
+    cmdPool->BeginSingleTimeCommand();
+    {
+        ZoneScopedN("VulkanImageSampler::copyBufferToImage:: cmd recording");
+        cmd.copyBufferToImage(buffer, m_pVulkanImageResource->GetVkImage(), vk::ImageLayout::eTransferDstOptimal, regions);
+    }
+    cmdPool->EndSingleTimeCommand(cmd, m_vulkanDevice->GetVkGraphicQueue());
 }
 
-
 std::shared_ptr<VulkanImageSampler> VulkanImageSampler::ConvertDevice(VulkanDevice* device)
 {
     ZoneScopedN("VulkanImageSampler::ConvertDevice");
+    // nothing streams the copy on the other device, it gets the whole chain
     std::shared_ptr<VulkanImageSampler> sampler(
-        new VulkanImageSampler(device, m_pRawData, m_memProps, m_config, m_pVulkanImageResource->m_native.config.value())
+        new VulkanImageSampler(device, m_pRawData, m_memProps, m_config, m_resourceConfig)
     );
     return sampler;
 }
\ No newline at end of file
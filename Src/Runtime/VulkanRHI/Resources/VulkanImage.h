@@ -1,5 +1,6 @@
 #pragma once
 #include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanStagingRing.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "Util/Textureutil.h"
 #include "vulkan/vulkan_enums.hpp"
@@ -34,6 +35,8 @@ public:
         vk::ImageCreateFlags        flags = {};
         uint32_t                    miplevel = 1;
         uint32_t                    arrayLayer = 1;
+        // narrowed textures read back as rgba through the view, see Util::Texture::getComponentMapping
+        vk::ComponentMapping        components = {};
 
         static Config CubeMap(uint32_t width, uint32_t height, uint32_t miplevels, uint32_t faceCount = 6);
     };
@@ -62,6 +65,7 @@ public:
     );
     ~VulkanImageResource();
     Config GetConfig() { return m_native.config.value(); }
+    inline vk::DeviceSize GetMemorySize() { return m_pVulkanDeviceMemory ? m_pVulkanDeviceMemory->GetSize() : 0; }
 public:
     void TransitionImageLayout(
         vk::ImageLayout oldLayout,
@@ -115,20 +119,36 @@ public:
 protected:
     VulkanDevice* m_vulkanDevice;
 
-    std::unique_ptr<VulkanImageResource> m_pVulkanImageResource;
-    std::unique_ptr<VulkanBuffer> m_pVulkanStagingBuffer;
+    // shared through the device's VulkanTextureRegistry when made from raw data
+    std::shared_ptr<VulkanImageResource> m_pVulkanImageResource;
+    // only the description is kept once uploaded, the payload is freed
     std::shared_ptr<Util::Texture::RawData> m_pRawData;
     Config m_config;
+    // the full chain, the image holds its levels from m_residentMip down
+    VulkanImageResource::Config m_resourceConfig;
+    uint32_t m_residentMip = 0;
+    bool m_streamed = false;
+    // a residency change recorded by RecordResidentMip, swapped in by ApplyResidentMip
+    struct PendingResidency
+    {
+        std::shared_ptr<VulkanImageResource> image;
+        uint32_t residentMip = 0;
+        VulkanStagingRing::Allocation allocation;
+        std::unique_ptr<VulkanBuffer> stagingBuffer;
+    };
+    std::unique_ptr<PendingResidency> m_pPendingResidency;
 
     vk::Sampler m_vkSampler;
     vk::MemoryPropertyFlags m_memProps;
 public:
+    // residentMip > 0 starts a streamed texture with only the coarser levels, see RecordResidentMip
     explicit VulkanImageSampler(
         VulkanDevice* device,
         std::shared_ptr<Util::Texture::RawData> rawData,
         vk::MemoryPropertyFlags memProps,
         Config config,
-        VulkanImageResource::Config resourceConfig
+        VulkanImageResource::Config resourceConfig,
+        uint32_t residentMip = 0
     );
     ~VulkanImageSampler();
     inline vk::ImageLayout GetImageLayout() { return m_config.imageLayout; }
@@ -139,11 +159,31 @@ public:
     void UploadImageToGPU();
     Config GetConfig() { return m_config; }
     std::shared_ptr<VulkanImageSampler> ConvertDevice(VulkanDevice* device);
-private:
 
-    void createStagingBuffer();
-    void createSampler();
-    void copyBufferToImage();
+    // level of the full chain that is level 0 of the image
+    inline uint32_t GetResidentMip() const { return m_residentMip; }
+    inline uint32_t GetMipLevels() const { return m_resourceConfig.miplevel; }
+    inline std::shared_ptr<Util::Texture::RawData> GetRawData() { return m_pRawData; }
+    // made with residentMip > 0 from 2d raw data carrying the whole chain, only those change their residency
+    inline bool IsStreamed() const { return m_streamed; }
+    // records into cmd the rebuild of the image with the levels from residentMip down. the levels both images hold are copied on the gpu,
+    // finer ones are uploaded from the raw data. the old image stays bound and sampleable until ApplyResidentMip.
+    // streamed textures without a pending change only, a no-op if residentMip is already resident
+    void RecordResidentMip(vk::CommandBuffer cmd, uint32_t residentMip);
+    inline bool HasPendingResidentMip() const { return m_pPendingResidency != nullptr; }
+    inline vk::DeviceSize GetPendingMemorySize() const { return m_pPendingResidency ? m_pPendingResidency->image->GetMemorySize() : 0; }
+    // once the recorded cmd completed, swaps the new image in and returns the old one, which frames in flight may still sample.
+    // the caller points its descriptor sets at the new view
+    std::shared_ptr<VulkanImageResource> ApplyResidentMip();
+    // drops a recorded change whose cmd completed or was never submitted
+    void CancelResidentMip();
+private:
+    static VulkanImageResource::Config getResidentConfig(const VulkanImageResource::Config& config, uint32_t residentMip);
+    // writes the raw levels [firstLevel, endLevel) of every face into staging memory, the regions target an image holding the levels from residentMip down.
+    // returns the dedicated buffer when the staging ring had no room
+    std::unique_ptr<VulkanBuffer> stageLevels(uint32_t firstLevel, uint32_t endLevel, uint32_t residentMip, VulkanStagingRing::Allocation& allocation, std::vector<vk::BufferImageCopy>& regions);
+    void copyBufferToImage(vk::Buffer buffer, const std::vector<vk::BufferImageCopy>& regions);
+    void generateMipmaps();
 };
 
 RHI_NAMESPACE_END
\ No newline at end of file
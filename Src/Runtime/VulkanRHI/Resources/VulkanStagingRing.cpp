@@ -0,0 +1,101 @@
+#include "VulkanStagingRing.h"
+#include "Runtime/VulkanRHI/Resources/VulkanBuffer.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_USING
+
+VulkanStagingRing::VulkanStagingRing(VulkanDevice* device, vk::DeviceSize capacity)
+    : m_vulkanDevice(device)
+    , m_capacity(capacity)
+{
+    ZoneScopedN("VulkanStagingRing::VulkanStagingRing");
+    m_pVulkanBuffer.reset(
+        new VulkanBuffer
+        (
+            m_vulkanDevice, m_capacity,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            vk::SharingMode::eExclusive
+        )
+    );
+    // mapped for the lifetime of the ring, freeing the memory unmaps it
+    m_mappedPointer = static_cast<unsigned char*>(m_pVulkanBuffer->MappingBuffer(0, m_capacity));
+}
+
+VulkanStagingRing::~VulkanStagingRing()
+{
+    ZoneScopedN("VulkanStagingRing::~VulkanStagingRing");
+    assert(m_ranges.empty());
+    m_pVulkanBuffer.reset();
+}
+
+VulkanStagingRing::Allocation VulkanStagingRing::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+    ZoneScopedN("VulkanStagingRing::Allocate");
+    assert(size > 0 && alignment > 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_ranges.empty())
+    {
+        m_head = 0;
+    }
+
+    // live space runs from the oldest range to the head, wrapping at the capacity
+    vk::DeviceSize offset = (m_head + alignment - 1) / alignment * alignment;
+    vk::DeviceSize limit = m_capacity;
+    if (!m_ranges.empty())
+    {
+        vk::DeviceSize tail = m_ranges.front().offset;
+        if (m_head <= tail)
+        {
+            limit = tail;
+        }
+        else if (offset + size > m_capacity)
+        {
+            offset = 0;
+            limit = tail;
+        }
+    }
+    if (offset + size > limit)
+    {
+        return Allocation{};
+    }
+
+    m_ranges.push_back(Range{ offset, offset + size, false });
+    m_head = offset + size;
+
+    Allocation allocation;
+    allocation.buffer = *m_pVulkanBuffer->GetPVkBuf();
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.pointer = m_mappedPointer + offset;
+    return allocation;
+}
+
+void VulkanStagingRing::Free(const Allocation& allocation)
+{
+    ZoneScopedN("VulkanStagingRing::Free");
+    if (!allocation.IsValid())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_ranges.begin(), m_ranges.end(), [&](const Range& range) { return range.offset == allocation.offset && !range.freed; });
+    assert(it != m_ranges.end());
+    if (it == m_ranges.end())
+    {
+        return;
+    }
+    it->freed = true;
+    // out of order frees only become reusable once everything older is freed too
+    while (!m_ranges.empty() && m_ranges.front().freed)
+    {
+        m_ranges.pop_front();
+    }
+}
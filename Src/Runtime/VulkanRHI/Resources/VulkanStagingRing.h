@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_BEGIN
+
+class VulkanDevice;
+class VulkanBuffer;
+// one persistently mapped host visible buffer shared by the uploads of a device.
+// callers write their payload straight through the returned pointer and free the allocation once the copy reading it completed
+class VulkanStagingRing
+{
+public:
+    struct Allocation
+    {
+        vk::Buffer buffer;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        unsigned char* pointer = nullptr;
+
+        inline bool IsValid() const { return pointer != nullptr; }
+    };
+private:
+    struct Range
+    {
+        vk::DeviceSize offset;
+        vk::DeviceSize end;
+        bool freed;
+    };
+
+    VulkanDevice* m_vulkanDevice;
+    std::unique_ptr<VulkanBuffer> m_pVulkanBuffer;
+    unsigned char* m_mappedPointer = nullptr;
+    vk::DeviceSize m_capacity;
+    vk::DeviceSize m_head = 0;
+    // live ranges in allocation order, space is reclaimed from the front once the oldest ones are freed
+    std::deque<Range> m_ranges;
+    std::mutex m_mutex;
+public:
+    static constexpr vk::DeviceSize DEFAULT_CAPACITY = 64ull << 20;
+
+    explicit VulkanStagingRing(VulkanDevice* device, vk::DeviceSize capacity = DEFAULT_CAPACITY);
+    ~VulkanStagingRing();
+
+    // invalid when size does not fit beside the live allocations, the caller falls back to a dedicated staging buffer then
+    Allocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+    void Free(const Allocation& allocation);
+    inline vk::DeviceSize GetCapacity() const { return m_capacity; }
+};
+
+RHI_NAMESPACE_END
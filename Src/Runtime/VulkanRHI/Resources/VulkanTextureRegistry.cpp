@@ -0,0 +1,138 @@
+#include "VulkanTextureRegistry.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Util/Fileutil.h"
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_USING
+
+VulkanTextureRegistry::VulkanTextureRegistry(VulkanDevice* device)
+    : m_vulkanDevice(device)
+{
+}
+
+VulkanTextureRegistry::~VulkanTextureRegistry()
+{
+    ZoneScopedN("VulkanTextureRegistry::~VulkanTextureRegistry");
+    for (auto& sampler : m_samplers)
+    {
+        m_vulkanDevice->GetVkDevice().destroySampler(sampler.second);
+    }
+    m_samplers.clear();
+    m_images.clear();
+}
+
+size_t VulkanTextureRegistry::KeyHash::operator()(const ImageKey& key) const
+{
+    return (size_t)Util::File::hashBytes(key.fields.data(), sizeof(key.fields), key.contentHash);
+}
+
+size_t VulkanTextureRegistry::KeyHash::operator()(const SamplerKey& key) const
+{
+    return (size_t)Util::File::hashBytes(key.fields.data(), sizeof(key.fields));
+}
+
+bool VulkanTextureRegistry::GetImageKey(Util::Texture::RawData& rawData, vk::MemoryPropertyFlags memProps, const VulkanImageResource::Config& config, vk::ImageLayout layout, ImageKey& key)
+{
+    key.contentHash = rawData.GetContentHash();
+    if (key.contentHash == 0)
+    {
+        return false;
+    }
+
+    key.fields = {
+        (uint32_t)rawData.GetDataSize(), (uint32_t)rawData.GetVkFormat(),
+        (uint32_t)(VkMemoryPropertyFlags)memProps, (uint32_t)layout,
+        config.extent.width, config.extent.height, config.extent.depth,
+        (uint32_t)config.format, config.miplevel, config.arrayLayer,
+        (uint32_t)(VkImageUsageFlags)config.imageUsage, (uint32_t)(VkImageCreateFlags)config.flags,
+        (uint32_t)config.imageType, (uint32_t)config.imageViewType, (uint32_t)config.imageTiling, (uint32_t)config.sampleCount,
+        config.subresourceRange.baseMipLevel, config.subresourceRange.levelCount,
+        config.subresourceRange.baseArrayLayer, config.subresourceRange.layerCount,
+        (uint32_t)config.components.r, (uint32_t)config.components.g, (uint32_t)config.components.b, (uint32_t)config.components.a
+    };
+    return true;
+}
+
+std::shared_ptr<VulkanImageResource> VulkanTextureRegistry::FindImage(const ImageKey& key)
+{
+    ZoneScopedN("VulkanTextureRegistry::FindImage");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_images.find(key);
+    return it != m_images.end() ? it->second.lock() : nullptr;
+}
+
+std::shared_ptr<VulkanImageResource> VulkanTextureRegistry::AddImage(const ImageKey& key, std::shared_ptr<VulkanImageResource> image)
+{
+    ZoneScopedN("VulkanTextureRegistry::AddImage");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // entries of released images are dropped here, there is nothing else to clean them up
+    for (auto it = m_images.begin(); it != m_images.end();)
+    {
+        it = it->second.expired() ? m_images.erase(it) : std::next(it);
+    }
+
+    auto& entry = m_images[key];
+    if (auto existing = entry.lock())
+    {
+        return existing;
+    }
+    entry = image;
+    return image;
+}
+
+vk::Sampler VulkanTextureRegistry::GetSampler(const VulkanImageSampler::Config& config)
+{
+    ZoneScopedN("VulkanTextureRegistry::GetSampler");
+    SamplerKey key = getSamplerKey(config);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_samplers.find(key);
+    if (it != m_samplers.end())
+    {
+        return it->second;
+    }
+
+    auto deviceProps = m_vulkanDevice->GetVulkanPhysicalDevice()->GetPhysicalDeviceInfo().deviceProps;
+    auto samplerInfo = vk::SamplerCreateInfo()
+                .setMagFilter(config.magFilter)
+                .setMinFilter(config.minFilter)
+                .setAddressModeU(config.uAddressMode)
+                .setAddressModeV(config.vAddressMode)
+                .setAddressModeW(config.wAddressMode)
+                .setAnisotropyEnable(config.anisotropyEnable)
+                .setMaxAnisotropy(deviceProps.limits.maxSamplerAnisotropy)
+                .setBorderColor(config.borderColor)
+                .setUnnormalizedCoordinates(config.unnormalizedCoordinates)
+                .setCompareEnable(config.compareEnable)
+                .setCompareOp(config.compareOp)
+                .setMipmapMode(config.mipmapMode)
+                .setMipLodBias(config.mipLodBias)
+                .setMinLod(config.minLod)
+                .setMaxLod(config.maxLod)
+                ;
+    vk::Sampler sampler = m_vulkanDevice->GetVkDevice().createSampler(samplerInfo);
+    m_samplers[key] = sampler;
+    return sampler;
+}
+
+VulkanTextureRegistry::SamplerKey VulkanTextureRegistry::getSamplerKey(const VulkanImageSampler::Config& config)
+{
+    // imageLayout belongs to the image, everything else is sampler state
+    SamplerKey key;
+    key.fields = {
+        (uint32_t)config.magFilter, (uint32_t)config.minFilter,
+        (uint32_t)config.uAddressMode, (uint32_t)config.vAddressMode, (uint32_t)config.wAddressMode,
+        (uint32_t)config.anisotropyEnable, (uint32_t)config.borderColor, (uint32_t)config.unnormalizedCoordinates,
+        (uint32_t)config.compareEnable, (uint32_t)config.compareOp, (uint32_t)config.mipmapMode,
+        0, 0, 0
+    };
+    std::memcpy(&key.fields[11], &config.mipLodBias, sizeof(float));
+    std::memcpy(&key.fields[12], &config.minLod, sizeof(float));
+    std::memcpy(&key.fields[13], &config.maxLod, sizeof(float));
+    return key;
+}
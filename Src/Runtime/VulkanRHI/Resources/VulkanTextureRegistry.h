@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Runtime/VulkanRHI/Resources/VulkanImage.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Util/Textureutil.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_BEGIN
+
+class VulkanDevice;
+// textures and samplers shared by everything on a device. VulkanImageSampler looks its image and sampler up here,
+// so the same texture loaded by several models, or twice by one, is uploaded once
+class VulkanTextureRegistry
+{
+public:
+    // the content hash of the raw data with every field that shapes the image made from it. the fields are compared on lookup,
+    // so only a collision of the content hash itself could match another texture
+    struct ImageKey
+    {
+        uint64_t contentHash = 0;
+        std::array<uint32_t, 24> fields {};
+        inline bool operator==(const ImageKey& other) const { return contentHash == other.contentHash && fields == other.fields; }
+    };
+    // every field of the sampler create info taken from the config, compared on lookup
+    struct SamplerKey
+    {
+        std::array<uint32_t, 14> fields {};
+        inline bool operator==(const SamplerKey& other) const { return fields == other.fields; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const ImageKey& key) const;
+        size_t operator()(const SamplerKey& key) const;
+    };
+private:
+    VulkanDevice* m_vulkanDevice;
+    // alive while a VulkanImageSampler holds them
+    std::unordered_map<ImageKey, std::weak_ptr<VulkanImageResource>, KeyHash> m_images;
+    // alive until the device is destroyed
+    std::unordered_map<SamplerKey, vk::Sampler, KeyHash> m_samplers;
+    std::mutex m_mutex;
+public:
+    explicit VulkanTextureRegistry(VulkanDevice* device);
+    ~VulkanTextureRegistry();
+
+    // false if rawData cannot be shared
+    static bool GetImageKey(Util::Texture::RawData& rawData, vk::MemoryPropertyFlags memProps, const VulkanImageResource::Config& config, vk::ImageLayout layout, ImageKey& key);
+    // nullptr if no live image has the key
+    std::shared_ptr<VulkanImageResource> FindImage(const ImageKey& key);
+    // an image uploaded under key, the first one added wins
+    std::shared_ptr<VulkanImageResource> AddImage(const ImageKey& key, std::shared_ptr<VulkanImageResource> image);
+
+    // created on first request, the caller must not destroy it
+    vk::Sampler GetSampler(const VulkanImageSampler::Config& config);
+private:
+    static SamplerKey getSamplerKey(const VulkanImageSampler::Config& config);
+};
+
+RHI_NAMESPACE_END
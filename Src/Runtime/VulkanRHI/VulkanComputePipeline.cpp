@@ -0,0 +1,63 @@
+#include "VulkanComputePipeline.h"
+#include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "Runtime/VulkanRHI/VulkanShaderSet.h"
+#include "vulkan/vulkan_enums.hpp"
+#include "vulkan/vulkan_structs.hpp"
+#include <memory>
+#include <stdexcept>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_USING
+
+VulkanComputePipeline::VulkanComputePipeline(
+    VulkanDevice* device,
+    std::shared_ptr<VulkanShaderSet> shaderset,
+    std::shared_ptr<VulkanPipelineLayout> pipelineLayout
+)
+    : m_vulkanDevice(device)
+    , m_vulkanShaderSet(shaderset)
+    , m_pVulkanPipelineLayout(pipelineLayout)
+{
+    ZoneScopedN("VulkanComputePipeline::VulkanComputePipeline");
+    auto shaderStages = m_vulkanShaderSet->GetShaderCreateInfos();
+    if (shaderStages.size() != 1 || shaderStages[0].stage != vk::ShaderStageFlagBits::eCompute)
+    {
+        throw std::runtime_error("compute pipeline needs exactly one compute shader");
+    }
+
+    auto createInfo = vk::ComputePipelineCreateInfo()
+                .setStage(shaderStages[0])
+                .setLayout(m_pVulkanPipelineLayout->GetVkPieplineLayout())
+                ;
+
+    auto result = m_vulkanDevice->GetVkDevice().createComputePipeline(nullptr, createInfo);
+    if (result.result != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("create compute pipeline failed");
+    }
+    m_vkPipeline = result.value;
+}
+
+VulkanComputePipeline::~VulkanComputePipeline()
+{
+    m_pVulkanPipelineLayout.reset();
+    m_vulkanShaderSet.reset();
+    m_vulkanDevice->GetVkDevice().destroyPipeline(m_vkPipeline);
+}
+
+void VulkanComputePipeline::Bind(vk::CommandBuffer cmd)
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_vkPipeline);
+}
+
+void VulkanComputePipeline::BindDescriptorSets(vk::CommandBuffer cmd, const std::vector<vk::DescriptorSet>& sets, uint32_t firstSet/* = 0 */)
+{
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, GetVkPipelineLayout(), firstSet, sets, {});
+}
+
+void VulkanComputePipeline::Dispatch(vk::CommandBuffer cmd, uint32_t groupCountX, uint32_t groupCountY/* = 1 */, uint32_t groupCountZ/* = 1 */)
+{
+    cmd.dispatch(groupCountX, groupCountY, groupCountZ);
+}
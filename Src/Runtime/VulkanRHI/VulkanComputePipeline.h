@@ -0,0 +1,42 @@
+#pragma once
+#include "Runtime/VulkanRHI/Layout/VulkanPipelineLayout.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include "vulkan/vulkan_handles.hpp"
+#include <memory>
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_BEGIN
+
+class VulkanShaderSet;
+class VulkanDevice;
+
+class VulkanComputePipeline
+{
+public:
+protected:
+    VulkanDevice* m_vulkanDevice = nullptr;
+
+    std::shared_ptr<VulkanShaderSet> m_vulkanShaderSet = nullptr;
+    std::shared_ptr<VulkanPipelineLayout> m_pVulkanPipelineLayout;
+
+    vk::Pipeline m_vkPipeline;
+public:
+    // shaderset must hold exactly one compute stage
+    explicit VulkanComputePipeline(
+        VulkanDevice* device,
+        std::shared_ptr<VulkanShaderSet> shaderset,
+        std::shared_ptr<VulkanPipelineLayout> pipelineLayout
+        );
+    ~VulkanComputePipeline();
+
+    void Bind(vk::CommandBuffer cmd);
+    void BindDescriptorSets(vk::CommandBuffer cmd, const std::vector<vk::DescriptorSet>& sets, uint32_t firstSet = 0);
+    void Dispatch(vk::CommandBuffer cmd, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+
+    inline std::shared_ptr<VulkanPipelineLayout> GetVulkanPipelineLayout() { return m_pVulkanPipelineLayout; }
+    inline vk::Pipeline& GetVkPipeline() { return m_vkPipeline; }
+    inline vk::PipelineLayout& GetVkPipelineLayout() { return m_pVulkanPipelineLayout->GetVkPieplineLayout(); }
+};
+
+RHI_NAMESPACE_END
@@ -7,6 +7,7 @@
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_handles.hpp"
 #include "vulkan/vulkan_structs.hpp"
+#include <algorithm>
 #include <stdint.h>
 #include <vulkan/vulkan.hpp>
 
@@ -88,12 +89,13 @@ VulkanDescriptorSets::VulkanDescriptorSets(
     assert(binding.size() == imageSamplers.size());
 
 
+    std::vector<vk::DescriptorSetLayout> layouts(descriptorNum, layout->GetVkDescriptorSetLayout());
     auto allocInfo = vk::DescriptorSetAllocateInfo()
                 .setDescriptorPool(descPool)
-                .setDescriptorSetCount(1)
-                .setSetLayouts(layout->GetVkDescriptorSetLayout());
+                .setDescriptorSetCount(descriptorNum)
+                .setSetLayouts(layouts);
     m_vkDescSets = m_vulkanDevice->GetVkDevice().allocateDescriptorSets(allocInfo);
-    assert(m_vkDescSets.size() == 1);
+    assert(m_vkDescSets.size() == descriptorNum);
 
 
     std::vector<vk::DescriptorImageInfo> imageInfo;
@@ -109,16 +111,19 @@ VulkanDescriptorSets::VulkanDescriptorSets(
                     .setSampler(*imageSamplers[i]->GetPVkSampler())
         );
     }
-    std::vector<vk::WriteDescriptorSet> writeDescs(imageInfo.size());
-    for (int i = 0; i < imageInfo.size(); i++)
+    std::vector<vk::WriteDescriptorSet> writeDescs;
+    for (vk::DescriptorSet& vkSet : m_vkDescSets)
     {
-        writeDescs[i]
-                    .setDstSet(m_vkDescSets[0])
-                    .setDstBinding(binding[i])
-                    .setDstArrayElement(0)
-                    .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-                    .setDescriptorCount(1)
-                    .setImageInfo(imageInfo[i]);
+        for (int i = 0; i < imageInfo.size(); i++)
+        {
+            writeDescs.emplace_back(vk::WriteDescriptorSet()
+                        .setDstSet(vkSet)
+                        .setDstBinding(binding[i])
+                        .setDstArrayElement(0)
+                        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                        .setDescriptorCount(1)
+                        .setImageInfo(imageInfo[i]));
+        }
     }
     m_vulkanDevice->GetVkDevice().updateDescriptorSets((uint32_t)writeDescs.size(), writeDescs.data(), 0, nullptr);
 }
@@ -160,11 +165,52 @@ void VulkanDescriptorSets::UpdateDescriptorSets(std::vector<vk::WriteDescriptorS
     m_vulkanDevice->GetVkDevice().updateDescriptorSets((uint32_t)writeDescs.size(), writeDescs.data(), 0, nullptr);
 }
 
+void VulkanDescriptorSets::UpdateImageSamplers(const std::vector<VulkanImageSampler*>& imageSamplers)
+{
+    ZoneScopedN("VulkanDescriptorSets::UpdateImageSamplers");
+    bool bound = false;
+    for (auto* imageSampler : imageSamplers)
+    {
+        bound = bound || std::find(m_pVulkanImageSamplers.begin(), m_pVulkanImageSamplers.end(), imageSampler) != m_pVulkanImageSamplers.end();
+    }
+    if (!bound)
+    {
+        return;
+    }
+    assert(m_vkDescSets.size() > 1);
+
+    // the next set still holds the views it had when it was current, all of them are written again
+    int nextSet = (m_currentSet + 1) % (int)m_vkDescSets.size();
+    std::vector<vk::DescriptorImageInfo> imageInfo(m_pVulkanImageSamplers.size());
+    std::vector<vk::WriteDescriptorSet> writeDescs;
+    for (int i = 0; i < m_pVulkanImageSamplers.size(); i++)
+    {
+        VulkanImageSampler* imageSampler = m_pVulkanImageSamplers[i];
+        if (!imageSampler)
+        {
+            continue;
+        }
+        imageInfo[i] = vk::DescriptorImageInfo()
+                    .setImageLayout(imageSampler->GetImageLayout())
+                    .setImageView(*imageSampler->GetPVkImageView())
+                    .setSampler(*imageSampler->GetPVkSampler());
+        writeDescs.emplace_back(vk::WriteDescriptorSet()
+                    .setDstSet(m_vkDescSets[nextSet])
+                    .setDstBinding(m_binding[i])
+                    .setDstArrayElement(0)
+                    .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                    .setDescriptorCount(1)
+                    .setImageInfo(imageInfo[i]));
+    }
+    m_vulkanDevice->GetVkDevice().updateDescriptorSets((uint32_t)writeDescs.size(), writeDescs.data(), 0, nullptr);
+    m_currentSet = nextSet;
+}
+
 
 void VulkanDescriptorSets::FillToBindedDescriptorSetsVector(std::vector<vk::DescriptorSet>& descList, VulkanPipelineLayout* pipelineLayout, int selfSetIndex)
 {
     ZoneScopedN("VulkanDescriptorSets::FillToBindedDescriptorSetsVector");
-    vk::DescriptorSet tobinding = m_vkDescSets[selfSetIndex];
+    vk::DescriptorSet tobinding = m_vkDescSets[selfSetIndex < 0 ? m_currentSet : selfSetIndex];
     int setId = pipelineLayout->GetDescriptorSetId(this);
     if (setId != -1)
     {
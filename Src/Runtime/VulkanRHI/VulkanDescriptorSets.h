@@ -23,6 +23,8 @@ private:
     std::vector<VulkanBuffer*> m_pVulkanUniformBuffers;
     std::vector<VulkanImageSampler*> m_pVulkanImageSamplers;
     std::vector<uint32_t> m_binding;
+    // the set bound by default, UpdateImageSamplers moves on to the next one
+    int m_currentSet = 0;
 
 public:
     explicit VulkanDescriptorSets(
@@ -60,8 +62,13 @@ public:
     inline uint32_t GetBinding(int idx) { return m_binding[idx]; }
 
     void UpdateDescriptorSets(std::vector<vk::WriteDescriptorSet>& writeDescs);
+    // after streamed textures changed their residency: when one of imageSamplers is bound, writes the current image views of all samplers
+    // into the next set and binds that one from then on. the next set must not be in use by a pending command buffer,
+    // so the sets are made with descriptorNum > 1 and switched no more often than the frames in flight complete
+    void UpdateImageSamplers(const std::vector<VulkanImageSampler*>& imageSamplers);
 
-    void FillToBindedDescriptorSetsVector(std::vector<vk::DescriptorSet>& descList, VulkanPipelineLayout* pipelineLayout, int selfSetIndex = 0);
+    // selfSetIndex -1 is the current set
+    void FillToBindedDescriptorSetsVector(std::vector<vk::DescriptorSet>& descList, VulkanPipelineLayout* pipelineLayout, int selfSetIndex = -1);
     void BindGraphicPipelinePoint(vk::CommandBuffer cmd, vk::PipelineLayout layout, const std::vector<int>& setIdx = {}, int firstIdx = 0);
 };
 
@@ -1,11 +1,14 @@
 #include "VulkanDevice.h"
 #include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanStagingRing.h"
+#include "Runtime/VulkanRHI/Resources/VulkanTextureRegistry.h"
 #include "Runtime/VulkanRHI/VulkanCommandPool.h"
 #include "Runtime/VulkanRHI/VulkanPipelineCache.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "Runtime/VulkanRHI/VulkanSwapchain.h"
 #include "Runtime/VulkanRHI/VulkanRenderPipeline.h"
 #include "Util/Fileutil.h"
+#include "Util/Textureutil.h"
 #include "vulkan/vulkan_enums.hpp"
 #include "vulkan/vulkan_structs.hpp"
 #include <GLFW/glfw3.h>
@@ -33,16 +36,19 @@ VulkanDevice::VulkanDevice(VulkanPhysicalDevice* physicalDevice) : m_vulkanPhysi
     std::vector<const char*> enableExtensions = m_vulkanPhysicalDevice->GetConfig().requiredExtensions;
     setUpQueueCreateInfos(createInfo, queueInfo);
     setUpExtensions(createInfo, enableExtensions);
-    if (m_vulkanPhysicalDevice->GetConfig().requiredFeatures)
-    {
-        createInfo.setPEnabledFeatures(&m_vulkanPhysicalDevice->GetConfig().requiredFeatures.value());
-    }
+    // bc is enabled whenever the device has it, cooked textures are transcoded to it
+    vk::PhysicalDeviceFeatures enabledFeatures = m_vulkanPhysicalDevice->GetConfig().requiredFeatures.value_or(vk::PhysicalDeviceFeatures());
+    enabledFeatures.setTextureCompressionBC(m_vulkanPhysicalDevice->GetVkPhysicalDevice().getFeatures().textureCompressionBC);
+    createInfo.setPEnabledFeatures(&enabledFeatures);
     m_vkDevice = m_vulkanPhysicalDevice->GetVkPhysicalDevice().createDevice(createInfo);
+    Util::Texture::setBlockCompressionSupported(enabledFeatures.textureCompressionBC == VK_TRUE);
 
     m_vkGraphicQueue = m_vkDevice.getQueue(m_queueFamilyIndices->graphic.value(), 0);
     m_vkPresentQueue = m_vkDevice.getQueue(m_queueFamilyIndices->present.value(), 0);
 
     m_pVulkanCmdPool.reset(new VulkanCommandPool(this, m_queueFamilyIndices->graphic.value()));
+    m_pVulkanStagingRing.reset(new VulkanStagingRing(this));
+    m_pVulkanTextureRegistry.reset(new VulkanTextureRegistry(this));
     m_pVulkanSwapchain.reset(new VulkanSwapchain(this));
     m_pVulkanPipelineCache.reset(new VulkanPipelineCache(this, m_vulkanPhysicalDevice->GetPhysicalDeviceInfo().deviceProps,
         Util::File::getResourcePath() / "PipelineCache\\pipelinecache.bin"));
@@ -63,6 +69,8 @@ VulkanDevice::~VulkanDevice()
     m_VulkanDescriptorSetLayoutPresets.UnInit();
     m_pVulkanPipelineCache.reset();
     m_pVulkanSwapchain.reset();
+    m_pVulkanTextureRegistry.reset();
+    m_pVulkanStagingRing.reset();
     m_pVulkanCmdPool.reset();
     m_vkDevice.destroy();
 }
@@ -106,6 +114,12 @@ void VulkanDevice::setUpExtensions(vk::DeviceCreateInfo& createInfo, std::vector
     {
         enableExtensions.emplace_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
     }
+    // texture streaming keeps its residency under the budget the driver reports
+    m_memoryBudgetSupported = m_vulkanPhysicalDevice->SupportExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memoryBudgetSupported)
+    {
+        enableExtensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     // swap chain
     auto it = std::find_if(enableExtensions.begin(), enableExtensions.end(), 
@@ -134,6 +148,29 @@ void VulkanDevice::setUpExtensions(vk::DeviceCreateInfo& createInfo, std::vector
 #endif
 }
 
+bool VulkanDevice::QueryDeviceLocalBudget(vk::DeviceSize& budget, vk::DeviceSize& usage)
+{
+    ZoneScopedN("VulkanDevice::QueryDeviceLocalBudget");
+    if (!m_memoryBudgetSupported)
+    {
+        return false;
+    }
+
+    auto chain = m_vulkanPhysicalDevice->GetVkPhysicalDevice().getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    const vk::PhysicalDeviceMemoryProperties& memoryProps = chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+    const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budgetProps = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    budget = 0;
+    usage = 0;
+    for (uint32_t heap = 0; heap < memoryProps.memoryHeapCount; heap++)
+    {
+        if (memoryProps.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+        {
+            budget += budgetProps.heapBudget[heap];
+            usage += budgetProps.heapUsage[heap];
+        }
+    }
+    return true;
+}
 
 std::vector<vk::SurfaceFormatKHR> VulkanDevice::GetSurfaceFormat()
 {
@@ -2,6 +2,7 @@
 
 #include "Runtime/VulkanRHI/Layout/VulkanDescriptorSetLayout.h"
 #include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
+#include "Runtime/VulkanRHI/Resources/VulkanStagingRing.h"
 #include "Runtime/VulkanRHI/VulkanCommandPool.h"
 #include "Runtime/VulkanRHI/VulkanPhysicalDevice.h"
 #include "Runtime/VulkanRHI/VulkanPipelineCache.h"
@@ -14,6 +15,7 @@
 RHI_NAMESPACE_BEGIN
 
 class VulkanRenderPipeline;
+class VulkanTextureRegistry;
 class VulkanDevice
 {
 
@@ -25,9 +27,12 @@ private:
     vk::Device m_vkDevice;
     vk::Queue m_vkGraphicQueue;
     vk::Queue m_vkPresentQueue;
+    bool m_memoryBudgetSupported = false;
 
     std::unique_ptr<VulkanSwapchain> m_pVulkanSwapchain;
     std::unique_ptr<VulkanCommandPool> m_pVulkanCmdPool;
+    std::unique_ptr<VulkanStagingRing> m_pVulkanStagingRing;
+    std::unique_ptr<VulkanTextureRegistry> m_pVulkanTextureRegistry;
     std::unique_ptr<VulkanPipelineCache> m_pVulkanPipelineCache;
     VulkanDescriptorSetLayoutPresets m_VulkanDescriptorSetLayoutPresets;
 
@@ -66,8 +71,12 @@ public:
     inline VulkanPhysicalDevice* GetVulkanPhysicalDevice() { return m_vulkanPhysicalDevice; }
     inline VulkanSwapchain* GetPVulkanSwapchain() { return m_pVulkanSwapchain.get(); }
     inline VulkanCommandPool* GetPVulkanCmdPool() { return m_pVulkanCmdPool.get(); }
+    inline VulkanStagingRing* GetPVulkanStagingRing() { return m_pVulkanStagingRing.get(); }
+    inline VulkanTextureRegistry* GetPVulkanTextureRegistry() { return m_pVulkanTextureRegistry.get(); }
     inline vk::Queue& GetVkGraphicQueue() { return m_vkGraphicQueue; }
     inline vk::Queue& GetVkPresentQueue() { return m_vkPresentQueue; }
+    // budget and usage of this process summed over the device local heaps, false without VK_EXT_memory_budget
+    bool QueryDeviceLocalBudget(vk::DeviceSize& budget, vk::DeviceSize& usage);
 private:
     void setUpQueueCreateInfos(vk::DeviceCreateInfo& createInfo, std::vector<vk::DeviceQueueCreateInfo>& queueInfo);
     void setUpExtensions(vk::DeviceCreateInfo& createInfo, std::vector<const char*>& enabledExtensions);
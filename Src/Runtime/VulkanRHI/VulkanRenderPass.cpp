@@ -84,6 +84,53 @@ VulkanRenderPassBuilder& VulkanRenderPassBuilder::SetDefaultSubpass()
     return *this;
 }
 
+VulkanRenderPassBuilder& VulkanRenderPassBuilder::AddSubpass(const std::vector<uint32_t>& colorAttachmentIds, const std::vector<uint32_t>& inputAttachmentIds, int depthStencilAttachmentId)
+{
+    assert(!m_attachments.empty());
+
+    auto& refs = m_subpassReferences.emplace_back();
+    for (uint32_t id : colorAttachmentIds)
+    {
+        assert(id < m_attachments.size() && m_attachments[id].type == VulkanFramebuffer::kColor);
+        refs.color.push_back(vk::AttachmentReference{id, vk::ImageLayout::eColorAttachmentOptimal});
+    }
+    for (uint32_t id : inputAttachmentIds)
+    {
+        assert(id < m_attachments.size());
+        vk::ImageLayout layout = m_attachments[id].type == VulkanFramebuffer::kDepthStencil
+                                    ? vk::ImageLayout::eDepthStencilReadOnlyOptimal
+                                    : vk::ImageLayout::eShaderReadOnlyOptimal;
+        refs.input.push_back(vk::AttachmentReference{id, layout});
+    }
+
+    vk::SubpassDescription subpass;
+    subpass
+        .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+        .setColorAttachments(refs.color)
+        .setInputAttachments(refs.input)
+        ;
+    if (depthStencilAttachmentId >= 0)
+    {
+        assert(depthStencilAttachmentId < m_attachments.size() && m_attachments[depthStencilAttachmentId].type == VulkanFramebuffer::kDepthStencil);
+        refs.depthStencil = vk::AttachmentReference{(uint32_t)depthStencilAttachmentId, vk::ImageLayout::eDepthStencilAttachmentOptimal};
+        subpass.setPDepthStencilAttachment(&refs.depthStencil);
+    }
+
+    return AddSubpass(subpass);
+}
+
+VulkanRenderPassBuilder& VulkanRenderPassBuilder::AddSubpassInputDependency(uint32_t srcSubpass, uint32_t dstSubpass)
+{
+    return AddSubpassDependency(vk::SubpassDependency()
+                .setSrcSubpass(srcSubpass)
+                .setDstSubpass(dstSubpass)
+                .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+                .setDstStageMask(vk::PipelineStageFlagBits::eFragmentShader)
+                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eInputAttachmentRead)
+                .setDependencyFlags(vk::DependencyFlagBits::eByRegion));
+}
+
 VulkanRenderPassBuilder& VulkanRenderPassBuilder::SetDefaultSubpassDependencies()
 {
     m_dependencies.resize(2);
@@ -221,6 +268,11 @@ void VulkanRenderPass::Begin(vk::CommandBuffer cmd, const std::vector<vk::ClearV
     cmd.beginRenderPass(renderpassBeginInfo , contents);
 }
 
+void VulkanRenderPass::NextSubpass(vk::CommandBuffer cmd, vk::SubpassContents contents)
+{
+    cmd.nextSubpass(contents);
+}
+
 void VulkanRenderPass::End(vk::CommandBuffer cmd)
 {
     cmd.endRenderPass();
@@ -2,6 +2,7 @@
 #include "Runtime/VulkanRHI/Resources/VulkanFramebuffer.h"
 #include "Runtime/VulkanRHI/VulkanRHI.h"
 #include "vulkan/vulkan_structs.hpp"
+#include <list>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
@@ -33,6 +34,7 @@ public:
     ~VulkanRenderPass();
 
     void Begin(vk::CommandBuffer cmd, const std::vector<vk::ClearValue>& clearValues, const vk::Rect2D& renderArea, vk::Framebuffer frameBuffer, vk::SubpassContents contents = {});
+    void NextSubpass(vk::CommandBuffer cmd, vk::SubpassContents contents = vk::SubpassContents::eInline);
     void End(vk::CommandBuffer cmd);
 
     void BindGraphicPipeline(vk::CommandBuffer cmd, const std::string& name);
@@ -51,9 +53,20 @@ public:
     VulkanRenderPassBuilder& SetDefaultSubpass();
     VulkanRenderPassBuilder& SetDefaultSubpassDependencies();
     inline VulkanRenderPassBuilder& AddSubpass(vk::SubpassDescription subpass) { m_subpasses.push_back(subpass); return *this; }
+    // attachment ids index into SetAttachments(), depthStencilAttachmentId < 0 means no depth
+    VulkanRenderPassBuilder& AddSubpass(const std::vector<uint32_t>& colorAttachmentIds, const std::vector<uint32_t>& inputAttachmentIds = {}, int depthStencilAttachmentId = -1);
     inline VulkanRenderPassBuilder& AddSubpassDependency(vk::SubpassDependency dep) { m_dependencies.push_back(dep); return *this; }
+    // attachment writes of srcSubpass -> input attachment reads of dstSubpass
+    VulkanRenderPassBuilder& AddSubpassInputDependency(uint32_t srcSubpass, uint32_t dstSubpass);
 
     std::unique_ptr<VulkanRenderPass> buildUnique();
+private:
+    struct SubpassAttachmentReferences
+    {
+        std::vector<vk::AttachmentReference> color;
+        std::vector<vk::AttachmentReference> input;
+        vk::AttachmentReference depthStencil;
+    };
 private:
     VulkanDevice* m_pDevice;
     std::vector<VulkanFramebuffer::Attachment> m_attachments;
@@ -63,5 +76,7 @@ private:
     std::vector<vk::AttachmentReference> m_vkColorAttachments;
     std::vector<vk::AttachmentReference> m_vkDepthStencilAttachments;
     std::vector<vk::AttachmentReference> m_vkResolveAttachments;
+    // list keeps the references alive & address stable for every added subpass
+    std::list<SubpassAttachmentReferences> m_subpassReferences;
 };
 RHI_NAMESPACE_END
\ No newline at end of file
@@ -72,7 +72,8 @@ VulkanRenderPipeline* VulkanRenderPipelineBuilder::build()
         m_VulkanMultisampleState,
         m_VulkanDepthStencilState,
         m_VulkanColorBlendState,
-        m_VulkanPipelineLayout
+        m_VulkanPipelineLayout,
+        m_Subpass
     );
 }
 
@@ -102,7 +103,8 @@ VulkanRenderPipeline::VulkanRenderPipeline(
     std::shared_ptr<VulkanMultisampleState> multisampleState,
     std::shared_ptr<VulkanDepthStencilState> depthStencilState,
     std::shared_ptr<VulkanColorBlendState> blendState,
-    std::shared_ptr<VulkanPipelineLayout> pipelineLayout
+    std::shared_ptr<VulkanPipelineLayout> pipelineLayout,
+    uint32_t subpass
 )
     : m_vulkanDevice(device)
     , m_vulkanShaderSet(shaderset)
@@ -117,6 +119,7 @@ VulkanRenderPipeline::VulkanRenderPipeline(
     , m_pVulkanDepthStencilState(depthStencilState)
     , m_pVulkanColorBlendState(blendState)
     , m_pVulkanPipelineLayout(pipelineLayout)
+    , m_subpass(subpass)
 {
     if (!shaderset && m_parent)
     {
@@ -153,7 +156,8 @@ VulkanRenderPipeline::VulkanRenderPipeline(
                 // layout
                 .setLayout(m_pVulkanPipelineLayout->GetVkPieplineLayout())
                 // render pass
-                .setRenderPass(m_pVulkanRenderPass->GetVkRenderPass());
+                .setRenderPass(m_pVulkanRenderPass->GetVkRenderPass())
+                .setSubpass(m_subpass);
     if (m_parent)
     {
         createInfo.setFlags(vk::PipelineCreateFlagBits::eDerivative)
@@ -42,6 +42,7 @@ protected:
     std::shared_ptr<VulkanColorBlendState> m_pVulkanColorBlendState;
 
     std::shared_ptr<VulkanPipelineLayout> m_pVulkanPipelineLayout;
+    uint32_t m_subpass = 0;
 
     vk::Pipeline m_vkPipeline;
 
@@ -60,7 +61,8 @@ public:
         std::shared_ptr<VulkanMultisampleState> multisampleState= nullptr,
         std::shared_ptr<VulkanDepthStencilState> depthStencilState= nullptr,
         std::shared_ptr<VulkanColorBlendState> blendState= nullptr,
-        std::shared_ptr<VulkanPipelineLayout> pipelineLayout = nullptr
+        std::shared_ptr<VulkanPipelineLayout> pipelineLayout = nullptr,
+        uint32_t subpass = 0
         );
     ~VulkanRenderPipeline();
 
@@ -68,6 +70,7 @@ public:
     inline VulkanDynamicState* GetPVulkanDynamicState() { return m_pVulkanDynamicState.get(); }
     inline VulkanDevice* GetPVulkanDevice() { return m_vulkanDevice; }
     inline VulkanRenderPass* GetVulkanRenderPass() { return m_pVulkanRenderPass; }
+    inline uint32_t GetSubpass() { return m_subpass; }
     inline vk::Pipeline& GetVkPipeline() { return m_vkPipeline; }
     inline vk::RenderPass& GetVkRenderPass() { return m_pVulkanRenderPass->GetVkRenderPass(); }
     inline vk::PipelineLayout& GetVkPipelineLayout() { return m_pVulkanPipelineLayout->GetVkPieplineLayout(); }
@@ -95,6 +98,7 @@ protected:
     BUILDER_SHARED_PTR_SET_FUNC(VulkanRenderPipelineBuilder, VulkanColorBlendState, VulkanColorBlendState)
 
     BUILDER_SHARED_PTR_SET_FUNC(VulkanRenderPipelineBuilder, VulkanPipelineLayout, VulkanPipelineLayout)
+    BUILDER_SET_FUNC(VulkanRenderPipelineBuilder, uint32_t, Subpass, 0)
 
 public:
 
@@ -0,0 +1,67 @@
+#include "VulkanTimestampQuery.h"
+#include "Runtime/VulkanRHI/VulkanDevice.h"
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include <array>
+
+RHI_NAMESPACE_USING
+
+VulkanTimestampQuery::VulkanTimestampQuery(VulkanDevice* device, uint32_t queryCount)
+    : m_pVulkanDevice(device)
+    , m_written(queryCount, false)
+{
+    ZoneScopedN("VulkanTimestampQuery::VulkanTimestampQuery");
+    m_timestampPeriod = m_pVulkanDevice->GetVulkanPhysicalDevice()->GetPhysicalDeviceInfo().deviceProps.limits.timestampPeriod;
+    auto createInfo = vk::QueryPoolCreateInfo()
+                .setQueryType(vk::QueryType::eTimestamp)
+                .setQueryCount(queryCount);
+    m_vkQueryPool = m_pVulkanDevice->GetVkDevice().createQueryPool(createInfo);
+}
+
+VulkanTimestampQuery::~VulkanTimestampQuery()
+{
+    m_pVulkanDevice->GetVkDevice().destroyQueryPool(m_vkQueryPool);
+    m_vkQueryPool = nullptr;
+}
+
+void VulkanTimestampQuery::Reset(vk::CommandBuffer cmd, uint32_t firstQuery, uint32_t queryCount)
+{
+    assert(firstQuery + queryCount <= m_written.size());
+    cmd.resetQueryPool(m_vkQueryPool, firstQuery, queryCount);
+    for (uint32_t i = firstQuery; i < firstQuery + queryCount; i++)
+    {
+        m_written[i] = false;
+    }
+}
+
+void VulkanTimestampQuery::Write(vk::CommandBuffer cmd, uint32_t query, vk::PipelineStageFlagBits stage)
+{
+    assert(query < m_written.size());
+    cmd.writeTimestamp(stage, m_vkQueryPool, query);
+    m_written[query] = true;
+}
+
+bool VulkanTimestampQuery::GetElapsedMs(uint32_t beginQuery, uint32_t endQuery, double& ms)
+{
+    assert(beginQuery < endQuery && endQuery < m_written.size());
+    if (!m_written[beginQuery] || !m_written[endQuery])
+    {
+        return false;
+    }
+
+    std::array<uint64_t, 2> timestamps;
+    vk::Result res = m_pVulkanDevice->GetVkDevice().getQueryPoolResults(
+                m_vkQueryPool, beginQuery, 1, sizeof(uint64_t), &timestamps[0], sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (res != vk::Result::eSuccess)
+    {
+        return false;
+    }
+    res = m_pVulkanDevice->GetVkDevice().getQueryPoolResults(
+                m_vkQueryPool, endQuery, 1, sizeof(uint64_t), &timestamps[1], sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (res != vk::Result::eSuccess)
+    {
+        return false;
+    }
+
+    ms = (double)(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1e6;
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Runtime/VulkanRHI/VulkanRHI.h"
+#include <stdint.h>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+RHI_NAMESPACE_BEGIN
+
+class VulkanDevice;
+class VulkanTimestampQuery
+{
+public:
+private:
+    VulkanDevice* m_pVulkanDevice = nullptr;
+    vk::QueryPool m_vkQueryPool;
+    float m_timestampPeriod = 1.0f;
+    std::vector<bool> m_written;
+public:
+    explicit VulkanTimestampQuery(VulkanDevice* device, uint32_t queryCount);
+    ~VulkanTimestampQuery();
+
+    void Reset(vk::CommandBuffer cmd, uint32_t firstQuery, uint32_t queryCount);
+    void Write(vk::CommandBuffer cmd, uint32_t query, vk::PipelineStageFlagBits stage = vk::PipelineStageFlagBits::eBottomOfPipe);
+    // non blocking, false if the queries are not written or not finished on gpu yet
+    bool GetElapsedMs(uint32_t beginQuery, uint32_t endQuery, double& ms);
+};
+
+RHI_NAMESPACE_END
@@ -0,0 +1,490 @@
+#include "Meshutil.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <iomanip>
+#include <meshoptimizer.h>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace Util {
+
+namespace {
+
+// the fifo size meshoptimizer models a generic gpu with
+constexpr uint32_t ANALYZE_CACHE_SIZE = 16;
+
+// a lod is kept only if it drops at least this share of the previous lod's triangles
+constexpr float LOD_MIN_REDUCTION = 0.25f;
+constexpr size_t LOD_MIN_INDEX_COUNT = 3 * 8;
+
+// floats from VertexData::texCoord on: uv, unused zw, normal xyz
+constexpr size_t LOD_ATTRIBUTE_COUNT = 7;
+constexpr float LOD_ATTRIBUTE_WEIGHTS[LOD_ATTRIBUTE_COUNT] = { 1.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.5f };
+static_assert(offsetof(Model::VertexData, normal) - offsetof(Model::VertexData, texCoord) == 4 * sizeof(float), "lod attributes expect the normal right after the texcoord");
+
+constexpr float UNORM16_MAX = 65535.0f;
+
+// unit vector to the octahedron unfolded onto [-1, 1]^2, a zero vector maps to +z
+glm::vec2 octEncode(const glm::vec3& v)
+{
+    float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (l1 == 0.0f)
+    {
+        return glm::vec2(0.0f);
+    }
+    glm::vec3 n = v / l1;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+// same as octDecode in mrt.packed.vert
+glm::vec3 octDecode(const glm::vec2& p)
+{
+    glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// vulkan snorm decoding, the most negative value clamps to -1
+float snorm8(int8_t v) { return std::max(v / 127.0f, -1.0f); }
+float snorm16(int16_t v) { return std::max(v / 32767.0f, -1.0f); }
+
+template<typename T>
+void encodeAttributes(const Model::VertexData& vertex, T& out)
+{
+    out.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+    out.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+
+    glm::vec3 normal = glm::vec3(vertex.normal);
+    glm::vec3 tangent = glm::vec3(vertex.tangent);
+    glm::vec2 n = octEncode(normal);
+    glm::vec2 t = octEncode(tangent);
+    out.normal[0] = (int16_t)glm::packSnorm1x16(n.x);
+    out.normal[1] = (int16_t)glm::packSnorm1x16(n.y);
+    out.tangent[0] = (int8_t)glm::packSnorm1x8(t.x);
+    out.tangent[1] = (int8_t)glm::packSnorm1x8(t.y);
+    // handedness of the tbn, the bitangent itself is not stored
+    out.tangent[2] = glm::dot(glm::cross(normal, tangent), glm::vec3(vertex.bitangent)) < 0.0f ? -127 : 127;
+    out.tangent[3] = 0;
+}
+
+template<typename T>
+void decodeAttributes(const T& in, Model::VertexData& vertex)
+{
+    vertex.texCoord = glm::vec4(glm::unpackHalf1x16(in.texCoord[0]), glm::unpackHalf1x16(in.texCoord[1]), 0.0f, 0.0f);
+    glm::vec3 normal = octDecode(glm::vec2(snorm16(in.normal[0]), snorm16(in.normal[1])));
+    glm::vec3 tangent = octDecode(glm::vec2(snorm8(in.tangent[0]), snorm8(in.tangent[1])));
+    vertex.normal = glm::vec4(normal, 0.0f);
+    vertex.tangent = glm::vec4(tangent, 0.0f);
+    vertex.bitangent = glm::vec4(glm::cross(normal, tangent) * snorm8(in.tangent[2]), 0.0f);
+}
+
+}
+
+Model::MeshStats& Model::MeshStats::operator+=(const MeshStats& r)
+{
+    triangleCount += r.triangleCount;
+    vertexCount += r.vertexCount;
+    verticesTransformed += r.verticesTransformed;
+    pixelsCovered += r.pixelsCovered;
+    pixelsShaded += r.pixelsShaded;
+    bytesFetched += r.bytesFetched;
+    vertexBytes += r.vertexBytes;
+    return *this;
+}
+
+std::string Model::MeshStats::ToString() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3)
+       << "acmr " << GetAcmr() << ", atvr " << GetAtvr() << ", overdraw " << GetOverdraw() << ", overfetch " << GetOverfetch();
+    return ss.str();
+}
+
+Model::MeshStats Model::analyzeMesh(const MeshData& meshData)
+{
+    MeshStats stats;
+    if (meshData.indices.size() % 3 != 0 || meshData.vertices.empty())
+    {
+        return stats;
+    }
+
+    const uint32_t* indices = meshData.indices.data();
+    size_t indexCount = meshData.indices.size();
+    size_t vertexCount = meshData.vertices.size();
+
+    auto cache = meshopt_analyzeVertexCache(indices, indexCount, vertexCount, ANALYZE_CACHE_SIZE, 0, 0);
+    auto overdraw = meshopt_analyzeOverdraw(indices, indexCount, &meshData.vertices[0].position.x, vertexCount, sizeof(VertexData));
+    auto fetch = meshopt_analyzeVertexFetch(indices, indexCount, vertexCount, sizeof(VertexData));
+
+    stats.triangleCount = indexCount / 3;
+    stats.vertexCount = vertexCount;
+    stats.verticesTransformed = cache.vertices_transformed;
+    stats.pixelsCovered = overdraw.pixels_covered;
+    stats.pixelsShaded = overdraw.pixels_shaded;
+    stats.bytesFetched = fetch.bytes_fetched;
+    stats.vertexBytes = vertexCount * sizeof(VertexData);
+    return stats;
+}
+
+void Model::optimizeMesh(MeshData& meshData)
+{
+    if (meshData.indices.size() % 3 != 0 || meshData.vertices.empty())
+    {
+        return;
+    }
+
+    size_t indexCount = meshData.indices.size();
+    std::vector<uint32_t> cacheOrder(indexCount);
+    meshopt_optimizeVertexCache(cacheOrder.data(), meshData.indices.data(), indexCount, meshData.vertices.size());
+    meshopt_optimizeOverdraw(
+        meshData.indices.data(), cacheOrder.data(), indexCount,
+        &meshData.vertices[0].position.x, meshData.vertices.size(), sizeof(VertexData), OVERDRAW_THRESHOLD
+    );
+
+    // in place, meshoptimizer copies the source when both pointers are the same
+    size_t vertexCount = meshopt_optimizeVertexFetch(
+        meshData.vertices.data(), meshData.indices.data(), indexCount,
+        meshData.vertices.data(), meshData.vertices.size(), sizeof(VertexData)
+    );
+    meshData.vertices.resize(vertexCount);
+    meshData.ComputeBounds();
+}
+
+void Model::generateLods(MeshData& meshData)
+{
+    meshData.lods.clear();
+    if (meshData.indices.size() % 3 != 0 || meshData.vertices.empty())
+    {
+        return;
+    }
+
+    const size_t baseIndexCount = meshData.indices.size();
+    const float* positions = &meshData.vertices[0].position.x;
+    const float* attributes = &meshData.vertices[0].texCoord.x;
+    const size_t vertexCount = meshData.vertices.size();
+    const float errorScale = meshopt_simplifyScale(positions, vertexCount, sizeof(VertexData));
+
+    meshData.lods.push_back(MeshLod{ 0, (uint32_t)baseIndexCount, 0.0f });
+    std::vector<uint32_t> lodIndices(baseIndexCount);
+    size_t targetIndexCount = baseIndexCount;
+    while (meshData.lods.size() < MAX_LOD_COUNT)
+    {
+        const size_t prevIndexCount = meshData.lods.back().indexCount;
+        targetIndexCount = targetIndexCount / 2 / 3 * 3;
+        if (targetIndexCount < LOD_MIN_INDEX_COUNT)
+        {
+            break;
+        }
+
+        // always from lod 0, so the error is measured against the source
+        float error = 0.0f;
+        size_t indexCount = meshopt_simplifyWithAttributes(
+            lodIndices.data(), meshData.indices.data(), baseIndexCount,
+            positions, vertexCount, sizeof(VertexData),
+            attributes, sizeof(VertexData), LOD_ATTRIBUTE_WEIGHTS, LOD_ATTRIBUTE_COUNT, nullptr,
+            targetIndexCount, LOD_MAX_ERROR, 0, &error
+        );
+        if (indexCount == 0 || indexCount > prevIndexCount * (1.0f - LOD_MIN_REDUCTION))
+        {
+            break;
+        }
+
+        meshopt_optimizeVertexCache(lodIndices.data(), lodIndices.data(), indexCount, vertexCount);
+        meshData.lods.push_back(MeshLod{ (uint32_t)meshData.indices.size(), (uint32_t)indexCount, error * errorScale });
+        meshData.indices.insert(meshData.indices.end(), lodIndices.begin(), lodIndices.begin() + indexCount);
+        targetIndexCount = indexCount;
+    }
+
+    if (meshData.lods.size() == 1)
+    {
+        meshData.lods.clear();
+    }
+}
+
+void Model::buildMeshlets(MeshData& meshData)
+{
+    meshData.meshlets.clear();
+    const size_t indexCount = meshData.GetLod(0).indexCount;
+    if (indexCount == 0 || indexCount % 3 != 0 || meshData.vertices.empty())
+    {
+        return;
+    }
+
+    const float* positions = &meshData.vertices[0].position.x;
+    const size_t vertexCount = meshData.vertices.size();
+    size_t maxMeshlets = meshopt_buildMeshletsBound(indexCount, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+    std::vector<meshopt_Meshlet> meshlets(maxMeshlets);
+    std::vector<uint32_t> meshletVertices(maxMeshlets * MESHLET_MAX_VERTICES);
+    std::vector<uint8_t> meshletTriangles(maxMeshlets * MESHLET_MAX_TRIANGLES * 3);
+    size_t meshletCount = meshopt_buildMeshlets(
+        meshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+        meshData.indices.data(), indexCount, positions, vertexCount, sizeof(VertexData),
+        MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, MESHLET_CONE_WEIGHT
+    );
+
+    // the local triangles index the meshlet vertex list, written back as mesh vertex indices
+    meshData.meshlets.reserve(meshletCount);
+    uint32_t indexOffset = 0;
+    for (size_t i = 0; i < meshletCount; i++)
+    {
+        const meshopt_Meshlet& src = meshlets[i];
+        const uint32_t* localVertices = &meshletVertices[src.vertex_offset];
+        const uint8_t* localTriangles = &meshletTriangles[src.triangle_offset];
+        meshopt_Bounds bounds = meshopt_computeMeshletBounds(localVertices, localTriangles, src.triangle_count, positions, vertexCount, sizeof(VertexData));
+
+        Meshlet meshlet{};
+        meshlet.sphere = glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius);
+        meshlet.coneApex = glm::vec4(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2], 0.0f);
+        meshlet.coneAxisCutoff = glm::vec4(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2], bounds.cone_cutoff);
+        meshlet.indexOffset = indexOffset;
+        meshlet.triangleCount = src.triangle_count;
+        for (uint32_t j = 0; j < src.triangle_count * 3; j++)
+        {
+            meshData.indices[indexOffset + j] = localVertices[localTriangles[j]];
+        }
+        indexOffset += src.triangle_count * 3;
+        meshData.meshlets.push_back(meshlet);
+    }
+    assert(indexOffset == indexCount);
+}
+
+bool Model::validateMeshlets(const MeshData& meshData, std::string* error)
+{
+    auto fail = [error](const std::string& msg)
+    {
+        if (error)
+        {
+            *error = msg;
+        }
+        return false;
+    };
+
+    uint32_t expectedOffset = 0;
+    for (size_t i = 0; i < meshData.meshlets.size(); i++)
+    {
+        const Meshlet& meshlet = meshData.meshlets[i];
+        if (meshlet.indexOffset != expectedOffset)
+        {
+            return fail("meshlet " + std::to_string(i) + " does not continue the previous one");
+        }
+        if (meshlet.triangleCount == 0 || meshlet.triangleCount > MESHLET_MAX_TRIANGLES)
+        {
+            return fail("meshlet " + std::to_string(i) + " has " + std::to_string(meshlet.triangleCount) + " triangles");
+        }
+        if ((size_t)meshlet.indexOffset + meshlet.triangleCount * 3 > meshData.indices.size())
+        {
+            return fail("meshlet " + std::to_string(i) + " runs past the index buffer");
+        }
+
+        std::set<uint32_t> vertices;
+        glm::vec3 center = glm::vec3(meshlet.sphere);
+        // meshoptimizer stores the radius as a float, allow for its rounding
+        float radius = meshlet.sphere.w * 1.001f + 1e-5f;
+        for (uint32_t j = 0; j < meshlet.triangleCount * 3; j++)
+        {
+            uint32_t vertex = meshData.indices[meshlet.indexOffset + j];
+            if (vertex >= meshData.vertices.size())
+            {
+                return fail("meshlet " + std::to_string(i) + " references vertex " + std::to_string(vertex));
+            }
+            if (glm::length(glm::vec3(meshData.vertices[vertex].position) - center) > radius)
+            {
+                return fail("meshlet " + std::to_string(i) + " sphere misses vertex " + std::to_string(vertex));
+            }
+            vertices.insert(vertex);
+        }
+        if (vertices.size() > MESHLET_MAX_VERTICES)
+        {
+            return fail("meshlet " + std::to_string(i) + " has " + std::to_string(vertices.size()) + " vertices");
+        }
+        expectedOffset += meshlet.triangleCount * 3;
+    }
+
+    if (!meshData.meshlets.empty() && expectedOffset != meshData.GetLod(0).indexCount)
+    {
+        return fail("meshlets cover " + std::to_string(expectedOffset) + " of " + std::to_string(meshData.GetLod(0).indexCount) + " lod 0 indices");
+    }
+    return true;
+}
+
+std::array<glm::vec4, 6> Model::extractFrustumPlanes(const glm::mat4& mvp)
+{
+    // rows of the column major matrix
+    glm::vec4 r0(mvp[0][0], mvp[1][0], mvp[2][0], mvp[3][0]);
+    glm::vec4 r1(mvp[0][1], mvp[1][1], mvp[2][1], mvp[3][1]);
+    glm::vec4 r2(mvp[0][2], mvp[1][2], mvp[2][2], mvp[3][2]);
+    glm::vec4 r3(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+
+    std::array<glm::vec4, 6> planes { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2 };
+    for (auto& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
+bool Model::isMeshletVisible(const Meshlet& meshlet, const std::array<glm::vec4, 6>& planes, const glm::vec3& eye, bool frustum, bool cone)
+{
+    glm::vec3 center = glm::vec3(meshlet.sphere);
+    if (frustum)
+    {
+        for (const auto& plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -meshlet.sphere.w)
+            {
+                return false;
+            }
+        }
+    }
+    if (cone && glm::dot(glm::normalize(glm::vec3(meshlet.coneApex) - eye), glm::vec3(meshlet.coneAxisCutoff)) >= meshlet.coneAxisCutoff.w)
+    {
+        return false;
+    }
+    return true;
+}
+
+float Model::computeUvScale(const MeshData& meshData)
+{
+    MeshLod lod = meshData.GetLod(0);
+    double area = 0.0;
+    double uvArea = 0.0;
+    for (uint32_t i = lod.indexOffset; i + 3 <= lod.indexOffset + lod.indexCount; i += 3)
+    {
+        const VertexData& a = meshData.vertices[meshData.indices[i]];
+        const VertexData& b = meshData.vertices[meshData.indices[i + 1]];
+        const VertexData& c = meshData.vertices[meshData.indices[i + 2]];
+        area += 0.5 * glm::length(glm::cross(glm::vec3(b.position - a.position), glm::vec3(c.position - a.position)));
+        glm::vec2 ab = glm::vec2(b.texCoord - a.texCoord);
+        glm::vec2 ac = glm::vec2(c.texCoord - a.texCoord);
+        uvArea += 0.5 * std::abs(ab.x * ac.y - ab.y * ac.x);
+    }
+    return uvArea > 0.0 ? (float)std::sqrt(area / uvArea) : 0.0f;
+}
+
+std::vector<uint16_t> Model::narrowIndices(const std::vector<uint32_t>& indices)
+{
+    std::vector<uint16_t> narrowed(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        assert(indices[i] <= UINT16_MAX);
+        narrowed[i] = (uint16_t)indices[i];
+    }
+    return narrowed;
+}
+
+uint32_t Model::getVertexStride(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::kFull:
+        return sizeof(VertexData);
+    case VertexFormat::kPacked:
+        return sizeof(PackedVertexData);
+    case VertexFormat::kQuantized:
+        return sizeof(QuantizedVertexData);
+    }
+    assert(false);
+    return 0;
+}
+
+std::vector<uint8_t> Model::encodeVertices(const MeshData& meshData, VertexFormat format)
+{
+    std::vector<uint8_t> encoded(meshData.vertices.size() * getVertexStride(format));
+    switch (format)
+    {
+    case VertexFormat::kFull:
+    {
+        std::memcpy(encoded.data(), meshData.vertices.data(), encoded.size());
+        break;
+    }
+    case VertexFormat::kPacked:
+    {
+        PackedVertexData* out = reinterpret_cast<PackedVertexData*>(encoded.data());
+        for (size_t i = 0; i < meshData.vertices.size(); i++)
+        {
+            out[i].position = glm::vec3(meshData.vertices[i].position);
+            encodeAttributes(meshData.vertices[i], out[i]);
+        }
+        break;
+    }
+    case VertexFormat::kQuantized:
+    {
+        const glm::vec3 extent = meshData.boundsMax - meshData.boundsMin;
+        const glm::vec3 invExtent(
+            extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+            extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+            extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+        );
+        QuantizedVertexData* out = reinterpret_cast<QuantizedVertexData*>(encoded.data());
+        for (size_t i = 0; i < meshData.vertices.size(); i++)
+        {
+            glm::vec3 unorm = glm::clamp((glm::vec3(meshData.vertices[i].position) - meshData.boundsMin) * invExtent, 0.0f, 1.0f);
+            out[i].position[0] = (uint16_t)(unorm.x * UNORM16_MAX + 0.5f);
+            out[i].position[1] = (uint16_t)(unorm.y * UNORM16_MAX + 0.5f);
+            out[i].position[2] = (uint16_t)(unorm.z * UNORM16_MAX + 0.5f);
+            out[i].position[3] = 0;
+            encodeAttributes(meshData.vertices[i], out[i]);
+        }
+        break;
+    }
+    }
+    return encoded;
+}
+
+Model::VertexDequantization Model::getVertexDequantization(const MeshData& meshData, VertexFormat format)
+{
+    VertexDequantization dequantization{ glm::vec4(0.0f), glm::vec4(1.0f) };
+    if (format == VertexFormat::kQuantized)
+    {
+        dequantization.offset = glm::vec4(meshData.boundsMin, 0.0f);
+        dequantization.scale = glm::vec4(meshData.boundsMax - meshData.boundsMin, 1.0f);
+    }
+    return dequantization;
+}
+
+Model::VertexData Model::decodeVertex(const uint8_t* encoded, VertexFormat format, const VertexDequantization& dequantization)
+{
+    VertexData vertex;
+    switch (format)
+    {
+    case VertexFormat::kFull:
+    {
+        std::memcpy(&vertex, encoded, sizeof(vertex));
+        return vertex;
+    }
+    case VertexFormat::kPacked:
+    {
+        PackedVertexData in;
+        std::memcpy(&in, encoded, sizeof(in));
+        vertex.position = dequantization.offset + dequantization.scale * glm::vec4(in.position, 0.0f);
+        decodeAttributes(in, vertex);
+        break;
+    }
+    case VertexFormat::kQuantized:
+    {
+        QuantizedVertexData in;
+        std::memcpy(&in, encoded, sizeof(in));
+        glm::vec4 unorm(in.position[0] / UNORM16_MAX, in.position[1] / UNORM16_MAX, in.position[2] / UNORM16_MAX, 0.0f);
+        vertex.position = dequantization.offset + dequantization.scale * unorm;
+        decodeAttributes(in, vertex);
+        break;
+    }
+    }
+    vertex.position.w = 1.0f;
+    return vertex;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Util/Modelutil.h"
+#include <array>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Util { namespace Model {
+
+// raw counters, so the stats of several meshes can be summed before taking the ratios
+struct MeshStats
+{
+    uint64_t triangleCount = 0;
+    uint64_t vertexCount = 0;
+    uint64_t verticesTransformed = 0; // post transform cache misses
+    uint64_t pixelsCovered = 0;
+    uint64_t pixelsShaded = 0;
+    uint64_t bytesFetched = 0;
+    uint64_t vertexBytes = 0;
+
+    MeshStats& operator+=(const MeshStats& r);
+    // transformed vertices per triangle, 0.5 is the lower bound of a regular grid
+    inline float GetAcmr() const { return triangleCount ? (float)verticesTransformed / triangleCount : 0.0f; }
+    // transformed vertices per vertex, 1 is optimal
+    inline float GetAtvr() const { return vertexCount ? (float)verticesTransformed / vertexCount : 0.0f; }
+    // shaded / covered pixels over a fixed set of view directions
+    inline float GetOverdraw() const { return pixelsCovered ? (float)pixelsShaded / pixelsCovered : 0.0f; }
+    // fetched / vertex buffer bytes
+    inline float GetOverfetch() const { return vertexBytes ? (float)bytesFetched / vertexBytes : 0.0f; }
+    std::string ToString() const;
+};
+
+MeshStats analyzeMesh(const MeshData& meshData);
+
+// reorders triangles for the post transform vertex cache, then again for overdraw as long as the cache
+// efficiency stays within OVERDRAW_THRESHOLD, then remaps the vertices into first use order. unreferenced vertices are dropped.
+// meshes that are not a triangle list are left untouched
+constexpr float OVERDRAW_THRESHOLD = 1.05f;
+void optimizeMesh(MeshData& meshData);
+
+// appends up to MAX_LOD_COUNT - 1 coarser index buffers to meshData.indices, each with about half the triangles of the previous one.
+// simplified from lod 0 with quadric error metrics that also weigh the uv and the normal, so seams and creases hold longer.
+// stops early once a lod cannot be reduced without exceeding LOD_MAX_ERROR
+constexpr uint32_t MAX_LOD_COUNT = 4;
+constexpr float LOD_MAX_ERROR = 0.05f; // relative to the mesh extent
+void generateLods(MeshData& meshData);
+
+// splits lod 0 into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles,
+// and rewrites its indices meshlet by meshlet. the triangle set is unchanged
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+constexpr float MESHLET_CONE_WEIGHT = 0.25f; // trades spatial compactness for tighter normal cones
+void buildMeshlets(MeshData& meshData);
+// the meshlets cover lod 0 exactly once, respect the size limits and bound their vertices. error receives the first failure
+bool validateMeshlets(const MeshData& meshData, std::string* error = nullptr);
+
+// planes of the clip volume of mvp in the space mvp maps from, xyz unit inward normal, w offset.
+// the near plane is z >= -w, which is exact for a gl depth range and conservative for a vulkan one
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& mvp);
+// cpu reference of meshlet.cull.comp, planes and eye in object space
+bool isMeshletVisible(const Meshlet& meshlet, const std::array<glm::vec4, 6>& planes, const glm::vec3& eye, bool frustum = true, bool cone = true);
+
+// object space length covered by one uv unit on lod 0, the square root of surface area over uv area. 0 without uv extent
+float computeUvScale(const MeshData& meshData);
+
+// indices must all be below 65536, see MeshData::FitsIndex16
+std::vector<uint16_t> narrowIndices(const std::vector<uint32_t>& indices);
+
+// vertex buffer contents of meshData in format, and the dequantization the packed shaders apply to it
+uint32_t getVertexStride(VertexFormat format);
+std::vector<uint8_t> encodeVertices(const MeshData& meshData, VertexFormat format);
+VertexDequantization getVertexDequantization(const MeshData& meshData, VertexFormat format);
+// inverse of encodeVertices for one vertex, the bitangent is rebuilt from the normal, the tangent and the sign
+VertexData decodeVertex(const uint8_t* encoded, VertexFormat format, const VertexDequantization& dequantization);
+
+}}
@@ -0,0 +1,463 @@
+#include "Modelcacheutil.h"
+#include "Util/Fileutil.h"
+#include "Util/Meshutil.h"
+#include "Util/Parallelutil.h"
+#include "Util/Texturecacheutil.h"
+#include "Util/Textureutil.h"
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Util { namespace Model {
+
+namespace {
+
+constexpr size_t BLOB_ALIGNMENT = 16;
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t materialIndexCount;
+};
+
+struct MeshHeader
+{
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t lodCount;
+    uint64_t meshletCount;
+    uint64_t indexSize; // 2 or 4 bytes
+};
+
+class Writer
+{
+public:
+    template<typename T>
+    void Write(const T& value) { WriteBytes(&value, sizeof(T)); }
+    void WriteBytes(const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+    }
+    void WriteString(const std::string& str)
+    {
+        Write((uint32_t)str.size());
+        WriteBytes(str.data(), str.size());
+    }
+    void Align(size_t alignment) { m_buffer.resize((m_buffer.size() + alignment - 1) / alignment * alignment, 0); }
+    const std::vector<char>& GetBuffer() const { return m_buffer; }
+private:
+    std::vector<char> m_buffer;
+};
+
+// bounds checked cursor over the mapping, every read fails instead of running past the end
+class Reader
+{
+public:
+    Reader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    template<typename T>
+    bool Read(T& value) { return ReadBytes(&value, sizeof(T)); }
+    bool ReadBytes(void* dst, size_t size)
+    {
+        const char* src = nullptr;
+        if (!Skip(size, src))
+        {
+            return false;
+        }
+        std::memcpy(dst, src, size);
+        return true;
+    }
+    bool ReadString(std::string& str)
+    {
+        uint32_t size = 0;
+        const char* src = nullptr;
+        if (!Read(size) || !Skip(size, src))
+        {
+            return false;
+        }
+        str.assign(src, size);
+        return true;
+    }
+    bool Align(size_t alignment)
+    {
+        size_t offset = (m_offset + alignment - 1) / alignment * alignment;
+        if (offset > m_size)
+        {
+            return false;
+        }
+        m_offset = offset;
+        return true;
+    }
+    // pointer into the mapping, valid while the region is mapped
+    bool Skip(size_t size, const char*& ptr)
+    {
+        if (size > m_size - m_offset)
+        {
+            return false;
+        }
+        ptr = m_data + m_offset;
+        m_offset += size;
+        return true;
+    }
+    inline size_t GetSize() const { return m_size; }
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+};
+
+template<typename T>
+bool readBlob(Reader& reader, uint64_t count, std::vector<T>& out)
+{
+    const char* src = nullptr;
+    if (count > reader.GetSize() / sizeof(T) || !reader.Align(BLOB_ALIGNMENT) || !reader.Skip(count * sizeof(T), src))
+    {
+        return false;
+    }
+    out.resize(count);
+    if (count > 0)
+    {
+        std::memcpy(out.data(), src, count * sizeof(T));
+    }
+    return true;
+}
+
+// widened back to 32 bits, the cpu side always works on uint32_t indices
+bool readIndices(Reader& reader, const MeshHeader& meshHeader, std::vector<uint32_t>& indices)
+{
+    if (meshHeader.indexSize == sizeof(uint32_t))
+    {
+        return readBlob(reader, meshHeader.indexCount, indices);
+    }
+    std::vector<uint16_t> narrowed;
+    if (meshHeader.indexSize != sizeof(uint16_t) || !readBlob(reader, meshHeader.indexCount, narrowed))
+    {
+        return false;
+    }
+    indices.assign(narrowed.begin(), narrowed.end());
+    return true;
+}
+
+bool readMaterial(Reader& reader, MaterialData& material)
+{
+    uint32_t textureCount = 0;
+    if (!reader.ReadString(material.name) || !reader.Read(textureCount))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < textureCount; i++)
+    {
+        TextureData texture;
+        uint32_t type = 0, uMode = 0, vMode = 0;
+        if (!reader.ReadString(texture.name) || !reader.Read(type) || !reader.Read(uMode) || !reader.Read(vMode))
+        {
+            return false;
+        }
+        texture.type = (aiTextureType)type;
+        texture.uMapMode = (aiTextureMapMode)uMode;
+        texture.vMapMode = (aiTextureMapMode)vMode;
+        material.textureDatas.emplace_back(std::move(texture));
+    }
+
+    uint32_t shaderCount = 0;
+    if (!reader.Read(shaderCount))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < shaderCount; i++)
+    {
+        uint32_t stage = 0;
+        std::string shaderPath;
+        if (!reader.Read(stage) || !reader.ReadString(shaderPath))
+        {
+            return false;
+        }
+        material.shaderDatas[(vk::ShaderStageFlagBits)stage] = shaderPath;
+    }
+    return true;
+}
+
+// decodes the (path, semantic) pairs missing from textureDataMap on a worker pool, then points every texture data at its raw data
+void loadTextures(
+    ModelData& modelData,
+    const boost::filesystem::path& folder,
+    std::map<Util::Texture::DecodeKey, std::shared_ptr<Util::Texture::RawData>>& textureDataMap
+)
+{
+    std::map<Util::Texture::DecodeKey, std::future<std::shared_ptr<Util::Texture::RawData>>> loads;
+    {
+        Util::Parallel::ThreadPool pool;
+        for (const auto& material : modelData.materialDatas)
+        {
+            for (const auto& texture : material.textureDatas)
+            {
+                auto texturePath = folder / texture.name;
+                Util::Texture::Semantic semantic = Util::Texture::getSemantic(texture.type);
+                Util::Texture::DecodeKey key { texturePath, semantic };
+                if (textureDataMap.find(key) == textureDataMap.end() && loads.find(key) == loads.end())
+                {
+                    loads[key] = pool.Submit([texturePath, semantic]()
+                    {
+                        return Util::Texture::loadCooked(texturePath, semantic);
+                    });
+                }
+            }
+        }
+        for (auto& load : loads)
+        {
+            textureDataMap[load.first] = load.second.get();
+        }
+    }
+
+    for (auto& material : modelData.materialDatas)
+    {
+        for (auto& texture : material.textureDatas)
+        {
+            texture.rawData = textureDataMap[{ folder / texture.name, Util::Texture::getSemantic(texture.type) }];
+        }
+    }
+}
+
+}
+
+ModelCache::ModelCache(const boost::filesystem::path& sourcePath, const std::string& importer)
+    : m_sourcePath(sourcePath)
+    , m_importer(importer)
+{
+    const uint32_t layout[] = { CACHE_VERSION, (uint32_t)sizeof(VertexData) };
+    uint64_t key = Util::File::hashBytes(layout, sizeof(layout));
+    key = Util::File::hashBytes(m_importer.data(), m_importer.size(), key);
+    if (!Util::File::hashFile(m_sourcePath, key))
+    {
+        std::cout << "[ModelCache] source not readable, cache disabled: " << m_sourcePath.string() << std::endl;
+        return;
+    }
+
+    // obj materials live in a side file
+    if (Util::File::getLowerExtension(m_sourcePath) == ".obj")
+    {
+        boost::filesystem::path mtlPath = m_sourcePath;
+        mtlPath.replace_extension(".mtl");
+        Util::File::hashFile(mtlPath, key);
+    }
+    m_key = key != 0 ? key : 1;
+}
+
+boost::filesystem::path ModelCache::GetCachePath() const
+{
+    std::stringstream name;
+    name << m_sourcePath.filename().string() << "." << m_importer << "."
+         << std::hex << std::setw(16) << std::setfill('0') << m_key << ".meshcache";
+    return m_sourcePath.parent_path() / name.str();
+}
+
+bool ModelCache::Load(ModelData& modelData, std::map<Util::Texture::DecodeKey, std::shared_ptr<Util::Texture::RawData>>& textureDataMap) const
+{
+    if (!IsValid())
+    {
+        return false;
+    }
+
+    boost::filesystem::path path = GetCachePath();
+    if (!Util::File::fileExist(path))
+    {
+        return false;
+    }
+
+    try
+    {
+        boost::interprocess::file_mapping mapping(path.string().c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+        Reader reader(static_cast<const char*>(region.get_address()), region.get_size());
+
+        FileHeader header;
+        if (!reader.Read(header)
+            || header.magic != CACHE_MAGIC
+            || header.version != CACHE_VERSION
+            || header.key != m_key
+            || header.vertexSize != sizeof(VertexData))
+        {
+            std::cout << "[ModelCache] ignore invalid cache file: " << path.string() << std::endl;
+            return false;
+        }
+
+        ModelData result;
+        result.meshDatas.resize(header.meshCount);
+        for (auto& mesh : result.meshDatas)
+        {
+            MeshHeader meshHeader;
+            if (!reader.ReadString(mesh.name)
+                || !reader.Read(meshHeader)
+                || !readBlob(reader, meshHeader.vertexCount, mesh.vertices)
+                || !readIndices(reader, meshHeader, mesh.indices)
+                || !readBlob(reader, meshHeader.lodCount, mesh.lods)
+                || !readBlob(reader, meshHeader.meshletCount, mesh.meshlets))
+            {
+                std::cout << "[ModelCache] truncated mesh in cache file: " << path.string() << std::endl;
+                return false;
+            }
+            for (const auto& lod : mesh.lods)
+            {
+                if ((uint64_t)lod.indexOffset + lod.indexCount > mesh.indices.size())
+                {
+                    std::cout << "[ModelCache] invalid lod in cache file: " << path.string() << std::endl;
+                    return false;
+                }
+            }
+            for (const auto& meshlet : mesh.meshlets)
+            {
+                if ((uint64_t)meshlet.indexOffset + (uint64_t)meshlet.triangleCount * 3 > mesh.indices.size())
+                {
+                    std::cout << "[ModelCache] invalid meshlet in cache file: " << path.string() << std::endl;
+                    return false;
+                }
+            }
+            mesh.boundsMin = meshHeader.boundsMin;
+            mesh.boundsMax = meshHeader.boundsMax;
+        }
+
+        result.materialDatas.resize(header.materialCount);
+        for (auto& material : result.materialDatas)
+        {
+            if (!readMaterial(reader, material))
+            {
+                std::cout << "[ModelCache] truncated material in cache file: " << path.string() << std::endl;
+                return false;
+            }
+        }
+
+        std::vector<uint64_t> materialIndexs;
+        if (!readBlob(reader, header.materialIndexCount, materialIndexs))
+        {
+            std::cout << "[ModelCache] truncated material indices in cache file: " << path.string() << std::endl;
+            return false;
+        }
+        result.materialIndexs.assign(materialIndexs.begin(), materialIndexs.end());
+
+        loadTextures(result, m_sourcePath.parent_path(), textureDataMap);
+        modelData = std::move(result);
+        return true;
+    }
+    catch (const boost::interprocess::interprocess_exception& e)
+    {
+        std::cout << "[ModelCache] map cache file failed: " << path.string() << " " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool ModelCache::Save(const ModelData& modelData) const
+{
+    if (!IsValid())
+    {
+        return false;
+    }
+
+    Writer writer;
+    FileHeader header
+    {
+        CACHE_MAGIC, CACHE_VERSION, m_key, (uint32_t)sizeof(VertexData),
+        (uint32_t)modelData.meshDatas.size(), (uint32_t)modelData.materialDatas.size(), (uint32_t)modelData.materialIndexs.size()
+    };
+    writer.Write(header);
+
+    for (const auto& mesh : modelData.meshDatas)
+    {
+        writer.WriteString(mesh.name);
+        const bool index16 = mesh.FitsIndex16();
+        writer.Write(MeshHeader{ mesh.boundsMin, mesh.boundsMax, mesh.vertices.size(), mesh.indices.size(), mesh.lods.size(), mesh.meshlets.size(), index16 ? sizeof(uint16_t) : sizeof(uint32_t) });
+        writer.Align(BLOB_ALIGNMENT);
+        writer.WriteBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(VertexData));
+        writer.Align(BLOB_ALIGNMENT);
+        if (index16)
+        {
+            std::vector<uint16_t> narrowed = narrowIndices(mesh.indices);
+            writer.WriteBytes(narrowed.data(), narrowed.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            writer.WriteBytes(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        }
+        writer.Align(BLOB_ALIGNMENT);
+        writer.WriteBytes(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+        writer.Align(BLOB_ALIGNMENT);
+        writer.WriteBytes(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+    }
+
+    for (const auto& material : modelData.materialDatas)
+    {
+        writer.WriteString(material.name);
+        writer.Write((uint32_t)material.textureDatas.size());
+        for (const auto& texture : material.textureDatas)
+        {
+            writer.WriteString(texture.name);
+            writer.Write((uint32_t)texture.type);
+            writer.Write((uint32_t)texture.uMapMode);
+            writer.Write((uint32_t)texture.vMapMode);
+        }
+        writer.Write((uint32_t)material.shaderDatas.size());
+        for (const auto& shader : material.shaderDatas)
+        {
+            writer.Write((uint32_t)shader.first);
+            writer.WriteString(shader.second.string());
+        }
+    }
+
+    std::vector<uint64_t> materialIndexs(modelData.materialIndexs.begin(), modelData.materialIndexs.end());
+    writer.Align(BLOB_ALIGNMENT);
+    writer.WriteBytes(materialIndexs.data(), materialIndexs.size() * sizeof(uint64_t));
+
+    // write to a temporary file first, so an interrupted run never leaves a truncated cache behind
+    boost::filesystem::path path = GetCachePath();
+    boost::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    boost::system::error_code err;
+    bool written = Util::File::writeFile(tmpPath, writer.GetBuffer());
+    if (written)
+    {
+        boost::filesystem::rename(tmpPath, path, err);
+    }
+    if (!written || err)
+    {
+        boost::filesystem::remove(tmpPath, err);
+        std::cout << "[ModelCache] write cache failed: " << path.string() << std::endl;
+        return false;
+    }
+
+    removeStaleFiles(path);
+    std::cout << "[ModelCache] saved " << path.filename().string() << " (" << writer.GetBuffer().size() / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+void ModelCache::removeStaleFiles(const boost::filesystem::path& keep) const
+{
+    const std::string prefix = m_sourcePath.filename().string() + "." + m_importer + ".";
+    boost::system::error_code err;
+    for (boost::filesystem::directory_iterator it(m_sourcePath.parent_path(), err), end; !err && it != end; it.increment(err))
+    {
+        const boost::filesystem::path& path = it->path();
+        std::string filename = path.filename().string();
+        if (path != keep && filename.rfind(prefix, 0) == 0 && path.extension() == ".meshcache")
+        {
+            boost::system::error_code removeErr;
+            boost::filesystem::remove(path, removeErr);
+        }
+    }
+}
+
+}}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Util/Modelutil.h"
+#include "Util/Textureutil.h"
+#include <boost/filesystem/path.hpp>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+namespace Util { namespace Model {
+
+// Cooked binary copy of an imported ModelData, written next to the source as <file>.<importer>.<key>.meshcache.
+// The key hashes the source file (and the .mtl of an obj), the importer, the cache version and the vertex layout.
+// Loading maps the file and copies the vertex / index blobs out of the mapping, nothing is parsed.
+class ModelCache
+{
+public:
+    // importer tags the file, so different loaders of the same source never share an entry
+    ModelCache(const boost::filesystem::path& sourcePath, const std::string& importer);
+
+    boost::filesystem::path GetCachePath() const;
+    // texture references are resolved against the source folder, the (path, semantic) pairs missing from textureDataMap are decoded in parallel
+    bool Load(ModelData& modelData, std::map<Util::Texture::DecodeKey, std::shared_ptr<Util::Texture::RawData>>& textureDataMap) const;
+    bool Save(const ModelData& modelData) const;
+    inline bool IsValid() const { return m_key != 0; }
+
+private:
+    void removeStaleFiles(const boost::filesystem::path& keep) const;
+
+private:
+    static constexpr uint32_t CACHE_MAGIC = 0x434d5256; // "VRMC"
+    static constexpr uint32_t CACHE_VERSION = 4;
+
+    boost::filesystem::path m_sourcePath;
+    std::string m_importer;
+    uint64_t m_key = 0;
+};
+
+}}
@@ -1,13 +1,21 @@
 #include "Modelutil.h"
 #include "Runtime/VulkanRHI/Graphic/Vertex.h"
 #include "Util/Fileutil.h"
+#include "Util/Meshutil.h"
+#include "Util/Modelcacheutil.h"
+#include "Util/Objweldutil.h"
+#include "Util/Texturecacheutil.h"
 #include "Util/Textureutil.h"
+#include <algorithm>
 #include <assimp/material.h>
 #include <assimp/mesh.h>
 #include <assimp/types.h>
+#include <atomic>
 #include <boost/filesystem/path.hpp>
+#include <chrono>
 #include <glm/fwd.hpp>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 
 #include <unordered_map>
@@ -23,7 +31,33 @@
 
 namespace Util {
 
-Model::TinyObj::TinyObj(const boost::filesystem::path& objPath)
+void Model::MeshData::ComputeBounds()
+{
+    if (vertices.empty())
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        return;
+    }
+
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (const auto& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, glm::vec3(vertex.position));
+        boundsMax = glm::max(boundsMax, glm::vec3(vertex.position));
+    }
+}
+
+Model::MeshLod Model::MeshData::GetLod(uint32_t lod) const
+{
+    if (lods.empty())
+    {
+        return MeshLod{ 0, (uint32_t)indices.size(), 0.0f };
+    }
+    return lods[std::min<size_t>(lod, lods.size() - 1)];
+}
+
+Model::TinyObj::TinyObj(const boost::filesystem::path& objPath, bool optimizeMeshes)
 {
     if (!Util::File::fileExist(objPath))
     {
@@ -31,6 +65,17 @@ Model::TinyObj::TinyObj(const boost::filesystem::path& objPath)
         return;
     }
 
+    ModelCache cache(objPath, optimizeMeshes ? "tinyobj-opt" : "tinyobj");
+    {
+        ModelData cooked;
+        std::map<Util::Texture::DecodeKey, std::shared_ptr<Util::Texture::RawData>> textureDataMap;
+        if (cache.Load(cooked, textureDataMap) && cooked.meshDatas.size() == 1)
+        {
+            m_meshData = std::move(cooked.meshDatas[0]);
+            return;
+        }
+    }
+
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -40,98 +85,87 @@ Model::TinyObj::TinyObj(const boost::filesystem::path& objPath)
         throw std::runtime_error("load model failed: " + warn + err);
     }
 
-    std::unordered_map<RHI::Vertex, uint32_t> uniqueVertices;
-    for (auto& shape : shapes)
+    auto tWeld = std::chrono::high_resolution_clock::now();
+    size_t indexCount = 0;
+    for (const auto& shape : shapes)
     {
-        for (auto& index : shape.mesh.indices)
-        {
-            RHI::Vertex vertex;
-
-            vertex.position = glm::vec4
-            {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2],
-                1.0f
-            };
-
-            vertex.texCoord = glm::vec4
-            {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-                0.f,0.f
-            };
+        indexCount += shape.mesh.indices.size();
+    }
 
-            if (uniqueVertices.find(vertex) == uniqueVertices.end())
+    // the vertex only reads the position and texcoord, so welding on their index pair gives the same vertices without building one per index
+    Model::VertexWelder welder(indexCount);
+    m_meshData.indices.reserve(indexCount);
+    for (const auto& shape : shapes)
+    {
+        for (const auto& index : shape.mesh.indices)
+        {
+            uint32_t vertexIdx = 0;
+            if (!welder.FindOrInsert(Model::VertexWelder::PackKey(index), (uint32_t)m_meshData.vertices.size(), vertexIdx))
             {
-                uniqueVertices[vertex] = m_meshData.vertices.size();
-                m_meshData.vertices.emplace_back(vertex);
+                m_meshData.vertices.emplace_back(Model::makeObjVertex(attrib, index));
             }
-            m_meshData.indices.emplace_back(uniqueVertices[vertex]);
+            m_meshData.indices.push_back(vertexIdx);
         }
     }
+    auto tWeldDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tWeld).count();
+    std::cout << "[TinyObj] " << objPath.filename().string() << " welded " << indexCount << " indices to "
+              << m_meshData.vertices.size() << " vertices in " << tWeldDiff << " ms" << std::endl;
+    m_meshData.ComputeBounds();
+
+    if (optimizeMeshes)
+    {
+        MeshStats before = analyzeMesh(m_meshData);
+        optimizeMesh(m_meshData);
+        std::cout << "[TinyObj] " << objPath.filename().string() << " optimized, before: " << before.ToString()
+                  << " after: " << analyzeMesh(m_meshData).ToString() << std::endl;
+    }
+
+    ModelData cooked;
+    cooked.meshDatas.push_back(m_meshData);
+    cache.Save(cooked);
 }
 
 
 void Util::Model::AssimpObj::fillMeshData(Util::Model::MeshData& meshData, aiMesh* mesh)
 {
+    // sized up front and written in place, the vertex fields without a source stay zero
+    meshData.vertices.resize(mesh->mNumVertices);
     for (size_t i = 0; i < mesh->mNumVertices; i++)
     {
-        meshData.vertices.push_back(Model::VertexData{});
-        Util::Model::VertexData& vertex = meshData.vertices.back();
-        glm::vec4 vec4(1.0f);
-        vec4.x = mesh->mVertices[i].x;
-        vec4.y = mesh->mVertices[i].y;
-        vec4.z = mesh->mVertices[i].z;
-        vertex.position = vec4;
-
+        Util::Model::VertexData& vertex = meshData.vertices[i];
+        vertex.position = glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
         if (mesh->mNormals)
         {
-            vec4.x = mesh->mNormals[i].x;
-            vec4.y = mesh->mNormals[i].y;
-            vec4.z = mesh->mNormals[i].z;
-            vertex.normal = vec4;
+            vertex.normal = glm::vec4(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z, 1.0f);
         }
-
         if (mesh->mTextureCoords[0])
         {
-            glm::vec4 vec4(0);
-            vec4.x = mesh->mTextureCoords[0][i].x;
-            vec4.y = mesh->mTextureCoords[0][i].y;
-            vertex.texCoord = vec4;
-        }
-        else
-        {
-            vertex.texCoord = glm::vec4(0.0f);
+            vertex.texCoord = glm::vec4(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y, 0.0f, 0.0f);
         }
-
         if (mesh->mTangents)
         {
-            // tangent
-            vec4.x = mesh->mTangents[i].x;
-            vec4.y = mesh->mTangents[i].y;
-            vec4.z = mesh->mTangents[i].z;
-            vertex.tangent = vec4;
+            vertex.tangent = glm::vec4(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z, 1.0f);
         }
-
         if (mesh->mBitangents)
         {
-            // bitangent
-            vec4.x = mesh->mBitangents[i].x;
-            vec4.y = mesh->mBitangents[i].y;
-            vec4.z = mesh->mBitangents[i].z;
-            vertex.bitangent = vec4;
+            vertex.bitangent = glm::vec4(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z, 1.0f);
         }
     }
 
+    size_t indexCount = 0;
     for (size_t i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
-        for (size_t j = 0; j < face.mNumIndices; j++)
-        {
-            meshData.indices.emplace_back(face.mIndices[j]);
-        }
+        indexCount += mesh->mFaces[i].mNumIndices;
     }
+    meshData.indices.resize(indexCount);
+    uint32_t* dst = meshData.indices.data();
+    for (size_t i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        std::copy(face.mIndices, face.mIndices + face.mNumIndices, dst);
+        dst += face.mNumIndices;
+    }
+    meshData.ComputeBounds();
 }
 
 void Util::Model::AssimpObj::fillTextureData(std::vector<Util::Model::TextureData>& textureDatas, aiMesh* mesh, aiMaterial* material, const boost::filesystem::path& textureFolderPath)
@@ -148,19 +182,25 @@ void Util::Model::AssimpObj::fillTextureData(std::vector<Util::Model::TextureDat
             aiTextureMapMode u_mode, v_mode;
             material->Get(AI_MATKEY_MAPPINGMODE_U(aiType, texIdx), u_mode);
             material->Get(AI_MATKEY_MAPPINGMODE_V(aiType, texIdx), v_mode);
-            std::shared_ptr<Util::Texture::RawData> textureRawData;
-            if (m_textureDataMap.find(texturePath) == m_textureDataMap.end())
             {
-                m_textureDataMap[texturePath] = Util::Texture::RawData::Load(texturePath, Util::Texture::RawData::Format::eRgbAlpha);
+                Util::Texture::Semantic semantic = Util::Texture::getSemantic((aiTextureType)aiType);
+                std::lock_guard<std::mutex> lock(m_textureMutex);
+                if (m_textureLoads.find({ texturePath, semantic }) == m_textureLoads.end())
+                {
+                    m_textureLoads[{ texturePath, semantic }] = m_pTexturePool->Submit([texturePath, semantic]()
+                    {
+                        return Util::Texture::loadCooked(texturePath, semantic);
+                    }).share();
+                }
             }
-            textureRawData = m_textureDataMap[texturePath];
+            // rawData is filled by resolveTextureData once the decode finishes
             textureDatas.emplace_back(
                 Util::Model::TextureData
                 {
                     name.C_Str(),
                     (aiTextureType)aiType,
                     u_mode, v_mode,
-                    textureRawData
+                    nullptr
                 }
             );
         }
@@ -168,9 +208,19 @@ void Util::Model::AssimpObj::fillTextureData(std::vector<Util::Model::TextureDat
 }
 
 
-Model::AssimpObj::AssimpObj(const boost::filesystem::path& objPath)
+Model::AssimpObj::AssimpObj(const boost::filesystem::path& objPath, bool optimizeMeshes)
     : m_filePath(objPath)
+    , m_optimizeMeshes(optimizeMeshes)
 {
+    auto tStart = std::chrono::high_resolution_clock::now();
+    ModelCache cache(objPath, m_optimizeMeshes ? "assimp-opt" : "assimp");
+    if (cache.Load(m_modelData, m_textureDataMap))
+    {
+        auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+        std::cout << "[AssimpObj] " << objPath.filename().string() << " loaded from cache in " << tDiff << " ms" << std::endl;
+        return;
+    }
+
     Assimp::Importer assimpImporter;
     const aiScene *scene = assimpImporter.ReadFile(objPath.string(), aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
@@ -180,46 +230,157 @@ Model::AssimpObj::AssimpObj(const boost::filesystem::path& objPath)
         return;
     }
 
-    processNode(scene->mRootNode, scene);
+    auto tConvert = std::chrono::high_resolution_clock::now();
+    m_pTexturePool = std::make_unique<Util::Parallel::ThreadPool>();
+    processScene(scene);
+    auto tMeshDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tConvert).count();
+    resolveTextureData();
+    m_pTexturePool.reset();
+    cache.Save(m_modelData);
+
+    size_t vertexCount = 0;
+    for (const auto& meshData : m_modelData.meshDatas)
+    {
+        vertexCount += meshData.vertices.size();
+    }
+    auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+    std::cout << "[AssimpObj] " << objPath.filename().string() << " imported in " << tDiff << " ms, "
+              << m_modelData.meshDatas.size() << " meshes, " << vertexCount << " vertices converted in " << tMeshDiff << " ms ("
+              << (tMeshDiff > 0.0 ? vertexCount / tMeshDiff / 1000.0 : 0.0) << " Mvertices/s)" << std::endl;
 }
 
-void Model::AssimpObj::processNode(aiNode* node, const aiScene* scene)
+void Model::AssimpObj::resolveTextureData()
 {
+    std::lock_guard<std::mutex> lock(m_textureMutex);
+    for (auto& load : m_textureLoads)
+    {
+        m_textureDataMap[load.first] = load.second.get();
+    }
+    m_textureLoads.clear();
+
     auto folder = m_filePath.parent_path();
-    std::map<std::string, size_t> matNameToIdx, meshNameToIdx;
-    for (size_t i = 0; i < node->mNumMeshes; i++)
+    for (auto& materialData : m_modelData.materialDatas)
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        for (auto& textureData : materialData.textureDatas)
+        {
+            textureData.rawData = m_textureDataMap[{ folder / textureData.name, Util::Texture::getSemantic(textureData.type) }];
+        }
+    }
+}
 
-        std::string meshName = mesh->mName.C_Str();
-        if (meshNameToIdx.find(meshName) != meshNameToIdx.end())
+void Model::AssimpObj::collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes, std::vector<bool>& visited)
+{
+    for (size_t i = 0; i < node->mNumMeshes; i++)
+    {
+        uint32_t meshIdx = node->mMeshes[i];
+        if (!visited[meshIdx])
         {
-            continue;
+            visited[meshIdx] = true;
+            meshes.push_back(scene->mMeshes[meshIdx]);
         }
+    }
 
-        MeshData meshData;
-        meshData.name = meshName;
-        fillMeshData(meshData, mesh);
-        meshNameToIdx[meshName] = m_modelData.meshDatas.size();
-        m_modelData.meshDatas.emplace_back(std::move(meshData));
+    for (size_t i = 0; i < node->mNumChildren; i++)
+    {
+        collectMeshes(node->mChildren[i], scene, meshes, visited);
+    }
+}
+
+void Model::AssimpObj::processScene(const aiScene* scene)
+{
+    // flatten the node tree first, a mesh referenced by several nodes is converted once
+    std::vector<aiMesh*> meshes;
+    std::vector<bool> visited(scene->mNumMeshes, false);
+    collectMeshes(scene->mRootNode, scene, meshes, visited);
 
-        std::string matName = material->GetName().C_Str();
-        if (matNameToIdx.find(matName) == matNameToIdx.end())
+    // materials are cheap to fill and queue their texture decodes, which then overlap with the mesh conversion
+    auto folder = m_filePath.parent_path();
+    std::vector<size_t> materialToIdx(scene->mNumMaterials, std::numeric_limits<size_t>::max());
+    m_modelData.meshDatas.resize(meshes.size());
+    m_modelData.materialIndexs.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        aiMesh* mesh = meshes[i];
+        size_t& matIdx = materialToIdx[mesh->mMaterialIndex];
+        if (matIdx == std::numeric_limits<size_t>::max())
         {
+            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
             MaterialData materialData;
-            materialData.name = matName;
+            materialData.name = material->GetName().C_Str();
             fillTextureData(materialData.textureDatas, mesh, material, folder);
-            matNameToIdx[matName] = m_modelData.materialDatas.size();
+            matIdx = m_modelData.materialDatas.size();
             m_modelData.materialDatas.emplace_back(std::move(materialData));
         }
+        m_modelData.materialIndexs[i] = matIdx;
+        m_modelData.meshDatas[i].name = mesh->mName.C_Str();
+    }
 
-        m_modelData.materialIndexs.emplace_back(matNameToIdx[matName]);
+    // mesh sizes vary a lot, so the workers pull meshes one at a time instead of taking fixed ranges
+    std::atomic<size_t> next{0};
+    std::vector<MeshStats> statsBefore(meshes.size()), statsAfter(meshes.size());
+#ifndef NDEBUG
+    // an exception must not leave a worker thread, the failures are thrown after the join
+    std::vector<std::string> meshletErrors(meshes.size());
+#endif
+    Util::Parallel::parallelFor(Util::Parallel::workerCount(), [&](size_t, size_t, uint32_t)
+    {
+        for (size_t i = next++; i < meshes.size(); i = next++)
+        {
+            fillMeshData(m_modelData.meshDatas[i], meshes[i]);
+            // aiProcess_Triangulate keeps points and lines, only pure triangle lists are reordered
+            if (m_optimizeMeshes && meshes[i]->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            {
+                statsBefore[i] = analyzeMesh(m_modelData.meshDatas[i]);
+                optimizeMesh(m_modelData.meshDatas[i]);
+                statsAfter[i] = analyzeMesh(m_modelData.meshDatas[i]);
+                buildMeshlets(m_modelData.meshDatas[i]);
+#ifndef NDEBUG
+                validateMeshlets(m_modelData.meshDatas[i], &meshletErrors[i]);
+#endif
+                generateLods(m_modelData.meshDatas[i]);
+            }
+        }
+    }, (uint32_t)meshes.size());
+#ifndef NDEBUG
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        if (!meshletErrors[i].empty())
+        {
+            throw std::runtime_error("invalid meshlets in " + m_modelData.meshDatas[i].name + ": " + meshletErrors[i]);
+        }
     }
+#endif
 
-    for (size_t i = 0; i < node->mNumChildren; i++)
+    if (m_optimizeMeshes)
     {
-        processNode(node->mChildren[i], scene);
+        MeshStats before, after;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            before += statsBefore[i];
+            after += statsAfter[i];
+        }
+        std::cout << "[AssimpObj] " << m_filePath.filename().string() << " optimized, before: " << before.ToString()
+                  << " after: " << after.ToString() << std::endl;
+
+        size_t meshletCount = 0;
+        for (const auto& meshData : m_modelData.meshDatas)
+        {
+            meshletCount += meshData.meshlets.size();
+        }
+        std::cout << "[AssimpObj] " << meshletCount << " meshlets" << std::endl;
+
+        // meshes without a coarser lod count with their last one, as they are drawn
+        std::cout << "[AssimpObj] triangles per lod:";
+        for (uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++)
+        {
+            uint64_t triangles = 0;
+            for (const auto& meshData : m_modelData.meshDatas)
+            {
+                triangles += meshData.GetLod(lod).indexCount / 3;
+            }
+            std::cout << " " << triangles;
+        }
+        std::cout << std::endl;
     }
 }
 
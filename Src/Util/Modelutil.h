@@ -1,13 +1,16 @@
 #pragma once
 
 
+#include "Util/Parallelutil.h"
 #include "Util/Textureutil.h"
 #include "vulkan/vulkan_enums.hpp"
 #include <assimp/material.h>
 #include <assimp/scene.h>
 #include <boost/filesystem/path.hpp>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
 #include <glm/glm.hpp>
 
@@ -29,11 +32,83 @@ struct VertexData
     }
 };
 
+// layout of the vertex buffer uploaded for a mesh, VertexData stays the cpu side copy
+enum class VertexFormat
+{
+    kFull,      // VertexData, 80 bytes
+    kPacked,    // PackedVertexData, 24 bytes
+    kQuantized  // QuantizedVertexData, 20 bytes
+};
+
+// float3 position, half2 uv, octahedral snorm16 normal, octahedral snorm8 tangent with the bitangent sign in z
+struct PackedVertexData
+{
+    glm::vec3 position;
+    uint16_t texCoord[2];
+    int16_t normal[2];
+    int8_t tangent[4];
+};
+static_assert(sizeof(PackedVertexData) == 24, "PackedVertexData must match the vertex attribute offsets");
+
+// as PackedVertexData, but the position is unorm16 within the mesh aabb, w unused
+struct QuantizedVertexData
+{
+    uint16_t position[4];
+    uint16_t texCoord[2];
+    int16_t normal[2];
+    int8_t tangent[4];
+};
+static_assert(sizeof(QuantizedVertexData) == 20, "QuantizedVertexData must match the vertex attribute offsets");
+
+// per mesh, read per instance by the packed vertex shaders: position = offset + scale * stored position
+struct VertexDequantization
+{
+    glm::vec4 offset;
+    glm::vec4 scale;
+};
+
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    // object space deviation from lod 0
+    float error;
+};
+
+// std430 layout, read by meshlet.cull.comp
+struct Meshlet
+{
+    glm::vec4 sphere;           // object space bounding sphere, xyz center, w radius
+    glm::vec4 coneApex;         // xyz apex of the normal cone
+    glm::vec4 coneAxisCutoff;   // xyz axis, w cutoff: back facing for every eye with dot(normalize(apex - eye), axis) >= cutoff
+    uint32_t indexOffset;       // into MeshData::indices, the triangles of a meshlet are contiguous
+    uint32_t triangleCount;
+    uint32_t pad[2];
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet must match the std430 struct of meshlet.cull.comp");
+
 struct MeshData
 {
     std::string name;
     std::vector<VertexData> vertices;
+    // lod 0 first, the coarser lods follow it and share the vertices
     std::vector<uint32_t> indices;
+    // object space aabb of the positions
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    // empty means indices is a single lod
+    std::vector<MeshLod> lods;
+    // partition of lod 0, empty if it was not split
+    std::vector<Meshlet> meshlets;
+
+    void ComputeBounds();
+    // clamped to the coarsest lod
+    MeshLod GetLod(uint32_t lod) const;
+    inline uint32_t GetLodCount() const { return lods.empty() ? 1 : (uint32_t)lods.size(); }
+    // every index fits in an uint16_t, the gpu and cache copies are then stored with 16 bits
+    inline bool FitsIndex16() const { return vertices.size() <= INDEX16_VERTEX_LIMIT; }
+
+    static constexpr size_t INDEX16_VERTEX_LIMIT = 65536;
 };
 
 struct TextureData
@@ -64,7 +139,8 @@ class TinyObj
 private:
     MeshData m_meshData;
 public:
-    explicit TinyObj(const boost::filesystem::path& objPath);
+    // optimizeMeshes runs the vertex cache / overdraw / fetch pass of Util/Meshutil.h, the result is cached separately
+    explicit TinyObj(const boost::filesystem::path& objPath, bool optimizeMeshes = true);
     ~TinyObj() = default;
 
     const std::vector<VertexData>* GetPVertices() { return &m_meshData.vertices; }
@@ -75,19 +151,29 @@ class AssimpObj
 {
 private:
     boost::filesystem::path m_filePath;
+    bool m_optimizeMeshes;
     ModelData m_modelData;
 
-    std::map<boost::filesystem::path, std::shared_ptr<Util::Texture::RawData>> m_textureDataMap;
+    std::map<Util::Texture::DecodeKey, std::shared_ptr<Util::Texture::RawData>> m_textureDataMap;
+    // decodes in flight on m_pTexturePool while the meshes are converted, same keys as m_textureDataMap
+    std::map<Util::Texture::DecodeKey, std::shared_future<std::shared_ptr<Util::Texture::RawData>>> m_textureLoads;
+    std::mutex m_textureMutex;
+    std::unique_ptr<Util::Parallel::ThreadPool> m_pTexturePool;
 public:
-    explicit AssimpObj(const boost::filesystem::path& objPath);
+    // optimizeMeshes runs the vertex cache / overdraw / fetch pass of Util/Meshutil.h, the result is cached separately
+    explicit AssimpObj(const boost::filesystem::path& objPath, bool optimizeMeshes = true);
     ~AssimpObj() = default;
 
     const ModelData* GetPModelData() { return &m_modelData; }
     ModelData&& MoveModelData() { return std::move(m_modelData); }
 private:
-    void processNode(aiNode* node, const aiScene* scene);
+    // depth first, each scene mesh once
+    void collectMeshes(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes, std::vector<bool>& visited);
+    void processScene(const aiScene* scene);
     void fillMeshData(Util::Model::MeshData& meshData, aiMesh* mesh);
     void fillTextureData(std::vector<Util::Model::TextureData>& textureDatas, aiMesh* mesh, aiMaterial* material, const boost::filesystem::path& textureFolderPath);
+    // waits for the queued decodes and hands the results to the material texture datas
+    void resolveTextureData();
 
 };
 
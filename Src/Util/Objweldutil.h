@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Util/Modelutil.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// shared by Model::TinyObj and Benchmark/, the index and attribute types are tinyobj::index_t and tinyobj::attrib_t.
+// templates, so this header does not pull in tiny_obj_loader.h ahead of its implementation in Modelutil.cpp
+
+namespace Util { namespace Model {
+
+// open addressing map from a packed (position, texcoord) index pair to the welded vertex index.
+// linear probing in a power of two table kept at most half full, lookup and insert share a single probe sequence
+class VertexWelder
+{
+public:
+    explicit VertexWelder(size_t maxKeys)
+    {
+        size_t capacity = 16;
+        while (capacity < maxKeys * 2)
+        {
+            capacity <<= 1;
+        }
+        m_keys.assign(capacity, EMPTY_KEY);
+        m_values.resize(capacity);
+        m_mask = capacity - 1;
+    }
+
+    // true if the key was present, otherwise newIndex is stored. index receives the stored value either way
+    bool FindOrInsert(uint64_t key, uint32_t newIndex, uint32_t& index)
+    {
+        for (size_t slot = mix(key) & m_mask;; slot = (slot + 1) & m_mask)
+        {
+            if (m_keys[slot] == key)
+            {
+                index = m_values[slot];
+                return true;
+            }
+            if (m_keys[slot] == EMPTY_KEY)
+            {
+                m_keys[slot] = key;
+                m_values[slot] = newIndex;
+                index = newIndex;
+                return false;
+            }
+        }
+    }
+
+    template<typename Index>
+    static inline uint64_t PackKey(const Index& index)
+    {
+        return (uint64_t)(uint32_t)index.vertex_index << 32 | (uint32_t)index.texcoord_index;
+    }
+
+private:
+    // splitmix64 finalizer, every key bit affects every slot bit
+    static inline uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+private:
+    // vertex_index is never negative, so the all ones key cannot occur
+    static constexpr uint64_t EMPTY_KEY = ~0ull;
+
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_values;
+    size_t m_mask = 0;
+};
+
+// position and texcoord of one obj index, the only attributes TinyObj reads
+template<typename Attrib, typename Index>
+VertexData makeObjVertex(const Attrib& attrib, const Index& index)
+{
+    VertexData vertex{};
+    vertex.position = glm::vec4
+    {
+        attrib.vertices[3 * index.vertex_index + 0],
+        attrib.vertices[3 * index.vertex_index + 1],
+        attrib.vertices[3 * index.vertex_index + 2],
+        1.0f
+    };
+
+    if (index.texcoord_index >= 0)
+    {
+        vertex.texCoord = glm::vec4
+        {
+            attrib.texcoords[2 * index.texcoord_index + 0],
+            1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+            0.f,0.f
+        };
+    }
+    return vertex;
+}
+
+}}
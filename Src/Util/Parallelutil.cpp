@@ -0,0 +1,87 @@
+#include "Parallelutil.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Util {
+
+uint32_t Parallel::workerCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void Parallel::parallelFor(size_t count, const std::function<void(size_t, size_t, uint32_t)>& fn, uint32_t maxWorkers)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    uint32_t workers = maxWorkers == 0 ? workerCount() : std::min(maxWorkers, workerCount());
+    workers = (uint32_t)std::min<size_t>(workers, count);
+    if (workers == 1)
+    {
+        fn(0, count, 0);
+        return;
+    }
+
+    size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (uint32_t w = 1; w < workers; w++)
+    {
+        size_t begin = std::min(count, chunk * w);
+        size_t end = std::min(count, begin + chunk);
+        threads.emplace_back(fn, begin, end, w);
+    }
+    fn(0, std::min(count, chunk), 0);
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+Parallel::ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    threadCount = threadCount == 0 ? workerCount() : threadCount;
+    m_workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+Parallel::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void Parallel::ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
+
+}
\ No newline at end of file
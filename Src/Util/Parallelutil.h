@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Util { namespace Parallel {
+
+// hardware threads, at least 1
+uint32_t workerCount();
+
+// splits [0, count) into contiguous ranges, one per worker, and blocks until all are done.
+// the calling thread runs worker 0. fn(begin, end, workerIdx)
+void parallelFor(size_t count, const std::function<void(size_t, size_t, uint32_t)>& fn, uint32_t maxWorkers = 0);
+
+// fixed set of worker threads draining a fifo of tasks. destruction finishes the queued tasks first
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename Fn>
+    std::future<std::invoke_result_t<Fn>> Submit(Fn&& fn)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Fn>()>>(std::forward<Fn>(fn));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace([task]() { (*task)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+    inline uint32_t GetThreadCount() const { return (uint32_t)m_workers.size(); }
+
+private:
+    void workerLoop();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+}}
@@ -0,0 +1,282 @@
+#include "Texturecacheutil.h"
+#include "Util/Fileutil.h"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <ktx.h>
+#include <memory>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Util { namespace Texture {
+
+namespace {
+
+// through a temporary file, so an interrupted run never leaves a truncated cache behind
+KTX_error_code writeFile(ktxTexture* texture, const boost::filesystem::path& path)
+{
+    boost::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    KTX_error_code ret = ktxTexture_WriteToNamedFile(texture, tmpPath.string().c_str());
+    boost::system::error_code err;
+    if (ret == KTX_SUCCESS)
+    {
+        boost::filesystem::rename(tmpPath, path, err);
+    }
+    if (ret != KTX_SUCCESS || err)
+    {
+        boost::filesystem::remove(tmpPath, err);
+        return ret != KTX_SUCCESS ? ret : KTX_FILE_WRITE_ERROR;
+    }
+    return KTX_SUCCESS;
+}
+
+}
+
+TextureCache::TextureCache(const boost::filesystem::path& sourcePath, Semantic semantic)
+    : m_sourcePath(sourcePath)
+    , m_semantic(semantic)
+{
+    const uint32_t settings[] = { CACHE_VERSION, UASTC_LEVEL, ZSTD_LEVEL, (uint32_t)m_semantic };
+    uint64_t key = Util::File::hashBytes(settings, sizeof(settings));
+    if (!Util::File::hashFile(m_sourcePath, key))
+    {
+        std::cout << "[TextureCache] source not readable, cache disabled: " << m_sourcePath.string() << std::endl;
+        return;
+    }
+    m_key = key != 0 ? key : 1;
+}
+
+boost::filesystem::path TextureCache::GetCachePath() const
+{
+    std::stringstream name;
+    name << m_sourcePath.filename().string() << "." << toString(m_semantic) << "."
+         << std::hex << std::setw(16) << std::setfill('0') << m_key << ".ktx2";
+    return m_sourcePath.parent_path() / name.str();
+}
+
+boost::filesystem::path TextureCache::GetTranscodedPath() const
+{
+    boost::filesystem::path path = GetCachePath();
+    return path.replace_extension(isBlockCompressionSupported() ? ".bc.ktx2" : ".rgba8.ktx2");
+}
+
+std::shared_ptr<RawData> TextureCache::Load() const
+{
+    if (!IsValid())
+    {
+        return nullptr;
+    }
+
+    boost::filesystem::path transcodedPath = GetTranscodedPath();
+    if (Util::File::fileExist(transcodedPath))
+    {
+        if (auto rawData = RawData::Load(transcodedPath, RawData::Format::eRgbAlpha))
+        {
+            return rawData;
+        }
+        std::cout << "[TextureCache] ignore invalid cache file: " << transcodedPath.string() << std::endl;
+    }
+
+    boost::filesystem::path path = GetCachePath();
+    if (!Util::File::fileExist(path))
+    {
+        return nullptr;
+    }
+    if (transcode(transcodedPath))
+    {
+        if (auto rawData = RawData::Load(transcodedPath, RawData::Format::eRgbAlpha))
+        {
+            return rawData;
+        }
+    }
+
+    // transcoded again on every load of the payload
+    auto rawData = RawData::Load(path, RawData::Format::eRgbAlpha);
+    if (!rawData)
+    {
+        std::cout << "[TextureCache] ignore invalid cache file: " << path.string() << std::endl;
+    }
+    return rawData;
+}
+
+std::shared_ptr<RawData> TextureCache::Cook(RawData& rawData) const
+{
+    if (!IsValid() || rawData.IsCompressed() || rawData.GetFormat() == RawData::Format::eRgb)
+    {
+        return nullptr;
+    }
+    RawData::Payload payload = rawData.AcquireData();
+    if (!payload)
+    {
+        return nullptr;
+    }
+
+    const uint32_t channels = (uint32_t)rawData.GetFormat();
+    ktxTextureCreateInfo createInfo{};
+    createInfo.vkFormat = (ktx_uint32_t)rawData.GetVkFormat();
+    createInfo.baseWidth = (ktx_uint32_t)rawData.GetWidth();
+    createInfo.baseHeight = (ktx_uint32_t)rawData.GetHeight();
+    createInfo.baseDepth = 1;
+    createInfo.numDimensions = 2;
+    createInfo.numLevels = getMipLevelCount(createInfo.baseWidth, createInfo.baseHeight);
+    createInfo.numLayers = 1;
+    createInfo.numFaces = 1;
+    createInfo.isArray = KTX_FALSE;
+    createInfo.generateMipmaps = KTX_FALSE;
+
+    ktxTexture2* texture = nullptr;
+    if (ktxTexture2_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+    {
+        std::cout << "[TextureCache] create ktx texture failed: " << m_sourcePath.string() << std::endl;
+        return nullptr;
+    }
+
+    // the loaders already decode one texture per worker, so the encoder stays single threaded
+    ktxBasisParams params{};
+    params.structSize = sizeof(params);
+    params.uastc = KTX_TRUE;
+    params.uastcFlags = UASTC_LEVEL;
+    params.threadCount = 1;
+    // spelled out so the transcoder side can rely on it, bc4 / bc5 read r / r and a
+    if (channels == 1)
+    {
+        std::memcpy(params.inputSwizzle, "rrr1", 4);
+    }
+    else if (channels == 2)
+    {
+        std::memcpy(params.inputSwizzle, "rrrg", 4);
+    }
+    KTX_error_code ret = ktxTexture_SetImageFromMemory(ktxTexture(texture), 0, 0, 0, payload.Get(), (ktx_size_t)rawData.GetDataSize());
+
+    // the mip chain is filtered from the source texels, block compressed levels cannot be blitted at load time
+    std::vector<unsigned char> level;
+    const unsigned char* src = payload.Get();
+    uint32_t width = createInfo.baseWidth;
+    uint32_t height = createInfo.baseHeight;
+    for (uint32_t levelIdx = 1; levelIdx < createInfo.numLevels && ret == KTX_SUCCESS; levelIdx++)
+    {
+        level = downsample(src, width, height, channels);
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+        src = level.data();
+        ret = ktxTexture_SetImageFromMemory(ktxTexture(texture), levelIdx, 0, 0, level.data(), level.size());
+    }
+    if (ret == KTX_SUCCESS)
+    {
+        ret = ktxTexture2_CompressBasisEx(texture, &params);
+    }
+    if (ret == KTX_SUCCESS)
+    {
+        ret = ktxTexture2_DeflateZstd(texture, ZSTD_LEVEL);
+    }
+
+    boost::filesystem::path path = GetCachePath();
+    if (ret == KTX_SUCCESS)
+    {
+        ret = writeFile(ktxTexture(texture), path);
+    }
+    ktxTexture_Destroy(ktxTexture(texture));
+    if (ret != KTX_SUCCESS)
+    {
+        std::cout << "[TextureCache] cook failed (" << ktxErrorString(ret) << "): " << m_sourcePath.string() << std::endl;
+        return nullptr;
+    }
+
+    removeStaleFiles();
+    boost::system::error_code err;
+    std::cout << "[TextureCache] cooked " << path.filename().string() << " ("
+              << rawData.GetDataSize() / 1024 << " KB -> " << boost::filesystem::file_size(path, err) / 1024 << " KB)" << std::endl;
+    return Load();
+}
+
+bool TextureCache::transcode(const boost::filesystem::path& transcodedPath) const
+{
+    ktxTexture2* texture = nullptr;
+    KTX_error_code ret = ktxTexture2_CreateFromNamedFile(GetCachePath().string().c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
+    if (ret != KTX_SUCCESS)
+    {
+        return false;
+    }
+
+    // the count picks the component mapping, the descriptor of the target no longer has it
+    uint32_t componentCount = ktxTexture2_GetNumComponents(texture);
+    if (ktxTexture2_NeedsTranscoding(texture))
+    {
+        ret = ktxTexture2_TranscodeBasis(texture, getTranscodeFormat(componentCount), 0);
+    }
+    if (ret == KTX_SUCCESS)
+    {
+        std::string value = std::to_string(componentCount);
+        ret = ktxHashList_AddKVPair(&texture->kvDataHead, KTX_COMPONENT_COUNT_KEY, (unsigned int)value.size() + 1, value.c_str());
+    }
+    if (ret == KTX_SUCCESS)
+    {
+        ret = writeFile(ktxTexture(texture), transcodedPath);
+    }
+    ktxTexture_Destroy(ktxTexture(texture));
+    if (ret != KTX_SUCCESS)
+    {
+        std::cout << "[TextureCache] transcode failed (" << ktxErrorString(ret) << "): " << m_sourcePath.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TextureCache::removeStaleFiles() const
+{
+    const std::string prefix = m_sourcePath.filename().string() + "." + toString(m_semantic) + ".";
+    const std::string keep = GetCachePath().filename().string().substr(prefix.size(), 16);
+    boost::system::error_code err;
+    for (boost::filesystem::directory_iterator it(m_sourcePath.parent_path(), err), end; !err && it != end; it.increment(err))
+    {
+        const boost::filesystem::path& path = it->path();
+        std::string filename = path.filename().string();
+        if (filename.rfind(prefix, 0) != 0 || path.extension() != ".ktx2")
+        {
+            continue;
+        }
+        // only <file>.<16 hex digits>[.bc|.rgba8].ktx2, other ktx2 files sharing the prefix are left alone
+        std::string suffix = filename.substr(std::min(filename.size(), prefix.size() + 16));
+        if (filename.size() >= prefix.size() + 16 && filename.compare(prefix.size(), 16, keep) != 0
+            && (suffix == ".ktx2" || suffix == ".bc.ktx2" || suffix == ".rgba8.ktx2"))
+        {
+            boost::system::error_code removeErr;
+            boost::filesystem::remove(path, removeErr);
+        }
+    }
+}
+
+std::shared_ptr<RawData> loadCooked(const boost::filesystem::path& sourcePath, Semantic semantic)
+{
+    // already gpu ready, nothing to cook
+    std::string extension = Util::File::getLowerExtension(sourcePath);
+    if (extension == ".ktx" || extension == ".ktx2")
+    {
+        return RawData::Load(sourcePath, RawData::Format::eRgbAlpha);
+    }
+
+    TextureCache cache(sourcePath, semantic);
+    auto rawData = cache.Load();
+    if (!rawData)
+    {
+        rawData = RawData::Load(sourcePath, RawData::Format::eRgbAlpha);
+        if (!rawData)
+        {
+            return nullptr;
+        }
+        rawData->Narrow(semantic);
+        if (auto cooked = cache.Cook(*rawData))
+        {
+            rawData = cooked;
+        }
+    }
+    rawData->SetComponents(getComponentMapping(semantic, (uint32_t)rawData->GetChannel(), rawData->GetVkFormat()));
+    return rawData;
+}
+
+}}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Util/Textureutil.h"
+#include <boost/filesystem/path.hpp>
+#include <memory>
+#include <stdint.h>
+
+namespace Util { namespace Texture {
+
+// Cooked copy of a source image, written next to it as <file>.<semantic>.<key>.ktx2.
+// The payload is basis universal (uastc) with zstd supercompression and a full mip chain, the key hashes the source file and the cook settings.
+// The first load transcodes it to bc4 / bc5 / bc7 by its component count when the device samples bc, to rgba8 otherwise, see setBlockCompressionSupported,
+// and keeps the result as <file>.<semantic>.<key>.<bc|rgba8>.ktx2. Loads of that read the header only, its levels are read untouched when the payload is needed
+class TextureCache
+{
+public:
+    TextureCache(const boost::filesystem::path& sourcePath, Semantic semantic);
+
+    boost::filesystem::path GetCachePath() const;
+    // the transcoded copy for the current device
+    boost::filesystem::path GetTranscodedPath() const;
+    std::shared_ptr<RawData> Load() const;
+    // encodes rawData narrowed to the semantic, then loads the written file back
+    std::shared_ptr<RawData> Cook(RawData& rawData) const;
+    inline bool IsValid() const { return m_key != 0; }
+
+private:
+    // writes the transcoded copy of the cooked file
+    bool transcode(const boost::filesystem::path& transcodedPath) const;
+    // the cooked and transcoded files of other keys
+    void removeStaleFiles() const;
+
+private:
+    static constexpr uint32_t CACHE_VERSION = 3;
+    static constexpr uint32_t UASTC_LEVEL = 2; // KTX_PACK_UASTC_LEVEL_DEFAULT
+    static constexpr uint32_t ZSTD_LEVEL = 18;
+
+    boost::filesystem::path m_sourcePath;
+    Semantic m_semantic;
+    uint64_t m_key = 0;
+};
+
+// the cooked texture of sourcePath, cooked first when missing or stale. falls back to the narrowed decode when cooking fails.
+// the component mapping of the result is set for the semantic
+std::shared_ptr<RawData> loadCooked(const boost::filesystem::path& sourcePath, Semantic semantic);
+
+}}
@@ -5,6 +5,7 @@
 #include <boost/system/detail/error_code.hpp>
 
 #include <cctype>
+#include <cstring>
 #include <fstream>
 #include <ios>
 #include <sstream>
@@ -278,4 +279,53 @@ std::string File::getLowerExtension(const boost::filesystem::path& path)
     std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return std::tolower(c); });
     return extension;
 }
-}
\ No newline at end of file
+
+uint64_t File::hashBytes(const void* data, std::size_t size, uint64_t hash)
+{
+    constexpr uint64_t FNV_PRIME = 1099511628211ull;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash ^= word;
+        hash *= FNV_PRIME;
+    }
+    for (; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool File::hashFile(const boost::filesystem::path& path, uint64_t& hash)
+{
+    if (!fileExist(path) || (!canRead(path) && !makeFileReadable(path)))
+    {
+        return false;
+    }
+
+    std::ifstream file(path.string(), std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    // streamed, a chunk size that is a multiple of the 8 byte word hashes the same as the whole file at once
+    constexpr std::size_t CHUNK_SIZE = 1 << 20;
+    std::vector<char> chunk(CHUNK_SIZE);
+    uint64_t result = hash;
+    while (file)
+    {
+        file.read(chunk.data(), (std::streamsize)chunk.size());
+        result = hashBytes(chunk.data(), (std::size_t)file.gcount(), result);
+    }
+    if (file.bad())
+    {
+        return false;
+    }
+    hash = result;
+    return true;
+}
+}
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <ios>
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <boost/filesystem.hpp>
@@ -36,4 +37,9 @@ bool writeFile(const boost::filesystem::path& path, const std::vector<char>& con
 bool writeFile(const boost::filesystem::path& path, const unsigned char* file, std::size_t filesize, eFileOpenMode mode = eFileOpenMode::kBinary, bool trunc = true);
 
 std::string getLowerExtension(const boost::filesystem::path& path);
+
+// fnv-1a over 8 byte words, for cache keys, not for security
+constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+uint64_t hashBytes(const void* data, std::size_t size, uint64_t hash = HASH_SEED);
+bool hashFile(const boost::filesystem::path& path, uint64_t& hash);
 }}
\ No newline at end of file
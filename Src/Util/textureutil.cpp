@@ -1,9 +1,14 @@
 #include "Textureutil.h"
 #include "Util/Fileutil.h"
 #include "vulkan/vulkan_enums.hpp"
+#include <algorithm>
 #include <assimp/material.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <ktx.h>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -11,13 +16,69 @@
 
 namespace Util {
 
+static std::atomic<bool> g_blockCompressionSupported = false;
+
+Texture::RawData::Payload::Payload(std::shared_ptr<RawData> rawData, const unsigned char* data)
+    : m_rawData(std::move(rawData))
+    , m_data(data)
+{
+}
+
+Texture::RawData::Payload::Payload(Payload&& other) noexcept
+    : m_rawData(std::move(other.m_rawData))
+    , m_data(other.m_data)
+{
+    other.m_data = nullptr;
+}
+
+Texture::RawData::Payload& Texture::RawData::Payload::operator=(Payload&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_rawData = std::move(other.m_rawData);
+        m_data = other.m_data;
+        other.m_data = nullptr;
+    }
+    return *this;
+}
+
+Texture::RawData::Payload::~Payload()
+{
+    release();
+}
+
+void Texture::RawData::Payload::release()
+{
+    if (m_rawData)
+    {
+        m_rawData->releasePayload();
+        m_rawData.reset();
+    }
+    m_data = nullptr;
+}
+
 Texture::RawData::~RawData()
 {
-    FreeData();
+    // a Payload keeps its raw data alive, so nothing holds this one anymore
+    assert(payloadHolders == 0);
+    freePayload();
 }
 
 void Texture::RawData::FreeData()
 {
+    std::lock_guard<std::mutex> lock(payloadMutex);
+    if (payloadHolders > 0)
+    {
+        freeRequested = true;
+        return;
+    }
+    freePayload();
+}
+
+void Texture::RawData::freePayload()
+{
+    freeRequested = false;
     if (ktxTexture)
     {
         ktxTexture_Destroy(ktxTexture);
@@ -26,6 +87,13 @@ void Texture::RawData::FreeData()
         return;
     }
 
+    if (!storage.empty())
+    {
+        storage = std::vector<unsigned char>();
+        data = nullptr;
+        return;
+    }
+
     if (data)
     {
         stbi_image_free(data);
@@ -33,7 +101,95 @@ void Texture::RawData::FreeData()
     }
 }
 
-int Texture::RawData::GetDataSize()
+void Texture::RawData::releasePayload()
+{
+    std::lock_guard<std::mutex> lock(payloadMutex);
+    assert(payloadHolders > 0);
+    if (--payloadHolders == 0 && freeRequested)
+    {
+        freePayload();
+    }
+}
+
+Texture::RawData::Payload Texture::RawData::AcquireData()
+{
+    std::lock_guard<std::mutex> lock(payloadMutex);
+    if (!data && !loadData())
+    {
+        return Payload();
+    }
+    // a free requested by someone else no longer applies to a payload that is wanted again
+    freeRequested = false;
+    payloadHolders++;
+    return Payload(shared_from_this(), data);
+}
+
+bool Texture::RawData::ReadData(unsigned char* dst, size_t size)
+{
+    assert(dst && size >= (size_t)dataSize);
+    std::lock_guard<std::mutex> lock(payloadMutex);
+    if (!data && ktxTexture)
+    {
+        // libktx closes the file once the image data is loaded, so the texture goes with it and a later load starts over.
+        // nobody holds a payload that is not loaded, so nothing reads the texture meanwhile
+        KTX_error_code ret = ktxTexture_LoadImageData(ktxTexture, dst, (ktx_size_t)size);
+        ktxTexture_Destroy(ktxTexture);
+        ktxTexture = nullptr;
+        if (ret != KTX_SUCCESS)
+        {
+            std::cout << "read texture failed (" << ktxErrorString(ret) << "): " + path.string() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    if (!data && !loadData())
+    {
+        return false;
+    }
+    std::memcpy(dst, data, (size_t)dataSize);
+    return true;
+}
+
+bool Texture::RawData::loadData()
+{
+    if (!ktxTexture)
+    {
+        if (path.empty())
+        {
+            return false;
+        }
+        // freed before, decoded again the way it was the first time
+        auto reloaded = Load(path, loadFormat, isCubeMap, loadVkFormat);
+        if (reloaded && narrowed)
+        {
+            reloaded->Narrow(*narrowed);
+        }
+        if (!reloaded || reloaded->dataSize != dataSize || reloaded->vkFormat != vkFormat)
+        {
+            std::cout << "reload texture failed, file changed since it was loaded: " + path.string() << std::endl;
+            return false;
+        }
+        std::swap(ktxTexture, reloaded->ktxTexture);
+        std::swap(storage, reloaded->storage);
+        std::swap(data, reloaded->data);
+        if (data)
+        {
+            return true;
+        }
+    }
+
+    KTX_error_code ret = ktxTexture_LoadImageData(ktxTexture, nullptr, 0);
+    if (ret != KTX_SUCCESS)
+    {
+        std::cout << "read texture failed (" << ktxErrorString(ret) << "): " + path.string() << std::endl;
+        return false;
+    }
+    data = ktxTexture_GetData(ktxTexture);
+    return data != nullptr;
+}
+
+int Texture::RawData::computeDataSize()
 {
     if (ktxTexture)
     {
@@ -42,6 +198,14 @@ int Texture::RawData::GetDataSize()
 
     switch (format)
     {
+    case Format::eGrey:
+    {
+        return width * height;
+    }
+    case Format::eGreyAlpha:
+    {
+        return width * height * 2;
+    }
     case Format::eRgb:
     {
         // assert(channel == 3);
@@ -62,15 +226,94 @@ int Texture::RawData::GetDataSize()
 
 size_t Util::Texture::RawData::GetLevelOffset(uint32_t level, uint32_t face)
 {
-    if (mipLevels == 1 || !ktxTexture)
+    if (levelOffsets.empty())
+    {
+        return 0;
+    }
+    assert(level < (uint32_t)mipLevels && face < faceCount);
+    return levelOffsets[level * faceCount + face];
+}
+
+size_t Util::Texture::RawData::GetLevelSize(uint32_t level)
+{
+    if (levelSizes.empty())
+    {
+        assert(level == 0);
+        return (size_t)dataSize / faceCount;
+    }
+    assert(level < (uint32_t)mipLevels);
+    return levelSizes[level];
+}
+
+uint64_t Texture::RawData::GetContentHash()
+{
+    if (contentHash != 0)
+    {
+        return contentHash;
+    }
+    // transcoding depends on the device, so bc and rgba8 loads of one file differ
+    const uint32_t settings[] = {
+        (uint32_t)loadFormat, (uint32_t)loadVkFormat, (uint32_t)isCubeMap,
+        narrowed ? 1 + (uint32_t)*narrowed : 0, (uint32_t)isBlockCompressionSupported()
+    };
+    uint64_t hash = Util::File::hashBytes(settings, sizeof(settings));
+    if (path.empty() || !Util::File::hashFile(path, hash))
     {
         return 0;
     }
+    contentHash = hash != 0 ? hash : 1;
+    return contentHash;
+}
+
+void Texture::RawData::Narrow(Semantic semantic)
+{
+    assert(!ktxTexture && data && format == Format::eRgbAlpha && vkFormat == vk::Format::eR8G8B8A8Unorm);
+    narrowed = semantic;
+    contentHash = 0;
+    if (semantic == Semantic::kColor)
+    {
+        vkFormat = vk::Format::eR8G8B8A8Srgb;
+        channel = 4;
+        return;
+    }
 
-    size_t offset = 0;
-    KTX_error_code ret = ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
-    assert(ret == KTX_SUCCESS);
-    return offset;
+    size_t texelCount = (size_t)width * height;
+    uint32_t channels = 2;
+    if (semantic == Semantic::kData)
+    {
+        bool grey = true;
+        bool opaque = true;
+        for (size_t i = 0; i < texelCount && (grey || opaque); i++)
+        {
+            const unsigned char* texel = data + i * 4;
+            grey = grey && texel[0] == texel[1] && texel[1] == texel[2];
+            opaque = opaque && texel[3] == 255;
+        }
+        channels = grey ? (opaque ? 1 : 2) : 4;
+    }
+    channel = channels;
+    if (channels == 4)
+    {
+        return;
+    }
+
+    // normal maps keep x and y, grey data keeps its value and alpha
+    uint32_t second = semantic == Semantic::kNormal ? 1 : 3;
+    std::vector<unsigned char> narrowed(texelCount * channels);
+    for (size_t i = 0; i < texelCount; i++)
+    {
+        narrowed[i * channels] = data[i * 4];
+        if (channels == 2)
+        {
+            narrowed[i * channels + 1] = data[i * 4 + second];
+        }
+    }
+    FreeData();
+    storage = std::move(narrowed);
+    data = storage.data();
+    format = channels == 1 ? Format::eGrey : Format::eGreyAlpha;
+    vkFormat = channels == 1 ? vk::Format::eR8Unorm : vk::Format::eR8G8Unorm;
+    dataSize = computeDataSize();
 }
 
 std::shared_ptr<Util::Texture::RawData> Util::Texture::RawData::Load(const boost::filesystem::path& texturePath, Texture::RawData::Format format, bool cubemap,  vk::Format fmt)
@@ -78,6 +321,9 @@ std::shared_ptr<Util::Texture::RawData> Util::Texture::RawData::Load(const boost
     std::shared_ptr<Util::Texture::RawData> rawData = std::make_shared<Util::Texture::RawData>(format);
     rawData->isCubeMap = cubemap;
     rawData->vkFormat = fmt;
+    rawData->path = texturePath;
+    rawData->loadFormat = format;
+    rawData->loadVkFormat = fmt;
     if (!Util::File::fileExist(texturePath))
     {
         std::cout << "load texture failed, file not exist: " + texturePath.string() << std::endl;
@@ -85,19 +331,71 @@ std::shared_ptr<Util::Texture::RawData> Util::Texture::RawData::Load(const boost
     }
 
     std::string extension = Util::File::getLowerExtension(texturePath);
-    if (extension == ".ktx")
+    if (extension == ".ktx" || extension == ".ktx2")
     {
-        ktxResult result = ktxTexture_CreateFromNamedFile(texturePath.string().c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &rawData->ktxTexture);
-        assert(result == KTX_SUCCESS);
+        // only the header is read here, the image data waits for GetData / ReadData unless it has to be transcoded
+        ktxResult result = ktxTexture_CreateFromNamedFile(texturePath.string().c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &rawData->ktxTexture);
+        if (result != KTX_SUCCESS)
+        {
+            std::cout << "load texture failed, invalid ktx file: " + texturePath.string() << std::endl;
+            rawData->ktxTexture = nullptr;
+            return nullptr;
+        }
+        if (rawData->ktxTexture->classId == ktxTexture2_c && ktxTexture2_NeedsTranscoding((ktxTexture2*)rawData->ktxTexture))
+        {
+            if (ktxTexture_LoadImageData(rawData->ktxTexture, nullptr, 0) != KTX_SUCCESS)
+            {
+                std::cout << "load texture failed, invalid ktx file: " + texturePath.string() << std::endl;
+                return nullptr;
+            }
+            uint32_t componentCount = ktxTexture2_GetNumComponents((ktxTexture2*)rawData->ktxTexture);
+            if (ktxTexture2_TranscodeBasis((ktxTexture2*)rawData->ktxTexture, getTranscodeFormat(componentCount), 0) != KTX_SUCCESS)
+            {
+                std::cout << "load texture failed, transcode failed: " + texturePath.string() << std::endl;
+                return nullptr;
+            }
+            rawData->vkFormat = (vk::Format)((ktxTexture2*)rawData->ktxTexture)->vkFormat;
+            rawData->channel = (int)componentCount;
+            rawData->data = ktxTexture_GetData(rawData->ktxTexture);
+        }
+        else if (rawData->ktxTexture->classId == ktxTexture2_c)
+        {
+            // a copy transcoded ahead of time, read as it is
+            unsigned int length = 0;
+            void* value = nullptr;
+            if (ktxHashList_FindValue(&rawData->ktxTexture->kvDataHead, KTX_COMPONENT_COUNT_KEY, &length, &value) == KTX_SUCCESS && length > 0)
+            {
+                rawData->vkFormat = (vk::Format)((ktxTexture2*)rawData->ktxTexture)->vkFormat;
+                rawData->channel = std::atoi(std::string((const char*)value, length).c_str());
+            }
+        }
         rawData->width = rawData->ktxTexture->baseWidth;
         rawData->height = rawData->ktxTexture->baseHeight;
         rawData->mipLevels = rawData->ktxTexture->numLevels;
-		rawData->data = ktxTexture_GetData(rawData->ktxTexture);
+        rawData->faceCount = rawData->ktxTexture->numFaces;
+        for (uint32_t level = 0; level < (uint32_t)rawData->mipLevels; level++)
+        {
+            rawData->levelSizes.push_back(ktxTexture_GetImageSize(rawData->ktxTexture, level));
+        }
+        if (rawData->mipLevels > 1 || rawData->isCubeMap)
+        {
+            for (uint32_t level = 0; level < (uint32_t)rawData->mipLevels; level++)
+            {
+                for (uint32_t face = 0; face < rawData->faceCount; face++)
+                {
+                    size_t offset = 0;
+                    KTX_error_code ret = ktxTexture_GetImageOffset(rawData->ktxTexture, level, 0, face, &offset);
+                    assert(ret == KTX_SUCCESS);
+                    rawData->levelOffsets.push_back(offset);
+                }
+            }
+        }
     }
     else
     {
         rawData->data = stbi_load(texturePath.string().c_str(), &rawData->width, &rawData->height, &rawData->channel, (int)format);
     }
+    rawData->dataSize = rawData->computeDataSize();
     return rawData->GetDataSize() != 0 ? rawData : nullptr;
 }
 
@@ -128,4 +426,131 @@ vk::SamplerAddressMode Util::Texture::Convert(aiTextureMapMode mapMode)
     }
 }
 
+void Texture::setBlockCompressionSupported(bool supported)
+{
+    g_blockCompressionSupported = supported;
+}
+
+bool Texture::isBlockCompressionSupported()
+{
+    return g_blockCompressionSupported;
+}
+
+bool Texture::isBlockCompressed(vk::Format format)
+{
+    return format >= vk::Format::eBc1RgbUnormBlock && format <= vk::Format::eBc7SrgbBlock;
+}
+
+ktx_transcode_fmt_e Texture::getTranscodeFormat(uint32_t componentCount)
+{
+    if (!isBlockCompressionSupported())
+    {
+        return KTX_TTF_RGBA32;
+    }
+    // one and two component payloads were cooked as rrr1 / rrrg, bc4 / bc5 keep r / r and g of them
+    return componentCount == 1 ? KTX_TTF_BC4_R : (componentCount == 2 ? KTX_TTF_BC5_RG : KTX_TTF_BC7_RGBA);
+}
+
+uint32_t Texture::getMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+uint32_t Texture::getMipTailLevel(uint32_t width, uint32_t height, uint32_t tailSize)
+{
+    uint32_t level = 0;
+    for (uint32_t size = std::max(width, height); size > std::max(tailSize, 1u); size >>= 1)
+    {
+        level++;
+    }
+    return level;
+}
+
+std::vector<unsigned char> Texture::downsample(const unsigned char* src, uint32_t width, uint32_t height, uint32_t channels)
+{
+    uint32_t dstWidth = std::max(width >> 1, 1u);
+    uint32_t dstHeight = std::max(height >> 1, 1u);
+    // a 1 texel wide side repeats its texel instead of reading past it
+    size_t stepX = width > 1 ? channels : 0;
+    size_t stepY = height > 1 ? (size_t)width * channels : 0;
+    std::vector<unsigned char> dst((size_t)dstWidth * dstHeight * channels);
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        const unsigned char* row = src + (size_t)y * 2 * width * channels;
+        unsigned char* out = dst.data() + (size_t)y * dstWidth * channels;
+        // plain loop over bytes, the compiler vectorizes it
+        for (size_t x = 0; x < (size_t)dstWidth * channels; x++)
+        {
+            size_t i = (x / channels) * 2 * channels + x % channels;
+            uint32_t sum = (uint32_t)row[i] + row[i + stepX] + row[i + stepY] + row[i + stepY + stepX];
+            out[x] = (unsigned char)((sum + 2) >> 2);
+        }
+    }
+    return dst;
+}
+
+Texture::Semantic Texture::getSemantic(aiTextureType type)
+{
+    switch (type)
+    {
+    case aiTextureType_DIFFUSE:
+    case aiTextureType_AMBIENT:
+    case aiTextureType_EMISSIVE:
+    case aiTextureType_BASE_COLOR:
+    case aiTextureType_EMISSION_COLOR:
+    {
+        return Semantic::kColor;
+    }
+    // obj bump maps land in height, they are grey height maps as often as normal maps, so they stay data
+    case aiTextureType_NORMALS:
+    case aiTextureType_NORMAL_CAMERA:
+    {
+        return Semantic::kNormal;
+    }
+    default:
+    {
+        return Semantic::kData;
+    }
+    }
+}
+
+const char* Texture::toString(Semantic semantic)
+{
+    switch (semantic)
+    {
+    case Semantic::kColor:
+        return "color";
+    case Semantic::kNormal:
+        return "normal";
+    default:
+        return "data";
+    }
+}
+
+vk::ComponentMapping Texture::getComponentMapping(Semantic semantic, uint32_t channels, vk::Format format)
+{
+    using Swizzle = vk::ComponentSwizzle;
+    // r8 / r8g8 / bc4 / bc5 hold the channels as they are, the rgba8 transcode of a one or two component payload holds rrr1 / rrrg
+    bool narrow = format == vk::Format::eR8Unorm || format == vk::Format::eR8G8Unorm
+                || format == vk::Format::eBc4UnormBlock || format == vk::Format::eBc5UnormBlock;
+    if (channels == 1 && narrow)
+    {
+        return vk::ComponentMapping{Swizzle::eR, Swizzle::eR, Swizzle::eR, Swizzle::eOne};
+    }
+    if (channels == 2 && semantic == Semantic::kNormal && !narrow)
+    {
+        return vk::ComponentMapping{Swizzle::eR, Swizzle::eA, Swizzle::eZero, Swizzle::eOne};
+    }
+    if (channels == 2 && semantic != Semantic::kNormal && narrow)
+    {
+        return vk::ComponentMapping{Swizzle::eR, Swizzle::eR, Swizzle::eR, Swizzle::eG};
+    }
+    return vk::ComponentMapping{};
+}
+
 }
\ No newline at end of file
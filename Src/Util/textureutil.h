@@ -3,11 +3,36 @@
 #include <vulkan/vulkan.hpp>
 #include <assimp/material.h>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <stdint.h>
+#include <utility>
+#include <vector>
 #include <ktx.h>
 namespace Util { namespace Texture {
 
+// set by the device once it knows whether bc formats can be sampled, basis universal ktx2 files are transcoded to bc then, to rgba8 otherwise
+void setBlockCompressionSupported(bool supported);
+bool isBlockCompressionSupported();
+bool isBlockCompressed(vk::Format format);
+// bc4 / bc5 / bc7 by the component count of a basis universal payload when the device samples bc, rgba8 otherwise
+ktx_transcode_fmt_e getTranscodeFormat(uint32_t componentCount);
+// the component count a transcoded copy was made from, transcoding replaces the format descriptor with the one of the target
+constexpr const char* KTX_COMPONENT_COUNT_KEY = "VulkanRHIComponentCount";
 
-class RawData final
+// what a texture holds decides its format: color is srgb, data and normal maps are linear and narrowed to the channels they use
+enum class Semantic
+{
+    kColor,
+    kData,
+    kNormal
+};
+Semantic getSemantic(aiTextureType type);
+const char* toString(Semantic semantic);
+// one decode of a file, the same file referenced as color and as data decodes to different formats
+using DecodeKey = std::pair<boost::filesystem::path, Semantic>;
+
+class RawData final : public std::enable_shared_from_this<RawData>
 {
 public:
     enum class Format
@@ -18,20 +43,66 @@ public:
         eRgb        = 3,
         eRgbAlpha   = 4
     };
+
+    // keeps the payload loaded while it is alive, a FreeData meanwhile is carried out once the last one is released.
+    // raw data is shared between threads, every read of the texels goes through one
+    class Payload
+    {
+    public:
+        Payload() = default;
+        Payload(Payload&& other) noexcept;
+        Payload& operator=(Payload&& other) noexcept;
+        Payload(const Payload&) = delete;
+        Payload& operator=(const Payload&) = delete;
+        ~Payload();
+
+        // nullptr when the payload could not be read
+        inline const unsigned char* Get() const { return m_data; }
+        inline explicit operator bool() const { return m_data != nullptr; }
+    private:
+        friend class RawData;
+        Payload(std::shared_ptr<RawData> rawData, const unsigned char* data);
+        void release();
+
+        std::shared_ptr<RawData> m_rawData;
+        const unsigned char* m_data = nullptr;
+    };
 private:
     int width = 0;
     int height = 0;
     int channel = 0;
     int mipLevels = 1;
+    int dataSize = 0;
     Format format = Format::eRgbAlpha;
     unsigned char* data = nullptr;
     ktxTexture* ktxTexture = nullptr;
+    // owns data once it is narrowed
+    std::vector<unsigned char> storage;
     bool isCubeMap = false;
     vk::Format vkFormat = vk::Format::eR8G8B8A8Unorm;
+    vk::ComponentMapping components;
+    // level * face count + face, kept when the payload is freed
+    std::vector<size_t> levelOffsets;
+    // bytes of one face of each level of a ktx payload
+    std::vector<size_t> levelSizes;
+    uint32_t faceCount = 1;
+    // what Load was called with, to read the payload again once it is freed
+    boost::filesystem::path path;
+    Format loadFormat = Format::eRgbAlpha;
+    vk::Format loadVkFormat = vk::Format::eR8G8B8A8Unorm;
+    std::optional<Semantic> narrowed;
+    uint64_t contentHash = 0;
+    // guards data, ktxTexture and storage
+    std::mutex payloadMutex;
+    uint32_t payloadHolders = 0;
+    // FreeData was called while the payload was held
+    bool freeRequested = false;
 public:
     explicit RawData(Format _format = Format::eRgbAlpha) : format(_format) {}
     ~RawData();
 
+    // frees the payload only, the description stays valid and AcquireData / ReadData read the file again.
+    // a held payload is freed when its last Payload is released
     void FreeData();
     inline int GetWidth() { return width; }
     inline int GetHeight() { return height; }
@@ -39,14 +110,42 @@ public:
     inline int GetMipLevels() { return mipLevels; }
     inline Format GetFormat() { return format; }
     inline vk::Format GetVkFormat() { return vkFormat; }
-    inline unsigned char* GetData() { return data; }
+    inline const vk::ComponentMapping& GetComponents() { return components; }
+    inline void SetComponents(const vk::ComponentMapping& _components) { components = _components; }
+    // ktx files that need no transcoding are read on first use. made by Load, so it can be held past its last owner
+    Payload AcquireData();
+    // writes GetDataSize bytes of payload to dst. a payload not read yet goes from the file straight into dst and is not kept
+    bool ReadData(unsigned char* dst, size_t size);
     inline bool IsCubeMap() { return isCubeMap; }
-    int GetDataSize();
+    inline bool IsCompressed() { return isBlockCompressed(vkFormat); }
+    inline int GetDataSize() { return dataSize; }
     size_t GetLevelOffset(uint32_t level, uint32_t face);
+    size_t GetLevelSize(uint32_t level);
+    // identifies the decoded texels: the source file and how it was decoded, without reading the payload. 0 if the file is gone
+    uint64_t GetContentHash();
+    // a decoded rgba8 image to the format of semantic: srgb for color, r8 / r8g8 for grey data without / with alpha, r8g8 xy for normal maps.
+    // data with distinct channels stays rgba8. channel is the count kept afterwards
+    void Narrow(Semantic semantic);
+private:
+    // with payloadMutex held
+    bool loadData();
+    void freePayload();
+    void releasePayload();
+    int computeDataSize();
 public:
     static std::shared_ptr<RawData> Load(const boost::filesystem::path& texturePath, Format format, bool cubemap = false, vk::Format fmt = vk::Format::eR8G8B8A8Unorm);
 };
 
     vk::SamplerAddressMode Convert(aiTextureMapMode mapMode);
+
+    // maps a texture narrowed to channels components back to the rgba the shaders read: data as grey (+ alpha), normal maps as xy in rg
+    vk::ComponentMapping getComponentMapping(Semantic semantic, uint32_t channels, vk::Format format);
+
+    // levels of a full chain down to 1x1
+    uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+    // first level whose sides are at most tailSize, the levels from there down form the mip tail
+    uint32_t getMipTailLevel(uint32_t width, uint32_t height, uint32_t tailSize);
+    // next level of an 8 bit per channel image, 2x2 box filter, the last row / column of an odd size is dropped
+    std::vector<unsigned char> downsample(const unsigned char* src, uint32_t width, uint32_t height, uint32_t channels);
 }
 }
\ No newline at end of file